@@ -39,15 +39,19 @@ struct Command {
     Function function;
 };
 
+extern const Command check_command;
 extern const Command diff_command;
 extern const Command diff_state_command;
 extern const Command diff_images_command;
 extern const Command dump_command;
 extern const Command dump_images_command;
 extern const Command leaks_command;
+extern const Command optimize_command;
 extern const Command pickle_command;
 extern const Command repack_command;
 extern const Command retrace_command;
 extern const Command sed_command;
+extern const Command snapshot_pack_command;
+extern const Command top_command;
 extern const Command trace_command;
 extern const Command trim_command;
@@ -0,0 +1,413 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h> // for CHAR_MAX
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <snappy.h>
+
+#include "cli.hpp"
+
+#include "crc32c.hpp"
+#include "os_thread.hpp"
+#include "os_time.hpp"
+#include "trace_snappy.hpp"
+
+
+static const char *synopsis = "Verify the integrity of a trace file.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace check [OPTIONS] TRACE_FILE\n"
+        << synopsis << "\n"
+        << "\n"
+        << "Verifies every chunk of a Snappy compressed trace in parallel.  Traces\n"
+        << "recorded with TRACE_CHECKSUMS=1 (or repacked with `apitrace repack -c`)\n"
+        << "are verified against their checksums; older traces are verified by\n"
+        << "validating the compressed data, which is slower.\n"
+        << "\n"
+        << "    -h, --help           Show detailed help for check options and exit\n"
+        << "    -j, --jobs=N         Number of threads (default: number of cpus)\n"
+        << "        --full           Also validate the compressed data of checksummed traces\n"
+        << "        --salvage=FILE   Write the intact chunks preceding the first damaged\n"
+        << "                         one into FILE\n"
+        << "\n";
+}
+
+enum {
+    FULL_OPT = CHAR_MAX + 1,
+    SALVAGE_OPT,
+};
+
+const static char *
+shortOptions = "hj:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"jobs", required_argument, 0, 'j'},
+    {"full", no_argument, 0, FULL_OPT},
+    {"salvage", required_argument, 0, SALVAGE_OPT},
+    {0, 0, 0, 0}
+};
+
+
+enum ChunkStatus {
+    CHUNK_OK = 0,
+    CHUNK_CHECKSUM_MISMATCH,
+    CHUNK_INVALID_DATA,
+    CHUNK_READ_ERROR,
+};
+
+static const char *
+statusDescription(unsigned char status)
+{
+    switch (status) {
+    case CHUNK_OK:
+        return "ok";
+    case CHUNK_CHECKSUM_MISMATCH:
+        return "checksum mismatch";
+    case CHUNK_INVALID_DATA:
+        return "invalid compressed data";
+    case CHUNK_READ_ERROR:
+        return "read error";
+    }
+    assert(0);
+    return "?";
+}
+
+
+struct Chunk
+{
+    uint64_t offset;
+    uint32_t length;
+    uint32_t checksum;
+};
+
+
+class Checker
+{
+public:
+    const char *filename;
+    bool checksums = false;
+    bool full = false;
+
+    size_t headerSize = 4;
+    uint64_t fileSize = 0;
+
+    std::vector<Chunk> chunks;
+    std::vector<unsigned char> status;
+
+    // Offset where the chunks stop being well formed, if not at a clean end
+    bool truncated = false;
+    uint64_t truncatedOffset = 0;
+
+    Checker(const char *_filename) :
+        filename(_filename)
+    {}
+
+    bool
+    scan(void);
+
+    void
+    verify(unsigned numJobs);
+
+private:
+    std::atomic<size_t> nextChunk;
+
+    static void
+    verifyThread(Checker *checker);
+};
+
+
+static inline uint32_t
+decodeUInt32(const unsigned char *buf)
+{
+    return  (uint32_t)buf[0] |
+           ((uint32_t)buf[1] <<  8) |
+           ((uint32_t)buf[2] << 16) |
+           ((uint32_t)buf[3] << 24);
+}
+
+
+/*
+ * Walk the chunk headers, without reading the chunk data.
+ */
+bool
+Checker::scan(void)
+{
+    std::ifstream stream(filename, std::ifstream::binary | std::ifstream::in);
+    if (!stream.is_open()) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return false;
+    }
+
+    stream.seekg(0, std::ios::end);
+    fileSize = stream.tellg();
+    stream.seekg(0, std::ios::beg);
+
+    unsigned char id[2] = {0, 0};
+    stream.read((char *)id, sizeof id);
+    if (!stream || id[0] != SNAPPY_BYTE1 ||
+        (id[1] != SNAPPY_BYTE2 && id[1] != SNAPPY_BYTE2_CHECKSUM)) {
+        std::cerr << "error: " << filename << " is not a Snappy compressed trace\n";
+        return false;
+    }
+    checksums = id[1] == SNAPPY_BYTE2_CHECKSUM;
+    headerSize = checksums ? 8 : 4;
+
+    uint64_t offset = sizeof id;
+    while (offset < fileSize) {
+        if (fileSize - offset < headerSize) {
+            truncated = true;
+            break;
+        }
+
+        unsigned char header[8];
+        stream.seekg(offset, std::ios::beg);
+        stream.read((char *)header, headerSize);
+        if (!stream) {
+            truncated = true;
+            break;
+        }
+
+        Chunk chunk;
+        chunk.offset = offset;
+        chunk.length = decodeUInt32(header);
+        chunk.checksum = checksums ? decodeUInt32(header + 4) : 0;
+
+        // Zero-filled tail of a memory-mapped trace that was not closed
+        if (chunk.length == 0) {
+            break;
+        }
+
+        if (chunk.length > fileSize - offset - headerSize) {
+            truncated = true;
+            break;
+        }
+
+        chunks.push_back(chunk);
+        offset += headerSize + chunk.length;
+    }
+
+    truncatedOffset = offset;
+
+    return true;
+}
+
+
+void
+Checker::verifyThread(Checker *checker)
+{
+    std::ifstream stream(checker->filename, std::ifstream::binary | std::ifstream::in);
+    std::vector<char> buffer;
+
+    // Claim a few consecutive chunks at a time, to keep reads sequential
+    const size_t batchSize = 8;
+
+    size_t numChunks = checker->chunks.size();
+    size_t begin;
+    while ((begin = checker->nextChunk.fetch_add(batchSize)) < numChunks) {
+        size_t end = std::min(begin + batchSize, numChunks);
+        for (size_t i = begin; i < end; ++i) {
+            const Chunk &chunk = checker->chunks[i];
+
+            buffer.resize(chunk.length);
+            stream.clear();
+            stream.seekg(chunk.offset + checker->headerSize, std::ios::beg);
+            stream.read(buffer.data(), chunk.length);
+
+            unsigned char status = CHUNK_OK;
+            if (!stream) {
+                status = CHUNK_READ_ERROR;
+            } else if (checker->checksums &&
+                       crc32c_8bytes(buffer.data(), chunk.length) != chunk.checksum) {
+                status = CHUNK_CHECKSUM_MISMATCH;
+            } else if ((checker->full || !checker->checksums) &&
+                       !snappy::IsValidCompressedBuffer(buffer.data(), chunk.length)) {
+                status = CHUNK_INVALID_DATA;
+            }
+            checker->status[i] = status;
+        }
+    }
+}
+
+
+void
+Checker::verify(unsigned numJobs)
+{
+    status.assign(chunks.size(), CHUNK_OK);
+    nextChunk = 0;
+
+    std::vector<os::thread> threads(numJobs);
+    for (auto & thread : threads) {
+        thread = os::thread(verifyThread, this);
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+}
+
+
+static bool
+salvage(const char *inFileName, const char *outFileName, uint64_t length)
+{
+    std::ifstream in(inFileName, std::ifstream::binary | std::ifstream::in);
+    std::ofstream out(outFileName, std::ofstream::binary | std::ofstream::out | std::ofstream::trunc);
+    if (!in.is_open() || !out.is_open()) {
+        std::cerr << "error: failed to open " << outFileName << " for writing\n";
+        return false;
+    }
+
+    std::vector<char> buffer(1024 * 1024);
+    while (length) {
+        size_t size = std::min<uint64_t>(length, buffer.size());
+        in.read(buffer.data(), size);
+        out.write(buffer.data(), size);
+        if (!in || !out) {
+            std::cerr << "error: failed to write " << outFileName << "\n";
+            return false;
+        }
+        length -= size;
+    }
+
+    return true;
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    unsigned numJobs = 0;
+    bool full = false;
+    const char *salvageFileName = nullptr;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'j':
+            numJobs = atoi(optarg);
+            break;
+        case FULL_OPT:
+            full = true;
+            break;
+        case SALVAGE_OPT:
+            salvageFileName = optarg;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc != optind + 1) {
+        std::cerr << "error: no trace file specified\n";
+        usage();
+        return 1;
+    }
+
+    if (!numJobs) {
+        numJobs = std::max(os::thread::hardware_concurrency(), 1U);
+    }
+
+    Checker checker(argv[optind]);
+    checker.full = full;
+
+    long long startTime = os::getTime();
+
+    if (!checker.scan()) {
+        return 1;
+    }
+    checker.verify(numJobs);
+
+    double seconds = double(os::getTime() - startTime) / os::timeFrequency;
+
+    size_t numChunks = checker.chunks.size();
+    size_t numDamaged = 0;
+    size_t firstDamaged = numChunks;
+    for (size_t i = 0; i < numChunks; ++i) {
+        if (checker.status[i] != CHUNK_OK) {
+            const Chunk &chunk = checker.chunks[i];
+            std::cerr << "error: chunk " << i << " at offset " << chunk.offset
+                      << ": " << statusDescription(checker.status[i]) << "\n";
+            firstDamaged = std::min(firstDamaged, i);
+            ++numDamaged;
+        }
+    }
+    if (checker.truncated) {
+        std::cerr << "error: trace is truncated at offset " << checker.truncatedOffset
+                  << " of " << checker.fileSize << "\n";
+    }
+
+    std::cout << checker.filename << ": " << numChunks << " chunks, "
+              << checker.fileSize << " bytes, "
+              << (checker.checksums ? "with" : "without") << " checksums, "
+              << "verified in " << seconds << " s\n";
+
+    uint64_t intactLength = firstDamaged < numChunks
+                          ? checker.chunks[firstDamaged].offset
+                          : checker.truncatedOffset;
+
+    if (numDamaged || checker.truncated) {
+        std::cout << "the first " << firstDamaged << " chunks (" << intactLength
+                  << " bytes) are intact\n";
+    } else {
+        std::cout << "ok\n";
+    }
+
+    if (salvageFileName) {
+        if (!salvage(checker.filename, salvageFileName, intactLength)) {
+            return 1;
+        }
+        std::cout << "salvaged " << firstDamaged << " chunks into "
+                  << salvageFileName << "\n";
+    }
+
+    return numDamaged || checker.truncated ? 1 : 0;
+}
+
+const Command check_command = {
+    "check",
+    synopsis,
+    usage,
+    command
+};
@@ -33,6 +33,8 @@
 #include "os_process.hpp"
 #include "cli_resources.hpp"
 
+#include "image_pack.hpp"
+
 static const char *synopsis = "Identify differences between two image dumps.";
 
 static os::String
@@ -55,6 +57,34 @@ usage(void)
     os::execute(args);
 }
 
+static bool
+isPack(const char *arg)
+{
+    size_t len = strlen(arg);
+    return arg[0] != '-' &&
+           len > 5 &&
+           strcmp(arg + len - 5, ".pack") == 0;
+}
+
+/*
+ * Unpack a snapshot pack into a directory named after it, so that it can be
+ * compared like a directory of snapshots.
+ */
+static bool
+unpack(const char *filename, os::String &prefix)
+{
+    prefix = filename;
+    prefix.trimExtension();
+    os::createDirectory(prefix);
+    prefix.append(OS_DIR_SEP);
+
+    if (image::extractPack(filename, prefix) < 0) {
+        std::cerr << "error: failed to unpack " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
 static int
 command(int argc, char *argv[])
 {
@@ -62,11 +92,20 @@ command(int argc, char *argv[])
 
     os::String command = find_command();
 
+    std::vector<os::String> prefixes(argc);
+
     std::vector<const char *> args;
     args.push_back(APITRACE_PYTHON_EXECUTABLE);
     args.push_back(command.str());
     for (i = 1; i < argc; i++) {
-        args.push_back(argv[i]);
+        if (isPack(argv[i])) {
+            if (!unpack(argv[i], prefixes[i])) {
+                return 1;
+            }
+            args.push_back(prefixes[i].str());
+        } else {
+            args.push_back(argv[i]);
+        }
     }
     args.push_back(NULL);
 
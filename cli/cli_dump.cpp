@@ -78,6 +78,7 @@ usage(void)
         "                         WHEN is 'auto', 'always', or 'never'\n"
         "    --grep[=REGEX]       dump only calls whose function names match regex\n"
         "    --thread-ids=[=BOOL] dump thread ids [default: no]\n"
+        "    --timestamps[=BOOL]  dump capture-time enter time (s) and duration (us) [default: no]\n"
         "    --call-nos[=BOOL]    dump call numbers[default: yes]\n"
         "    --arg-names[=BOOL]   dump argument names [default: yes]\n"
         "    --blobs              dump blobs into files\n"
@@ -95,6 +96,7 @@ enum {
     ARG_NAMES_OPT,
     BLOBS_OPT,
     MULTILINE_OPT,
+    TIMESTAMPS_OPT,
 };
 
 const static char *
@@ -113,6 +115,7 @@ longOptions[] = {
     {"arg-names", optional_argument, 0, ARG_NAMES_OPT},
     {"blobs", no_argument, 0, BLOBS_OPT},
     {"multiline", optional_argument, 0, MULTILINE_OPT},
+    {"timestamps", optional_argument, 0, TIMESTAMPS_OPT},
     {0, 0, 0, 0}
 };
 
@@ -137,7 +140,7 @@ public:
 
         {
             std::ofstream stream(fileName, std::ofstream::binary);
-            stream.write((const char *)blob->buf, blob->size);
+            stream.write(blob->data(), blob->size);
             stream.close();
         }
 
@@ -218,6 +221,13 @@ command(int argc, char *argv[])
                 dumpFlags |= trace::DUMP_FLAG_NO_MULTILINE;
             }
             break;
+        case TIMESTAMPS_OPT:
+            if (trace::boolOption(optarg)) {
+                dumpFlags |= trace::DUMP_FLAG_TIMESTAMPS;
+            } else {
+                dumpFlags &= ~trace::DUMP_FLAG_TIMESTAMPS;
+            }
+            break;
         case BLOBS_OPT:
             blobs = true;
             break;
@@ -252,6 +262,9 @@ command(int argc, char *argv[])
     for (int i = optind; i < argc; ++i) {
         trace::Parser p;
 
+        // Blob contents are only needed when writing them out
+        p.setLazyBlobs(!blobs);
+
         if (!p.open(argv[i])) {
             return 1;
         }
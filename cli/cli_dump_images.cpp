@@ -55,12 +55,15 @@ usage(void)
         "    -m, --mrt              dump all MRTs and depth/stencil\n"
         "    -o, --output=PREFIX    prefix to use in naming output files\n"
         "                           (default is trace filename without extension)\n"
+        "        --pack=FILE        write all images into a single snapshot pack\n"
+        "                           (see `apitrace snapshot-pack`)\n"
         "\n";
 }
 
 enum {
     CALLS_OPT = CHAR_MAX + 1,
     CALL_NOS_OPT,
+    PACK_OPT,
 };
 
 const static char *
@@ -73,6 +76,7 @@ longOptions[] = {
     {"call-nos", optional_argument, 0, CALL_NOS_OPT},
     {"mrt", no_argument, 0, 'm'},
     {"output", required_argument, 0, 'o'},
+    {"pack", required_argument, 0, PACK_OPT},
     {0, 0, 0, 0}
 };
 
@@ -84,6 +88,7 @@ command(int argc, char *argv[])
     const char *traceName = NULL;
     const char *output = NULL;
     std::string call_nos;
+    std::string pack;
     bool mrt = false;
 
     int opt;
@@ -105,6 +110,10 @@ command(int argc, char *argv[])
         case 'o':
             output = optarg;
             break;
+        case PACK_OPT:
+            pack = "--snapshot-pack=";
+            pack.append(optarg);
+            break;
         default:
             std::cerr << "error: unexpected option `" << (char)opt << "`\n";
             usage();
@@ -136,8 +145,12 @@ command(int argc, char *argv[])
 
     std::vector<const char *> opts;
 
-    opts.push_back("-s");
-    opts.push_back(output);
+    if (pack.empty()) {
+        opts.push_back("-s");
+        opts.push_back(output);
+    } else {
+        opts.push_back(pack.c_str());
+    }
     opts.push_back("-S");
     if (calls)
         opts.push_back(calls);
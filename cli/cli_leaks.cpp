@@ -26,57 +26,182 @@
  *********************************************************************/
 
 #include <string.h>
+#include <limits.h> // for CHAR_MAX
+#include <getopt.h>
+
 #include <iostream>
 
 #include "cli.hpp"
-#include "os_string.hpp"
-#include "os_process.hpp"
-#include "cli_resources.hpp"
+
+#include "trace_parser.hpp"
+#include "trace_lifetime.hpp"
+
 
 static const char *synopsis = "Check trace for object leaks.";
 
-static os::String
-find_command(void)
+
+static void
+usage(void)
 {
-    return findScript("leaks.py");
+    std::cout
+        << "usage: apitrace leaks [OPTIONS] TRACE_FILE\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help           Show detailed help for leaks options and exit\n"
+        "        --objects        List the lifetime of every object\n"
+        "        --frames         List the live objects and buffer bytes at the end of\n"
+        "                         every frame\n"
+        "\n"
+        "Objects which are not deleted before the last context is destroyed, or\n"
+        "before the end of the trace, are reported as leaks on stderr.\n"
+    ;
 }
 
+
+enum {
+    OBJECTS_OPT = CHAR_MAX + 1,
+    FRAMES_OPT,
+};
+
+const static char *
+shortOptions = "h";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"objects", no_argument, 0, OBJECTS_OPT},
+    {"frames", no_argument, 0, FRAMES_OPT},
+    {0, 0, 0, 0}
+};
+
+
+static std::ostream &
+operator << (std::ostream &os, const trace::ObjectLifetime &object)
+{
+    os << object.kind << " ";
+    if (strcmp(object.kind, "context") == 0) {
+        os << "0x" << std::hex << object.name << std::dec;
+    } else {
+        os << object.name;
+    }
+    return os;
+}
+
+
 static void
-usage(void)
+writeCallNo(std::ostream &os, trace::CallNo callNo)
 {
-    os::String command = find_command();
+    if (callNo == trace::NO_CALL) {
+        os << "-";
+    } else {
+        os << callNo;
+    }
+}
 
-    char *args[4];
-    args[0] = (char *) APITRACE_PYTHON_EXECUTABLE;
-    args[1] = (char *) command.str();
-    args[2] = (char *) "--help";
-    args[3] = NULL;
 
-    os::execute(args);
+static int
+leaks_trace(const char *filename, bool listObjects, bool listFrames)
+{
+    trace::Parser p;
+
+    if (!p.open(filename)) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return 1;
+    }
+
+    trace::LifetimeTracker tracker;
+
+    trace::Call *call;
+    while ((call = p.parse_call())) {
+        tracker.handleCall(*call);
+        delete call;
+    }
+
+    tracker.finish();
+
+    const std::vector<trace::ObjectLifetime> &objects = tracker.getObjects();
+
+    for (auto & object : objects) {
+        // Contexts are often left for the window system to destroy
+        if (object.leaked && strcmp(object.kind, "context") != 0) {
+            std::cerr << object.created << ": error: " << object << " was not destroyed until ";
+            if (object.deleted == trace::NO_CALL) {
+                std::cerr << "<EOF>";
+            } else {
+                std::cerr << object.deleted;
+            }
+            std::cerr << " (last used in call " << object.lastUsed << ")\n";
+        }
+    }
+
+    if (listObjects) {
+        std::cout << "# kind name created last-used deleted frame size\n";
+        for (auto & object : objects) {
+            std::cout << object << " " << object.created << " ";
+            writeCallNo(std::cout, object.lastUsed);
+            std::cout << " ";
+            writeCallNo(std::cout, object.leaked ? trace::NO_CALL : object.deleted);
+            std::cout << " " << object.createdFrame << " " << object.size << "\n";
+        }
+    }
+
+    if (listFrames) {
+        std::cout << "# frame last-call live-objects live-bytes\n";
+        for (auto & frame : tracker.getFrames()) {
+            std::cout << frame.frame << " " << frame.lastCall << " "
+                      << frame.liveObjects << " " << frame.liveBytes << "\n";
+        }
+    }
+
+    return 0;
 }
 
+
 static int
 command(int argc, char *argv[])
 {
-    int i;
+    bool listObjects = false;
+    bool listFrames = false;
 
-    os::String command = find_command();
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case OBJECTS_OPT:
+            listObjects = true;
+            break;
+        case FRAMES_OPT:
+            listFrames = true;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
 
-    os::String apitracePath = os::getProcessName();
+    if (optind >= argc) {
+        std::cerr << "error: apitrace leaks requires a trace file as an argument.\n";
+        usage();
+        return 1;
+    }
 
-    std::vector<const char *> args;
-    args.push_back(APITRACE_PYTHON_EXECUTABLE);
-    args.push_back(command.str());
-    args.push_back("--apitrace");
-    args.push_back(apitracePath.str());
-    for (i = 1; i < argc; i++) {
-        args.push_back(argv[i]);
+    if (argc > optind + 1) {
+        std::cerr << "error: extraneous arguments:";
+        for (int i = optind + 1; i < argc; i++) {
+            std::cerr << " " << argv[i];
+        }
+        std::cerr << "\n";
+        usage();
+        return 1;
     }
-    args.push_back(NULL);
 
-    return os::execute((char * const *)&args[0]);
+    return leaks_trace(argv[optind], listObjects, listFrames);
 }
 
+
 const Command leaks_command = {
     "leaks",
     synopsis,
@@ -66,16 +66,20 @@ const Command help_command = {
 };
 
 static const Command * commands[] = {
+    &check_command,
     &diff_command,
     &diff_state_command,
     &diff_images_command,
     &dump_command,
     &dump_images_command,
     &leaks_command,
+    &optimize_command,
     &pickle_command,
     &sed_command,
+    &snapshot_pack_command,
     &repack_command,
     &retrace_command,
+    &top_command,
     &trace_command,
     &trim_command,
     &help_command
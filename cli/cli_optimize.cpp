@@ -0,0 +1,245 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Removal of redundant OpenGL state calls, as found by trace::StateOptimizer.
+ */
+
+
+#include <string.h>
+#include <limits.h> // for CHAR_MAX
+#include <getopt.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cli.hpp"
+
+#include "os_string.hpp"
+
+#include "trace_optimizer.hpp"
+#include "trace_parser.hpp"
+#include "trace_writer.hpp"
+
+
+static const char *synopsis = "Remove redundant state calls from a trace.";
+
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace optimize [OPTIONS] TRACE_FILE\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help               Show detailed help for optimize options and exit\n"
+        "    -o, --output=TRACE_FILE  Output trace file\n"
+        "        --remap=FILE         Write a table mapping the call numbers of the\n"
+        "                             output trace to those of the input trace.\n"
+        "                             Each `NEW ORIG` line means that calls NEW and\n"
+        "                             onwards correspond to calls ORIG and onwards,\n"
+        "                             up to the next line.\n"
+        "    -v, --verbose            List every removed call\n"
+        "\n"
+        "Calls which bind the currently bound object (textures, buffers, vertex\n"
+        "arrays, programs), enable or disable capabilities to their current\n"
+        "state, or set uniforms to their current value are removed.\n"
+    ;
+}
+
+
+enum {
+    REMAP_OPT = CHAR_MAX + 1,
+};
+
+const static char *
+shortOptions = "ho:v";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"output", required_argument, 0, 'o'},
+    {"remap", required_argument, 0, REMAP_OPT},
+    {"verbose", no_argument, 0, 'v'},
+    {0, 0, 0, 0}
+};
+
+
+struct optimize_options {
+    std::string output;
+    std::string remap;
+    bool verbose = false;
+};
+
+
+static int
+optimize_trace(const char *filename, optimize_options &options)
+{
+    trace::Parser p;
+
+    if (!p.open(filename)) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return 1;
+    }
+
+    if (options.output.empty()) {
+        os::String base(filename);
+        base.trimExtension();
+
+        options.output = std::string(base.str()) + std::string("-optimized.trace");
+    }
+
+    trace::Writer writer;
+    if (!writer.open(options.output.c_str(), p.getVersion(), p.getProperties())) {
+        std::cerr << "error: failed to create " << options.output << "\n";
+        return 1;
+    }
+
+    std::ofstream remap;
+    if (!options.remap.empty()) {
+        remap.open(options.remap.c_str());
+        if (!remap) {
+            std::cerr << "error: failed to create " << options.remap << "\n";
+            return 1;
+        }
+    }
+
+    trace::StateOptimizer optimizer;
+
+    struct FunctionCount {
+        unsigned long long total = 0;
+        unsigned long long removed = 0;
+    };
+    std::map<std::string, FunctionCount> counts;
+
+    unsigned long long numCalls = 0;
+    unsigned long long numRemoved = 0;
+    bool remapped = false;
+
+    trace::Call *call;
+    while ((call = p.parse_call())) {
+        FunctionCount &count = counts[call->sig->name];
+        ++count.total;
+        ++numCalls;
+
+        if (optimizer.isRedundant(call)) {
+            ++count.removed;
+            ++numRemoved;
+            remapped = false;
+            if (options.verbose) {
+                std::cerr << call->no << " " << call->sig->name << " removed\n";
+            }
+        } else {
+            if (remap.is_open() && !remapped) {
+                remap << (call->no - numRemoved) << " " << call->no << "\n";
+                remapped = true;
+            }
+            writer.writeCall(call);
+        }
+
+        delete call;
+    }
+
+    std::cerr << "Removed " << numRemoved << " of " << numCalls << " calls\n";
+
+    std::vector<std::pair<std::string, FunctionCount>> sorted;
+    for (auto & it : counts) {
+        if (it.second.removed) {
+            sorted.push_back(it);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<std::string, FunctionCount> &a,
+                 const std::pair<std::string, FunctionCount> &b) {
+                  return a.second.removed > b.second.removed;
+              });
+    for (auto & it : sorted) {
+        std::cerr << "  " << it.first << ": " << it.second.removed << " of " << it.second.total << " removed\n";
+    }
+
+    std::cerr << "Optimized trace is available as " << options.output << "\n";
+
+    return 0;
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    optimize_options options;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'o':
+            options.output = optarg;
+            break;
+        case REMAP_OPT:
+            options.remap = optarg;
+            break;
+        case 'v':
+            options.verbose = true;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "error: apitrace optimize requires a trace file as an argument.\n";
+        usage();
+        return 1;
+    }
+
+    if (argc > optind + 1) {
+        std::cerr << "error: extraneous arguments:";
+        for (int i = optind + 1; i < argc; i++) {
+            std::cerr << " " << argv[i];
+        }
+        std::cerr << "\n";
+        usage();
+        return 1;
+    }
+
+    return optimize_trace(argv[optind], options);
+}
+
+
+const Command optimize_command = {
+    "optimize",
+    synopsis,
+    usage,
+    command
+};
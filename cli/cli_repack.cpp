@@ -52,19 +52,21 @@ usage(void)
         << "Snappy compression allows for faster replay and smaller memory footprint,\n"
         << "at the expense of a slightly smaller compression ratio than zlib\n"
         << "\n"
-        << "    -b,--brotli  Use Brotli compression\n"
-        << "    -z,--zlib    Use ZLib compression\n"
+        << "    -b,--brotli    Use Brotli compression\n"
+        << "    -z,--zlib      Use ZLib compression\n"
+        << "    -c,--checksum  Add per-chunk checksums to Snappy output\n"
         << "\n";
 }
 
 const static char *
-shortOptions = "hbz";
+shortOptions = "hbzc";
 
 const static struct option
 longOptions[] = {
     {"help", no_argument, 0, 'h'},
     {"brotli", optional_argument, 0, 'b'},
     {"zlib", no_argument, 0, 'z'},
+    {"checksum", no_argument, 0, 'c'},
     {0, 0, 0, 0}
 };
 
@@ -188,7 +190,8 @@ repack_brotli(trace::File *inFile, const char *outFileName, int quality)
 }
 
 static int
-repack(const char *inFileName, const char *outFileName, Format format, int quality)
+repack(const char *inFileName, const char *outFileName, Format format, int quality,
+       bool checksums)
 {
     int ret = EXIT_FAILURE;
 
@@ -199,7 +202,7 @@ repack(const char *inFileName, const char *outFileName, Format format, int quali
 
     trace::OutStream *outFile = nullptr;
     if (format == FORMAT_SNAPPY) {
-        outFile = trace::createSnappyStream(outFileName);
+        outFile = trace::createSnappyStream(outFileName, checksums);
     } else if (format == FORMAT_BROTLI) {
         ret = repack_brotli(inFile, outFileName, quality);
         delete inFile;
@@ -223,6 +226,7 @@ command(int argc, char *argv[])
     Format format = FORMAT_SNAPPY;
     int opt;
     int quality = -1;
+    bool checksums = false;
     while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
         switch (opt) {
         case 'h':
@@ -237,6 +241,9 @@ command(int argc, char *argv[])
         case 'z':
             format = FORMAT_ZLIB;
             break;
+        case 'c':
+            checksums = true;
+            break;
         default:
             std::cerr << "error: unexpected option `" << (char)opt << "`\n";
             usage();
@@ -250,7 +257,12 @@ command(int argc, char *argv[])
         return 1;
     }
 
-    return repack(argv[optind], argv[optind + 1], format, quality);
+    if (checksums && format != FORMAT_SNAPPY) {
+        std::cerr << "error: checksums are only supported with Snappy compression\n";
+        return 1;
+    }
+
+    return repack(argv[optind], argv[optind + 1], format, quality, checksums);
 }
 
 const Command repack_command = {
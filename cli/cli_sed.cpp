@@ -130,10 +130,9 @@ public:
     void visit(String *node) override {
         if (!searchString.compare(node->value)) {
             size_t len = replaceString.length() + 1;
-            delete [] node->value;
             char *str = new char [len];
             memcpy(str, replaceString.c_str(), len);
-            node->value = str;
+            node->setValue(str);
         }
     }
 
@@ -0,0 +1,211 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h> // for CHAR_MAX
+#include <getopt.h>
+
+#include <iostream>
+#include <string>
+
+#include "cli.hpp"
+
+#include "os_string.hpp"
+
+#include "trace_callset.hpp"
+#include "trace_option.hpp"
+
+#include "image_pack.hpp"
+
+
+static const char *synopsis = "List or extract the snapshots of a snapshot pack.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace snapshot-pack list PACK\n"
+        << "       apitrace snapshot-pack extract [OPTIONS] PACK\n"
+        << synopsis << "\n"
+        "\n"
+        "Snapshot packs are written by `glretrace --snapshot-pack=FILE`.\n"
+        "\n"
+        "    -h, --help             show this help message and exit\n"
+        "        --calls=CALLSET    extract only snapshots of these calls\n"
+        "        --call-nos[=BOOL]  use call numbers in image filenames,\n"
+        "                           otherwise use sequential numbers (default=yes)\n"
+        "    -o, --output=PREFIX    prefix to use in naming output files\n"
+        "                           (default is pack filename without extension)\n"
+        "\n";
+}
+
+enum {
+    CALLS_OPT = CHAR_MAX + 1,
+    CALL_NOS_OPT,
+};
+
+const static char *
+shortOptions = "ho:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"calls", required_argument, 0, CALLS_OPT},
+    {"call-nos", optional_argument, 0, CALL_NOS_OPT},
+    {"output", required_argument, 0, 'o'},
+    {0, 0, 0, 0}
+};
+
+
+static int
+listPack(image::PackReader &reader)
+{
+    if (!reader.isComplete()) {
+        std::cerr << "warning: pack has no index (incomplete replay?), records were scanned\n";
+    }
+
+    std::cout << "snapshot  call        mrt       format  size\n";
+    for (size_t i = 0; i < reader.size(); ++i) {
+        const image::PackEntry &entry = reader.entry(i);
+
+        std::string mrt;
+        if (entry.mrt == -2) {
+            mrt = "stencil";
+        } else if (entry.mrt == -1) {
+            mrt = "depth";
+        } else {
+            mrt = std::to_string(entry.mrt);
+        }
+
+        char line[128];
+        snprintf(line, sizeof line, "%-9u %-11u %-9s %-7s %u\n",
+                 entry.snapshotNo, entry.callNo, mrt.c_str(),
+                 image::packFormatExtension(entry.format), entry.size);
+        std::cout << line;
+    }
+
+    return 0;
+}
+
+
+static int
+extractPack(image::PackReader &reader, const char *prefix,
+            const trace::CallSet &calls, bool useCallNos)
+{
+    unsigned numExtracted = 0;
+    for (size_t i = 0; i < reader.size(); ++i) {
+        const image::PackEntry &entry = reader.entry(i);
+        if (!calls.contains(entry.callNo)) {
+            continue;
+        }
+
+        if (!reader.extract(i, prefix, useCallNos)) {
+            std::cerr << "error: failed to extract snapshot of call " << entry.callNo << "\n";
+            return 1;
+        }
+
+        ++numExtracted;
+    }
+
+    std::cerr << "Extracted " << numExtracted << " of " << reader.size() << " snapshots\n";
+    return 0;
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    trace::CallSet calls(trace::FREQUENCY_ALL);
+    bool useCallNos = true;
+    const char *output = NULL;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case CALLS_OPT:
+            calls.merge(optarg);
+            break;
+        case CALL_NOS_OPT:
+            useCallNos = trace::boolOption(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: apitrace snapshot-pack requires an action and a pack file as arguments.\n";
+        usage();
+        return 1;
+    }
+
+    const char *action = argv[optind];
+    const char *packName = argv[optind + 1];
+
+    bool list = strcmp(action, "list") == 0;
+    if (!list && strcmp(action, "extract") != 0) {
+        std::cerr << "error: unknown action `" << action << "`\n";
+        usage();
+        return 1;
+    }
+
+    image::PackReader reader;
+    if (!reader.open(packName)) {
+        std::cerr << "error: failed to open snapshot pack " << packName << "\n";
+        return 1;
+    }
+
+    if (list) {
+        return listPack(reader);
+    }
+
+    os::String prefix;
+    if (output == NULL) {
+        prefix = packName;
+        prefix.trimDirectory();
+        prefix.trimExtension();
+        prefix.append('.');
+        output = prefix.str();
+    }
+
+    return extractPack(reader, output, calls, useCallNos);
+}
+
+const Command snapshot_pack_command = {
+    "snapshot-pack",
+    synopsis,
+    usage,
+    command
+};
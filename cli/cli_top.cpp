@@ -0,0 +1,317 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "cli.hpp"
+
+#include "os_time.hpp"
+#include "trace_telemetry.hpp"
+
+
+static const char *synopsis = "Show live statistics of a process being traced.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace top [OPTIONS] [PID]\n"
+        << synopsis << "\n"
+        << "\n"
+        << "The traced process must run with TRACE_TELEMETRY=1.  When PID is omitted,\n"
+        << "the process being traced is found automatically (Linux only).\n"
+        << "\n"
+        << "    -h, --help               Show detailed help for top options and exit\n"
+        << "    -i, --interval=SECONDS   Update interval (default 1)\n"
+        << "    -n, --iterations=N       Exit after N updates\n"
+        << "    -b, --batch              Append updates instead of redrawing the screen\n"
+        << "\n";
+}
+
+const static char *
+shortOptions = "hi:n:b";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"interval", required_argument, 0, 'i'},
+    {"iterations", required_argument, 0, 'n'},
+    {"batch", no_argument, 0, 'b'},
+    {0, 0, 0, 0}
+};
+
+
+struct Sample
+{
+    long long time;
+    uint64_t calls;
+    uint64_t discardedCalls;
+    uint64_t frames;
+    uint64_t bytesWritten;
+    uint64_t bytesCompressed;
+    uint64_t bytesPending;
+    uint64_t compressTime;
+    uint64_t mutexWaitTime;
+    uint64_t mutexWaits;
+    uint64_t largestBlobSize;
+    uint64_t largestBlobCall;
+
+    void
+    take(const trace::Telemetry *t) {
+        time = os::getTime();
+        calls = trace::Telemetry::get(t->calls);
+        discardedCalls = trace::Telemetry::get(t->discardedCalls);
+        frames = trace::Telemetry::get(t->frames);
+        bytesWritten = trace::Telemetry::get(t->bytesWritten);
+        bytesCompressed = trace::Telemetry::get(t->bytesCompressed);
+        bytesPending = trace::Telemetry::get(t->bytesPending);
+        compressTime = trace::Telemetry::get(t->compressTime);
+        mutexWaitTime = trace::Telemetry::get(t->mutexWaitTime);
+        mutexWaits = trace::Telemetry::get(t->mutexWaits);
+        largestBlobSize = trace::Telemetry::get(t->largestBlobSize);
+        largestBlobCall = trace::Telemetry::get(t->largestBlobCall);
+    }
+};
+
+
+static const char *
+formatBytes(char *buf, size_t size, double bytes)
+{
+    static const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    unsigned unit = 0;
+    while (bytes >= 1024.0 && unit + 1 < sizeof units / sizeof units[0]) {
+        bytes /= 1024.0;
+        ++unit;
+    }
+    snprintf(buf, size, "%.1f %s", bytes, units[unit]);
+    return buf;
+}
+
+
+static void
+display(const trace::Telemetry *t, const Sample &prev, const Sample &curr,
+        bool redraw)
+{
+    double seconds = double(curr.time - prev.time) / os::timeFrequency;
+    if (seconds <= 0) {
+        seconds = 1.0;
+    }
+    // Tracer-side times are in the traced process' ticks
+    double ticks = seconds * t->timeFrequency;
+
+    char a[32], b[32];
+
+    if (redraw) {
+        // Clear the screen and home the cursor
+        printf("\33[H\33[2J");
+    }
+
+    printf("apitrace top - %s (pid %llu)\n\n",
+           t->processName, (unsigned long long)t->pid);
+
+    printf("  calls          %12.0f/s   (%.0f/s discarded, %llu total)\n",
+           (curr.calls - prev.calls) / seconds,
+           (curr.discardedCalls - prev.discardedCalls) / seconds,
+           (unsigned long long)curr.calls);
+    printf("  frames         %12.1f/s   (%llu total)\n",
+           (curr.frames - prev.frames) / seconds,
+           (unsigned long long)curr.frames);
+    printf("  written        %12s/s   (%s total)\n",
+           formatBytes(a, sizeof a, (curr.bytesWritten - prev.bytesWritten) / seconds),
+           formatBytes(b, sizeof b, curr.bytesWritten));
+
+    uint64_t compressed = curr.bytesCompressed - prev.bytesCompressed;
+    printf("  compressed     %12s/s   (%s total, ratio %.2f)\n",
+           formatBytes(a, sizeof a, compressed / seconds),
+           formatBytes(b, sizeof b, curr.bytesCompressed),
+           curr.bytesCompressed ? double(curr.bytesWritten - curr.bytesPending) / curr.bytesCompressed : 0.0);
+    printf("  pending        %12s\n",
+           formatBytes(a, sizeof a, curr.bytesPending));
+    printf("  compress time  %12.1f%%\n",
+           100.0 * (curr.compressTime - prev.compressTime) / ticks);
+    printf("  mutex wait     %12.1f%%    (%.0f/s contended)\n",
+           100.0 * (curr.mutexWaitTime - prev.mutexWaitTime) / ticks,
+           (curr.mutexWaits - prev.mutexWaits) / seconds);
+    if (curr.largestBlobSize) {
+        printf("  largest blob   %12s    (call %llu)\n",
+               formatBytes(a, sizeof a, curr.largestBlobSize),
+               (unsigned long long)curr.largestBlobCall);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+
+static bool
+isProcessAlive(unsigned long pid)
+{
+#ifdef _WIN32
+    return true;
+#else
+    return kill(pid, 0) == 0 || errno != ESRCH;
+#endif
+}
+
+
+/*
+ * List the IDs of the running processes which published telemetry.
+ */
+static std::vector<unsigned long>
+findProcesses(void)
+{
+    std::vector<unsigned long> pids;
+#ifdef __linux__
+    DIR *dir = opendir("/dev/shm");
+    if (dir) {
+        static const char prefix[] = "apitrace.";
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (strncmp(entry->d_name, prefix, strlen(prefix)) == 0) {
+                const char *digits = entry->d_name + strlen(prefix);
+                char *end;
+                unsigned long pid = strtoul(digits, &end, 10);
+                if (end == digits || *end != 0) {
+                    continue;
+                }
+                if (isProcessAlive(pid)) {
+                    pids.push_back(pid);
+                } else {
+                    // Left behind by a process which crashed while tracing
+                    trace::TelemetrySegment::remove(pid);
+                }
+            }
+        }
+        closedir(dir);
+    }
+#endif
+    return pids;
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    double interval = 1.0;
+    long iterations = -1;
+    bool batch = false;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'i':
+            interval = atof(optarg);
+            if (interval <= 0) {
+                std::cerr << "error: invalid interval " << optarg << "\n";
+                return 1;
+            }
+            break;
+        case 'n':
+            iterations = atol(optarg);
+            break;
+        case 'b':
+            batch = true;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    unsigned long pid;
+    if (optind < argc) {
+        pid = strtoul(argv[optind], NULL, 10);
+    } else {
+        std::vector<unsigned long> pids = findProcesses();
+        if (pids.empty()) {
+            std::cerr << "error: no traced process found (was it started with TRACE_TELEMETRY=1?)\n";
+            return 1;
+        }
+        if (pids.size() > 1) {
+            std::cerr << "error: several traced processes found, please choose one:";
+            for (auto p : pids) {
+                std::cerr << " " << p;
+            }
+            std::cerr << "\n";
+            return 1;
+        }
+        pid = pids[0];
+    }
+
+    trace::TelemetrySegment segment;
+    if (!segment.open(pid)) {
+        std::cerr << "error: no telemetry for process " << pid << " (was it started with TRACE_TELEMETRY=1?)\n";
+        return 1;
+    }
+    const trace::Telemetry *telemetry = segment.get();
+
+    bool redraw = !batch && isatty(fileno(stdout));
+
+    Sample prev, curr;
+    prev.take(telemetry);
+
+    for (long i = 0; iterations < 0 || i < iterations; ++i) {
+        os::sleep((unsigned long)(interval * 1000000.0));
+
+        curr.take(telemetry);
+        display(telemetry, prev, curr, redraw);
+        prev = curr;
+
+        if (telemetry->closed.load(std::memory_order_relaxed) ||
+            !isProcessAlive(pid)) {
+            std::cout << "process " << pid << " finished tracing\n";
+            break;
+        }
+    }
+
+    return 0;
+}
+
+const Command top_command = {
+    "top",
+    synopsis,
+    usage,
+    command
+};
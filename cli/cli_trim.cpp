@@ -39,6 +39,11 @@
 
 static const char *synopsis = "Create a new trace by trimming an existing trace.";
 
+/*
+ * Blobs at least this large are only read if the call is kept.
+ */
+#define TRIM_LAZY_BLOB_MIN_SIZE (256*1024)
+
 static void
 usage(void)
 {
@@ -99,6 +104,10 @@ trim_trace(const char *filename, struct trim_options *options)
     trace::Parser p;
     unsigned frame;
 
+    // Only the blobs of the calls we keep need to be read.  Reading a
+    // deferred blob means seeking back to it, so small blobs aren't worth it.
+    p.setLazyBlobs(true, TRIM_LAZY_BLOB_MIN_SIZE);
+
     if (!p.open(filename)) {
         std::cerr << "error: failed to open " << filename << "\n";
         return 1;
@@ -6,6 +6,11 @@
 
 #include <QDebug>
 #include <QSysInfo>
+#include <QVarLengthArray>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "image.hpp"
 
@@ -154,71 +159,132 @@ static inline unsigned char clamp(float x)
 }
 
 
-QImage
-ApiSurface::qimageFromRawImage(const image::Image *image,
-                               float lowerValue,
-                               float upperValue,
-                               bool opaque,
-                               bool alpha)
+/*
+ * Range-maps n floats to bytes, i.e., clamp((src[i] + offset) * scale).
+ */
+static void
+mapFloatRange(const float *src, unsigned char *dst, int n,
+              float offset, float scale)
 {
-    QImage img;
-    int width = image->width;
-    int height = image->height;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 vOffset = _mm_set1_ps(offset);
+    const __m128 vScale = _mm_set1_ps(scale);
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vMax = _mm_set1_ps(255.0f);
+    const __m128 vHalf = _mm_set1_ps(0.5f);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v[4];
+        for (int j = 0; j < 4; ++j) {
+            __m128 f = _mm_loadu_ps(src + i + 4*j);
+            f = _mm_mul_ps(_mm_add_ps(f, vOffset), vScale);
+            // max() first, so that NaNs become zero
+            f = _mm_min_ps(_mm_max_ps(f, vZero), vMax);
+            v[j] = _mm_cvttps_epi32(_mm_add_ps(f, vHalf));
+        }
+        __m128i lo = _mm_packs_epi32(v[0], v[1]);
+        __m128i hi = _mm_packs_epi32(v[2], v[3]);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = clamp((src[i] + offset) * scale);
+    }
+}
 
-    img = QImage(width, height, QImage::Format_ARGB32);
 
-    int offset = - lowerValue * 255;
-    int scale = 256 / (upperValue - lowerValue);
+void
+ApiSurface::convertRawImage(const image::Image *image,
+                            QImage &dst,
+                            const QRect &rect,
+                            bool flip,
+                            float lowerValue,
+                            float upperValue,
+                            bool opaque,
+                            bool alpha)
+{
+    Q_ASSERT(dst.format() == QImage::Format_ARGB32);
+    Q_ASSERT(dst.width() >= rect.width() && dst.height() >= rect.height());
+
+    const int channels = image->channels;
+    const int width = rect.width();
+
+    /* UNORM8 values go through a lookup table */
+    unsigned char lut[256];
+    if (image->channelType == image::TYPE_UNORM8) {
+        int offset = - lowerValue * 255;
+        int scale = 256 / (upperValue - lowerValue);
+        for (int v = 0; v < 256; ++v) {
+            lut[v] = clamp(((v + offset) * scale) >> 8);
+        }
+    }
 
     float offset_f = - lowerValue;
     float scale_f = 255.0f / (upperValue - lowerValue);
 
-    int aMask = (opaque || alpha) ? 0xff : 0;
+    unsigned char aMask = (opaque || alpha) ? 0xff : 0;
 
-    const unsigned char *srcRow = image->start();
-    for (int y = 0; y < height; ++y) {
-        QRgb *dst = (QRgb *)img.scanLine(y);
+    QVarLengthArray<unsigned char, 4096> bytes(width * channels);
+
+    for (int y = 0; y < rect.height(); ++y) {
+        int srcY = rect.y() + y;
+        if (flip) {
+            srcY = image->height - 1 - srcY;
+        }
+        const unsigned char *srcRow = image->start()
+                                    + (ptrdiff_t)srcY * image->stride()
+                                    + rect.x() * image->bytesPerPixel;
 
+        unsigned char *b = bytes.data();
         if (image->channelType == image::TYPE_UNORM8) {
-            const unsigned char *src = srcRow;
-            for (int x = 0; x < width; ++x) {
-                unsigned char rgba[4] = {0, 0, 0, 0xff};
-                for (int c = 0; c < image->channels; ++c) {
-                    rgba[c] = clamp(((*src++ + offset) * scale) >> 8);
-                }
-                if (image->channels == 1) {
-                    // Use gray-scale instead of red
-                    rgba[1] = rgba[0];
-                    rgba[2] = rgba[0];
-                }
-                if (alpha) {
-                    rgba[2] = rgba[1] = rgba[0] = rgba[3];
-                }
-                rgba[3] |= aMask;
-                dst[x] = qRgba(rgba[0], rgba[1], rgba[2], rgba[3]);
+            for (int i = 0; i < width * channels; ++i) {
+                b[i] = lut[srcRow[i]];
             }
         } else {
-            const float *src = (const float *)srcRow;
-            for (int x = 0; x < width; ++x) {
-                unsigned char rgba[4] = {0, 0, 0, 0xff};
-                for (int c = 0; c < image->channels; ++c) {
-                    rgba[c] = clamp((*src++ + offset_f)*scale_f);
-                }
-                if (image->channels == 1) {
-                    // Use gray-scale instead of red
-                    rgba[1] = rgba[0];
-                    rgba[2] = rgba[0];
-                }
-                if (alpha) {
-                    rgba[2] = rgba[1] = rgba[0] = rgba[3];
-                }
-                rgba[3] |= aMask;
-                dst[x] = qRgba(rgba[0], rgba[1], rgba[2], rgba[3]);
-            }
+            mapFloatRange((const float *)srcRow, b, width * channels,
+                          offset_f, scale_f);
         }
 
-        srcRow += image->stride();
+        QRgb *dstRow = (QRgb *)dst.scanLine(y);
+        for (int x = 0; x < width; ++x, b += channels) {
+            unsigned char rgba[4] = {0, 0, 0, 0xff};
+            switch (channels) {
+            case 1:
+                // Use gray-scale instead of red
+                rgba[0] = rgba[1] = rgba[2] = b[0];
+                break;
+            case 4:
+                rgba[3] = b[3];
+                /* fall-through */
+            case 3:
+                rgba[2] = b[2];
+                /* fall-through */
+            case 2:
+                rgba[1] = b[1];
+                rgba[0] = b[0];
+                break;
+            }
+            if (alpha) {
+                rgba[2] = rgba[1] = rgba[0] = rgba[3];
+            }
+            rgba[3] |= aMask;
+            dstRow[x] = qRgba(rgba[0], rgba[1], rgba[2], rgba[3]);
+        }
     }
+}
+
+
+QImage
+ApiSurface::qimageFromRawImage(const image::Image *image,
+                               float lowerValue,
+                               float upperValue,
+                               bool opaque,
+                               bool alpha)
+{
+    QImage img(image->width, image->height, QImage::Format_ARGB32);
+
+    convertRawImage(image, img, img.rect(), false,
+                    lowerValue, upperValue, opaque, alpha);
 
     return img;
 }
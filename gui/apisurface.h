@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QImage>
+#include <QRect>
 #include <QSize>
 #include <QString>
 
@@ -34,6 +35,20 @@ public:
                                      bool opaque = false,
                                      bool alpha = false);
 
+    /*
+     * Converts the given rectangle of img (in display coordinates, i.e.,
+     * after the optional vertical flip) into the top-left corner of dst,
+     * which must be of Format_ARGB32.
+     */
+    static void convertRawImage(const image::Image *img,
+                                QImage &dst,
+                                const QRect &rect,
+                                bool flip = false,
+                                float lowerValue = 0.0f,
+                                float upperValue = 1.0f,
+                                bool opaque = false,
+                                bool alpha = false);
+
 private:
 
     QSize  m_size;
@@ -70,8 +70,9 @@ ApiTrace::~ApiTrace()
 {
     m_loaderThread->quit();
     m_loaderThread->deleteLater();
-    qDeleteAll(m_frames);
+    // The loader's tasks may still be creating calls of our frames
     delete m_loader;
+    qDeleteAll(m_frames);
     delete m_saver;
 }
 
@@ -215,7 +215,7 @@ void VariantVisitor::visit(trace::Array *array)
 
 void VariantVisitor::visit(trace::Blob *blob)
 {
-    QByteArray barray = QByteArray(blob->buf, blob->size);
+    QByteArray barray = QByteArray(blob->data(), blob->size);
     m_variant = QVariant(barray);
 }
 
@@ -679,18 +679,7 @@ ApiTraceCall::loadData(TraceLoader *loader,
 {
     m_index = call->no;
     m_thread = call->thread_id;
-    m_signature = loader->signature(call->sig->id);
-
-    if (!m_signature) {
-        QString name = QString::fromLatin1(call->sig->name);
-        QStringList argNames;
-        argNames.reserve(call->sig->num_args);
-        for (int i = 0; i < call->sig->num_args; ++i) {
-            argNames += QString::fromLatin1(call->sig->arg_names[i]);
-        }
-        m_signature = new ApiTraceCallSignature(name, argNames);
-        loader->addSignature(call->sig->id, m_signature);
-    }
+    m_signature = loader->signature(call->sig);
     if (call->ret) {
         VariantVisitor retVisitor;
         call->ret->visit(retVisitor);
@@ -863,6 +852,11 @@ int ApiTraceCall::index() const
     return m_index;
 }
 
+ApiTraceCallSignature * ApiTraceCall::signature() const
+{
+    return m_signature;
+}
+
 QString ApiTraceCall::name() const
 {
     return m_signature->name();
@@ -245,6 +245,7 @@ public:
     ~ApiTraceCall();
 
     int index() const;
+    ApiTraceCallSignature *signature() const;
     QString name() const;
     QStringList argNames() const;
     QVector<QVariant> arguments() const;
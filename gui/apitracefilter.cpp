@@ -1,15 +1,168 @@
 #include "apitracefilter.h"
 
+#include "apitrace.h"
 #include "apitracecall.h"
 #include "apitracemodel.h"
 
 #include <QDebug>
+#include <QThread>
+
+#include <algorithm>
+
+static ApiTraceFilter::FrameCalls
+frameCalls(ApiTraceFrame *frame,
+           QHash<const ApiTraceCallSignature*, quint32> &functionCodes,
+           QStringList &functions)
+{
+    ApiTraceFilter::FrameCalls result;
+    result.frame = frame;
+
+    const QVector<ApiTraceCall*> calls = frame->calls();
+    result.codes.reserve(calls.count());
+    for (const ApiTraceCall *call : calls) {
+        trace::CallFlags flags = call->flags();
+        if (flags & trace::CALL_FLAG_MARKER_PUSH) {
+            result.codes.append(ApiTraceFilter::MarkerPushCode);
+        } else if (flags & trace::CALL_FLAG_MARKER_POP) {
+            result.codes.append(ApiTraceFilter::MarkerPopCode);
+        } else {
+            const ApiTraceCallSignature *sig = call->signature();
+            auto itr = functionCodes.constFind(sig);
+            if (itr == functionCodes.constEnd()) {
+                itr = functionCodes.insert(sig, functions.count());
+                functions.append(sig->name());
+            }
+            result.codes.append(itr.value());
+        }
+    }
+    return result;
+}
+
+static ApiTraceFilter::FrameBits
+filterFrameCalls(const ApiTraceFilter::Spec &spec,
+                 const QStringList &functions,
+                 const QList<ApiTraceFilter::FrameCalls> &frames)
+{
+    QBitArray accepted(functions.count());
+    for (int i = 0; i < functions.count(); ++i) {
+        accepted.setBit(i, spec.acceptsFunction(functions[i]));
+    }
+
+    ApiTraceFilter::FrameBits result;
+    for (const ApiTraceFilter::FrameCalls &frame : frames) {
+        QBitArray bits(frame.codes.count());
+        for (int i = 0; i < frame.codes.count(); ++i) {
+            quint32 code = frame.codes[i];
+            // Never filter push glPushDebugGroup() and friends, or all calls
+            // inside the debug group will be filtered out, but always filter
+            // glPopDebugGroup() and friends, as their presence is implied.
+            if (code == ApiTraceFilter::MarkerPushCode) {
+                bits.setBit(i);
+            } else if (code != ApiTraceFilter::MarkerPopCode) {
+                bits.setBit(i, accepted.testBit(code));
+            }
+        }
+        result.insert(frame.frame, bits);
+    }
+    return result;
+}
+
+
+bool ApiTraceFilter::Spec::acceptsFunction(const QString &function) const
+{
+    if (!regexp.isEmpty() && regexp.isValid()) {
+        return function.contains(regexp);
+    }
+
+    if (filters & ResolutionsFilter) {
+        if (function.contains(QLatin1String("glXGetProcAddress")))
+            return false;
+        if (function.contains(QLatin1String("wglGetProcAddress")))
+            return false;
+    }
+
+    if (filters & ErrorsQueryFilter) {
+        if (function.contains(QLatin1String("glGetError")))
+            return false;
+    }
+
+    if (filters & ExtraStateFilter) {
+        if (function.contains(QLatin1String("glXGetCurrentDisplay")))
+            return false;
+        if (function.contains(QLatin1String("wglDescribePixelFormat")))
+            return false;
+        if (function.contains(QLatin1String("wglGetCurrentContext")))
+            return false;
+    }
+
+    if (filters & ExtensionsFilter) {
+        if (function.contains(QLatin1String("glXGetClientString")))
+            return false;
+        if (function.contains(QLatin1String("glXQueryExtensionsString")))
+            return false;
+        if (function.contains(QLatin1String("glGetString")))
+            return false;
+    }
+
+    if (filters & CustomFilter) {
+        return !function.contains(customRegexp);
+    }
+
+    return true;
+}
+
+
+void ApiTraceFilterWorker::filterFrames(quint64 generation,
+                                        const ApiTraceFilter::Spec &spec,
+                                        const QStringList &functions,
+                                        const QList<ApiTraceFilter::FrameCalls> &frames)
+{
+    emit framesFiltered(generation, filterFrameCalls(spec, functions, frames));
+}
+
 
 ApiTraceFilter::ApiTraceFilter(QObject *parent)
     : QSortFilterProxyModel(),
-      m_filters(ExtensionsFilter | ResolutionsFilter |
-                ErrorsQueryFilter | ExtraStateFilter)
+      m_generation(0),
+      m_dispatchPending(false)
 {
+    m_pendingSpec.filters = FilterOptions(ExtensionsFilter | ResolutionsFilter |
+                                          ErrorsQueryFilter | ExtraStateFilter);
+    m_spec = m_pendingSpec;
+
+    m_worker = new ApiTraceFilterWorker();
+    m_workerThread = new QThread();
+    m_worker->moveToThread(m_workerThread);
+
+    connect(this,
+            SIGNAL(filterFrames(quint64,ApiTraceFilter::Spec,QStringList,QList<ApiTraceFilter::FrameCalls>)),
+            m_worker,
+            SLOT(filterFrames(quint64,ApiTraceFilter::Spec,QStringList,QList<ApiTraceFilter::FrameCalls>)));
+    connect(m_worker,
+            SIGNAL(framesFiltered(quint64,ApiTraceFilter::FrameBits)),
+            this,
+            SLOT(framesFiltered(quint64,ApiTraceFilter::FrameBits)));
+
+    m_workerThread->start();
+}
+
+ApiTraceFilter::~ApiTraceFilter()
+{
+    m_workerThread->quit();
+    m_workerThread->wait();
+    delete m_worker;
+    delete m_workerThread;
+}
+
+void ApiTraceFilter::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+    resetFrameBits();
+    if (sourceModel) {
+        // frames are deleted when the trace is reloaded
+        connect(sourceModel, SIGNAL(modelReset()),
+                this, SLOT(resetFrameBits()));
+    }
 }
 
 bool ApiTraceFilter::filterAcceptsRow(int sourceRow,
@@ -28,82 +181,129 @@ bool ApiTraceFilter::filterAcceptsRow(int sourceRow,
     }
 
     ApiTraceCall *call = static_cast<ApiTraceCall*>(event);
-    trace::CallFlags flags = call->flags();
+    ApiTraceFrame *frame = call->parentFrame();
+    if (frame && frame->isLoaded()) {
+        // calls() is in trace order, hence sorted by call number
+        const QVector<ApiTraceCall*> calls = frame->calls();
+        auto itr = std::lower_bound(calls.constBegin(), calls.constEnd(), call,
+                                    [](const ApiTraceCall *a, const ApiTraceCall *b) {
+                                        return a->index() < b->index();
+                                    });
+        if (itr != calls.constEnd() && *itr == call) {
+            const QBitArray &bits = frameBits(frame);
+            int pos = itr - calls.constBegin();
+            if (pos < bits.size()) {
+                return bits.testBit(pos);
+            }
+        }
+    }
 
-    // Never filter push glPushDebugGroup() and friends, or all calls inside
-    // the debug group will be filtered out.
+    trace::CallFlags flags = call->flags();
     if (flags & trace::CALL_FLAG_MARKER_PUSH) {
         return true;
     }
-
-    // Always filter glPopDebugGroup() and friends, as their presence is implied.
     if (flags & trace::CALL_FLAG_MARKER_POP) {
         return false;
     }
+    return m_spec.acceptsFunction(call->name());
+}
 
-    QString function = call->name();
-
-    if (!m_regexp.isEmpty() && m_regexp.isValid()) {
-        return function.contains(m_regexp);
+const QBitArray & ApiTraceFilter::frameBits(ApiTraceFrame *frame) const
+{
+    FrameBits::const_iterator itr = m_frameBits.constFind(frame);
+    if (itr == m_frameBits.constEnd()) {
+        // Frame loaded since the worker last ran: evaluate it in place, still
+        // once per distinct function.
+        QHash<const ApiTraceCallSignature*, quint32> functionCodes;
+        QStringList functions;
+        QList<FrameCalls> frames;
+        frames.append(frameCalls(frame, functionCodes, functions));
+        FrameBits bits = filterFrameCalls(m_spec, functions, frames);
+        itr = m_frameBits.insert(frame, bits.value(frame));
     }
+    return itr.value();
+}
 
-    if (m_filters & ResolutionsFilter) {
-        if (function.contains(QLatin1String("glXGetProcAddress")))
-            return false;
-        if (function.contains(QLatin1String("wglGetProcAddress")))
-            return false;
+void ApiTraceFilter::specChanged()
+{
+    ++m_generation;
+
+    // Several settings are usually changed together, so dispatch the
+    // work once control returns to the event loop.
+    if (!m_dispatchPending) {
+        m_dispatchPending = true;
+        QMetaObject::invokeMethod(this, "dispatchFilter", Qt::QueuedConnection);
     }
+}
 
-    if (m_filters & ErrorsQueryFilter) {
-        if (function.contains(QLatin1String("glGetError")))
-            return false;
+void ApiTraceFilter::dispatchFilter()
+{
+    m_dispatchPending = false;
+
+    const ApiTrace *trace = 0;
+    if (sourceModel()) {
+        trace = static_cast<ApiTraceModel *>(sourceModel())->apiTrace();
     }
 
-    if (m_filters & ExtraStateFilter) {
-        if (function.contains(QLatin1String("glXGetCurrentDisplay")))
-            return false;
-        if (function.contains(QLatin1String("wglDescribePixelFormat")))
-            return false;
-        if (function.contains(QLatin1String("wglGetCurrentContext")))
-            return false;
+    QHash<const ApiTraceCallSignature*, quint32> functionCodes;
+    QStringList functions;
+    QList<FrameCalls> frames;
+    if (trace) {
+        for (ApiTraceFrame *frame : trace->frames()) {
+            if (frame->isLoaded()) {
+                frames.append(frameCalls(frame, functionCodes, functions));
+            }
+        }
     }
 
-    if (m_filters & ExtensionsFilter) {
-        if (function.contains(QLatin1String("glXGetClientString")))
-            return false;
-        if (function.contains(QLatin1String("glXQueryExtensionsString")))
-            return false;
-        if (function.contains(QLatin1String("glGetString")))
-            return false;
+    if (frames.isEmpty()) {
+        // nothing to precompute
+        framesFiltered(m_generation, FrameBits());
+        return;
     }
 
-    if (m_filters & CustomFilter) {
-        return !function.contains(m_customRegexp);
+    emit filterFrames(m_generation, m_pendingSpec, functions, frames);
+}
+
+void ApiTraceFilter::framesFiltered(quint64 generation,
+                                    const ApiTraceFilter::FrameBits &bits)
+{
+    // results of superseded settings
+    if (generation != m_generation) {
+        return;
     }
 
+    m_spec = m_pendingSpec;
+    m_frameBits = bits;
+    invalidate();
+}
 
-    return true;
+void ApiTraceFilter::resetFrameBits()
+{
+    ++m_generation;
+    m_spec = m_pendingSpec;
+    m_frameBits.clear();
 }
 
 
 void ApiTraceFilter::setFilterRegexp(const QRegExp &regexp)
 {
-    if (regexp != m_regexp) {
-        m_regexp = regexp;
-        invalidate();
+    if (regexp != m_pendingSpec.regexp) {
+        m_pendingSpec.regexp = regexp;
+        specChanged();
     }
 }
 
 ApiTraceFilter::FilterOptions ApiTraceFilter::filterOptions() const
 {
-    return m_filters;
+    return m_pendingSpec.filters;
 }
 
 void ApiTraceFilter::setFilterOptions(ApiTraceFilter::FilterOptions opts)
 {
-    if (opts != m_filters) {
-        m_filters = opts;
-        invalidate();
+    if (opts != m_pendingSpec.filters) {
+        m_pendingSpec.filters = opts;
+        specChanged();
     }
 }
 
@@ -117,17 +317,20 @@ QModelIndex ApiTraceFilter::indexForCall(ApiTraceCall *call) const
 
 QRegExp ApiTraceFilter::filterRegexp() const
 {
-    return m_regexp;
+    return m_pendingSpec.regexp;
 }
 
 void ApiTraceFilter::setCustomFilterRegexp(const QString &str)
 {
-    m_customRegexp = QRegExp(str);
+    if (str != m_pendingSpec.customRegexp.pattern()) {
+        m_pendingSpec.customRegexp = QRegExp(str);
+        specChanged();
+    }
 }
 
 QString ApiTraceFilter::customFilterRegexp() const
 {
-    return m_customRegexp.pattern();
+    return m_pendingSpec.customRegexp.pattern();
 }
 
 #include "apitracefilter.moc"
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <QBitArray>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
 #include <QRegExp>
 #include <QSortFilterProxyModel>
+#include <QStringList>
+#include <QVector>
 
 class ApiTraceCall;
+class ApiTraceFrame;
+class ApiTraceFilterWorker;
+class QThread;
 
 class ApiTraceFilter : public QSortFilterProxyModel
 {
@@ -18,8 +27,38 @@ public:
         CustomFilter      = 1 << 4,
     };
     Q_DECLARE_FLAGS(FilterOptions, FilterOption)
+
+    /*
+     * Everything the verdict for a call depends on.  Besides the marker
+     * flags only the function name matters, so the regular expressions
+     * are evaluated once per distinct function rather than once per call.
+     */
+    struct Spec {
+        QRegExp regexp;
+        FilterOptions filters;
+        QRegExp customRegexp;
+
+        bool acceptsFunction(const QString &function) const;
+    };
+
+    /*
+     * Compact call metadata of a loaded frame, in ApiTraceFrame::calls()
+     * order: an index into the function name table, or one of the marker
+     * codes below.
+     */
+    enum {
+        MarkerPushCode = 0xffffffff,
+        MarkerPopCode  = 0xfffffffe,
+    };
+    struct FrameCalls {
+        ApiTraceFrame *frame; // only used as a key by the worker
+        QVector<quint32> codes;
+    };
+    typedef QHash<ApiTraceFrame*, QBitArray> FrameBits;
+
 public:
     ApiTraceFilter(QObject *parent = 0);
+    ~ApiTraceFilter();
 
     FilterOptions filterOptions() const;
     void setFilterOptions(FilterOptions opts);
@@ -31,11 +70,59 @@ public:
     QString customFilterRegexp() const;
 
     QModelIndex indexForCall(ApiTraceCall *call) const;
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
 protected:
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
 
+signals:
+    void filterFrames(quint64 generation,
+                      const ApiTraceFilter::Spec &spec,
+                      const QStringList &functions,
+                      const QList<ApiTraceFilter::FrameCalls> &frames);
+
+private slots:
+    void dispatchFilter();
+    void framesFiltered(quint64 generation,
+                        const ApiTraceFilter::FrameBits &bits);
+    void resetFrameBits();
+
+private:
+    void specChanged();
+    const QBitArray &frameBits(ApiTraceFrame *frame) const;
+
 private:
-    QRegExp m_regexp;
-    FilterOptions m_filters;
-    QRegExp m_customRegexp;
+    // settings as last set, possibly still being evaluated by the worker
+    Spec m_pendingSpec;
+    // settings m_frameBits were computed with
+    Spec m_spec;
+
+    quint64 m_generation;
+    bool m_dispatchPending;
+    mutable FrameBits m_frameBits;
+
+    QThread *m_workerThread;
+    ApiTraceFilterWorker *m_worker;
+};
+Q_DECLARE_METATYPE(ApiTraceFilter::Spec);
+Q_DECLARE_METATYPE(ApiTraceFilter::FrameBits);
+Q_DECLARE_METATYPE(QList<ApiTraceFilter::FrameCalls>);
+
+/*
+ * Computes per-frame bitsets of accepted calls off the GUI thread, so that
+ * toggling a filter on frames with many calls does not block the UI.
+ */
+class ApiTraceFilterWorker : public QObject
+{
+    Q_OBJECT
+public slots:
+    void filterFrames(quint64 generation,
+                      const ApiTraceFilter::Spec &spec,
+                      const QStringList &functions,
+                      const QList<ApiTraceFilter::FrameCalls> &frames);
+
+signals:
+    void framesFiltered(quint64 generation,
+                        const ApiTraceFilter::FrameBits &bits);
 };
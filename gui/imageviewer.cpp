@@ -65,31 +65,27 @@ ImageViewer::~ImageViewer()
 
 void ImageViewer::setData(const QByteArray &data)
 {
+    m_convertedImage.setImage(0);
     delete m_image;
     m_image = ApiSurface::imageFromData(data);
+    m_convertedImage.setImage(m_image);
     slotUpdate();
 }
 
 void ImageViewer::slotUpdate()
 {
-    m_convertedImage =
-        m_convertedImage.mirrored(false, flipCheckBox->isChecked());
-
     double lowerValue = lowerSpinBox->value();
     double upperValue = upperSpinBox->value();
 
     bool opaque = opaqueCheckBox->isChecked();
     bool alpha  = alphaCheckBox->isChecked();
+    bool flip   = flipCheckBox->isChecked();
 
-    m_convertedImage = ApiSurface::qimageFromRawImage(m_image,
-                                                      lowerValue, upperValue,
-                                                      opaque, alpha);
-
-    if (flipCheckBox->isChecked()) {
-        m_convertedImage = m_convertedImage.mirrored(false, true);
-    }
+    // Tiles are converted on demand as they get painted
+    m_convertedImage.setConversion(lowerValue, upperValue,
+                                   opaque, alpha, flip);
 
-    m_pixelWidget->setSurface(m_convertedImage);
+    m_pixelWidget->setSurface(&m_convertedImage);
 
     updateGeometry();
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ui_imageviewer.h"
+#include "tiledimage.h"
 #include <QDialog>
 
 class PixelWidget;
@@ -31,6 +32,6 @@ private slots:
 
 private:
     image::Image *m_image;
-    QImage m_convertedImage;
+    TiledImage m_convertedImage;
     PixelWidget *m_pixelWidget;
 };
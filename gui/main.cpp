@@ -4,6 +4,7 @@
 
 #include "apitrace.h"
 #include "apitracecall.h"
+#include "apitracefilter.h"
 
 #include "os_string.hpp"
 #include "os_process.hpp"
@@ -39,6 +40,9 @@ int main(int argc, char **argv)
     qRegisterMetaType<ApiTrace::SearchResult>();
     qRegisterMetaType<ApiTrace::SearchRequest>();
     qRegisterMetaType<ImageHash>();
+    qRegisterMetaType<ApiTraceFilter::Spec>();
+    qRegisterMetaType<ApiTraceFilter::FrameBits>("ApiTraceFilter::FrameBits");
+    qRegisterMetaType<QList<ApiTraceFilter::FrameCalls> >();
 
 #ifndef Q_OS_WIN
     os::String currentProcess = os::getProcessName();
@@ -961,7 +961,7 @@ void MainWindow::initObjects()
     m_retracer = new Retracer(this);
 
     m_vdataInterpreter = new VertexDataInterpreter(this);
-    m_vdataInterpreter->setListWidget(m_ui.vertexDataListWidget);
+    m_vdataInterpreter->setListView(m_ui.vertexDataListView);
     m_vdataInterpreter->setStride(
         m_ui.vertexStrideSB->value());
     m_vdataInterpreter->setComponents(
@@ -970,6 +970,8 @@ void MainWindow::initObjects()
         m_ui.startingOffsetSB->value());
     m_vdataInterpreter->setTypeFromString(
         m_ui.vertexTypeCB->currentText());
+    m_vdataInterpreter->setNormalized(
+        m_ui.vertexNormalizedCB->isChecked());
 
     m_model = new ApiTraceModel();
     m_model->setApiTrace(m_trace);
@@ -1067,6 +1069,8 @@ void MainWindow::initConnections()
             m_vdataInterpreter, SLOT(setComponents(int)));
     connect(m_ui.startingOffsetSB, SIGNAL(valueChanged(int)),
             m_vdataInterpreter, SLOT(setStartingOffset(int)));
+    connect(m_ui.vertexNormalizedCB, SIGNAL(toggled(bool)),
+            m_vdataInterpreter, SLOT(setNormalized(bool)));
 
 
     connect(m_ui.actionNew, SIGNAL(triggered()),
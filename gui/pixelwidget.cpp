@@ -45,6 +45,7 @@
 ****************************************************************************/
 
 #include "pixelwidget.h"
+#include "tiledimage.h"
 
 #include <qapplication.h>
 #include <qdesktopwidget.h>
@@ -61,7 +62,8 @@
 #include <qdebug.h>
 
 PixelWidget::PixelWidget(QWidget *parent)
-    : QWidget(parent)
+    : QWidget(parent),
+      m_surface(0)
 {
     setWindowTitle(QLatin1String("PixelTool"));
     setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
@@ -84,7 +86,7 @@ PixelWidget::~PixelWidget()
 {
 }
 
-void PixelWidget::setSurface(const QImage &image)
+void PixelWidget::setSurface(const TiledImage *image)
 {
     m_surface = image;
     updateGeometry();
@@ -116,19 +118,35 @@ void render_string(QPainter *p, int w, int h, const QString &text, int flags)
     p->drawText(bounds, flags, text);
 }
 
-void PixelWidget::paintEvent(QPaintEvent *)
+void PixelWidget::paintEvent(QPaintEvent *event)
 {
     QPainter p(this);
 
     int w = width();
     int h = height();
 
-    p.save();
-    p.scale(zoomValue(), zoomValue());
-    p.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    p.drawImage(0, 0, m_surface);
-    p.scale(1/zoomValue(), 1/zoomValue());
-    p.restore();
+    if (m_surface && !m_surface->isNull()) {
+        // Only convert and draw the tiles intersecting the exposed area
+        const int tileSize = TiledImage::TileSize;
+        QRect exposed = event->rect();
+        int x0 = qMax(0, int(exposed.left() / zoomValue()) / tileSize);
+        int y0 = qMax(0, int(exposed.top() / zoomValue()) / tileSize);
+        int x1 = qMin((m_surface->width() - 1) / tileSize,
+                      int(exposed.right() / zoomValue()) / tileSize);
+        int y1 = qMin((m_surface->height() - 1) / tileSize,
+                      int(exposed.bottom() / zoomValue()) / tileSize);
+
+        p.save();
+        p.scale(zoomValue(), zoomValue());
+        p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        for (int ty = y0; ty <= y1; ++ty) {
+            for (int tx = x0; tx <= x1; ++tx) {
+                p.drawImage(tx * tileSize, ty * tileSize,
+                            m_surface->tile(tx, ty));
+            }
+        }
+        p.restore();
+    }
 
     // Draw the grid on top.
     if (m_gridActive) {
@@ -234,8 +252,9 @@ void PixelWidget::mouseMoveEvent(QMouseEvent *e)
     int x = e->x() / zoomValue();
     int y = e->y() / zoomValue();
 
-    if (x < m_surface.width() && y < m_surface.height() && x >= 0 && y >= 0) {
-        m_currentColor = m_surface.pixel(x, y);
+    if (m_surface && x < m_surface->width() && y < m_surface->height() &&
+        x >= 0 && y >= 0) {
+        m_currentColor = m_surface->pixel(x, y);
     } else
         m_currentColor = QColor();
 
@@ -329,11 +348,11 @@ void PixelWidget::contextMenuEvent(QContextMenuEvent *e)
 
 QSize PixelWidget::sizeHint() const
 {
-    if (m_surface.isNull())
+    if (!m_surface || m_surface->isNull())
         return m_initialSize;
 
-    QSize sz(m_surface.width() * zoomValue(),
-             m_surface.height() * zoomValue());
+    QSize sz(m_surface->width() * zoomValue(),
+             m_surface->height() * zoomValue());
     return sz;
 }
 
@@ -387,7 +406,8 @@ void PixelWidget::setGridSize(int gridSize)
 void PixelWidget::copyToClipboard()
 {
     QClipboard *cb = QApplication::clipboard();
-    cb->setImage(m_surface);
+    if (m_surface)
+        cb->setImage(m_surface->toImage());
 }
 
 void PixelWidget::saveToFile()
@@ -396,7 +416,8 @@ void PixelWidget::saveToFile()
     if (!name.isEmpty()) {
         if (!name.endsWith(QLatin1String(".png")))
             name.append(QLatin1String(".png"));
-        m_surface.save(name, "PNG");
+        if (m_surface)
+            m_surface->toImage().save(name, "PNG");
     }
 }
 
@@ -49,6 +49,8 @@
 #include <qwidget.h>
 #include <qpixmap.h>
 
+class TiledImage;
+
 class PixelWidget : public QWidget
 {
     Q_OBJECT
@@ -56,7 +58,7 @@ public:
     PixelWidget(QWidget *parent = 0);
     ~PixelWidget();
     
-    void setSurface(const QImage &image);
+    void setSurface(const TiledImage *image);
 
     QColor colorAtCurrentPosition() const;
 
@@ -105,7 +107,7 @@ private:
     QPoint m_lastMousePos;
     QPoint m_dragStart;
     QPoint m_dragCurrent;
-    QImage m_surface;
+    const TiledImage *m_surface;
 
     QSize m_initialSize;
     QColor m_currentColor;
@@ -0,0 +1,105 @@
+#include "tiledimage.h"
+
+#include "apisurface.h"
+
+#include "image.hpp"
+
+
+// Cache cost is in KiB
+static const int maxCacheCost = 64 * 1024;
+
+
+TiledImage::TiledImage()
+    : m_image(0),
+      m_lowerValue(0.0f),
+      m_upperValue(1.0f),
+      m_opaque(false),
+      m_alpha(false),
+      m_flip(false),
+      m_tiles(maxCacheCost)
+{
+}
+
+void TiledImage::setImage(const image::Image *image)
+{
+    m_image = image;
+    m_tiles.clear();
+}
+
+void TiledImage::setConversion(float lowerValue, float upperValue,
+                               bool opaque, bool alpha, bool flip)
+{
+    if (lowerValue != m_lowerValue ||
+        upperValue != m_upperValue ||
+        opaque != m_opaque ||
+        alpha != m_alpha ||
+        flip != m_flip) {
+        m_lowerValue = lowerValue;
+        m_upperValue = upperValue;
+        m_opaque = opaque;
+        m_alpha = alpha;
+        m_flip = flip;
+        m_tiles.clear();
+    }
+}
+
+bool TiledImage::isNull() const
+{
+    return !m_image;
+}
+
+QSize TiledImage::size() const
+{
+    return QSize(width(), height());
+}
+
+int TiledImage::width() const
+{
+    return m_image ? m_image->width : 0;
+}
+
+int TiledImage::height() const
+{
+    return m_image ? m_image->height : 0;
+}
+
+QImage TiledImage::tile(int tileX, int tileY) const
+{
+    QRect rect(tileX * TileSize, tileY * TileSize, TileSize, TileSize);
+    rect &= QRect(QPoint(0, 0), size());
+    if (rect.isEmpty()) {
+        return QImage();
+    }
+
+    quint64 key = (quint64(tileY) << 32) | quint32(tileX);
+    QImage *cached = m_tiles.object(key);
+    if (cached) {
+        return *cached;
+    }
+
+    QImage *img = new QImage(rect.size(), QImage::Format_ARGB32);
+    ApiSurface::convertRawImage(m_image, *img, rect, m_flip,
+                                m_lowerValue, m_upperValue,
+                                m_opaque, m_alpha);
+    m_tiles.insert(key, img, qMax(1, img->byteCount() / 1024));
+    return *img;
+}
+
+QRgb TiledImage::pixel(int x, int y) const
+{
+    QImage img = tile(x / TileSize, y / TileSize);
+    return img.pixel(x % TileSize, y % TileSize);
+}
+
+QImage TiledImage::toImage() const
+{
+    if (!m_image) {
+        return QImage();
+    }
+
+    QImage img(size(), QImage::Format_ARGB32);
+    ApiSurface::convertRawImage(m_image, img, img.rect(), m_flip,
+                                m_lowerValue, m_upperValue,
+                                m_opaque, m_alpha);
+    return img;
+}
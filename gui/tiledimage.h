@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QSize>
+
+namespace image {
+    class Image;
+}
+
+/*
+ * Display conversion of an image::Image, done lazily per tile.
+ *
+ * Only the tiles actually painted are converted, and they are kept in a
+ * bounded cache until the conversion settings change, so large (e.g.,
+ * floating point) render targets don't need a full conversion whenever
+ * the range is tweaked.
+ */
+class TiledImage
+{
+public:
+    enum {
+        TileSize = 256
+    };
+
+    TiledImage();
+
+    void setImage(const image::Image *image);
+    void setConversion(float lowerValue, float upperValue,
+                       bool opaque, bool alpha, bool flip);
+
+    bool isNull() const;
+    QSize size() const;
+    int width() const;
+    int height() const;
+
+    QImage tile(int tileX, int tileY) const;
+    QRgb pixel(int x, int y) const;
+
+    QImage toImage() const;
+
+private:
+    const image::Image *m_image;
+
+    float m_lowerValue;
+    float m_upperValue;
+    bool m_opaque;
+    bool m_alpha;
+    bool m_flip;
+
+    mutable QCache<quint64, QImage> m_tiles;
+};
@@ -3,12 +3,36 @@
 #include "apitrace.h"
 #include <QDebug>
 #include <QFile>
+#include <QRunnable>
+#include <QThread>
 
 #define FRAMES_TO_CACHE 100
 
+// Each parser has its own file handle and decompression buffers
+#define MAX_PARSERS 4
+
+namespace {
+
+class LoaderTask : public QRunnable
+{
+public:
+    LoaderTask(const std::function<void ()> &function)
+        : m_function(function)
+    {}
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void ()> m_function;
+};
+
+}
+
 static ApiTraceCall *
 apiCallFromTraceCall(const trace::Call *call,
-                     const QHash<QString, QUrl> &helpHash,
                      ApiTraceFrame *frame,
                      ApiTraceCall *parentCall,
                      TraceLoader *loader)
@@ -20,8 +44,6 @@ apiCallFromTraceCall(const trace::Call *call,
     else
         apiCall = new ApiTraceCall(frame, loader, call);
 
-    apiCall->setHelpUrl(helpHash.value(apiCall->name()));
-
     return apiCall;
 }
 
@@ -32,7 +54,8 @@ TraceLoader::TraceLoader(QObject *parent)
 
 TraceLoader::~TraceLoader()
 {
-    m_parser.close();
+    cancelAll();
+    closeParsers();
     qDeleteAll(m_signatures);
 }
 
@@ -42,12 +65,15 @@ void TraceLoader::loadTrace(const QString &filename)
         loadHelpFile();
     }
 
+    cancelAll();
+    closeParsers();
+    m_fetchedFrames.clear();
+
     if (!m_frameBookmarks.isEmpty()) {
         qDeleteAll(m_signatures);
         m_signatures.clear();
         m_frameBookmarks.clear();
         m_createdFrames.clear();
-        m_parser.close();
     }
 
     if (!m_parser.open(filename.toLatin1())) {
@@ -67,6 +93,7 @@ void TraceLoader::loadTrace(const QString &filename)
     emit startedParsing();
 
     scanTrace();
+    openParsers(filename);
 
     emit guessedApi(static_cast<int>(m_parser.api));
     emit finishedParsing();
@@ -74,7 +101,93 @@ void TraceLoader::loadTrace(const QString &filename)
 
 void TraceLoader::loadFrame(ApiTraceFrame *currentFrame)
 {
-    fetchFrameContents(currentFrame);
+    dispatch(FramePriority, [=](trace::Parser &parser) {
+        fetchFrameContents(currentFrame, parser);
+    });
+}
+
+void TraceLoader::openParsers(const QString &filename)
+{
+    Q_ASSERT(m_parsers.isEmpty());
+    m_parsers.append(&m_parser);
+
+    int numParsers = qBound(1, QThread::idealThreadCount(), MAX_PARSERS);
+    while (m_parsers.count() < numParsers) {
+        trace::Parser *parser = new trace::Parser;
+        if (!parser->openShared(filename.toLatin1(), m_parser)) {
+            delete parser;
+            break;
+        }
+        m_parsers.append(parser);
+    }
+
+    m_idleParsers = m_parsers;
+    m_threadPool.setMaxThreadCount(m_parsers.count());
+}
+
+void TraceLoader::closeParsers()
+{
+    Q_ASSERT(m_idleParsers.count() == m_parsers.count());
+
+    // The borrowing parsers must go before m_parser
+    for (trace::Parser *parser : m_parsers) {
+        if (parser != &m_parser) {
+            delete parser;
+        }
+    }
+    m_parsers.clear();
+    m_idleParsers.clear();
+
+    m_parser.close();
+}
+
+trace::Parser *TraceLoader::acquireParser()
+{
+    QMutexLocker locker(&m_parsersMutex);
+    // There are as many parsers as threads, so this seldom waits
+    while (m_idleParsers.isEmpty()) {
+        m_parserReleased.wait(&m_parsersMutex);
+    }
+    return m_idleParsers.takeLast();
+}
+
+void TraceLoader::releaseParser(trace::Parser *parser)
+{
+    QMutexLocker locker(&m_parsersMutex);
+    m_idleParsers.append(parser);
+    m_parserReleased.wakeOne();
+}
+
+/*
+ * Run a task on the thread pool, with a parser of its own.
+ */
+void TraceLoader::dispatch(int priority,
+                           const std::function<void (trace::Parser &)> &task)
+{
+    if (m_parsers.isEmpty()) {
+        return;
+    }
+
+    int generation = m_generation.loadAcquire();
+    m_threadPool.start(new LoaderTask([=]() {
+        if (m_generation.loadAcquire() != generation) {
+            return;
+        }
+        trace::Parser *parser = acquireParser();
+        task(*parser);
+        releaseParser(parser);
+    }), priority);
+}
+
+/*
+ * Drop queued tasks, and wait for the running ones.
+ */
+void TraceLoader::cancelAll()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_searchGeneration.fetchAndAddOrdered(1);
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
 }
 
 int TraceLoader::numberOfFrames() const
@@ -172,35 +285,53 @@ void TraceLoader::scanTrace()
 }
 
 
-ApiTraceCallSignature * TraceLoader::signature(unsigned id)
+ApiTraceCallSignature * TraceLoader::signature(const trace::FunctionSig *sig)
 {
-    if (id >= m_signatures.count()) {
-        m_signatures.resize(id + 1);
-        return NULL;
-    } else {
-        return m_signatures[id];
+    QMutexLocker locker(&m_signaturesMutex);
+
+    if (sig->id >= unsigned(m_signatures.count())) {
+        m_signatures.resize(sig->id + 1);
     }
+
+    ApiTraceCallSignature *&signature = m_signatures[sig->id];
+    if (!signature) {
+        QString name = QString::fromLatin1(sig->name);
+        QStringList argNames;
+        argNames.reserve(sig->num_args);
+        for (unsigned i = 0; i < sig->num_args; ++i) {
+            argNames += QString::fromLatin1(sig->arg_names[i]);
+        }
+        signature = new ApiTraceCallSignature(name, argNames);
+        signature->setHelpUrl(m_helpHash.value(name));
+    }
+    return signature;
 }
 
-void TraceLoader::addSignature(unsigned id, ApiTraceCallSignature *signature)
+bool TraceLoader::isSearchCancelled(int searchGeneration) const
 {
-    m_signatures[id] = signature;
+    return m_searchGeneration.loadAcquire() != searchGeneration;
 }
 
-void TraceLoader::searchNext(const ApiTrace::SearchRequest &request)
+void TraceLoader::searchNext(const ApiTrace::SearchRequest &request,
+                             trace::Parser &parser, int searchGeneration)
 {
-    Q_ASSERT(m_parser.supportsOffsets());
+    Q_ASSERT(parser.supportsOffsets());
     int startFrame = m_createdFrames.indexOf(request.frame);
-    const FrameBookmark &frameBookmark = m_frameBookmarks[startFrame];
-    m_parser.setBookmark(frameBookmark.start);
+    const FrameBookmark frameBookmark = m_frameBookmarks.value(startFrame);
+    parser.setBookmark(frameBookmark.start);
     trace::Call *call = 0;
-    while ((call = m_parser.parse_call())) {
+    while ((call = parser.parse_call())) {
+
+        if (isSearchCancelled(searchGeneration)) {
+            delete call;
+            return;
+        }
 
         if (callContains(call, request.text, request.cs)) {
             unsigned frameIdx = callInFrame(call->no);
-            ApiTraceFrame *frame = m_createdFrames[frameIdx];
+            ApiTraceFrame *frame = m_createdFrames.at(frameIdx);
             const QVector<ApiTraceCall*> calls =
-                    fetchFrameContents(frame);
+                    fetchFrameContents(frame, parser);
             for (int i = 0; i < calls.count(); ++i) {
                 if (calls[i]->index() == call->no) {
                     emit searchResult(request, ApiTrace::SearchResult_Found,
@@ -217,27 +348,34 @@ void TraceLoader::searchNext(const ApiTrace::SearchRequest &request)
     emit searchResult(request, ApiTrace::SearchResult_NotFound, 0);
 }
 
-void TraceLoader::searchPrev(const ApiTrace::SearchRequest &request)
+void TraceLoader::searchPrev(const ApiTrace::SearchRequest &request,
+                             trace::Parser &parser, int searchGeneration)
 {
-    Q_ASSERT(m_parser.supportsOffsets());
+    Q_ASSERT(parser.supportsOffsets());
     int startFrame = m_createdFrames.indexOf(request.frame);
     trace::Call *call = 0;
     QList<trace::Call*> frameCalls;
     int frameIdx = startFrame;
 
-    const FrameBookmark &frameBookmark = m_frameBookmarks[frameIdx];
+    const FrameBookmark frameBookmark = m_frameBookmarks.value(frameIdx);
     int numCallsToParse = frameBookmark.numberOfCalls;
-    m_parser.setBookmark(frameBookmark.start);
+    parser.setBookmark(frameBookmark.start);
 
-    while ((call = m_parser.parse_call())) {
+    while ((call = parser.parse_call())) {
 
         frameCalls.append(call);
         --numCallsToParse;
 
+        if (isSearchCancelled(searchGeneration)) {
+            qDeleteAll(frameCalls);
+            return;
+        }
+
         if (numCallsToParse == 0) {
             bool foundCall = searchCallsBackwards(frameCalls,
                                                   frameIdx,
-                                                  request);
+                                                  request,
+                                                  parser);
 
             qDeleteAll(frameCalls);
             frameCalls.clear();
@@ -248,9 +386,9 @@ void TraceLoader::searchPrev(const ApiTrace::SearchRequest &request)
             --frameIdx;
 
             if (frameIdx >= 0) {
-                const FrameBookmark &frameBookmark =
-                        m_frameBookmarks[frameIdx];
-                m_parser.setBookmark(frameBookmark.start);
+                const FrameBookmark frameBookmark =
+                        m_frameBookmarks.value(frameIdx);
+                parser.setBookmark(frameBookmark.start);
                 numCallsToParse = frameBookmark.numberOfCalls;
             }
         }
@@ -260,14 +398,15 @@ void TraceLoader::searchPrev(const ApiTrace::SearchRequest &request)
 
 bool TraceLoader::searchCallsBackwards(const QList<trace::Call*> &calls,
                                        int frameIdx,
-                                       const ApiTrace::SearchRequest &request)
+                                       const ApiTrace::SearchRequest &request,
+                                       trace::Parser &parser)
 {
     for (int i = calls.count() - 1; i >= 0; --i) {
         trace::Call *call = calls[i];
         if (callContains(call, request.text, request.cs)) {
-            ApiTraceFrame *frame = m_createdFrames[frameIdx];
+            ApiTraceFrame *frame = m_createdFrames.at(frameIdx);
             const QVector<ApiTraceCall*> apiCalls =
-                    fetchFrameContents(frame);
+                    fetchFrameContents(frame, parser);
             for (int i = 0; i < apiCalls.count(); ++i) {
                 if (apiCalls[i]->index() == call->no) {
                     emit searchResult(request,
@@ -306,32 +445,55 @@ bool TraceLoader::callContains(trace::Call *call,
     /*
      * FIXME: do string comparison directly on trace::Call
      */
-    ApiTraceCall *apiCall = apiCallFromTraceCall(call, m_helpHash,
-                                                 0, 0, this);
+    ApiTraceCall *apiCall = apiCallFromTraceCall(call, 0, 0, this);
     bool result = apiCall->contains(str, sensitivity);
     delete apiCall;
     return result;
 }
 
 QVector<ApiTraceCall*>
-TraceLoader::fetchFrameContents(ApiTraceFrame *currentFrame)
+TraceLoader::fetchFrameContents(ApiTraceFrame *currentFrame,
+                                trace::Parser &parser)
 {
     Q_ASSERT(currentFrame);
 
-    if (currentFrame->isLoaded()) {
-        return currentFrame->calls();
+    {
+        QMutexLocker locker(&m_framesMutex);
+        while (m_fetchingFrames.contains(currentFrame)) {
+            m_frameFetched.wait(&m_framesMutex);
+        }
+        QHash<ApiTraceFrame*, QVector<ApiTraceCall*> >::const_iterator itr =
+                m_fetchedFrames.constFind(currentFrame);
+        if (itr != m_fetchedFrames.constEnd()) {
+            return *itr;
+        }
+        m_fetchingFrames.insert(currentFrame);
     }
 
+    QVector<ApiTraceCall*> calls = loadFrameContents(currentFrame, parser);
+
+    QMutexLocker locker(&m_framesMutex);
+    m_fetchingFrames.remove(currentFrame);
+    m_fetchedFrames.insert(currentFrame, calls);
+    m_frameFetched.wakeAll();
+
+    return calls;
+}
+
+QVector<ApiTraceCall*>
+TraceLoader::loadFrameContents(ApiTraceFrame *currentFrame,
+                               trace::Parser &parser)
+{
     unsigned frameIdx = currentFrame->number;
     int numOfCalls = numberOfCallsInFrame(frameIdx);
 
     if (numOfCalls) {
-        const FrameBookmark &frameBookmark = m_frameBookmarks[frameIdx];
+        const FrameBookmark frameBookmark = m_frameBookmarks.value(frameIdx);
 
-        m_parser.setBookmark(frameBookmark.start);
+        parser.setBookmark(frameBookmark.start);
 
         FrameContents frameCalls(numOfCalls);
-        frameCalls.load(this, currentFrame, m_helpHash, m_parser);
+        frameCalls.load(this, currentFrame, parser);
         if (frameCalls.topLevelCount() == frameCalls.allCallsCount()) {
             emit frameContentsLoaded(currentFrame,
                                      frameCalls.allCalls(),
@@ -350,45 +512,52 @@ TraceLoader::fetchFrameContents(ApiTraceFrame *currentFrame)
 
 void TraceLoader::findFrameStart(ApiTraceFrame *frame)
 {
-    if (!frame->isLoaded()) {
-        loadFrame(frame);
-    }
-    emit foundFrameStart(frame);
+    dispatch(FramePriority, [=](trace::Parser &parser) {
+        fetchFrameContents(frame, parser);
+        emit foundFrameStart(frame);
+    });
 }
 
 void TraceLoader::findFrameEnd(ApiTraceFrame *frame)
 {
-    if (!frame->isLoaded()) {
-        loadFrame(frame);
-    }
-    emit foundFrameEnd(frame);
+    dispatch(FramePriority, [=](trace::Parser &parser) {
+        fetchFrameContents(frame, parser);
+        emit foundFrameEnd(frame);
+    });
 }
 
 void TraceLoader::findCallIndex(int index)
 {
-    int frameIdx = callInFrame(index);
-    ApiTraceFrame *frame = m_createdFrames[frameIdx];
-    QVector<ApiTraceCall*> calls = fetchFrameContents(frame);
-    QVector<ApiTraceCall*>::const_iterator itr;
-    ApiTraceCall *call = 0;
-    for (itr = calls.constBegin(); itr != calls.constEnd(); ++itr) {
-        if ((*itr)->index() == index) {
-            call = *itr;
-            break;
+    dispatch(LookupPriority, [=](trace::Parser &parser) {
+        int frameIdx = callInFrame(index);
+        ApiTraceFrame *frame = m_createdFrames.at(frameIdx);
+        QVector<ApiTraceCall*> calls = fetchFrameContents(frame, parser);
+        QVector<ApiTraceCall*>::const_iterator itr;
+        ApiTraceCall *call = 0;
+        for (itr = calls.constBegin(); itr != calls.constEnd(); ++itr) {
+            if ((*itr)->index() == index) {
+                call = *itr;
+                break;
+            }
         }
-    }
-    if (call) {
-        emit foundCallIndex(call);
-    }
+        if (call) {
+            emit foundCallIndex(call);
+        }
+    });
 }
 
 void TraceLoader::search(const ApiTrace::SearchRequest &request)
 {
-    if (request.direction == ApiTrace::SearchRequest::Next) {
-        searchNext(request);
-    } else {
-        searchPrev(request);
-    }
+    // Supersede any search still running
+    int searchGeneration = m_searchGeneration.fetchAndAddOrdered(1) + 1;
+
+    dispatch(SearchPriority, [=](trace::Parser &parser) {
+        if (request.direction == ApiTrace::SearchRequest::Next) {
+            searchNext(request, parser, searchGeneration);
+        } else {
+            searchPrev(request, parser, searchGeneration);
+        }
+    });
 }
 
 TraceLoader::FrameContents::FrameContents(int numOfCalls)
@@ -445,7 +614,6 @@ TraceLoader::FrameContents::isEmpty()
 bool
 TraceLoader::FrameContents::load(TraceLoader   *loader,
                                ApiTraceFrame *currentFrame, 
-                               QHash<QString, QUrl> helpHash,
                                trace::Parser &parser)
 {
     bool bEndFrameReached = false;
@@ -455,7 +623,7 @@ TraceLoader::FrameContents::load(TraceLoader   *loader,
 
     while ((call = parser.parse_call())) {
 
-        apiCall = apiCallFromTraceCall(call, helpHash, currentFrame,
+        apiCall = apiCallFromTraceCall(call, currentFrame,
                                        m_groups.isEmpty() ? 0 : m_groups.top(),
                                        loader);
         Q_ASSERT(apiCall);
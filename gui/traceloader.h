@@ -5,11 +5,27 @@
 #include "trace_file.hpp"
 #include "trace_parser.hpp"
 
+#include <QAtomicInt>
+#include <QHash>
 #include <QObject>
 #include <QList>
 #include <QMap>
+#include <QMutex>
+#include <QSet>
 #include <QStack>
-
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <functional>
+
+/*
+ * Loads frames and searches the trace on behalf of ApiTrace.
+ *
+ * The trace is scanned once on the loader thread.  Afterwards requests are
+ * run on a thread pool, each with one of a few parsers opened on the same
+ * file, so that a long search doesn't hold up expanding frames.  Frame loads
+ * take priority over call lookups and searches.
+ */
 class TraceLoader : public QObject
 {
     Q_OBJECT
@@ -18,8 +34,10 @@ public:
     ~TraceLoader();
 
 
-    ApiTraceCallSignature *signature(unsigned id);
-    void addSignature(unsigned id, ApiTraceCallSignature *signature);
+    /*
+     * Thread-safe, as it's called while loading calls.
+     */
+    ApiTraceCallSignature *signature(const trace::FunctionSig *sig);
 
     trace::EnumSig *enumSignature(unsigned id);
 
@@ -30,7 +48,7 @@ private:
         FrameContents(int numOfCalls=0);
 
         bool load(TraceLoader *loader, ApiTraceFrame* frame,
-                  QHash<QString, QUrl> helpHash, trace::Parser &parser);
+                  trace::Parser &parser);
         void reset();
         int  topLevelCount()      const;
         int  allCallsCount()      const;
@@ -87,6 +105,13 @@ private:
         trace::ParseBookmark start;
         int numberOfCalls;
     };
+    // Thread pool priorities
+    enum {
+        SearchPriority = 0,
+        LookupPriority,
+        FramePriority,
+    };
+
     int numberOfFrames() const;
     int numberOfCallsInFrame(int frameIdx) const;
 
@@ -94,21 +119,57 @@ private:
     void guessApi(const trace::Call *call);
     void scanTrace();
 
-    void searchNext(const ApiTrace::SearchRequest &request);
-    void searchPrev(const ApiTrace::SearchRequest &request);
+    void openParsers(const QString &filename);
+    void closeParsers();
+    trace::Parser *acquireParser();
+    void releaseParser(trace::Parser *parser);
+    void dispatch(int priority,
+                  const std::function<void (trace::Parser &)> &task);
+    void cancelAll();
+
+    void searchNext(const ApiTrace::SearchRequest &request,
+                    trace::Parser &parser, int searchGeneration);
+    void searchPrev(const ApiTrace::SearchRequest &request,
+                    trace::Parser &parser, int searchGeneration);
+    bool isSearchCancelled(int searchGeneration) const;
 
     int callInFrame(int callIdx) const;
     bool callContains(trace::Call *call,
                       const QString &str,
                       Qt::CaseSensitivity sensitivity);
-     QVector<ApiTraceCall*> fetchFrameContents(ApiTraceFrame *frame);
+     QVector<ApiTraceCall*> fetchFrameContents(ApiTraceFrame *frame,
+                                               trace::Parser &parser);
+     QVector<ApiTraceCall*> loadFrameContents(ApiTraceFrame *frame,
+                                              trace::Parser &parser);
      bool searchCallsBackwards(const QList<trace::Call*> &calls,
                                int frameIdx,
-                               const ApiTrace::SearchRequest &request);
+                               const ApiTrace::SearchRequest &request,
+                               trace::Parser &parser);
 
 private:
+    // Scans the trace, and owns the signature tables the other parsers
+    // borrow.
     trace::Parser m_parser;
 
+    // m_parser plus the borrowing parsers, and those not in use by a task
+    QList<trace::Parser*> m_parsers;
+    QList<trace::Parser*> m_idleParsers;
+    QMutex m_parsersMutex;
+    QWaitCondition m_parserReleased;
+
+    QThreadPool m_threadPool;
+    // Bumped to abandon the tasks of the previous trace, or searches
+    // superseded by a newer one
+    QAtomicInt m_generation;
+    QAtomicInt m_searchGeneration;
+
+    // Frames whose calls were already created, so that concurrent requests
+    // for the same frame don't load it twice
+    QHash<ApiTraceFrame*, QVector<ApiTraceCall*> > m_fetchedFrames;
+    QSet<ApiTraceFrame*> m_fetchingFrames;
+    QMutex m_framesMutex;
+    QWaitCondition m_frameFetched;
+
     typedef QMap<int, FrameBookmark> FrameBookmarks;
     FrameBookmarks m_frameBookmarks;
     QList<ApiTraceFrame*> m_createdFrames;
@@ -116,4 +177,5 @@ private:
     QHash<QString, QUrl> m_helpHash;
 
     QVector<ApiTraceCallSignature*> m_signatures;
+    QMutex m_signaturesMutex;
 };
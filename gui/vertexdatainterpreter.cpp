@@ -1,11 +1,13 @@
 #include "vertexdatainterpreter.h"
 
-#include <QListWidget>
-#include <QStringList>
+#include <QListView>
 
 #include <QDebug>
 
-#include <qmath.h>
+#include <algorithm>
+#include <limits>
+
+#include <string.h>
 
 static int
 sizeForType(int type)
@@ -16,6 +18,7 @@ sizeForType(int type)
         return 1;
     case DT_INT16:
     case DT_UINT16:
+    case DT_HALF:
         return 2;
     case DT_INT32:
     case DT_UINT32:
@@ -29,80 +32,97 @@ sizeForType(int type)
     }
 }
 
-template <typename T>
-static QStringList
-convertData(const QByteArray &dataArray,
-            int type,
-            int stride,
-            int numComponents,
-            int startingOffset)
-{
-    QStringList strings;
-
-    int dataSize = dataArray.size() - startingOffset;
-    const char *data = dataArray.constData() + startingOffset;
-    int typeSize = sizeForType(type);
-    int elementSize = numComponents * typeSize;
-
-    if (!stride)
-        stride = elementSize;
-
-    int numElements = dataSize / stride;
-
-    if ((numElements % numComponents) != 0) {
-        int temp = qFloor(dataSize / (float)stride);
-        int fullElemSize = temp * stride;
-        if (fullElemSize + numComponents * typeSize <= dataSize) {
-            /* num full elements plus the part of the buffer in which we fit */
-            numElements = temp + 1;
-        } else {
-            numElements = temp;
+static float
+halfToFloat(quint16 half)
+{
+    quint32 sign = quint32(half & 0x8000) << 16;
+    quint32 exponent = (half >> 10) & 0x1f;
+    quint32 mantissa = half & 0x3ff;
+    quint32 bits;
+
+    if (exponent == 0x1f) {
+        // Infinity or NaN
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent) {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if (mantissa) {
+        // Denormal, so renormalize
+        exponent = 127 - 15 + 1;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            --exponent;
         }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    } else {
+        bits = sign;
     }
 
-#if 0
-    qDebug() << "numElements = "<<numElements;
-    qDebug() << "elementSize = "<<elementSize;
-    qDebug() << "stride = "<<stride;
-    qDebug() << "numComponents = "<<numComponents;
-    qDebug() << "typeSize = "<<typeSize;
-#endif
-
-
-    for (int i = 0; i < numElements; ++i) {
-        QString vectorString = QString::fromLatin1("%1) [").arg(i);
-        for (int j = 0; j < numComponents; ++j) {
-            int offset = i*stride + j*typeSize;
-            const T *elementPtr =
-                (const T*)(data + offset);
-            T elem = *elementPtr;
-            vectorString += QString::number(elem);
-            if ((j + 1) < numComponents)
-                vectorString += QLatin1String(", ");
-        }
-        vectorString += "]";
-        strings += vectorString;
+    float value;
+    memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+template <typename T>
+static QString
+componentString(const char *data, bool normalized)
+{
+    T elem;
+    memcpy(&elem, data, sizeof elem);
+    if (normalized && std::numeric_limits<T>::is_integer) {
+        double value = double(elem) / std::numeric_limits<T>::max();
+        return QString::number(std::max(value, -1.0));
     }
+    return QString::number(elem);
+}
 
-    return strings;
+static QString
+componentString(int type, const char *data, bool normalized)
+{
+    switch(type) {
+    case DT_INT8:
+        return componentString<qint8>(data, normalized);
+    case DT_UINT8:
+        return componentString<quint8>(data, normalized);
+    case DT_INT16:
+        return componentString<qint16>(data, normalized);
+    case DT_UINT16:
+        return componentString<quint16>(data, normalized);
+    case DT_INT32:
+        return componentString<qint32>(data, normalized);
+    case DT_UINT32:
+        return componentString<quint32>(data, normalized);
+    case DT_FLOAT:
+        return componentString<float>(data, normalized);
+    case DT_DOUBLE:
+        return componentString<double>(data, normalized);
+    case DT_HALF:
+        {
+            quint16 half;
+            memcpy(&half, data, sizeof half);
+            return QString::number(halfToFloat(half));
+        }
+    default:
+        return QString();
+    }
 }
 
 
 VertexDataInterpreter::VertexDataInterpreter(QObject *parent)
-    : QObject(parent),
-      m_listWidget(0),
+    : QAbstractListModel(parent),
       m_type(DT_FLOAT),
       m_stride(16),
       m_components(4),
-      m_startingOffset(0)
+      m_startingOffset(0),
+      m_normalized(false),
+      m_numElements(0),
+      m_elementStride(0)
 {
 }
 
 void VertexDataInterpreter::setData(const QByteArray &data)
 {
     m_data = data;
-    if (m_listWidget)
-        m_listWidget->clear();
+    interpretData();
 }
 
 QByteArray VertexDataInterpreter::data() const
@@ -113,6 +133,7 @@ QByteArray VertexDataInterpreter::data() const
 void VertexDataInterpreter::setType(int type)
 {
     m_type = type;
+    interpretData();
 }
 
 int VertexDataInterpreter::type() const
@@ -123,6 +144,7 @@ int VertexDataInterpreter::type() const
 void VertexDataInterpreter::setStride(int stride)
 {
     m_stride = stride;
+    interpretData();
 }
 
 int VertexDataInterpreter::stride() const
@@ -133,6 +155,7 @@ int VertexDataInterpreter::stride() const
 void VertexDataInterpreter::setComponents(int num)
 {
     m_components = num;
+    interpretData();
 }
 
 int VertexDataInterpreter::components() const
@@ -140,60 +163,83 @@ int VertexDataInterpreter::components() const
     return m_components;
 }
 
-void VertexDataInterpreter::setListWidget(QListWidget *listWidget)
+void VertexDataInterpreter::setNormalized(bool normalized)
+{
+    m_normalized = normalized;
+    interpretData();
+}
+
+bool VertexDataInterpreter::normalized() const
 {
-    m_listWidget = listWidget;
+    return m_normalized;
 }
 
+void VertexDataInterpreter::setListView(QListView *listView)
+{
+    // All rows have the same height, which spares the view from measuring
+    // every row of large buffers
+    listView->setUniformItemSizes(true);
+    listView->setModel(this);
+}
+
+/*
+ * Only recomputes the buffer layout -- vertices are decoded on demand by
+ * data().
+ */
 void VertexDataInterpreter::interpretData()
 {
-    if (!m_listWidget)
-        return;
+    beginResetModel();
 
-    m_listWidget->clear();
+    m_numElements = 0;
 
-    if (m_data.isEmpty() || !m_components)
-        return;
+    int dataSize = m_data.size() - m_startingOffset;
+    int elementSize = m_components * sizeForType(m_type);
 
-    QStringList lst;
-    switch(m_type) {
-    case DT_INT8:
-        lst = convertData<qint8>(m_data, m_type, m_stride, m_components,
-                                 m_startingOffset);
-        break;
-    case DT_UINT8:
-        lst = convertData<quint8>(m_data, m_type, m_stride, m_components,
-                                  m_startingOffset);
-        break;
-    case DT_INT16:
-        lst = convertData<qint16>(m_data, m_type, m_stride, m_components,
-                                  m_startingOffset);
-        break;
-    case DT_UINT16:
-        lst = convertData<quint16>(m_data, m_type, m_stride, m_components,
-                                   m_startingOffset);
-        break;
-    case DT_INT32:
-        lst = convertData<qint32>(m_data, m_type, m_stride, m_components,
-                                  m_startingOffset);
-        break;
-    case DT_UINT32:
-        lst = convertData<quint32>(m_data, m_type, m_stride, m_components,
-                                   m_startingOffset);
-        break;
-    case DT_FLOAT:
-        lst = convertData<float>(m_data, m_type, m_stride, m_components,
-                                 m_startingOffset);
-        break;
-    case DT_DOUBLE:
-        lst = convertData<double>(m_data, m_type, m_stride, m_components,
-                                  m_startingOffset);
-        break;
-    default:
-        qDebug()<<"unkown gltype = "<<m_type;
+    m_elementStride = m_stride ? m_stride : elementSize;
+
+    if (m_components > 0 && m_startingOffset >= 0 &&
+        elementSize > 0 && dataSize >= elementSize) {
+        /* num full strides plus the last element, which may not be padded */
+        m_numElements = (dataSize - elementSize) / m_elementStride + 1;
+    }
+
+    endResetModel();
+}
+
+int VertexDataInterpreter::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_numElements;
+}
+
+QVariant VertexDataInterpreter::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_numElements)
+        return QVariant();
+
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    return vertexString(index.row());
+}
+
+QString VertexDataInterpreter::vertexString(int index) const
+{
+    const char *data = m_data.constData() + m_startingOffset +
+                       qint64(index) * m_elementStride;
+    int typeSize = sizeForType(m_type);
+
+    QString vectorString = QString::fromLatin1("%1) [").arg(index);
+    for (int j = 0; j < m_components; ++j) {
+        vectorString += componentString(m_type, data + j * typeSize,
+                                        m_normalized);
+        if ((j + 1) < m_components)
+            vectorString += QLatin1String(", ");
     }
-    //qDebug()<<"list is "<<lst;
-    m_listWidget->addItems(lst);
+    vectorString += "]";
+
+    return vectorString;
 }
 
 
@@ -215,6 +261,8 @@ void VertexDataInterpreter::setTypeFromString(const QString &str)
         setType(DT_UINT8);
     } else if (str == QLatin1String("GL_DOUBLE")) {
         setType(DT_DOUBLE);
+    } else if (str == QLatin1String("GL_HALF_FLOAT")) {
+        setType(DT_HALF);
     } else {
         qDebug()<<"unknown vertex data type";
     }
@@ -228,6 +276,7 @@ int VertexDataInterpreter::startingOffset() const
 void VertexDataInterpreter::setStartingOffset(int offset)
 {
     m_startingOffset = offset;
+    interpretData();
 }
 
 #include "vertexdatainterpreter.moc"
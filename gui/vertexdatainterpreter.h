@@ -1,8 +1,9 @@
 #pragma once
 
-#include <QObject>
+#include <QAbstractListModel>
+#include <QByteArray>
 
-class QListWidget;
+class QListView;
 
 enum DataType {
     DT_INT8,
@@ -13,9 +14,16 @@ enum DataType {
     DT_UINT32,
     DT_FLOAT,
     DT_DOUBLE,
+    DT_HALF,
 };
 
-class VertexDataInterpreter : public QObject
+/*
+ * Presents a raw buffer as a list of vertices.
+ *
+ * Vertices are only decoded when the view asks for them, so that large
+ * buffers can be browsed, and re-interpreted, without delay.
+ */
+class VertexDataInterpreter : public QAbstractListModel
 {
     Q_OBJECT
 public:
@@ -27,8 +35,12 @@ public:
     int stride() const;
     int components() const;
     int startingOffset() const;
+    bool normalized() const;
 
-    void setListWidget(QListWidget *listWidget);
+    void setListView(QListView *listView);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 
 public slots:
     void interpretData();
@@ -39,12 +51,20 @@ public slots:
     void setComponents(int num);
     void setType(int type);
     void setStartingOffset(int offset);
+    void setNormalized(bool normalized);
+
+private:
+    QString vertexString(int index) const;
 
 private:
-    QListWidget *m_listWidget;
     QByteArray m_data;
     int m_type;
     int m_stride;
     int m_components;
     int m_startingOffset;
+    bool m_normalized;
+
+    // Layout derived from the above by interpretData()
+    int m_numElements;
+    int m_elementStride;
 };
@@ -0,0 +1,492 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "os_string.hpp"
+
+#include "image.hpp"
+#include "image_pack.hpp"
+
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+
+namespace image {
+
+
+static const char packMagic[8] = {'A', 'P', 'I', 'S', 'N', 'A', 'P', 'K'};
+static const char indexMagic[8] = {'A', 'P', 'I', 'S', 'N', 'A', 'P', 'I'};
+static const uint32_t packVersion = 1;
+
+static const size_t headerSize = 16;
+static const size_t recordHeaderSize = 20;
+static const size_t indexEntrySize = 32;
+static const size_t trailerSize = 20;
+
+
+static inline void
+putUInt32(unsigned char *p, uint32_t value) {
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+static inline void
+putUInt64(unsigned char *p, uint64_t value) {
+    putUInt32(p, (uint32_t)value);
+    putUInt32(p + 4, (uint32_t)(value >> 32));
+}
+
+static inline uint32_t
+getUInt32(const unsigned char *p) {
+    return (uint32_t)p[0] |
+           ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+getUInt64(const unsigned char *p) {
+    return (uint64_t)getUInt32(p) | ((uint64_t)getUInt32(p + 4) << 32);
+}
+
+
+const char *
+packFormatExtension(PackFormat format)
+{
+    switch (format) {
+    case PACK_FORMAT_PNG:
+        return "png";
+    case PACK_FORMAT_PNM:
+        return "pnm";
+    }
+    return "bin";
+}
+
+
+PackWriter::PackWriter() :
+    file(NULL),
+    offset(0),
+    failed(false)
+{
+}
+
+
+PackWriter::~PackWriter()
+{
+    close();
+}
+
+
+bool
+PackWriter::open(const char *filename)
+{
+    assert(!file);
+
+    file = fopen(filename, "wb");
+    if (!file) {
+        return false;
+    }
+
+    unsigned char header[headerSize];
+    memcpy(header, packMagic, sizeof packMagic);
+    putUInt32(header + 8, packVersion);
+    putUInt32(header + 12, 0);
+    if (fwrite(header, sizeof header, 1, file) != 1) {
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    offset = headerSize;
+    failed = false;
+    entries.clear();
+    return true;
+}
+
+
+bool
+PackWriter::add(unsigned callNo, unsigned snapshotNo, int mrt,
+                PackFormat format, const std::string &data)
+{
+    os::unique_lock<os::mutex> lock(mutex);
+
+    if (!file || failed) {
+        return false;
+    }
+
+    unsigned char header[recordHeaderSize];
+    putUInt32(header + 0, callNo);
+    putUInt32(header + 4, snapshotNo);
+    putUInt32(header + 8, (uint32_t)mrt);
+    putUInt32(header + 12, format);
+    putUInt32(header + 16, (uint32_t)data.size());
+
+    if (fwrite(header, sizeof header, 1, file) != 1 ||
+        (!data.empty() && fwrite(data.data(), data.size(), 1, file) != 1)) {
+        // Part of the record might have been written, so the offset of
+        // further records would be unknown
+        failed = true;
+        return false;
+    }
+
+    // Keep complete records on disk should the replay crash
+    if (fflush(file) != 0) {
+        failed = true;
+        return false;
+    }
+
+    PackEntry entry;
+    entry.offset = offset + recordHeaderSize;
+    entry.size = (uint32_t)data.size();
+    entry.callNo = callNo;
+    entry.snapshotNo = snapshotNo;
+    entry.mrt = mrt;
+    entry.format = format;
+    entries.push_back(entry);
+
+    offset += recordHeaderSize + data.size();
+    return true;
+}
+
+
+bool
+PackWriter::addPNG(unsigned callNo, unsigned snapshotNo, int mrt,
+                   const Image &image, bool strip_alpha)
+{
+    // Encode outside the lock, so that threaded snapshotters only
+    // serialize on the actual file writes.
+    std::ostringstream os(std::ios::binary);
+    if (!image.writePNG(os, strip_alpha)) {
+        return false;
+    }
+    return add(callNo, snapshotNo, mrt, PACK_FORMAT_PNG, os.str());
+}
+
+
+bool
+PackWriter::close(void)
+{
+    os::unique_lock<os::mutex> lock(mutex);
+
+    if (!file) {
+        return true;
+    }
+
+    if (failed) {
+        fclose(file);
+        file = NULL;
+        entries.clear();
+        return false;
+    }
+
+    bool ok = true;
+
+    unsigned char buf[indexEntrySize];
+    for (const PackEntry &entry : entries) {
+        putUInt64(buf + 0, entry.offset);
+        putUInt32(buf + 8, entry.size);
+        putUInt32(buf + 12, entry.callNo);
+        putUInt32(buf + 16, entry.snapshotNo);
+        putUInt32(buf + 20, (uint32_t)entry.mrt);
+        putUInt32(buf + 24, entry.format);
+        putUInt32(buf + 28, 0);
+        ok = ok && fwrite(buf, sizeof buf, 1, file) == 1;
+    }
+
+    unsigned char trailer[trailerSize];
+    putUInt64(trailer, offset);
+    putUInt32(trailer + 8, (uint32_t)entries.size());
+    memcpy(trailer + 12, indexMagic, sizeof indexMagic);
+    ok = ok && fwrite(trailer, sizeof trailer, 1, file) == 1;
+
+    ok = fclose(file) == 0 && ok;
+    file = NULL;
+    entries.clear();
+    return ok;
+}
+
+
+PackReader::PackReader() :
+    file(NULL),
+    complete(false)
+{
+}
+
+
+PackReader::~PackReader()
+{
+    close();
+}
+
+
+bool
+PackReader::open(const char *filename)
+{
+    close();
+
+    file = fopen(filename, "rb");
+    if (!file) {
+        return false;
+    }
+
+    unsigned char header[headerSize];
+    if (fread(header, sizeof header, 1, file) != 1 ||
+        memcmp(header, packMagic, sizeof packMagic) != 0 ||
+        getUInt32(header + 8) > packVersion) {
+        close();
+        return false;
+    }
+
+    if (fseek64(file, 0, SEEK_END) != 0) {
+        close();
+        return false;
+    }
+    uint64_t fileSize = ftell64(file);
+
+    complete = readIndex(fileSize);
+    if (!complete) {
+        entries.clear();
+        if (!scanRecords(fileSize)) {
+            close();
+            return false;
+        }
+    }
+
+    // Records written by a threaded snapshotter may be out of order
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const PackEntry &a, const PackEntry &b) {
+            return a.snapshotNo < b.snapshotNo;
+        });
+
+    return true;
+}
+
+
+bool
+PackReader::readIndex(uint64_t fileSize)
+{
+    if (fileSize < headerSize + trailerSize) {
+        return false;
+    }
+
+    unsigned char trailer[trailerSize];
+    if (fseek64(file, fileSize - trailerSize, SEEK_SET) != 0 ||
+        fread(trailer, sizeof trailer, 1, file) != 1 ||
+        memcmp(trailer + 12, indexMagic, sizeof indexMagic) != 0) {
+        return false;
+    }
+
+    uint64_t indexOffset = getUInt64(trailer);
+    uint32_t count = getUInt32(trailer + 8);
+    if (indexOffset < headerSize ||
+        indexOffset + (uint64_t)count * indexEntrySize + trailerSize != fileSize) {
+        return false;
+    }
+
+    if (fseek64(file, indexOffset, SEEK_SET) != 0) {
+        return false;
+    }
+
+    entries.resize(count);
+    unsigned char buf[indexEntrySize];
+    for (PackEntry &entry : entries) {
+        if (fread(buf, sizeof buf, 1, file) != 1) {
+            return false;
+        }
+        entry.offset = getUInt64(buf + 0);
+        entry.size = getUInt32(buf + 8);
+        entry.callNo = getUInt32(buf + 12);
+        entry.snapshotNo = getUInt32(buf + 16);
+        entry.mrt = (int32_t)getUInt32(buf + 20);
+        entry.format = (PackFormat)getUInt32(buf + 24);
+        if (entry.offset + entry.size > indexOffset) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool
+PackReader::scanRecords(uint64_t fileSize)
+{
+    uint64_t offset = headerSize;
+    unsigned char header[recordHeaderSize];
+    while (offset + recordHeaderSize <= fileSize) {
+        if (fseek64(file, offset, SEEK_SET) != 0 ||
+            fread(header, sizeof header, 1, file) != 1) {
+            break;
+        }
+
+        PackEntry entry;
+        entry.offset = offset + recordHeaderSize;
+        entry.callNo = getUInt32(header + 0);
+        entry.snapshotNo = getUInt32(header + 4);
+        entry.mrt = (int32_t)getUInt32(header + 8);
+        entry.format = (PackFormat)getUInt32(header + 12);
+        entry.size = getUInt32(header + 16);
+
+        // Stop at a truncated record (e.g., the replay crashed mid-write)
+        if (entry.offset + entry.size > fileSize) {
+            break;
+        }
+
+        entries.push_back(entry);
+        offset = entry.offset + entry.size;
+    }
+
+    return true;
+}
+
+
+void
+PackReader::close(void)
+{
+    if (file) {
+        fclose(file);
+        file = NULL;
+    }
+    complete = false;
+    entries.clear();
+}
+
+
+long
+PackReader::find(unsigned callNo, int mrt) const
+{
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].callNo == callNo && entries[i].mrt == mrt) {
+            return (long)i;
+        }
+    }
+    return -1;
+}
+
+
+bool
+PackReader::read(size_t i, std::string &data)
+{
+    assert(file);
+    assert(i < entries.size());
+
+    const PackEntry &entry = entries[i];
+    data.resize(entry.size);
+    if (fseek64(file, entry.offset, SEEK_SET) != 0) {
+        return false;
+    }
+    return entry.size == 0 ||
+           fread(&data[0], entry.size, 1, file) == 1;
+}
+
+
+Image *
+PackReader::readImage(size_t i)
+{
+    std::string data;
+    if (!read(i, data)) {
+        return NULL;
+    }
+
+    switch (entries[i].format) {
+    case PACK_FORMAT_PNG:
+        {
+            std::istringstream is(data, std::ios::binary);
+            return readPNG(is);
+        }
+    case PACK_FORMAT_PNM:
+        return readPNM(data.data(), data.size());
+    }
+
+    return NULL;
+}
+
+
+bool
+PackReader::extract(size_t i, const char *prefix, bool useCallNos)
+{
+    const PackEntry &entry = entries[i];
+
+    unsigned no = useCallNos ? entry.callNo : entry.snapshotNo;
+    const char *ext = packFormatExtension(entry.format);
+    os::String filename;
+    if (entry.mrt == -2) {
+        filename = os::String::format("%s%010u-s.%s", prefix, no, ext);
+    } else if (entry.mrt == -1) {
+        filename = os::String::format("%s%010u-z.%s", prefix, no, ext);
+    } else if (entry.mrt > 0) {
+        filename = os::String::format("%s%010u-mrt%u.%s", prefix, no, entry.mrt, ext);
+    } else {
+        filename = os::String::format("%s%010u.%s", prefix, no, ext);
+    }
+
+    std::string data;
+    if (!read(i, data)) {
+        return false;
+    }
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = data.empty() || fwrite(data.data(), data.size(), 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+    return ok;
+}
+
+
+long
+extractPack(const char *filename, const char *prefix)
+{
+    PackReader reader;
+    if (!reader.open(filename)) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < reader.size(); ++i) {
+        if (!reader.extract(i, prefix)) {
+            return -1;
+        }
+    }
+
+    return (long)reader.size();
+}
+
+
+} /* namespace image */
@@ -0,0 +1,185 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Snapshot packs: many encoded snapshots appended to a single file.
+ *
+ * Layout (all integers little-endian):
+ *
+ *   header   "APISNAPK" magic, uint32 version, uint32 reserved
+ *   records  uint32 callNo, uint32 snapshotNo, int32 mrt, uint32 format,
+ *            uint32 size, followed by size bytes of encoded image
+ *   index    one PackEntry per record (offset, size, callNo, snapshotNo,
+ *            mrt, format)
+ *   trailer  uint64 index offset, uint32 entry count, "APISNAPI" magic
+ *
+ * The index is only written when the pack is closed.  Each record carries
+ * its own header, so packs left behind by a crashed replay can still be
+ * read by scanning the records.
+ */
+
+#pragma once
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "os_thread.hpp"
+
+
+namespace image {
+
+
+class Image;
+
+
+enum PackFormat {
+    PACK_FORMAT_PNG = 0,
+    PACK_FORMAT_PNM,
+};
+
+
+const char *
+packFormatExtension(PackFormat format);
+
+
+struct PackEntry
+{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t callNo;
+    uint32_t snapshotNo;
+    // 0..N-1 for color attachments, -1 for depth, -2 for stencil
+    int32_t mrt;
+    PackFormat format;
+};
+
+
+class PackWriter
+{
+public:
+    PackWriter();
+    ~PackWriter();
+
+    bool
+    open(const char *filename);
+
+    // Append already encoded data.  Safe to call from several threads.
+    // After a failed write no more records are appended, and no index is
+    // written, so that the pack is read by scanning its complete records.
+    bool
+    add(unsigned callNo, unsigned snapshotNo, int mrt,
+        PackFormat format, const std::string &data);
+
+    // Encode an image as PNG and append it.
+    bool
+    addPNG(unsigned callNo, unsigned snapshotNo, int mrt,
+           const Image &image, bool strip_alpha = false);
+
+    // Write the index and trailer.
+    bool
+    close(void);
+
+    inline bool
+    isOpen(void) const {
+        return file != NULL;
+    }
+
+private:
+    FILE *file;
+    uint64_t offset;
+    bool failed;
+    std::vector<PackEntry> entries;
+    os::mutex mutex;
+};
+
+
+class PackReader
+{
+public:
+    PackReader();
+    ~PackReader();
+
+    bool
+    open(const char *filename);
+
+    void
+    close(void);
+
+    // False when the index was missing and had to be rebuilt.
+    inline bool
+    isComplete(void) const {
+        return complete;
+    }
+
+    inline size_t
+    size(void) const {
+        return entries.size();
+    }
+
+    inline const PackEntry &
+    entry(size_t i) const {
+        return entries[i];
+    }
+
+    // Index of the entry with the given call number and MRT, or -1.
+    long
+    find(unsigned callNo, int mrt = 0) const;
+
+    bool
+    read(size_t i, std::string &data);
+
+    // Decode an entry; returns NULL on failure.
+    Image *
+    readImage(size_t i);
+
+    // Write an entry to a file named like `glretrace -s PREFIX` would,
+    // numbered by call or by snapshot.
+    bool
+    extract(size_t i, const char *prefix, bool useCallNos = true);
+
+private:
+    FILE *file;
+    bool complete;
+    std::vector<PackEntry> entries;
+
+    bool
+    readIndex(uint64_t fileSize);
+
+    bool
+    scanRecords(uint64_t fileSize);
+};
+
+
+// Write all the snapshots of a pack to files, as PackReader::extract does.
+// Returns the number of snapshots written, or -1 on failure.
+long
+extractPack(const char *filename, const char *prefix);
+
+
+} /* namespace image */
@@ -0,0 +1,191 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+
+#include "os_process.hpp"
+#include "os_string.hpp"
+
+#include "image.hpp"
+#include "image_pack.hpp"
+
+#include "gtest/gtest.h"
+
+
+using namespace image;
+
+
+static Image *
+makeImage(unsigned width, unsigned height, unsigned char seed)
+{
+    Image *image = new Image(width, height, 4);
+    for (unsigned i = 0; i < width * height * 4; ++i) {
+        image->pixels[i] = (unsigned char)(i * 7 + seed);
+    }
+    return image;
+}
+
+
+class PackTest : public ::testing::Test
+{
+protected:
+    os::String filename;
+
+    void SetUp() override {
+        filename = os::getTemporaryDirectoryPath();
+        filename.join(os::String::format("image_pack_test.%u.pack",
+                                         (unsigned)os::getCurrentProcessId()));
+    }
+
+    void TearDown() override {
+        os::removeFile(filename);
+    }
+
+    void writePack(void) {
+        PackWriter writer;
+        ASSERT_TRUE(writer.open(filename));
+        for (unsigned i = 0; i < 3; ++i) {
+            std::unique_ptr<Image> image(makeImage(5 + i, 3, i));
+            ASSERT_TRUE(writer.addPNG(100 + i, i, 0, *image));
+        }
+        ASSERT_TRUE(writer.add(200, 3, -1, PACK_FORMAT_PNM, std::string("P6\n1 1\n255\n\1\2\3", 14)));
+        ASSERT_TRUE(writer.close());
+    }
+
+    void checkPack(PackReader &reader) {
+        ASSERT_EQ(reader.size(), 4U);
+        for (unsigned i = 0; i < 3; ++i) {
+            const PackEntry &entry = reader.entry(i);
+            EXPECT_EQ(entry.callNo, 100 + i);
+            EXPECT_EQ(entry.snapshotNo, i);
+            EXPECT_EQ(entry.mrt, 0);
+            EXPECT_EQ(entry.format, PACK_FORMAT_PNG);
+
+            std::unique_ptr<Image> expected(makeImage(5 + i, 3, i));
+            std::unique_ptr<Image> actual(reader.readImage(i));
+            ASSERT_TRUE(actual);
+            ASSERT_EQ(actual->width, expected->width);
+            ASSERT_EQ(actual->height, expected->height);
+            ASSERT_EQ(actual->channels, 4U);
+            EXPECT_EQ(memcmp(actual->pixels, expected->pixels, expected->_stride() * expected->height), 0);
+        }
+
+        EXPECT_EQ(reader.find(200, -1), 3);
+        EXPECT_EQ(reader.find(200, 0), -1);
+        std::unique_ptr<Image> pnm(reader.readImage(3));
+        ASSERT_TRUE(pnm);
+        EXPECT_EQ(pnm->width, 1U);
+        EXPECT_EQ(pnm->pixels[2], 3);
+    }
+};
+
+
+TEST_F(PackTest, RoundTrip)
+{
+    writePack();
+
+    PackReader reader;
+    ASSERT_TRUE(reader.open(filename));
+    EXPECT_TRUE(reader.isComplete());
+    checkPack(reader);
+
+    // Unpacked with the same names as `glretrace -s PREFIX`
+    os::String prefix(filename);
+    prefix.trimExtension();
+    prefix.append("-");
+    ASSERT_EQ(extractPack(filename, prefix), 4);
+    os::String png = os::String::format("%s%010u.png", prefix.str(), 101);
+    os::String pnm = os::String::format("%s%010u-z.pnm", prefix.str(), 200);
+    std::unique_ptr<Image> image(readPNG(png));
+    os::removeFile(os::String::format("%s%010u.png", prefix.str(), 100));
+    os::removeFile(png);
+    os::removeFile(os::String::format("%s%010u.png", prefix.str(), 102));
+    EXPECT_TRUE(os::removeFile(pnm));
+    ASSERT_TRUE(image);
+    EXPECT_EQ(image->width, 6U);
+}
+
+
+TEST_F(PackTest, MissingIndex)
+{
+    writePack();
+
+    // Simulate a replay that died while writing a record, before the pack
+    // was closed, by dropping the index and leaving a partial record.
+    std::string contents;
+    FILE *fp = fopen(filename, "rb");
+    ASSERT_TRUE(fp);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, fp)) > 0) {
+        contents.append(buf, n);
+    }
+    fclose(fp);
+
+    ASSERT_GT(contents.size(), 20U);
+    const unsigned char *trailer = (const unsigned char *)contents.data() + contents.size() - 20;
+    size_t indexOffset = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16);
+    ASSERT_LT(indexOffset, contents.size());
+    contents.resize(indexOffset);
+    contents.append("\x2c\x01\0\0\4\0\0", 7);
+
+    fp = fopen(filename, "wb");
+    ASSERT_TRUE(fp);
+    ASSERT_EQ(fwrite(contents.data(), contents.size(), 1, fp), 1U);
+    fclose(fp);
+
+    PackReader reader;
+    ASSERT_TRUE(reader.open(filename));
+    EXPECT_FALSE(reader.isComplete());
+    checkPack(reader);
+}
+
+
+#ifdef __linux__
+
+// No more records are appended after a failed write, and no index is written
+TEST(PackWriter, WriteFailure)
+{
+    PackWriter writer;
+    ASSERT_TRUE(writer.open("/dev/full"));
+    std::string pnm("P6\n1 1\n255\n\1\2\3", 14);
+    EXPECT_FALSE(writer.add(100, 0, 0, PACK_FORMAT_PNM, pnm));
+    EXPECT_FALSE(writer.add(101, 1, 0, PACK_FORMAT_PNM, pnm));
+    EXPECT_FALSE(writer.close());
+}
+
+#endif
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -202,6 +202,24 @@ createDirectory(const String &path)
     return mkdir(path, 0777) == 0;
 }
 
+bool
+removeFile(const String &fileName)
+{
+    return unlink(fileName) == 0;
+}
+
+#ifndef __APPLE__
+String
+getTemporaryDirectoryPath(void)
+{
+    const char *tmpdir = getenv("TMPDIR");
+    if (tmpdir && tmpdir[0]) {
+        return String(tmpdir);
+    }
+    return String("/tmp");
+}
+#endif
+
 bool
 String::exists(void) const
 {
@@ -0,0 +1,617 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Microbenchmarks for the trace library.
+ *
+ * Every benchmark runs over a deterministic synthetic trace (see
+ * trace_synth.hpp), so results are comparable across builds and machines
+ * without needing any graphics API.
+ */
+
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "os_process.hpp"
+#include "os_string.hpp"
+#include "os_time.hpp"
+#include "trace_callset.hpp"
+#include "trace_dump.hpp"
+#include "trace_file.hpp"
+#include "trace_ostream.hpp"
+#include "trace_parser.hpp"
+#include "trace_synth.hpp"
+
+
+using namespace trace;
+
+
+struct Fixture
+{
+    SynthMix mix;
+    SynthOptions options;
+
+    os::String filename;
+    os::String scratchFilename;
+
+    // Uncompressed trace stream
+    std::vector<char> raw;
+
+    unsigned long long numCalls = 0;
+
+    // Bookmarks at the start of every frame, and the parser that took them
+    // (random access is only possible after all signatures have been seen)
+    std::vector<ParseBookmark> bookmarks;
+    std::unique_ptr<Parser> seekParser;
+};
+
+
+struct Result
+{
+    unsigned long long bytes = 0;
+    unsigned long long calls = 0;
+};
+
+
+typedef bool (*BenchFunction)(Fixture &fixture, Result &result);
+
+
+/**
+ * Output stream buffer which discards everything, but counts the bytes.
+ */
+class NullBuffer : public std::streambuf
+{
+public:
+    unsigned long long count = 0;
+
+protected:
+    int overflow(int c) override {
+        ++count;
+        return c;
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        count += n;
+        return n;
+    }
+};
+
+
+static bool
+benchWrite(Fixture &fixture, Result &result)
+{
+    SynthGenerator generator(fixture.options);
+    if (!generator.writeFile(fixture.scratchFilename)) {
+        return false;
+    }
+    result.bytes = fixture.raw.size();
+    result.calls = fixture.numCalls;
+    return true;
+}
+
+
+static bool
+benchCompress(Fixture &fixture, Result &result)
+{
+    std::unique_ptr<OutStream> stream(createSnappyStream(fixture.scratchFilename));
+    if (!stream) {
+        return false;
+    }
+
+    // Writer emits many tiny writes, so mimic that with small pieces
+    const size_t pieceSize = 256;
+    const char *data = fixture.raw.data();
+    size_t size = fixture.raw.size();
+    for (size_t offset = 0; offset < size; offset += pieceSize) {
+        stream->write(data + offset, std::min(pieceSize, size - offset));
+    }
+    stream.reset();
+
+    result.bytes = size;
+    result.calls = fixture.numCalls;
+    return true;
+}
+
+
+static bool
+benchDecompress(Fixture &fixture, Result &result)
+{
+    std::unique_ptr<File> file(File::createForRead(fixture.filename));
+    if (!file) {
+        return false;
+    }
+
+    char buffer[64 * 1024];
+    size_t total = 0;
+    size_t read;
+    while ((read = file->read(buffer, sizeof buffer)) != 0) {
+        total += read;
+    }
+    file->close();
+
+    if (total != fixture.raw.size()) {
+        std::cerr << "error: decompressed " << total << " bytes, expected "
+                  << fixture.raw.size() << "\n";
+        return false;
+    }
+
+    result.bytes = total;
+    result.calls = fixture.numCalls;
+    return true;
+}
+
+
+static bool
+benchParse(Fixture &fixture, Result &result)
+{
+    Parser parser;
+    if (!parser.open(fixture.filename)) {
+        return false;
+    }
+
+    unsigned long long numCalls = 0;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        ++numCalls;
+        delete call;
+    }
+
+    result.bytes = fixture.raw.size();
+    result.calls = numCalls;
+    return numCalls == fixture.numCalls;
+}
+
+
+/*
+ * Parsing with string interning, as done by qapitrace.
+ */
+static bool
+benchParseIntern(Fixture &fixture, Result &result)
+{
+    Parser parser;
+    parser.setStringInterning(1, 1024);
+    if (!parser.open(fixture.filename)) {
+        return false;
+    }
+
+    unsigned long long numCalls = 0;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        ++numCalls;
+        delete call;
+    }
+
+    result.bytes = fixture.raw.size();
+    result.calls = numCalls;
+    return numCalls == fixture.numCalls;
+}
+
+
+/*
+ * Parsing without reading blob contents, as done by `apitrace dump`.
+ */
+static bool
+benchParseLazy(Fixture &fixture, Result &result)
+{
+    Parser parser;
+    parser.setLazyBlobs(true);
+    if (!parser.open(fixture.filename)) {
+        return false;
+    }
+
+    unsigned long long numCalls = 0;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        ++numCalls;
+        delete call;
+    }
+
+    result.bytes = fixture.raw.size();
+    result.calls = numCalls;
+    return numCalls == fixture.numCalls;
+}
+
+
+static bool
+benchScan(Fixture &fixture, Result &result)
+{
+    Parser parser;
+    if (!parser.open(fixture.filename)) {
+        return false;
+    }
+
+    unsigned long long numCalls = 0;
+    Call *call;
+    while ((call = parser.scan_call())) {
+        ++numCalls;
+        delete call;
+    }
+
+    result.bytes = fixture.raw.size();
+    result.calls = numCalls;
+    return numCalls == fixture.numCalls;
+}
+
+
+/*
+ * Random access to frame starts, as done by qapitrace when expanding frames.
+ */
+static bool
+benchSeek(Fixture &fixture, Result &result)
+{
+    if (fixture.bookmarks.empty()) {
+        return false;
+    }
+
+    Parser &parser = *fixture.seekParser;
+
+    SynthRandom rng(fixture.options.seed);
+    const unsigned numSeeks = 256;
+    for (unsigned i = 0; i < numSeeks; ++i) {
+        const ParseBookmark &bookmark = fixture.bookmarks[rng.below(fixture.bookmarks.size())];
+        parser.setBookmark(bookmark);
+        Call *call = parser.parse_call();
+        if (!call) {
+            return false;
+        }
+        // Calls are returned in leave order, so with interleaved threads the
+        // first call might not be the one entered first
+        if (call->no < bookmark.next_call_no) {
+            delete call;
+            return false;
+        }
+        delete call;
+    }
+
+    result.calls = numSeeks;
+    return true;
+}
+
+
+static bool
+benchDump(Fixture &fixture, Result &result)
+{
+    Parser parser;
+    if (!parser.open(fixture.filename)) {
+        return false;
+    }
+
+    NullBuffer buffer;
+    std::ostream os(&buffer);
+
+    unsigned long long numCalls = 0;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        dump(*call, os, DUMP_FLAG_NO_COLOR);
+        ++numCalls;
+        delete call;
+    }
+
+    result.bytes = buffer.count;
+    result.calls = numCalls;
+    return numCalls == fixture.numCalls;
+}
+
+
+/*
+ * Call set matching, as done by `apitrace dump --calls` and `apitrace trim`.
+ */
+static bool
+benchCallSet(Fixture &fixture, Result &result)
+{
+    Parser parser;
+    if (!parser.open(fixture.filename)) {
+        return false;
+    }
+
+    CallSet calls;
+    calls.merge("0-1000/2,2000-3000/frame,4000-*/draw,5000-6000/3");
+
+    unsigned long long numCalls = 0;
+    unsigned long long numMatches = 0;
+    Call *call;
+    while ((call = parser.scan_call())) {
+        if (calls.contains(*call)) {
+            ++numMatches;
+        }
+        ++numCalls;
+        delete call;
+    }
+
+    result.bytes = fixture.raw.size();
+    result.calls = numCalls;
+    return numCalls == fixture.numCalls && numMatches;
+}
+
+
+struct Benchmark
+{
+    const char *name;
+    BenchFunction function;
+};
+
+static const Benchmark
+benchmarks[] = {
+    {"write", benchWrite},
+    {"compress", benchCompress},
+    {"decompress", benchDecompress},
+    {"parse", benchParse},
+    {"parseintern", benchParseIntern},
+    {"parselazy", benchParseLazy},
+    {"scan", benchScan},
+    {"seek", benchSeek},
+    {"dump", benchDump},
+    {"callset", benchCallSet},
+};
+
+
+/*
+ * Generate the trace for the fixture, and gather the reference data the
+ * benchmarks need.
+ */
+static bool
+setUp(Fixture &fixture)
+{
+    os::String prefix = os::getTemporaryDirectoryPath();
+    prefix.join(os::String::format("trace_bench.%u.%s",
+                                   unsigned(os::getCurrentProcessId()),
+                                   SynthGenerator::mixName(fixture.mix)));
+    fixture.filename = os::String::format("%s.trace", prefix.str());
+    fixture.scratchFilename = os::String::format("%s.scratch.trace", prefix.str());
+
+    SynthGenerator generator(fixture.options);
+    if (!generator.writeFile(fixture.filename)) {
+        std::cerr << "error: failed to write " << fixture.filename.str() << "\n";
+        return false;
+    }
+
+    std::unique_ptr<File> file(File::createForRead(fixture.filename));
+    if (!file) {
+        return false;
+    }
+    char buffer[64 * 1024];
+    size_t read;
+    while ((read = file->read(buffer, sizeof buffer)) != 0) {
+        fixture.raw.insert(fixture.raw.end(), buffer, buffer + read);
+    }
+    file->close();
+
+    fixture.seekParser.reset(new Parser);
+    Parser &parser = *fixture.seekParser;
+    if (!parser.open(fixture.filename)) {
+        return false;
+    }
+    bool frameStart = true;
+    Call *call;
+    do {
+        ParseBookmark bookmark;
+        parser.getBookmark(bookmark);
+        call = parser.scan_call();
+        if (call) {
+            if (frameStart) {
+                fixture.bookmarks.push_back(bookmark);
+            }
+            frameStart = call->flags & CALL_FLAG_END_FRAME;
+            ++fixture.numCalls;
+            delete call;
+        }
+    } while (call);
+
+    if (fixture.numCalls != fixture.options.numCalls) {
+        std::cerr << "error: parsed " << fixture.numCalls << " calls, expected "
+                  << fixture.options.numCalls << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+
+static void
+tearDown(Fixture &fixture)
+{
+    fixture.seekParser.reset();
+    os::removeFile(fixture.filename);
+    os::removeFile(fixture.scratchFilename);
+}
+
+
+static const char *synopsis = "Run trace library microbenchmarks.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: trace_bench [OPTIONS]\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help             show this help message and exit\n"
+        "    --filter=REGEX         only run benchmarks whose name/mix match regex\n"
+        "    --calls=N              number of calls per synthetic trace [default: 100000]\n"
+        "    --min-time=SECONDS     minimum time to run each benchmark [default: 0.5]\n"
+        "\n"
+        "Mixes: scalar, arrays, blobs, threads, signatures.\n"
+        "Benchmarks: write, compress, decompress, parse, parseintern, parselazy, scan,\n"
+        "seek, dump, callset.\n"
+        "\n"
+    ;
+}
+
+enum {
+    FILTER_OPT = CHAR_MAX + 1,
+    CALLS_OPT,
+    MIN_TIME_OPT,
+};
+
+const static char *
+shortOptions = "h";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"filter", required_argument, 0, FILTER_OPT},
+    {"calls", required_argument, 0, CALLS_OPT},
+    {"min-time", required_argument, 0, MIN_TIME_OPT},
+    {0, 0, 0, 0}
+};
+
+
+int
+main(int argc, char **argv)
+{
+    std::regex filter(".*");
+    unsigned numCalls = 100000;
+    double minTime = 0.5;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case FILTER_OPT:
+            filter = std::regex(optarg);
+            break;
+        case CALLS_OPT:
+            numCalls = strtoul(optarg, NULL, 0);
+            break;
+        case MIN_TIME_OPT:
+            minTime = strtod(optarg, NULL);
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (numCalls < 2) {
+        std::cerr << "error: at least two calls are required\n";
+        return 1;
+    }
+
+    std::cout
+        << std::left << std::setw(24) << "benchmark"
+        << std::right
+        << std::setw(8) << "iters"
+        << std::setw(12) << "ms/iter"
+        << std::setw(12) << "MB/s"
+        << std::setw(14) << "calls/s"
+        << "\n";
+
+    int ret = 0;
+
+    for (unsigned mix = 0; mix < SYNTH_MIX_COUNT; ++mix) {
+        Fixture fixture;
+        fixture.mix = SynthMix(mix);
+        fixture.options.mix = fixture.mix;
+        fixture.options.numCalls = numCalls;
+        if (fixture.mix == SYNTH_MIX_BLOBS) {
+            // Keep the blob trace in the order of tens of MB
+            fixture.options.numCalls = std::max(numCalls / 50, 2U);
+            fixture.options.callsPerFrame = 100;
+            fixture.options.maxBlobSize = 64 * 1024;
+        }
+
+        bool fixtureReady = false;
+
+        for (auto & benchmark : benchmarks) {
+            std::string name = benchmark.name;
+            name += "/";
+            name += SynthGenerator::mixName(fixture.mix);
+            if (!std::regex_search(name, filter)) {
+                continue;
+            }
+
+            if (!fixtureReady) {
+                if (!setUp(fixture)) {
+                    tearDown(fixture);
+                    return 1;
+                }
+                fixtureReady = true;
+            }
+
+            // Run at least once, and then until minTime is exceeded
+            unsigned long long iterations = 0;
+            Result total;
+            long long startTime = os::getTime();
+            long long elapsed;
+            do {
+                Result result;
+                if (!benchmark.function(fixture, result)) {
+                    std::cerr << "error: " << name << " failed\n";
+                    ret = 1;
+                    break;
+                }
+                total.bytes += result.bytes;
+                total.calls += result.calls;
+                ++iterations;
+                elapsed = os::getTime() - startTime;
+            } while (double(elapsed) < minTime * os::timeFrequency);
+
+            if (!iterations) {
+                continue;
+            }
+
+            double seconds = double(elapsed) / os::timeFrequency;
+            if (seconds <= 0.0) {
+                seconds = 1.0 / os::timeFrequency;
+            }
+
+            std::cout
+                << std::left << std::setw(24) << name
+                << std::right << std::fixed
+                << std::setw(8) << iterations
+                << std::setw(12) << std::setprecision(3) << 1000.0 * seconds / iterations;
+            if (total.bytes) {
+                std::cout << std::setw(12) << std::setprecision(1) << total.bytes / seconds / (1024.0 * 1024.0);
+            } else {
+                std::cout << std::setw(12) << "-";
+            }
+            std::cout
+                << std::setw(14) << std::setprecision(0) << total.calls / seconds
+                << std::endl;
+        }
+
+        if (fixtureReady) {
+            tearDown(fixture);
+        }
+    }
+
+    return ret;
+}
@@ -29,6 +29,7 @@
 #include <limits>
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "highlight.hpp"
@@ -231,7 +232,14 @@ void Dumper::visit(Array *array) {
 }
 
 void Dumper::visit(Blob *blob) {
-    os << pointer << "blob(" << blob->size << ")" << normal;
+    os << pointer << "blob(" << blob->size;
+    if (blob->isElided()) {
+        os << ", " << blob->recordedSize << " recorded";
+        if (!blob->digest.empty()) {
+            os << ", " << blob->digest;
+        }
+    }
+    os << ")" << normal;
 }
 
 void Dumper::visit(Pointer *p) {
@@ -263,6 +271,14 @@ void Dumper::visit(Call *call)
     if (dumpFlags & DUMP_FLAG_THREAD_IDS) {
         os << "@" << std::hex << call->thread_id << std::dec << " ";
     }
+    if ((dumpFlags & DUMP_FLAG_TIMESTAMPS) && call->hasTimestamps()) {
+        // enter time in seconds, followed by the duration in microseconds
+        char buf[64];
+        snprintf(buf, sizeof buf, "[%.6f +%.3f] ",
+                 call->enterTime * 1e-9,
+                 (call->leaveTime - call->enterTime) * 1e-3);
+        os << buf;
+    }
 
     if (callFlags & CALL_FLAG_NON_REPRODUCIBLE) {
         os << strike;
@@ -48,7 +48,8 @@ File::createForRead(const char *filename)
     stream.close();
 
     File *file;
-    if (byte1 == SNAPPY_BYTE1 && byte2 == SNAPPY_BYTE2) {
+    if (byte1 == SNAPPY_BYTE1 &&
+        (byte2 == SNAPPY_BYTE2 || byte2 == SNAPPY_BYTE2_CHECKSUM)) {
         file = File::createSnappy();
     } else if (byte1 == 0x1f && byte2 == 0x8b) {
         file = File::createZLib();
@@ -41,6 +41,11 @@
  * The default size of an uncompressed chunk is specified in
  * SNAPPY_CHUNK_SIZE.
  *
+ * In the checksummed revision of the format, identified by
+ * SNAPPY_BYTE2_CHECKSUM, the length is followed by an uint32 CRC-32C of the
+ * compressed data.  Reading stops at the first chunk whose checksum doesn't
+ * match, so that corrupted traces yield the calls up to that point.
+ *
  * Note:
  * Currently the default size for a a to-be-compressed data is
  * 1mb, meaning that the compressed data will be <= 1mb.
@@ -60,6 +65,7 @@
 #include <assert.h>
 #include <string.h>
 
+#include "crc32c.hpp"
 #include "trace_file.hpp"
 #include "trace_snappy.hpp"
 
@@ -109,7 +115,7 @@ private:
     void flushWriteCache(void);
     void flushReadCache(size_t skipLength = 0);
     void createCache(size_t size);
-    size_t readCompressedLength();
+    size_t readUInt32(void);
 private:
     std::ifstream m_stream;
     size_t m_cacheMaxSize;
@@ -121,6 +127,12 @@ private:
 
     uint64_t m_currentChunkOffset;
     std::streampos m_endPos;
+
+    // Whether the cache holds the decompressed current chunk, which isn't
+    // the case when skipping over it entirely
+    bool m_cacheValid;
+
+    bool m_checksums;
 };
 
 SnappyFile::SnappyFile(void)
@@ -128,7 +140,9 @@ SnappyFile::SnappyFile(void)
       m_cacheMaxSize(SNAPPY_CHUNK_SIZE),
       m_cacheSize(m_cacheMaxSize),
       m_cache(new char [m_cacheMaxSize]),
-      m_cachePtr(m_cache)
+      m_cachePtr(m_cache),
+      m_cacheValid(false),
+      m_checksums(false)
 {
     size_t maxCompressedLength =
         snappy::MaxCompressedLength(SNAPPY_CHUNK_SIZE);
@@ -159,7 +173,9 @@ bool SnappyFile::rawOpen(const char *filename)
         unsigned char byte1, byte2;
         m_stream >> byte1;
         m_stream >> byte2;
-        assert(byte1 == SNAPPY_BYTE1 && byte2 == SNAPPY_BYTE2);
+        assert(byte1 == SNAPPY_BYTE1 &&
+               (byte2 == SNAPPY_BYTE2 || byte2 == SNAPPY_BYTE2_CHECKSUM));
+        m_checksums = byte2 == SNAPPY_BYTE2_CHECKSUM;
 
         flushReadCache();
     }
@@ -217,9 +233,12 @@ void SnappyFile::flushReadCache(size_t skipLength)
     //assert(m_cachePtr == m_cache + m_cacheSize);
     m_currentChunkOffset = m_stream.tellg();
     size_t compressedLength;
-    compressedLength = readCompressedLength();
+    compressedLength = readUInt32();
+    uint32_t checksum = m_checksums ? readUInt32() : 0;
     if (!compressedLength) {
-        // Reached end of file
+        // Reached end of file, or the zero-filled tail of a memory-mapped
+        // trace that was not closed cleanly
+        m_stream.setstate(std::ios::eofbit);
         createCache(0);
         return;
     }
@@ -244,6 +263,15 @@ void SnappyFile::flushReadCache(size_t skipLength)
         return;
     }
 
+    if (m_checksums &&
+        crc32c_8bytes(m_compressedCache, compressedLength) != checksum) {
+        std::cerr << "warning: checksum mismatch in trace chunk at offset "
+                  << m_currentChunkOffset << ", ignoring the rest of the trace\n";
+        m_stream.setstate(std::ios::eofbit);
+        createCache(0);
+        return;
+    }
+
     if (!snappy::GetUncompressedLength(m_compressedCache, compressedLength,
                                        &m_cacheSize)) {
         createCache(0);
@@ -254,11 +282,14 @@ void SnappyFile::flushReadCache(size_t skipLength)
     if (skipLength < m_cacheSize) {
         snappy::RawUncompress(m_compressedCache, compressedLength,
                               m_cache);
+    } else {
+        m_cacheValid = false;
     }
 }
 
 void SnappyFile::createCache(size_t size)
 {
+    m_cacheValid = true;
     if (size > m_cacheMaxSize) {
         do {
             m_cacheMaxSize <<= 1;
@@ -273,7 +304,7 @@ void SnappyFile::createCache(size_t size)
     m_cacheSize = size;
 }
 
-size_t SnappyFile::readCompressedLength()
+size_t SnappyFile::readUInt32(void)
 {
     unsigned char buf[4];
     size_t length;
@@ -304,6 +335,15 @@ File::Offset SnappyFile::currentOffset(void) const
 
 void SnappyFile::setCurrentOffset(const File::Offset &offset)
 {
+    // Reuse the current chunk if possible, which is common when reading
+    // lazy blobs
+    if (offset.chunk == m_currentChunkOffset &&
+        m_cacheValid &&
+        offset.offsetInChunk <= m_cacheSize) {
+        m_cachePtr = m_cache + offset.offsetInChunk;
+        return;
+    }
+
     // to remove eof bit
     m_stream.clear();
     // seek to the start of a chunk
@@ -344,6 +384,9 @@ bool SnappyFile::rawSkip(size_t length)
 
 int SnappyFile::rawPercentRead(void)
 {
+    if (endOfData()) {
+        return 100;
+    }
     return int(100 * (double(m_stream.tellg()) / double(m_endPos)));
 }
 
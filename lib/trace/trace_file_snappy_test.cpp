@@ -0,0 +1,122 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include <stdio.h>
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+#include "os_process.hpp"
+#include "os_string.hpp"
+#include "trace_ostream.hpp"
+#include "trace_parser.hpp"
+#include "trace_synth.hpp"
+
+
+using namespace trace;
+
+
+static unsigned
+countCalls(const char *filename)
+{
+    Parser parser;
+    if (!parser.open(filename)) {
+        return 0;
+    }
+    unsigned numCalls = 0;
+    Call *call;
+    while ((call = parser.parse_call())) {
+        delete call;
+        ++numCalls;
+    }
+    return numCalls;
+}
+
+
+class ChecksumTest : public ::testing::Test
+{
+protected:
+    os::String filename;
+    SynthOptions options;
+
+    void SetUp() override {
+        filename = os::getTemporaryDirectoryPath();
+        filename.join(os::String::format("trace_file_snappy_test.%u.trace",
+                                         (unsigned)os::getCurrentProcessId()));
+
+        // Several chunks worth of blobs
+        options.mix = SYNTH_MIX_BLOBS;
+        options.numCalls = 100;
+        options.callsPerFrame = 10;
+
+        Writer writer;
+        Properties properties;
+        ASSERT_TRUE(writer.open(createSnappyStream(filename, true),
+                                TRACE_VERSION, properties));
+        SynthGenerator(options).writeCalls(writer);
+        writer.close();
+    }
+
+    void TearDown() override {
+        os::removeFile(filename);
+    }
+};
+
+
+TEST_F(ChecksumTest, RoundTrip)
+{
+    EXPECT_EQ(countCalls(filename), options.numCalls);
+}
+
+
+TEST_F(ChecksumTest, StopsAtCorruption)
+{
+    FILE *file = fopen(filename, "r+b");
+    ASSERT_NE(file, nullptr);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+
+    // Flip a byte in the second half
+    fseek(file, size * 3 / 4, SEEK_SET);
+    int c = fgetc(file);
+    fseek(file, size * 3 / 4, SEEK_SET);
+    fputc(c ^ 0xff, file);
+    fclose(file);
+
+    unsigned numCalls = countCalls(filename);
+    EXPECT_GT(numCalls, 0U);
+    EXPECT_LT(numCalls, options.numCalls);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
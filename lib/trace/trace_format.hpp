@@ -34,7 +34,7 @@
 namespace trace {
 
 
-#define TRACE_VERSION 6
+#define TRACE_VERSION 7
 
 
 enum Event {
@@ -49,6 +49,7 @@ enum CallDetail {
     CALL_THREAD,
     CALL_BACKTRACE,
     CALL_FLAGS,
+    CALL_TIMESTAMP,
 };
 
 enum Type {
@@ -68,6 +69,8 @@ enum Type {
     TYPE_OPAQUE,
     TYPE_REPR,
     TYPE_WSTRING,
+    TYPE_STRING_REF,
+    TYPE_ELIDED_BLOB,
 };
 
 enum BacktraceDetail {
@@ -0,0 +1,371 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "trace_lifetime.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+
+namespace trace {
+
+
+static bool
+ruleLess(const LifetimeRule &rule, const char *name)
+{
+    return strcmp(rule.function, name) < 0;
+}
+
+
+static bool
+nameLess(const char *name, const LifetimeRule &rule)
+{
+    return strcmp(name, rule.function) < 0;
+}
+
+
+/**
+ * Get the value of an object handle.
+ */
+class HandleVisitor : public Visitor
+{
+public:
+    unsigned long long handle = 0;
+
+    void visit(Null *) override {}
+    void visit(Bool *node) override { handle = node->value; }
+    void visit(SInt *node) override { handle = node->value; }
+    void visit(UInt *node) override { handle = node->value; }
+    void visit(Float *) override {}
+    void visit(Double *) override {}
+    void visit(String *) override {}
+    void visit(WString *) override {}
+    void visit(Enum *node) override { handle = node->value; }
+    void visit(Struct *) override {}
+    void visit(Array *) override {}
+    void visit(Blob *) override {}
+    void visit(Pointer *node) override { handle = node->value; }
+};
+
+
+static unsigned long long
+handleValue(const Value *value)
+{
+    HandleVisitor visitor;
+    const_cast<Value *>(value)->visit(visitor);
+    return visitor.handle;
+}
+
+
+static const Value *
+ruleValue(const Call &call, int index)
+{
+    if (index < 0) {
+        return call.ret;
+    }
+    if ((unsigned)index >= call.args.size()) {
+        return NULL;
+    }
+    return call.args[index].value;
+}
+
+
+LifetimeTracker::LifetimeTracker()
+{
+    contextKind = kindIndex("context");
+    bufferKind = kindIndex("buffer");
+}
+
+
+unsigned
+LifetimeTracker::kindIndex(const char *kind)
+{
+    for (unsigned i = 0; i < kinds.size(); ++i) {
+        if (strcmp(kinds[i], kind) == 0) {
+            return i;
+        }
+    }
+    kinds.push_back(kind);
+    return kinds.size() - 1;
+}
+
+
+const LifetimeTracker::SigRules &
+LifetimeTracker::lookupRules(const FunctionSig *sig)
+{
+    if (sig->id >= sigRules.size()) {
+        sigRules.resize(sig->id + 1);
+    }
+
+    SigRules &rules = sigRules[sig->id];
+    if (!rules.resolved) {
+        rules.resolved = true;
+        const LifetimeRule *first = lifetimeRules;
+        const LifetimeRule *last = lifetimeRules + numLifetimeRules;
+        rules.begin = std::lower_bound(first, last, sig->name, ruleLess);
+        rules.end = std::upper_bound(rules.begin, last, sig->name, nameLess);
+        for (const LifetimeRule *rule = rules.begin; rule != rules.end; ++rule) {
+            rules.kinds.push_back(kindIndex(rule->kind));
+        }
+    }
+    return rules;
+}
+
+
+ObjectLifetime *
+LifetimeTracker::lookup(unsigned kind, unsigned long long name)
+{
+    auto it = live.find(Key(kind, name));
+    if (it == live.end()) {
+        return NULL;
+    }
+    return &objects[it->second];
+}
+
+
+void
+LifetimeTracker::create(unsigned kind, unsigned long long name, CallNo callNo)
+{
+    if (!name) {
+        return;
+    }
+
+    // A name may be reused without its deletion being noticed
+    destroy(kind, name, callNo);
+
+    ObjectLifetime object;
+    object.kind = kinds[kind];
+    object.name = name;
+    object.created = callNo;
+    object.lastUsed = callNo;
+    object.createdFrame = frameNo;
+
+    live[Key(kind, name)] = objects.size();
+    objects.push_back(object);
+
+    if (kind == contextKind) {
+        ++liveContexts;
+    }
+}
+
+
+void
+LifetimeTracker::destroy(unsigned kind, unsigned long long name, CallNo callNo)
+{
+    auto it = live.find(Key(kind, name));
+    if (it == live.end()) {
+        return;
+    }
+
+    ObjectLifetime &object = objects[it->second];
+    object.deleted = callNo;
+    liveBytes -= object.size;
+    live.erase(it);
+
+    if (kind == contextKind) {
+        assert(liveContexts > 0);
+        if (--liveContexts == 0) {
+            leakAll(callNo);
+        }
+    }
+}
+
+
+void
+LifetimeTracker::leakAll(CallNo callNo)
+{
+    for (auto &entry : live) {
+        ObjectLifetime &object = objects[entry.second];
+        object.deleted = callNo;
+        object.leaked = true;
+    }
+    live.clear();
+    bindings.clear();
+    liveBytes = 0;
+}
+
+
+void
+LifetimeTracker::handleCall(const Call &call)
+{
+    lastCall = call.no;
+    frameCalls = true;
+
+    if (!(call.flags & CALL_FLAG_NO_SIDE_EFFECTS)) {
+        const SigRules &rules = lookupRules(call.sig);
+        for (size_t i = 0; i < rules.kinds.size(); ++i) {
+            applyRule(call, rules.begin[i], rules.kinds[i]);
+        }
+    }
+
+    if (call.flags & CALL_FLAG_END_FRAME) {
+        endFrame();
+    }
+}
+
+
+void
+LifetimeTracker::applyRule(const Call &call, const LifetimeRule &rule, unsigned kind)
+{
+    unsigned long long target = 0;
+    if (rule.targetArg >= 0) {
+        const Value *value = ruleValue(call, rule.targetArg);
+        if (!value) {
+            return;
+        }
+        target = handleValue(value);
+    }
+
+    if (rule.action == LIFETIME_SIZE) {
+        const Value *size = ruleValue(call, rule.countArg);
+        if (!size) {
+            return;
+        }
+
+        unsigned long long name;
+        if (rule.arg >= 0) {
+            const Value *value = ruleValue(call, rule.arg);
+            if (!value) {
+                return;
+            }
+            name = handleValue(value);
+        } else {
+            auto it = bindings.find(Key(kind, target));
+            if (it == bindings.end()) {
+                return;
+            }
+            name = it->second;
+        }
+
+        ObjectLifetime *object = lookup(kind, name);
+        if (object) {
+            liveBytes -= object->size;
+            object->size = std::max(size->toSInt(), 0LL);
+            liveBytes += object->size;
+            object->lastUsed = call.no;
+        }
+        return;
+    }
+
+    const Value *value = ruleValue(call, rule.arg);
+    if (!value) {
+        return;
+    }
+
+    // Gather the handles
+    std::vector<unsigned long long> names;
+    const Array *array = value->toArray();
+    if (array) {
+        names.reserve(array->values.size());
+        for (const Value *element : array->values) {
+            names.push_back(handleValue(element));
+        }
+    } else {
+        unsigned long long name = handleValue(value);
+        unsigned long long count = 1;
+        if (rule.countArg >= 0) {
+            const Value *countValue = ruleValue(call, rule.countArg);
+            if (!countValue) {
+                return;
+            }
+            count = std::max(countValue->toSInt(), 0LL);
+        }
+        if (name) {
+            names.reserve(count);
+            for (unsigned long long i = 0; i < count; ++i) {
+                names.push_back(name + i);
+            }
+        }
+    }
+
+    for (unsigned long long name : names) {
+        if (!name) {
+            continue;
+        }
+
+        switch (rule.action) {
+        case LIFETIME_CREATE:
+            create(kind, name, call.no);
+            break;
+        case LIFETIME_DELETE:
+            destroy(kind, name, call.no);
+            break;
+        case LIFETIME_BIND:
+            // Binding an unused name creates the object on legacy contexts
+            if (!lookup(kind, name)) {
+                create(kind, name, call.no);
+            }
+            bindings[Key(kind, target)] = name;
+            /* fall-through */
+        case LIFETIME_USE:
+            if (ObjectLifetime *object = lookup(kind, name)) {
+                object->lastUsed = call.no;
+            }
+            break;
+        default:
+            assert(0);
+            break;
+        }
+    }
+
+    if (rule.action == LIFETIME_BIND && names.empty()) {
+        bindings.erase(Key(kind, target));
+    }
+}
+
+
+void
+LifetimeTracker::endFrame(void)
+{
+    FrameLifetime frame;
+    frame.frame = frameNo;
+    frame.lastCall = lastCall;
+    frame.liveObjects = live.size();
+    frame.liveBytes = liveBytes;
+    frames.push_back(frame);
+
+    ++frameNo;
+    frameCalls = false;
+}
+
+
+void
+LifetimeTracker::finish(void)
+{
+    for (auto &entry : live) {
+        objects[entry.second].leaked = true;
+    }
+
+    if (frameCalls) {
+        endFrame();
+    }
+}
+
+
+} /* namespace trace */
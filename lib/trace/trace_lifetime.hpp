@@ -0,0 +1,228 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/*
+ * Tracking of the lifetime of API objects (textures, buffers, programs,
+ * contexts, etc) over a trace.
+ */
+
+#pragma once
+
+
+#include <stddef.h>
+
+#include <unordered_map>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "trace_model.hpp"
+
+
+namespace trace {
+
+
+enum LifetimeAction {
+    LIFETIME_CREATE,    // handles are new objects
+    LIFETIME_DELETE,    // handles are deleted
+    LIFETIME_BIND,      // handle is bound to a target
+    LIFETIME_USE,       // handles are merely used
+    LIFETIME_SIZE,      // sets the storage size of a buffer
+};
+
+
+/**
+ * How a function affects objects of a kind.
+ *
+ * The table of rules is generated from the API specs by
+ * trace_lifetime_gl.py.
+ */
+struct LifetimeRule
+{
+    const char *function;
+    LifetimeAction action;
+    const char *kind;
+
+    // Handle argument, or -1 for the return value (or for the object bound
+    // to targetArg, in LIFETIME_SIZE rules)
+    int arg;
+
+    // Number of consecutive names for ranges (glGenLists, glDeleteLists), or
+    // the size argument of LIFETIME_SIZE rules; -1 if none
+    int countArg;
+
+    // Binding target argument, or -1 if none
+    int targetArg;
+};
+
+extern const LifetimeRule lifetimeRules[];
+extern const size_t numLifetimeRules;
+
+
+static const CallNo NO_CALL = ~0U;
+
+
+struct ObjectLifetime
+{
+    const char *kind;
+    unsigned long long name;
+
+    CallNo created = NO_CALL;
+    CallNo lastUsed = NO_CALL;
+
+    // Call which deleted the object (or destroyed the last context, when
+    // leaked), or NO_CALL if it lived until the end of the trace
+    CallNo deleted = NO_CALL;
+
+    unsigned createdFrame = 0;
+
+    // Storage size in bytes, for buffers
+    unsigned long long size = 0;
+
+    // Whether the object was never explicitly deleted
+    bool leaked = false;
+};
+
+
+struct FrameLifetime
+{
+    unsigned frame;
+    CallNo lastCall;
+    size_t liveObjects;
+    unsigned long long liveBytes;
+};
+
+
+/**
+ * Follows object creation, use and deletion over a stream of calls.
+ *
+ * Object names are tracked in a single namespace per kind, regardless of
+ * contexts and share groups.  When the last context is destroyed, all
+ * objects still alive are considered leaked.
+ */
+class LifetimeTracker
+{
+public:
+    LifetimeTracker();
+
+    void
+    handleCall(const Call &call);
+
+    /**
+     * Mark objects alive at the end of the trace as leaked, and account the
+     * last (possibly unterminated) frame.
+     */
+    void
+    finish(void);
+
+    /**
+     * All objects, by order of creation.
+     */
+    const std::vector<ObjectLifetime> &
+    getObjects(void) const {
+        return objects;
+    }
+
+    /**
+     * Live objects and bytes at the end of every frame.
+     */
+    const std::vector<FrameLifetime> &
+    getFrames(void) const {
+        return frames;
+    }
+
+    size_t
+    getLiveObjects(void) const {
+        return live.size();
+    }
+
+    unsigned long long
+    getLiveBytes(void) const {
+        return liveBytes;
+    }
+
+private:
+    struct SigRules {
+        bool resolved = false;
+        const LifetimeRule *begin = nullptr;
+        const LifetimeRule *end = nullptr;
+        std::vector<unsigned> kinds;
+    };
+
+    typedef std::pair<unsigned, unsigned long long> Key;
+
+    struct KeyHash {
+        size_t operator () (const Key &key) const {
+            return std::hash<unsigned long long>()(key.second) ^ (size_t)key.first * 0x9e3779b9U;
+        }
+    };
+
+    std::vector<SigRules> sigRules;
+
+    std::vector<const char *> kinds;
+    unsigned contextKind;
+    unsigned bufferKind;
+
+    std::vector<ObjectLifetime> objects;
+    std::unordered_map<Key, size_t, KeyHash> live;
+    std::map<Key, unsigned long long> bindings;
+    unsigned long long liveBytes = 0;
+    size_t liveContexts = 0;
+
+    unsigned frameNo = 0;
+    CallNo lastCall = NO_CALL;
+    bool frameCalls = false;
+
+    std::vector<FrameLifetime> frames;
+
+    const SigRules &
+    lookupRules(const FunctionSig *sig);
+
+    unsigned
+    kindIndex(const char *kind);
+
+    void
+    applyRule(const Call &call, const LifetimeRule &rule, unsigned kind);
+
+    void
+    create(unsigned kind, unsigned long long name, CallNo callNo);
+
+    void
+    destroy(unsigned kind, unsigned long long name, CallNo callNo);
+
+    ObjectLifetime *
+    lookup(unsigned kind, unsigned long long name);
+
+    void
+    leakAll(CallNo callNo);
+
+    void
+    endFrame(void);
+};
+
+
+} /* namespace trace */
@@ -0,0 +1,194 @@
+#!/usr/bin/env python
+##########################################################################
+#
+# Copyright 2026 agent
+# All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+##########################################################################/
+
+
+'''Generate the table of object lifetime rules for trace::LifetimeTracker
+from the API specs.
+
+Handle arguments determine which functions create, delete, bind or just use
+GL objects, so that the table doesn't need to be maintained by hand.
+'''
+
+
+# Adjust path
+import os.path
+import re
+import sys
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', '..'))
+
+
+import specs.stdapi as stdapi
+from specs.gltypes import contextKey
+from specs.glapi import glapi
+from specs.glxapi import glxapi, GLXContext
+from specs.wglapi import wglapi, HGLRC
+from specs.cglapi import cglapi, CGLContextObj
+from specs.eglapi import eglapi, EGLContext
+
+
+contextTypes = (GLXContext, HGLRC, CGLContextObj, EGLContext)
+
+
+def stripConst(type):
+    while isinstance(type, stdapi.Const):
+        type = type.type
+    return type
+
+
+def objectKind(type):
+    '''Kind of object referred by a handle type, or None.'''
+
+    type = stripConst(type)
+    if type in contextTypes:
+        return 'context'
+    if isinstance(type, stdapi.Handle) and type.name[0].islower():
+        # Handles keyed by other objects (uniform locations, etc) are not
+        # objects on their own
+        if type.key is None or type.key is contextKey:
+            return type.name
+    return None
+
+
+def elementKind(type):
+    '''Kind of object referred by each element of an array of handles.'''
+
+    type = stripConst(type)
+    if isinstance(type, (stdapi.Array, stdapi.Pointer)):
+        return objectKind(type.type)
+    return None
+
+
+class Rule:
+
+    def __init__(self, function, action, kind, arg, countArg = -1, targetArg = -1):
+        self.function = function
+        self.action = action
+        self.kind = kind
+        self.arg = arg
+        self.countArg = countArg
+        self.targetArg = targetArg
+
+
+createRE = re.compile(r'^(gl|glX|egl|wgl|CGL)(Gen|Create|New)[A-Z]|^glFenceSync')
+deleteRE = re.compile(r'^(gl|glX|egl|wgl|CGL)(Delete|Destroy)[A-Z]')
+bindRE = re.compile(r'^glBind[A-Z]')
+bufferSizeRE = re.compile(r'^gl(Named)?Buffer(Data|Storage)(ARB|EXT)?$')
+
+
+def argIndex(function, name):
+    for arg in function.args:
+        if arg.name == name:
+            return arg.index
+    return -1
+
+
+def functionRules(function):
+    rules = []
+
+    isCreate = createRE.match(function.name) is not None
+    isDelete = deleteRE.match(function.name) is not None
+    isBind = bindRE.match(function.name) is not None
+    targetArg = argIndex(function, 'target')
+
+    # Objects returned by the function
+    kind = objectKind(function.type)
+    if kind is not None and isCreate:
+        countArg = -1
+        handle = stripConst(function.type)
+        if isinstance(handle, stdapi.Handle) and handle.range is not None:
+            countArg = argIndex(function, handle.range)
+        rules.append(Rule(function, 'CREATE', kind, -1, countArg))
+
+    for arg in function.args:
+        kind = elementKind(arg.type)
+        if kind is not None:
+            if arg.output:
+                if isCreate:
+                    rules.append(Rule(function, 'CREATE', kind, arg.index))
+            elif isDelete:
+                rules.append(Rule(function, 'DELETE', kind, arg.index))
+            else:
+                rules.append(Rule(function, 'USE', kind, arg.index))
+            continue
+
+        kind = objectKind(arg.type)
+        if kind is not None and arg.input:
+            if isDelete:
+                # glDeleteLists deletes a range of names
+                rules.append(Rule(function, 'DELETE', kind, arg.index, argIndex(function, 'range')))
+            elif isBind and targetArg != -1 and targetArg < arg.index:
+                rules.append(Rule(function, 'BIND', kind, arg.index, targetArg = targetArg))
+            else:
+                rules.append(Rule(function, 'USE', kind, arg.index))
+
+    if bufferSizeRE.match(function.name):
+        sizeArg = argIndex(function, 'size')
+        bufferArg = argIndex(function, 'buffer')
+        if sizeArg != -1:
+            rules.append(Rule(function, 'SIZE', 'buffer', bufferArg, sizeArg, targetArg))
+
+    return rules
+
+
+def main():
+    rules = []
+    for module in (glapi, glxapi, wglapi, cglapi, eglapi):
+        for function in module.functions:
+            rules.extend(functionRules(function))
+
+    # Only track kinds of objects that can be explicitly deleted
+    deletable = set([rule.kind for rule in rules if rule.action == 'DELETE'])
+    rules = [rule for rule in rules if rule.kind in deletable]
+
+    # Sorted by function name, for binary search
+    rules.sort(key = lambda rule: rule.function.name)
+
+    print '// Generated by', os.path.basename(sys.argv[0]), '-- do not edit'
+    print
+    print '#include "trace_lifetime.hpp"'
+    print
+    print
+    print 'namespace trace {'
+    print
+    print
+    print 'const LifetimeRule'
+    print 'lifetimeRules[] = {'
+    for rule in rules:
+        print '    {"%s", LIFETIME_%s, "%s", %i, %i, %i},' % (
+            rule.function.name, rule.action, rule.kind,
+            rule.arg, rule.countArg, rule.targetArg,
+        )
+    print '};'
+    print
+    print 'const size_t'
+    print 'numLifetimeRules = sizeof lifetimeRules / sizeof lifetimeRules[0];'
+    print
+    print
+    print '} /* namespace trace */'
+
+
+if __name__ == '__main__':
+    main()
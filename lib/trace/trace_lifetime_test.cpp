@@ -0,0 +1,200 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "trace_lifetime.hpp"
+
+#include "gtest/gtest.h"
+
+
+using namespace trace;
+
+
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_TEXTURE_2D 0x0DE1
+
+
+static const char *args2[] = {"a", "b"};
+static const char *args4[] = {"a", "b", "c", "d"};
+
+static const FunctionSig glXCreateContext_sig = {0, "glXCreateContext", 4, args4};
+static const FunctionSig glGenBuffers_sig = {1, "glGenBuffers", 2, args2};
+static const FunctionSig glBindBuffer_sig = {2, "glBindBuffer", 2, args2};
+static const FunctionSig glBufferData_sig = {3, "glBufferData", 4, args4};
+static const FunctionSig glXSwapBuffers_sig = {4, "glXSwapBuffers", 2, args2};
+static const FunctionSig glDeleteBuffers_sig = {5, "glDeleteBuffers", 2, args2};
+static const FunctionSig glGenTextures_sig = {6, "glGenTextures", 2, args2};
+static const FunctionSig glBindTexture_sig = {7, "glBindTexture", 2, args2};
+static const FunctionSig glXDestroyContext_sig = {8, "glXDestroyContext", 2, args2};
+
+
+class CallBuilder
+{
+    Call *call;
+    unsigned index = 0;
+
+public:
+    CallBuilder(const FunctionSig &sig, CallNo no, CallFlags flags = 0) :
+        call(new Call(&sig, flags, 0))
+    {
+        call->no = no;
+        for (auto &arg : call->args) {
+            arg.value = new Null;
+        }
+    }
+
+    ~CallBuilder() {
+        delete call;
+    }
+
+    CallBuilder &
+    arg(Value *value) {
+        delete call->args[index].value;
+        call->args[index++].value = value;
+        return *this;
+    }
+
+    CallBuilder &
+    arg(unsigned long long value) {
+        return arg(new UInt(value));
+    }
+
+    CallBuilder &
+    names(std::initializer_list<unsigned long long> names) {
+        Array *array = new Array(names.size());
+        size_t i = 0;
+        for (auto name : names) {
+            array->values[i++] = new UInt(name);
+        }
+        return arg(array);
+    }
+
+    CallBuilder &
+    ret(Value *value) {
+        call->ret = value;
+        return *this;
+    }
+
+    void
+    handle(LifetimeTracker &tracker) {
+        tracker.handleCall(*call);
+    }
+};
+
+
+static const ObjectLifetime *
+findObject(const LifetimeTracker &tracker, const char *kind, unsigned long long name)
+{
+    for (auto &object : tracker.getObjects()) {
+        if (strcmp(object.kind, kind) == 0 && object.name == name) {
+            return &object;
+        }
+    }
+    return NULL;
+}
+
+
+TEST(LifetimeTracker, Basic)
+{
+    LifetimeTracker tracker;
+
+    CallBuilder(glXCreateContext_sig, 0).ret(new Pointer(0x1000)).handle(tracker);
+    CallBuilder(glGenBuffers_sig, 1).arg(2).names({1, 2}).handle(tracker);
+    CallBuilder(glBindBuffer_sig, 2).arg(GL_ARRAY_BUFFER).arg(1).handle(tracker);
+    CallBuilder(glBufferData_sig, 3).arg(GL_ARRAY_BUFFER).arg(new SInt(1024)).handle(tracker);
+    CallBuilder(glXSwapBuffers_sig, 4, CALL_FLAG_END_FRAME).handle(tracker);
+    CallBuilder(glDeleteBuffers_sig, 5).arg(1).names({1}).handle(tracker);
+    CallBuilder(glGenTextures_sig, 6).arg(1).names({7}).handle(tracker);
+    CallBuilder(glBindTexture_sig, 7).arg(GL_TEXTURE_2D).arg(7).handle(tracker);
+    CallBuilder(glXDestroyContext_sig, 8).arg(new Pointer(0xd15)).arg(new Pointer(0x1000)).handle(tracker);
+    tracker.finish();
+
+    ASSERT_EQ(4, tracker.getObjects().size());
+
+    const ObjectLifetime *context = findObject(tracker, "context", 0x1000);
+    ASSERT_TRUE(context);
+    EXPECT_EQ(0, context->created);
+    EXPECT_EQ(8, context->deleted);
+    EXPECT_FALSE(context->leaked);
+
+    const ObjectLifetime *buffer1 = findObject(tracker, "buffer", 1);
+    ASSERT_TRUE(buffer1);
+    EXPECT_EQ(1, buffer1->created);
+    EXPECT_EQ(3, buffer1->lastUsed);
+    EXPECT_EQ(5, buffer1->deleted);
+    EXPECT_EQ(1024, buffer1->size);
+    EXPECT_FALSE(buffer1->leaked);
+
+    const ObjectLifetime *buffer2 = findObject(tracker, "buffer", 2);
+    ASSERT_TRUE(buffer2);
+    EXPECT_EQ(1, buffer2->lastUsed);
+    EXPECT_EQ(8, buffer2->deleted);
+    EXPECT_TRUE(buffer2->leaked);
+
+    const ObjectLifetime *texture = findObject(tracker, "texture", 7);
+    ASSERT_TRUE(texture);
+    EXPECT_EQ(1, texture->createdFrame);
+    EXPECT_EQ(7, texture->lastUsed);
+    EXPECT_TRUE(texture->leaked);
+
+    const std::vector<FrameLifetime> &frames = tracker.getFrames();
+    ASSERT_EQ(2, frames.size());
+    EXPECT_EQ(4, frames[0].lastCall);
+    EXPECT_EQ(3, frames[0].liveObjects);
+    EXPECT_EQ(1024, frames[0].liveBytes);
+    EXPECT_EQ(8, frames[1].lastCall);
+    EXPECT_EQ(0, frames[1].liveObjects);
+    EXPECT_EQ(0, frames[1].liveBytes);
+}
+
+
+TEST(LifetimeTracker, Lists)
+{
+    LifetimeTracker tracker;
+
+    static const char *args1[] = {"range"};
+    static const FunctionSig glGenLists_sig = {0, "glGenLists", 1, args1};
+    static const FunctionSig glDeleteLists_sig = {1, "glDeleteLists", 2, args2};
+
+    CallBuilder(glGenLists_sig, 0).arg(3).ret(new UInt(10)).handle(tracker);
+    EXPECT_EQ(3, tracker.getLiveObjects());
+    CallBuilder(glDeleteLists_sig, 1).arg(10).arg(new SInt(2)).handle(tracker);
+    EXPECT_EQ(1, tracker.getLiveObjects());
+    tracker.finish();
+
+    const ObjectLifetime *list = findObject(tracker, "list", 12);
+    ASSERT_TRUE(list);
+    EXPECT_TRUE(list->leaked);
+    EXPECT_EQ(NO_CALL, list->deleted);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -26,6 +26,8 @@
 
 #include <string.h>
 #include <deque>
+#include <iostream>
+#include <mutex>
 
 #include "trace_model.hpp"
 
@@ -58,7 +60,18 @@ Call::argByName(const char *argName) {
 
 
 String::~String() {
-    delete [] value;
+    if (!shared) {
+        delete [] value;
+    }
+}
+
+
+void String::setValue(const char *_value) {
+    if (!shared) {
+        delete [] value;
+    }
+    shared.reset();
+    value = _value;
 }
 
 
@@ -127,6 +140,10 @@ size_t BoundBlob::totalSize = 0;
 typedef std::deque<BoundBlob> BoundBlobQueue;
 static BoundBlobQueue boundBlobQueue;
 
+// Protects the queue above and BoundBlob::totalSize, as calls may be
+// destroyed from several threads
+static std::mutex boundBlobMutex;
+
 
 Blob::~Blob() {
     // Blobs are often bound and referred during many calls, so we can't delete
@@ -138,11 +155,15 @@ Blob::~Blob() {
     // we can easily exhaust all memory.  So instead we maintain a queue of
     // bound blobs and keep the total size bounded.
 
+    delete [] prefix;
+
     if (!bound) {
         delete [] buf;
         return;
     }
 
+    std::lock_guard<std::mutex> lock(boundBlobMutex);
+
     while (!boundBlobQueue.empty() &&
            BoundBlob::totalSize + size > BLOB_MAX_BOUND_SIZE) {
         boundBlobQueue.pop_front();
@@ -152,6 +173,53 @@ Blob::~Blob() {
     boundBlobQueue.push_back(std::move(bb));
 }
 
+void Blob::releaseBound(void) {
+    std::lock_guard<std::mutex> lock(boundBlobMutex);
+    boundBlobQueue.clear();
+}
+
+void Blob::loadPrefix(void) {
+    assert(!prefix);
+    prefix = new char[recordedSize];
+    if (!source || !source->readBlob(offset, prefix, recordedSize)) {
+        std::cerr << "warning: failed to read blob contents\n";
+        memset(prefix, 0, recordedSize);
+    }
+    source.reset();
+}
+
+const char *Blob::recordedData(void) const {
+    if (buf) {
+        return buf;
+    }
+    if (recordedSize == size) {
+        return data();
+    }
+    if (!prefix) {
+        const_cast<Blob *>(this)->loadPrefix();
+    }
+    return prefix;
+}
+
+void Blob::load(void) {
+    assert(!buf);
+    if (recordedSize < size) {
+        const char *recorded = recordedData();
+        buf = new char[size];
+        memcpy(buf, recorded, recordedSize);
+        memset(buf + recordedSize, 0, size - recordedSize);
+        delete [] prefix;
+        prefix = nullptr;
+        return;
+    }
+    buf = new char[size];
+    if (!source || !source->readBlob(offset, buf, size)) {
+        std::cerr << "warning: failed to read blob contents\n";
+        memset(buf, 0, size);
+    }
+    source.reset();
+}
+
 StackFrame::~StackFrame() {
     if (module != NULL) {
         delete [] module;
@@ -228,13 +296,13 @@ double Repr   ::toDouble(void) const { return machineValue->toDouble(); }
 // pointer cast
 void * Value  ::toPointer(void) const { assert(0); return NULL; }
 void * Null   ::toPointer(void) const { return NULL; }
-void * Blob   ::toPointer(void) const { return buf; }
+void * Blob   ::toPointer(void) const { return const_cast<char *>(data()); }
 void * Pointer::toPointer(void) const { return (void *)value; }
 void * Repr   ::toPointer(void) const { return machineValue->toPointer(); }
 
 void * Value  ::toPointer(bool bind) { assert(0); return NULL; }
 void * Null   ::toPointer(bool bind) { return NULL; }
-void * Blob   ::toPointer(bool bind) { if (bind) bound = true; return buf; }
+void * Blob   ::toPointer(bool bind) { if (bind) bound = true; return const_cast<char *>(data()); }
 void * Pointer::toPointer(bool bind) { return (void *)value; }
 void * Repr   ::toPointer(bool bind) { return machineValue->toPointer(bind); }
 
@@ -34,9 +34,13 @@
 #include <stdlib.h>
 
 #include <map>
+#include <memory>
+#include <string>
 #include <vector>
 #include <ostream>
 
+#include "trace_file.hpp"
+
 
 namespace trace {
 
@@ -233,13 +237,30 @@ class String : public Value
 {
 public:
     String(const char * _value) : value(_value) {}
+
+    /**
+     * String sharing an interned, immutable buffer.
+     */
+    String(const std::shared_ptr<const char> &_shared) :
+        value(_shared.get()),
+        shared(_shared)
+    {}
+
     ~String();
 
     bool toBool(void) const override;
     const char *toString(void) const override;
     void visit(Visitor &visitor) override;
 
+    /**
+     * Replace the value, taking ownership of the new one.
+     */
+    void setValue(const char *_value);
+
     const char * value;
+
+private:
+    std::shared_ptr<const char> shared;
 };
 
 
@@ -327,6 +348,18 @@ public:
 };
 
 
+/**
+ * Where the contents of lazily parsed blobs can be read from.
+ */
+class BlobSource
+{
+public:
+    virtual ~BlobSource() {}
+
+    virtual bool readBlob(const File::Offset &offset, void *buf, size_t size) = 0;
+};
+
+
 class Blob : public Value
 {
 public:
@@ -334,8 +367,33 @@ public:
         size = _size;
         buf = new char[_size];
         bound = false;
+        recordedSize = _size;
     }
 
+    /**
+     * Elided blob, taking ownership of the first _recordedSize bytes of the
+     * contents.
+     */
+    Blob(size_t _size, char *_prefix, size_t _recordedSize) :
+        size(_size),
+        buf(nullptr),
+        bound(false),
+        recordedSize(_recordedSize),
+        prefix(_prefix)
+    {}
+
+    /**
+     * Blob whose contents are only read from the source on first access.
+     */
+    Blob(size_t _size, const std::shared_ptr<BlobSource> &_source, const File::Offset &_offset) :
+        size(_size),
+        buf(nullptr),
+        bound(false),
+        recordedSize(_size),
+        source(_source),
+        offset(_offset)
+    {}
+
     ~Blob();
 
     bool toBool(void) const override;
@@ -347,9 +405,58 @@ public:
     const Blob *toBlob(void) const override { return this; }
     Blob *toBlob(void) override { return this; }
 
+    /**
+     * Contents, read on demand for lazy blobs, and zero-filled past
+     * recordedSize for elided blobs.  Use this rather than buf.
+     */
+    inline const char *
+    data(void) const {
+        if (!buf) {
+            const_cast<Blob *>(this)->load();
+        }
+        return buf;
+    }
+
+    /**
+     * The first recordedSize bytes of the contents, without materializing
+     * the unrecorded part of elided blobs.
+     */
+    const char *
+    recordedData(void) const;
+
     size_t size;
     char *buf;
     bool bound;
+
+    /**
+     * For blobs elided by the tracer's blob policy, only the first
+     * recordedSize bytes are the original contents, and the rest is zero.
+     * The digest, if any, describes the original contents.
+     */
+    size_t recordedSize;
+    std::string digest;
+
+    inline bool
+    isElided(void) const {
+        return recordedSize < size || !digest.empty();
+    }
+
+    /**
+     * Free the contents of all the bound blobs kept so far, once nothing
+     * may refer to them anymore, e.g., before replaying another trace.
+     */
+    static void
+    releaseBound(void);
+
+private:
+    std::shared_ptr<BlobSource> source;
+    File::Offset offset;
+
+    // Recorded contents of elided blobs, until fully loaded
+    char *prefix = nullptr;
+
+    void load(void);
+    void loadPrefix(void);
 };
 
 
@@ -541,6 +648,12 @@ enum {
     CALL_FLAG_MARKER                    = (1 << 8),
     CALL_FLAG_MARKER_PUSH               = (1 << 9),
     CALL_FLAG_MARKER_POP                = (1 << 10),
+
+    /**
+     * Whether the contents of some input blob were only partially recorded,
+     * due to the tracer's blob policy.
+     */
+    CALL_FLAG_ELIDED                    = (1 << 11),
 };
 
 
@@ -562,13 +675,23 @@ public:
     CallFlags flags;
     Backtrace* backtrace;
 
+    /**
+     * Capture-time enter/leave timestamps, in nanoseconds since tracing
+     * started, or NO_TIMESTAMP if the trace doesn't record them.
+     */
+    static const unsigned long long NO_TIMESTAMP = ~0ULL;
+    unsigned long long enterTime;
+    unsigned long long leaveTime;
+
     Call(const FunctionSig *_sig, const CallFlags &_flags, unsigned _thread_id) :
         thread_id(_thread_id), 
         sig(_sig), 
         args(_sig->num_args), 
         ret(0),
         flags(_flags),
-        backtrace(0) {
+        backtrace(0),
+        enterTime(NO_TIMESTAMP),
+        leaveTime(NO_TIMESTAMP) {
     }
 
     ~Call();
@@ -586,6 +709,11 @@ public:
 
     Value &
     argByName(const char *argName);
+
+    inline bool
+    hasTimestamps(void) const {
+        return enterTime != NO_TIMESTAMP && leaveTime != NO_TIMESTAMP;
+    }
 };
 
 
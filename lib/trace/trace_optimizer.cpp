@@ -0,0 +1,665 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <limits.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "trace_optimizer.hpp"
+
+
+namespace trace {
+
+
+#define GL_TEXTURE_GEN_S                0x0C60
+#define GL_TEXTURE_GEN_T                0x0C61
+#define GL_TEXTURE_GEN_R                0x0C62
+#define GL_TEXTURE_GEN_Q                0x0C63
+#define GL_TEXTURE_1D                   0x0DE0
+#define GL_TEXTURE_2D                   0x0DE1
+#define GL_TEXTURE_3D                   0x806F
+#define GL_TEXTURE_RECTANGLE            0x84F5
+#define GL_TEXTURE_CUBE_MAP             0x8513
+#define GL_ELEMENT_ARRAY_BUFFER         0x8893
+#define GL_TRANSFORM_FEEDBACK_BUFFER    0x8C8E
+#define GL_TEXTURE_EXTERNAL_OES         0x8D65
+
+
+/**
+ * Strip the vendor suffix of extension functions which behave like their
+ * core counterparts.
+ */
+static std::string
+coreName(const char *name)
+{
+    static const char *suffixes[] = {"ARB", "EXT", "OES", "APPLE", "KHR", "NV"};
+    std::string s(name);
+    for (auto suffix : suffixes) {
+        size_t len = strlen(suffix);
+        if (s.length() > len &&
+            s.compare(s.length() - len, len, suffix) == 0) {
+            s.erase(s.length() - len);
+            break;
+        }
+    }
+    return s;
+}
+
+
+static bool
+startsWith(const std::string &s, const char *prefix)
+{
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+
+static bool
+isUniformSuffix(const std::string &s, size_t pos)
+{
+    // glUniform1f, glUniform4fv, glUniformMatrix4fv, glUniformHandleui64,
+    // glUniformui64, etc.
+    return pos < s.length() &&
+           ((s[pos] >= '1' && s[pos] <= '4') ||
+            s.compare(pos, 6, "Matrix") == 0 ||
+            s.compare(pos, 6, "Handle") == 0 ||
+            s.compare(pos, 4, "ui64") == 0);
+}
+
+
+/**
+ * Capabilities which are enabled separately for each texture unit.
+ */
+static bool
+isTextureUnitCap(unsigned long long cap)
+{
+    switch (cap) {
+    case GL_TEXTURE_1D:
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_RECTANGLE:
+    case GL_TEXTURE_CUBE_MAP:
+    case GL_TEXTURE_EXTERNAL_OES:
+    case GL_TEXTURE_GEN_S:
+    case GL_TEXTURE_GEN_T:
+    case GL_TEXTURE_GEN_R:
+    case GL_TEXTURE_GEN_Q:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+StateCallKind
+classifyStateCall(const char *name, unsigned &contextArg)
+{
+    contextArg = 0;
+
+    if (strcmp(name, "glXMakeCurrent") == 0 ||
+        strcmp(name, "wglMakeCurrent") == 0 ||
+        strcmp(name, "CGLSetCurrentContext") == 0) {
+        contextArg = name[0] == 'g' ? 2 : name[0] == 'w' ? 1 : 0;
+        return STATE_CALL_MAKE_CURRENT;
+    }
+    if (strcmp(name, "glXMakeContextCurrent") == 0 ||
+        strcmp(name, "glXMakeCurrentReadSGI") == 0 ||
+        strcmp(name, "eglMakeCurrent") == 0) {
+        contextArg = 3;
+        return STATE_CALL_MAKE_CURRENT;
+    }
+    if (strcmp(name, "wglMakeContextCurrentARB") == 0 ||
+        strcmp(name, "wglMakeContextCurrentEXT") == 0) {
+        contextArg = 2;
+        return STATE_CALL_MAKE_CURRENT;
+    }
+
+    if (!startsWith(name, "gl") || startsWith(name, "glX")) {
+        if (strstr(name, "Context") &&
+            (strstr(name, "Create") || strstr(name, "Destroy"))) {
+            return STATE_CALL_CONTEXT_LIFETIME;
+        }
+        return STATE_CALL_OTHER;
+    }
+
+    std::string s = coreName(name);
+
+    if (s == "glActiveTexture")                 return STATE_CALL_ACTIVE_TEXTURE;
+    if (s == "glBindTexture")                   return STATE_CALL_BIND_TEXTURE;
+    if (s == "glBindTextures" ||
+        s == "glBindTextureUnit" ||
+        s == "glBindMultiTexture")              return STATE_CALL_BIND_TEXTURES;
+    if (s == "glDeleteTextures")                return STATE_CALL_DELETE_TEXTURES;
+    if (s == "glBindBuffer")                    return STATE_CALL_BIND_BUFFER;
+    if (s == "glBindBufferBase" ||
+        s == "glBindBufferRange" ||
+        s == "glBindBufferOffset")              return STATE_CALL_BIND_BUFFER_INDEXED;
+    if (s == "glBindBuffersBase" ||
+        s == "glBindBuffersRange")              return STATE_CALL_BIND_BUFFERS;
+    if (s == "glDeleteBuffers")                 return STATE_CALL_DELETE_BUFFERS;
+    if (s == "glBindVertexArray")               return STATE_CALL_BIND_VERTEX_ARRAY;
+    if (s == "glDeleteVertexArrays")            return STATE_CALL_DELETE_VERTEX_ARRAYS;
+    if (s == "glBindTransformFeedback" ||
+        s == "glDeleteTransformFeedbacks")      return STATE_CALL_BIND_TRANSFORM_FEEDBACK;
+    if (s == "glUseProgram" ||
+        s == "glUseProgramObject")              return STATE_CALL_USE_PROGRAM;
+    if (s == "glLinkProgram" ||
+        s == "glProgramBinary")                 return STATE_CALL_LINK_PROGRAM;
+    if (s == "glDeleteProgram" ||
+        s == "glDeleteObject")                  return STATE_CALL_DELETE_PROGRAM;
+    if (s == "glEnable")                        return STATE_CALL_ENABLE;
+    if (s == "glDisable")                       return STATE_CALL_DISABLE;
+    if (s == "glEnablei" || s == "glDisablei" ||
+        s == "glEnableIndexed" ||
+        s == "glDisableIndexed")                return STATE_CALL_ENABLE_INDEXED;
+    if (startsWith(s, "glUniform") &&
+        isUniformSuffix(s, strlen("glUniform")))        return STATE_CALL_UNIFORM;
+    if (startsWith(s, "glProgramUniform") &&
+        isUniformSuffix(s, strlen("glProgramUniform"))) return STATE_CALL_PROGRAM_UNIFORM;
+    if (s == "glNewList")                       return STATE_CALL_NEW_LIST;
+    if (s == "glEndList")                       return STATE_CALL_END_LIST;
+    if (s == "glCallList" ||
+        s == "glCallLists" ||
+        s == "glPopAttrib" ||
+        s == "glPopClientAttrib")               return STATE_CALL_RESTORE_STATE;
+
+    return STATE_CALL_OTHER;
+}
+
+
+/**
+ * Serialize argument values so that they can be compared.
+ */
+class ValueSerializer : public Visitor
+{
+public:
+    std::string bytes;
+
+    template <class T>
+    inline void
+    append(char tag, const T &value) {
+        bytes += tag;
+        bytes.append(reinterpret_cast<const char *>(&value), sizeof value);
+    }
+
+    void visit(Null *) override {
+        bytes += 'n';
+    }
+
+    void visit(Bool *node) override {
+        append('b', node->value);
+    }
+
+    void visit(SInt *node) override {
+        append('i', node->value);
+    }
+
+    void visit(UInt *node) override {
+        append('u', node->value);
+    }
+
+    void visit(Float *node) override {
+        append('f', node->value);
+    }
+
+    void visit(Double *node) override {
+        append('d', node->value);
+    }
+
+    void visit(String *node) override {
+        bytes += 's';
+        bytes.append(node->value, strlen(node->value) + 1);
+    }
+
+    void visit(WString *node) override {
+        bytes += 'w';
+        const wchar_t *value = node->value;
+        bytes.append(reinterpret_cast<const char *>(value), (wcslen(value) + 1) * sizeof *value);
+    }
+
+    void visit(Enum *node) override {
+        append('e', node->value);
+    }
+
+    void visit(Bitmask *node) override {
+        append('m', node->value);
+    }
+
+    void visit(Struct *node) override {
+        append('{', node->members.size());
+        for (auto member : node->members) {
+            _visit(member);
+        }
+    }
+
+    void visit(Array *node) override {
+        append('[', node->values.size());
+        for (auto value : node->values) {
+            _visit(value);
+        }
+    }
+
+    void visit(Blob *node) override {
+        append('B', node->size);
+        bytes.append(node->data(), node->size);
+    }
+
+    void visit(Pointer *node) override {
+        append('p', node->value);
+    }
+
+    void visit(Repr *node) override {
+        _visit(node->machineValue);
+    }
+};
+
+
+void
+StateOptimizer::ContextState::forgetUniforms(unsigned long long prog)
+{
+    auto first = uniforms.lower_bound(std::make_pair(prog, LLONG_MIN));
+    auto last = uniforms.upper_bound(std::make_pair(prog, LLONG_MAX));
+    uniforms.erase(first, last);
+}
+
+
+void
+StateOptimizer::ContextState::forgetUniforms(unsigned long long prog, long long location, unsigned long long count)
+{
+    auto first = uniforms.lower_bound(std::make_pair(prog, LLONG_MIN));
+    auto last = uniforms.lower_bound(std::make_pair(prog, location + (long long)count));
+    while (first != last) {
+        long long start = first->first.second;
+        if (start + (long long)first->second.count > location) {
+            first = uniforms.erase(first);
+        } else {
+            ++first;
+        }
+    }
+}
+
+
+void
+StateOptimizer::ContextState::forgetUniforms(long long location, unsigned long long count)
+{
+    auto it = uniforms.begin();
+    while (it != uniforms.end()) {
+        long long start = it->first.second;
+        if (start < location + (long long)count &&
+            start + (long long)it->second.count > location) {
+            it = uniforms.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+void
+StateOptimizer::ContextState::forgetUnitCaps(unsigned long long cap)
+{
+    auto it = unitCaps.begin();
+    while (it != unitCaps.end()) {
+        if (it->first.second == cap) {
+            it = unitCaps.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+void
+StateOptimizer::ContextState::forgetAll(void)
+{
+    bool list = insideList;
+    *this = ContextState();
+    insideList = list;
+}
+
+
+StateOptimizer::ContextState &
+StateOptimizer::getContextState(unsigned thread_id)
+{
+    auto it = currentContexts.find(thread_id);
+    ContextId context;
+    if (it != currentContexts.end()) {
+        context = it->second;
+    } else {
+        // Context made current before tracing started; use a per-thread
+        // placeholder that doesn't clash with real context handles
+        context = ~ContextId(thread_id);
+        currentContexts[thread_id] = context;
+    }
+    return contexts[context];
+}
+
+
+void
+StateOptimizer::forgetTextures(void)
+{
+    for (auto & it : contexts) {
+        it.second.textures.clear();
+    }
+}
+
+
+void
+StateOptimizer::forgetBuffers(void)
+{
+    for (auto & it : contexts) {
+        it.second.buffers.clear();
+    }
+}
+
+
+// Programs might be shared with other contexts, so uniforms are forgotten
+// everywhere
+void
+StateOptimizer::forgetUniforms(void)
+{
+    for (auto & it : contexts) {
+        it.second.uniforms.clear();
+    }
+}
+
+
+bool
+StateOptimizer::isRedundant(Call *call)
+{
+    if (call->flags & CALL_FLAG_INCOMPLETE) {
+        return false;
+    }
+
+    unsigned contextArg;
+    StateCallKind kind = getKind(call, contextArg);
+    if (kind == STATE_CALL_OTHER) {
+        return false;
+    }
+
+    if (kind == STATE_CALL_MAKE_CURRENT) {
+        currentContexts[call->thread_id] = call->arg(contextArg).toUIntPtr();
+        return false;
+    }
+
+    if (kind == STATE_CALL_CONTEXT_LIFETIME) {
+        // Context handles might be reused
+        for (auto & it : contexts) {
+            it.second.forgetAll();
+        }
+        return false;
+    }
+
+    ContextState &state = getContextState(call->thread_id);
+
+    if (kind == STATE_CALL_NEW_LIST) {
+        state.insideList = true;
+        return false;
+    }
+
+    if (kind == STATE_CALL_END_LIST) {
+        // The list might have been executed while compiled
+        state.insideList = false;
+        state.forgetAll();
+        forgetUniforms();
+        return false;
+    }
+
+    // Calls inside display lists are recorded, not executed
+    if (state.insideList) {
+        return false;
+    }
+
+    switch (kind) {
+    case STATE_CALL_RESTORE_STATE:
+        state.forgetAll();
+        forgetUniforms();
+        return false;
+
+    case STATE_CALL_ACTIVE_TEXTURE:
+        {
+            unsigned long long unit = call->arg(0).toUInt();
+            if (state.activeTextureKnown && state.activeTexture == unit) {
+                return true;
+            }
+            state.activeTextureKnown = true;
+            state.activeTexture = unit;
+        }
+        return false;
+
+    case STATE_CALL_BIND_TEXTURE:
+        if (state.activeTextureKnown) {
+            auto key = std::make_pair(state.activeTexture, call->arg(0).toUInt());
+            unsigned long long texture = call->arg(1).toUInt();
+            auto it = state.textures.find(key);
+            if (it != state.textures.end() && it->second == texture) {
+                return true;
+            }
+            state.textures[key] = texture;
+        }
+        return false;
+
+    case STATE_CALL_BIND_TEXTURES:
+        state.textures.clear();
+        return false;
+
+    case STATE_CALL_DELETE_TEXTURES:
+        // Names might be reused, even by other contexts in the share group
+        forgetTextures();
+        return false;
+
+    case STATE_CALL_BIND_BUFFER:
+        {
+            unsigned long long target = call->arg(0).toUInt();
+            unsigned long long buffer = call->arg(1).toUInt();
+            auto it = state.buffers.find(target);
+            if (it != state.buffers.end() && it->second == buffer) {
+                return true;
+            }
+            state.buffers[target] = buffer;
+        }
+        return false;
+
+    case STATE_CALL_BIND_BUFFER_INDEXED:
+        state.buffers.erase(call->arg(0).toUInt());
+        return false;
+
+    case STATE_CALL_BIND_BUFFERS:
+        state.buffers.clear();
+        return false;
+
+    case STATE_CALL_DELETE_BUFFERS:
+        forgetBuffers();
+        return false;
+
+    case STATE_CALL_BIND_VERTEX_ARRAY:
+        {
+            unsigned long long vertexArray = call->arg(0).toUInt();
+            if (state.vertexArrayKnown && state.vertexArray == vertexArray) {
+                return true;
+            }
+            state.vertexArrayKnown = true;
+            state.vertexArray = vertexArray;
+            // The element array buffer binding is vertex array state
+            state.buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+        }
+        return false;
+
+    case STATE_CALL_DELETE_VERTEX_ARRAYS:
+        for (auto & it : contexts) {
+            it.second.vertexArrayKnown = false;
+            it.second.buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+        }
+        return false;
+
+    case STATE_CALL_BIND_TRANSFORM_FEEDBACK:
+        // The transform feedback buffer bindings are transform feedback
+        // object state
+        state.buffers.erase(GL_TRANSFORM_FEEDBACK_BUFFER);
+        return false;
+
+    case STATE_CALL_USE_PROGRAM:
+        {
+            unsigned long long program = call->arg(0).toUInt();
+            if (state.programKnown && state.program == program) {
+                return true;
+            }
+            state.programKnown = true;
+            state.program = program;
+        }
+        return false;
+
+    case STATE_CALL_LINK_PROGRAM:
+        {
+            unsigned long long program = call->arg(0).toUInt();
+            for (auto & it : contexts) {
+                it.second.forgetUniforms(program);
+            }
+        }
+        return false;
+
+    case STATE_CALL_DELETE_PROGRAM:
+        for (auto & it : contexts) {
+            it.second.programKnown = false;
+        }
+        forgetUniforms();
+        return false;
+
+    case STATE_CALL_ENABLE:
+        return enable(state, call, true);
+
+    case STATE_CALL_DISABLE:
+        return enable(state, call, false);
+
+    case STATE_CALL_ENABLE_INDEXED:
+        {
+            unsigned long long cap = call->arg(0).toUInt();
+            state.caps.erase(cap);
+            // glEnableIndexedEXT also enables texture unit capabilities
+            state.forgetUnitCaps(cap);
+        }
+        return false;
+
+    case STATE_CALL_UNIFORM:
+        return uniform(state, call, state.programKnown ? state.program : 0, 0);
+
+    case STATE_CALL_PROGRAM_UNIFORM:
+        return uniform(state, call, call->arg(0).toUInt(), 1);
+
+    default:
+        return false;
+    }
+}
+
+
+bool
+StateOptimizer::enable(ContextState &state, Call *call, bool enabled)
+{
+    unsigned long long cap = call->arg(0).toUInt();
+
+    if (isTextureUnitCap(cap)) {
+        if (!state.activeTextureKnown) {
+            // Might be any unit's
+            state.forgetUnitCaps(cap);
+            return false;
+        }
+        auto key = std::make_pair(state.activeTexture, cap);
+        auto it = state.unitCaps.find(key);
+        if (it != state.unitCaps.end() && it->second == enabled) {
+            return true;
+        }
+        state.unitCaps[key] = enabled;
+        return false;
+    }
+
+    auto it = state.caps.find(cap);
+    if (it != state.caps.end() && it->second == enabled) {
+        return true;
+    }
+    state.caps[cap] = enabled;
+    return false;
+}
+
+
+/*
+ * Uniform updates.  A zero program means that the program is unknown, or
+ * that the active program of the bound pipeline is used.
+ */
+bool
+StateOptimizer::uniform(ContextState &state, Call *call, unsigned long long prog, unsigned locationArg)
+{
+    long long location = call->arg(locationArg).toSInt();
+    if (location < 0) {
+        return false;
+    }
+
+    // Vector variants set `count` consecutive locations
+    unsigned long long count = 1;
+    std::string name = coreName(call->sig->name);
+    if (name[name.length() - 1] == 'v') {
+        count = call->arg(locationArg + 1).toUInt();
+    }
+
+    if (prog == 0) {
+        // Could be any program's, so forget these locations in all of them
+        for (auto & it : contexts) {
+            it.second.forgetUniforms(location, count);
+        }
+        return false;
+    }
+
+    ValueSerializer serializer;
+    for (unsigned i = locationArg + 1; i < call->args.size(); ++i) {
+        if (call->args[i].value) {
+            call->args[i].value->visit(serializer);
+        } else {
+            serializer.bytes += 'n';
+        }
+    }
+
+    auto key = std::make_pair(prog, location);
+    auto it = state.uniforms.find(key);
+    if (it != state.uniforms.end() &&
+        it->second.count == count &&
+        it->second.bytes == serializer.bytes) {
+        return true;
+    }
+
+    // Uniforms are program state, and programs might be shared with other
+    // contexts, so forget any values overlapping the updated locations
+    // everywhere
+    for (auto & it : contexts) {
+        it.second.forgetUniforms(prog, location, count);
+    }
+
+    UniformValue &value = state.uniforms[key];
+    value.count = count;
+    value.bytes.swap(serializer.bytes);
+
+    return false;
+}
+
+
+} /* namespace trace */
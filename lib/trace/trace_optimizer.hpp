@@ -0,0 +1,198 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Removal of redundant OpenGL state calls.
+ *
+ * The binding, enable and uniform state of every context is simulated over
+ * the call stream, and calls which would set a state to the value it already
+ * has are reported as redundant.  Whenever the state can't be known for sure
+ * (display lists, attribute stacks, object deletion, etc.) it is forgotten,
+ * so that only provably redundant calls are removed.
+ */
+
+#pragma once
+
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "trace_model.hpp"
+
+
+namespace trace {
+
+
+enum StateCallKind {
+    STATE_CALL_UNKNOWN = 0,
+    STATE_CALL_OTHER,
+    STATE_CALL_ACTIVE_TEXTURE,
+    STATE_CALL_BIND_TEXTURE,
+    STATE_CALL_BIND_TEXTURES,           // multi-bind and DSA, forget texture bindings
+    STATE_CALL_DELETE_TEXTURES,
+    STATE_CALL_BIND_BUFFER,
+    STATE_CALL_BIND_BUFFER_INDEXED,     // also changes the generic binding
+    STATE_CALL_BIND_BUFFERS,
+    STATE_CALL_DELETE_BUFFERS,
+    STATE_CALL_BIND_VERTEX_ARRAY,
+    STATE_CALL_DELETE_VERTEX_ARRAYS,
+    STATE_CALL_BIND_TRANSFORM_FEEDBACK, // also changes the generic binding
+    STATE_CALL_USE_PROGRAM,
+    STATE_CALL_LINK_PROGRAM,            // resets the uniforms
+    STATE_CALL_DELETE_PROGRAM,
+    STATE_CALL_ENABLE,
+    STATE_CALL_DISABLE,
+    STATE_CALL_ENABLE_INDEXED,
+    STATE_CALL_UNIFORM,
+    STATE_CALL_PROGRAM_UNIFORM,
+    STATE_CALL_NEW_LIST,
+    STATE_CALL_END_LIST,
+    STATE_CALL_RESTORE_STATE,           // glCallList, glPopAttrib, etc.
+    STATE_CALL_MAKE_CURRENT,
+    STATE_CALL_CONTEXT_LIFETIME,
+};
+
+
+/**
+ * Classify a function by its effect on the tracked state.  For make-current
+ * calls, contextArg is set to the index of the context argument.
+ */
+StateCallKind
+classifyStateCall(const char *name, unsigned &contextArg);
+
+
+class StateOptimizer
+{
+    struct UniformValue
+    {
+        unsigned long long count;
+        std::string bytes;
+    };
+
+    /**
+     * State of a single context.  Missing entries mean unknown state.
+     */
+    struct ContextState
+    {
+        bool activeTextureKnown = false;
+        unsigned long long activeTexture = 0;
+
+        // (unit, target) -> texture
+        std::map<std::pair<unsigned long long, unsigned long long>, unsigned long long> textures;
+
+        // target -> buffer
+        std::map<unsigned long long, unsigned long long> buffers;
+
+        bool vertexArrayKnown = false;
+        unsigned long long vertexArray = 0;
+
+        bool programKnown = false;
+        unsigned long long program = 0;
+
+        // capability -> enabled
+        std::map<unsigned long long, bool> caps;
+
+        // (unit, capability) -> enabled, for texture unit capabilities
+        std::map<std::pair<unsigned long long, unsigned long long>, bool> unitCaps;
+
+        // (program, location) -> value
+        std::map<std::pair<unsigned long long, long long>, UniformValue> uniforms;
+
+        bool insideList = false;
+
+        void
+        forgetUniforms(unsigned long long prog);
+
+        // Forget values overlapping locations [location, location + count)
+        void
+        forgetUniforms(unsigned long long prog, long long location, unsigned long long count);
+
+        // Same as above, for every program
+        void
+        forgetUniforms(long long location, unsigned long long count);
+
+        // Forget a texture unit capability in every unit
+        void
+        forgetUnitCaps(unsigned long long cap);
+
+        void
+        forgetAll(void);
+    };
+
+    typedef unsigned long long ContextId;
+
+    std::map<ContextId, ContextState> contexts;
+
+    // thread -> current context
+    std::map<unsigned, ContextId> currentContexts;
+
+    std::vector<StateCallKind> kinds;
+    std::vector<unsigned> contextArgs;
+
+    inline StateCallKind
+    getKind(const Call *call, unsigned &contextArg) {
+        unsigned id = call->sig->id;
+        if (id >= kinds.size()) {
+            kinds.resize(id + 1, STATE_CALL_UNKNOWN);
+            contextArgs.resize(id + 1, 0);
+        }
+        if (kinds[id] == STATE_CALL_UNKNOWN) {
+            kinds[id] = classifyStateCall(call->sig->name, contextArgs[id]);
+        }
+        contextArg = contextArgs[id];
+        return kinds[id];
+    }
+
+    ContextState &
+    getContextState(unsigned thread_id);
+
+    void
+    forgetTextures(void);
+
+    void
+    forgetBuffers(void);
+
+    void
+    forgetUniforms(void);
+
+    bool
+    enable(ContextState &state, Call *call, bool enabled);
+
+    bool
+    uniform(ContextState &state, Call *call, unsigned long long prog, unsigned locationArg);
+
+public:
+    /**
+     * Simulate the effect of the call on the state, and return whether it
+     * is redundant.  Calls must be given in trace order.
+     */
+    bool
+    isRedundant(Call *call);
+};
+
+
+} /* namespace trace */
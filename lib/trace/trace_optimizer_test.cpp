@@ -0,0 +1,273 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "trace_optimizer.hpp"
+
+#include "gtest/gtest.h"
+
+
+using namespace trace;
+
+
+#define GL_TEXTURE_2D 0x0DE1
+#define GL_TEXTURE_GEN_S 0x0C60
+#define GL_DEPTH_TEST 0x0B71
+#define GL_TEXTURE0 0x84C0
+#define GL_TEXTURE1 0x84C1
+#define GL_TRANSFORM_FEEDBACK 0x8E22
+#define GL_TRANSFORM_FEEDBACK_BUFFER 0x8C8E
+
+
+static const char *args1[] = {"a"};
+static const char *args2[] = {"a", "b"};
+static const char *args3[] = {"a", "b", "c"};
+
+static const FunctionSig glXMakeCurrent_sig = {0, "glXMakeCurrent", 3, args3};
+static const FunctionSig glActiveTexture_sig = {1, "glActiveTexture", 1, args1};
+static const FunctionSig glEnable_sig = {2, "glEnable", 1, args1};
+static const FunctionSig glBindBuffer_sig = {3, "glBindBuffer", 2, args2};
+static const FunctionSig glBindTransformFeedback_sig = {4, "glBindTransformFeedback", 2, args2};
+static const FunctionSig glUseProgram_sig = {5, "glUseProgram", 1, args1};
+static const FunctionSig glUniform1f_sig = {6, "glUniform1f", 2, args2};
+static const FunctionSig glUniform1i64vNV_sig = {7, "glUniform1i64vNV", 3, args3};
+static const FunctionSig glCallList_sig = {8, "glCallList", 1, args1};
+static const FunctionSig glProgramUniform1f_sig = {9, "glProgramUniform1f", 3, args3};
+static const FunctionSig glDisable_sig = {10, "glDisable", 1, args1};
+
+
+class CallBuilder
+{
+    Call *call;
+    unsigned index = 0;
+
+public:
+    CallBuilder(const FunctionSig &sig) :
+        call(new Call(&sig, 0, 0))
+    {
+        for (auto &arg : call->args) {
+            arg.value = new Null;
+        }
+    }
+
+    ~CallBuilder() {
+        delete call;
+    }
+
+    CallBuilder &
+    arg(Value *value) {
+        delete call->args[index].value;
+        call->args[index++].value = value;
+        return *this;
+    }
+
+    CallBuilder &
+    arg(unsigned long long value) {
+        return arg(new UInt(value));
+    }
+
+    CallBuilder &
+    array(std::initializer_list<signed long long> values) {
+        Array *array = new Array(values.size());
+        size_t i = 0;
+        for (auto value : values) {
+            array->values[i++] = new SInt(value);
+        }
+        return arg(array);
+    }
+
+    bool
+    isRedundant(StateOptimizer &optimizer) {
+        return optimizer.isRedundant(call);
+    }
+};
+
+
+static bool
+makeCurrent(StateOptimizer &optimizer, unsigned long long context)
+{
+    return CallBuilder(glXMakeCurrent_sig).arg(new Pointer(1)).arg(2).arg(new Pointer(context)).isRedundant(optimizer);
+}
+
+static bool
+activeTexture(StateOptimizer &optimizer, unsigned long long unit)
+{
+    return CallBuilder(glActiveTexture_sig).arg(unit).isRedundant(optimizer);
+}
+
+static bool
+enable(StateOptimizer &optimizer, unsigned long long cap)
+{
+    return CallBuilder(glEnable_sig).arg(cap).isRedundant(optimizer);
+}
+
+static bool
+disable(StateOptimizer &optimizer, unsigned long long cap)
+{
+    return CallBuilder(glDisable_sig).arg(cap).isRedundant(optimizer);
+}
+
+static bool
+bindBuffer(StateOptimizer &optimizer, unsigned long long target, unsigned long long buffer)
+{
+    return CallBuilder(glBindBuffer_sig).arg(target).arg(buffer).isRedundant(optimizer);
+}
+
+static bool
+useProgram(StateOptimizer &optimizer, unsigned long long program)
+{
+    return CallBuilder(glUseProgram_sig).arg(program).isRedundant(optimizer);
+}
+
+static bool
+uniform1f(StateOptimizer &optimizer, long long location, float value)
+{
+    return CallBuilder(glUniform1f_sig).arg(new SInt(location)).arg(new Float(value)).isRedundant(optimizer);
+}
+
+
+TEST(StateOptimizer, Basic)
+{
+    StateOptimizer optimizer;
+
+    EXPECT_FALSE(enable(optimizer, GL_DEPTH_TEST));
+    EXPECT_TRUE(enable(optimizer, GL_DEPTH_TEST));
+    EXPECT_FALSE(disable(optimizer, GL_DEPTH_TEST));
+
+    EXPECT_FALSE(useProgram(optimizer, 1));
+    EXPECT_TRUE(useProgram(optimizer, 1));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 1.0f));
+    EXPECT_TRUE(uniform1f(optimizer, 0, 1.0f));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 2.0f));
+}
+
+
+// Texture enables and texture coordinate generation are per texture unit
+TEST(StateOptimizer, TextureUnitCaps)
+{
+    StateOptimizer optimizer;
+
+    // Unknown unit
+    EXPECT_FALSE(enable(optimizer, GL_TEXTURE_2D));
+    EXPECT_FALSE(enable(optimizer, GL_TEXTURE_2D));
+
+    EXPECT_FALSE(activeTexture(optimizer, GL_TEXTURE0));
+    EXPECT_FALSE(enable(optimizer, GL_TEXTURE_2D));
+    EXPECT_FALSE(enable(optimizer, GL_TEXTURE_GEN_S));
+    EXPECT_TRUE(enable(optimizer, GL_TEXTURE_2D));
+
+    EXPECT_FALSE(activeTexture(optimizer, GL_TEXTURE1));
+    EXPECT_FALSE(enable(optimizer, GL_TEXTURE_2D));
+    EXPECT_FALSE(enable(optimizer, GL_TEXTURE_GEN_S));
+    EXPECT_TRUE(enable(optimizer, GL_TEXTURE_2D));
+    EXPECT_FALSE(disable(optimizer, GL_TEXTURE_2D));
+
+    EXPECT_FALSE(activeTexture(optimizer, GL_TEXTURE0));
+    EXPECT_TRUE(enable(optimizer, GL_TEXTURE_2D));
+    EXPECT_TRUE(enable(optimizer, GL_TEXTURE_GEN_S));
+}
+
+
+// Uniforms set while no program is known (or through a pipeline) might
+// belong to any program
+TEST(StateOptimizer, UniformUnknownProgram)
+{
+    StateOptimizer optimizer;
+
+    EXPECT_FALSE(makeCurrent(optimizer, 0x100));
+    EXPECT_FALSE(useProgram(optimizer, 1));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 1.0f));
+    EXPECT_FALSE(CallBuilder(glProgramUniform1f_sig).arg(2).arg(new SInt(0)).arg(new Float(1.0f)).isRedundant(optimizer));
+
+    // Another context, which made its program current before the trace
+    // started
+    EXPECT_FALSE(makeCurrent(optimizer, 0x200));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 2.0f));
+
+    EXPECT_FALSE(makeCurrent(optimizer, 0x100));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 1.0f));
+    EXPECT_FALSE(CallBuilder(glProgramUniform1f_sig).arg(2).arg(new SInt(0)).arg(new Float(1.0f)).isRedundant(optimizer));
+
+    // Program 0, i.e., the active program of the bound pipeline
+    EXPECT_TRUE(uniform1f(optimizer, 0, 1.0f));
+    EXPECT_FALSE(useProgram(optimizer, 0));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 3.0f));
+    EXPECT_FALSE(useProgram(optimizer, 1));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 1.0f));
+}
+
+
+TEST(StateOptimizer, BindTransformFeedback)
+{
+    StateOptimizer optimizer;
+
+    EXPECT_FALSE(bindBuffer(optimizer, GL_TRANSFORM_FEEDBACK_BUFFER, 5));
+    EXPECT_TRUE(bindBuffer(optimizer, GL_TRANSFORM_FEEDBACK_BUFFER, 5));
+    EXPECT_FALSE(CallBuilder(glBindTransformFeedback_sig).arg(GL_TRANSFORM_FEEDBACK).arg(2).isRedundant(optimizer));
+    EXPECT_FALSE(bindBuffer(optimizer, GL_TRANSFORM_FEEDBACK_BUFFER, 5));
+}
+
+
+// NV vector variants set `count` locations, like the others
+TEST(StateOptimizer, UniformNV)
+{
+    StateOptimizer optimizer;
+
+    EXPECT_FALSE(useProgram(optimizer, 1));
+    EXPECT_FALSE(CallBuilder(glUniform1i64vNV_sig).arg(new SInt(0)).arg(2).array({1, 2}).isRedundant(optimizer));
+    EXPECT_TRUE(CallBuilder(glUniform1i64vNV_sig).arg(new SInt(0)).arg(2).array({1, 2}).isRedundant(optimizer));
+
+    // Overwrites the second element
+    EXPECT_FALSE(uniform1f(optimizer, 1, 3.0f));
+    EXPECT_FALSE(CallBuilder(glUniform1i64vNV_sig).arg(new SInt(0)).arg(2).array({1, 2}).isRedundant(optimizer));
+}
+
+
+// Display lists might set the uniforms of any program, shared with any context
+TEST(StateOptimizer, CallListUniforms)
+{
+    StateOptimizer optimizer;
+
+    EXPECT_FALSE(makeCurrent(optimizer, 0x100));
+    EXPECT_FALSE(useProgram(optimizer, 1));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 1.0f));
+
+    EXPECT_FALSE(makeCurrent(optimizer, 0x200));
+    EXPECT_FALSE(useProgram(optimizer, 1));
+    EXPECT_FALSE(CallBuilder(glCallList_sig).arg(1).isRedundant(optimizer));
+
+    EXPECT_FALSE(makeCurrent(optimizer, 0x100));
+    EXPECT_TRUE(useProgram(optimizer, 1));
+    EXPECT_FALSE(uniform1f(optimizer, 0, 1.0f));
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -33,17 +33,43 @@
 namespace trace {
 
 
+struct Telemetry;
+
+
 class OutStream {
 public:
     virtual ~OutStream() {}
 
     virtual bool write(const void *buffer, size_t length) = 0;
     virtual void flush(void) = 0;
+
+    /**
+     * Account written, compressed, and pending bytes in the given counters.
+     */
+    void setTelemetry(Telemetry *telemetry) {
+        m_telemetry = telemetry;
+    }
+
+protected:
+    Telemetry *m_telemetry = nullptr;
 };
 
 
+/**
+ * With checksums, every chunk carries a CRC-32C of its compressed data, so
+ * that corruption can be detected by `apitrace check` and readers.  Such
+ * traces can't be read by versions of apitrace that predate them.
+ */
+OutStream *
+createSnappyStream(const char *filename, bool checksums = false);
+
+/**
+ * Same format as createSnappyStream, but chunks are written into a
+ * memory-mapped file so they survive crashes.  Returns nullptr when not
+ * supported, so callers should fall back to createSnappyStream.
+ */
 OutStream *
-createSnappyStream(const char *filename);
+createMappedSnappyStream(const char *filename, bool checksums = false);
 
 OutStream *
 createZLibStream(const char *filename);
@@ -27,39 +27,85 @@
 
 #include "trace_ostream.hpp"
 
+#include <atomic>
 #include <fstream>
 
 #include <assert.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 #include <snappy.h>
 
 #include "os.hpp"
+#include "os_time.hpp"
+#include "crc32c.hpp"
 #include "trace_snappy.hpp"
+#include "trace_telemetry.hpp"
 
 
 #define SNAPPY_CHUNK_SIZE (1 * 1024 * 1024)
 
+/*
+ * Granularity in which mapped files are extended and mapped.  Must be
+ * comfortably larger than the largest compressed chunk.
+ */
+#define MAPPED_WINDOW_SIZE (32 * 1024 * 1024)
+
 
 using namespace trace;
 
 
+/**
+ * Buffers and compresses the data in snappy chunks, leaving to derived
+ * classes how the compressed chunks reach the disk.
+ */
 class SnappyOutStream : public OutStream {
 public:
-    SnappyOutStream(const char *filename);
+    SnappyOutStream(bool checksums);
     ~SnappyOutStream();
 
-    SnappyOutStream(void);
     bool write(const void *buffer, size_t length) override;
     void flush(void) override;
-    bool isOpen(void) {
-        return m_stream.is_open();
+
+protected:
+    /**
+     * Write a compressed chunk, prefixed by the header from
+     * encodeChunkHeader.
+     */
+    virtual void writeChunk(const char *data, size_t length) = 0;
+
+    /**
+     * Ensure previously written chunks reach the OS.
+     */
+    virtual void flushChunks(void) {}
+
+    void flushWriteCache(void);
+
+    static const size_t MAX_CHUNK_HEADER_SIZE = 8;
+
+    /**
+     * Encode the chunk length, followed by the checksum of the data if
+     * enabled, returning the header size.
+     */
+    size_t
+    encodeChunkHeader(unsigned char buf[MAX_CHUNK_HEADER_SIZE],
+                      const char *data, size_t length) const;
+
+    inline char
+    identifierByte2(void) const {
+        return m_checksums ? SNAPPY_BYTE2_CHECKSUM : SNAPPY_BYTE2;
     }
 
+    static void
+    encodeUInt32(unsigned char buf[4], size_t value);
 
 private:
-    void close(void);
-
     inline size_t usedCacheSize(void) const
     {
         assert(m_cachePtr >= m_cache);
@@ -74,53 +120,41 @@ private:
             return 0;
         }
     }
-    inline bool endOfData(void) const
-    {
-        return m_stream.eof() && freeCacheSize() == 0;
-    }
-    void flushWriteCache(void);
-    void createCache(size_t size);
-    void writeCompressedLength(size_t length);
 private:
-    std::ofstream m_stream;
     size_t m_cacheMaxSize;
     size_t m_cacheSize;
     char *m_cache;
     char *m_cachePtr;
 
     char *m_compressedCache;
+
+    bool m_checksums;
 };
 
-SnappyOutStream::SnappyOutStream(const char *filename)
+SnappyOutStream::SnappyOutStream(bool checksums)
     : m_cacheMaxSize(SNAPPY_CHUNK_SIZE),
       m_cacheSize(m_cacheMaxSize),
       m_cache(new char [m_cacheMaxSize]),
-      m_cachePtr(m_cache)
+      m_cachePtr(m_cache),
+      m_checksums(checksums)
 {
     size_t maxCompressedLength =
         snappy::MaxCompressedLength(SNAPPY_CHUNK_SIZE);
     m_compressedCache = new char[maxCompressedLength];
-    
-    std::ios_base::openmode fmode = std::fstream::binary
-                                  | std::fstream::out
-                                  | std::fstream::trunc;
-    m_stream.open(filename, fmode);
-    if (m_stream.is_open()) {
-        m_stream << SNAPPY_BYTE1;
-        m_stream << SNAPPY_BYTE2;
-        m_stream.flush();
-    }
 }
 
 SnappyOutStream::~SnappyOutStream()
 {
-    close();
     delete [] m_compressedCache;
     delete [] m_cache;
 }
 
 bool SnappyOutStream::write(const void *buffer, size_t length)
 {
+    if (m_telemetry) {
+        Telemetry::add(m_telemetry->bytesWritten, length);
+    }
+
     if (freeCacheSize() > length) {
         memcpy(m_cachePtr, buffer, length);
         m_cachePtr += length;
@@ -146,22 +180,17 @@ bool SnappyOutStream::write(const void *buffer, size_t length)
         }
     }
 
-    return true;
-}
+    if (m_telemetry) {
+        Telemetry::set(m_telemetry->bytesPending, usedCacheSize());
+    }
 
-void SnappyOutStream::close(void)
-{
-    flushWriteCache();
-    m_stream.close();
-    delete [] m_cache;
-    m_cache = NULL;
-    m_cachePtr = NULL;
+    return true;
 }
 
 void SnappyOutStream::flush(void)
 {
     flushWriteCache();
-    m_stream.flush();
+    flushChunks();
 }
 
 void SnappyOutStream::flushWriteCache(void)
@@ -171,32 +200,105 @@ void SnappyOutStream::flushWriteCache(void)
     if (inputLength) {
         size_t compressedLength;
 
+        long long startTime = m_telemetry ? os::getTime() : 0;
+
         ::snappy::RawCompress(m_cache, inputLength,
                               m_compressedCache, &compressedLength);
 
-        writeCompressedLength(compressedLength);
-        m_stream.write(m_compressedCache, compressedLength);
+        writeChunk(m_compressedCache, compressedLength);
         m_cachePtr = m_cache;
+
+        if (m_telemetry) {
+            Telemetry::add(m_telemetry->compressTime, os::getTime() - startTime);
+            Telemetry::add(m_telemetry->bytesCompressed,
+                           compressedLength + (m_checksums ? 8 : 4));
+            Telemetry::set(m_telemetry->bytesPending, 0);
+        }
     }
     assert(m_cachePtr == m_cache);
 }
 
-void SnappyOutStream::writeCompressedLength(size_t length)
+size_t SnappyOutStream::encodeChunkHeader(unsigned char buf[MAX_CHUNK_HEADER_SIZE],
+                                          const char *data, size_t length) const
 {
-    unsigned char buf[4];
-    buf[0] = length & 0xff; length >>= 8;
-    buf[1] = length & 0xff; length >>= 8;
-    buf[2] = length & 0xff; length >>= 8;
-    buf[3] = length & 0xff; length >>= 8;
-    assert(length == 0);
-    m_stream.write((const char *)buf, sizeof buf);
+    encodeUInt32(buf, length);
+    if (!m_checksums) {
+        return 4;
+    }
+    encodeUInt32(buf + 4, crc32c_8bytes(data, length));
+    return 8;
+}
+
+void SnappyOutStream::encodeUInt32(unsigned char buf[4], size_t value)
+{
+    buf[0] = value & 0xff; value >>= 8;
+    buf[1] = value & 0xff; value >>= 8;
+    buf[2] = value & 0xff; value >>= 8;
+    buf[3] = value & 0xff; value >>= 8;
+    assert(value == 0);
+}
+
+
+/**
+ * Writes the compressed chunks through a std::ofstream.
+ */
+class FileSnappyOutStream : public SnappyOutStream {
+public:
+    FileSnappyOutStream(const char *filename, bool checksums);
+    ~FileSnappyOutStream();
+
+    bool isOpen(void) {
+        return m_stream.is_open();
+    }
+
+protected:
+    void writeChunk(const char *data, size_t length) override;
+    void flushChunks(void) override;
+
+private:
+    std::ofstream m_stream;
+};
+
+FileSnappyOutStream::FileSnappyOutStream(const char *filename, bool checksums)
+    : SnappyOutStream(checksums)
+{
+    std::ios_base::openmode fmode = std::fstream::binary
+                                  | std::fstream::out
+                                  | std::fstream::trunc;
+    m_stream.open(filename, fmode);
+    if (m_stream.is_open()) {
+        m_stream << SNAPPY_BYTE1;
+        m_stream << identifierByte2();
+        m_stream.flush();
+    }
+}
+
+FileSnappyOutStream::~FileSnappyOutStream()
+{
+    if (m_stream.is_open()) {
+        flushWriteCache();
+        m_stream.close();
+    }
+}
+
+void FileSnappyOutStream::writeChunk(const char *data, size_t length)
+{
+    unsigned char buf[MAX_CHUNK_HEADER_SIZE];
+    size_t headerSize = encodeChunkHeader(buf, data, length);
+    m_stream.write((const char *)buf, headerSize);
+    m_stream.write(data, length);
+}
+
+void FileSnappyOutStream::flushChunks(void)
+{
+    m_stream.flush();
 }
 
 
 OutStream *
-trace::createSnappyStream(const char *filename)
+trace::createSnappyStream(const char *filename, bool checksums)
 {
-    SnappyOutStream *outStream = new SnappyOutStream(filename);
+    FileSnappyOutStream *outStream = new FileSnappyOutStream(filename, checksums);
     if (!outStream->isOpen()) {
         os::log("error: could not open %s for writing\n", filename);
         delete outStream;
@@ -205,3 +307,220 @@ trace::createSnappyStream(const char *filename)
 
     return outStream;
 }
+
+
+#ifndef _WIN32
+
+/**
+ * Writes the compressed chunks into a shared memory mapping of the file.
+ *
+ * The file is extended ahead of time in MAPPED_WINDOW_SIZE steps, so every
+ * completed chunk lands in the page cache as soon as it is compressed, and
+ * survives the process crashing without any further system call.  Only the
+ * chunk being buffered at the time of a crash can be lost.
+ *
+ * The unwritten tail of the file is zero-filled, which readers interpret as
+ * the end of the trace.  On a clean close the file is truncated to the
+ * actual size.
+ */
+class MappedSnappyOutStream : public SnappyOutStream {
+public:
+    MappedSnappyOutStream(bool checksums);
+    ~MappedSnappyOutStream();
+
+    bool open(const char *filename);
+
+protected:
+    void writeChunk(const char *data, size_t length) override;
+
+private:
+    bool mapWindow(size_t length);
+    void unmapWindow(void);
+    bool writeAt(const void *buffer, size_t length, uint64_t offset);
+
+    int m_fd = -1;
+    pid_t m_pid = 0;
+    size_t m_pageSize = 0;
+
+    // End of the written data
+    uint64_t m_offset = 0;
+
+    // Allocated file size
+    uint64_t m_fileSize = 0;
+
+    char *m_map = nullptr;
+    uint64_t m_mapOffset = 0;
+    size_t m_mapSize = 0;
+
+    // Whether mapping failed and we resorted to plain writes
+    bool m_unmapped = false;
+};
+
+MappedSnappyOutStream::MappedSnappyOutStream(bool checksums)
+    : SnappyOutStream(checksums)
+{
+    m_pageSize = sysconf(_SC_PAGESIZE);
+}
+
+MappedSnappyOutStream::~MappedSnappyOutStream()
+{
+    if (m_fd < 0) {
+        return;
+    }
+
+    if (getpid() == m_pid) {
+        flushWriteCache();
+        unmapWindow();
+        if (ftruncate(m_fd, m_offset) != 0) {
+            os::log("apitrace: warning: failed to truncate trace (%s)\n", strerror(errno));
+        }
+    } else {
+        // We are a forked child process sharing the parent's mapping, so
+        // anything we write would corrupt the parent's trace.
+        unmapWindow();
+    }
+
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+bool MappedSnappyOutStream::open(const char *filename)
+{
+    m_fd = ::open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    m_pid = getpid();
+
+    const char header[2] = {SNAPPY_BYTE1, identifierByte2()};
+    if (!writeAt(header, sizeof header, 0)) {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_offset = sizeof header;
+    m_fileSize = m_offset;
+
+    return mapWindow(0);
+}
+
+bool MappedSnappyOutStream::mapWindow(size_t length)
+{
+    if (m_map &&
+        m_offset + length <= m_mapOffset + m_mapSize) {
+        return true;
+    }
+
+    unmapWindow();
+
+    uint64_t mapOffset = m_offset & ~uint64_t(m_pageSize - 1);
+    size_t mapSize = MAPPED_WINDOW_SIZE;
+    assert(m_offset + length <= mapOffset + mapSize);
+
+    uint64_t mapEnd = mapOffset + mapSize;
+    if (mapEnd > m_fileSize) {
+        // Allocate the blocks upfront, as running out of disk space while
+        // writing into a sparse mapping would raise SIGBUS.
+#ifdef __APPLE__
+        int err = ftruncate(m_fd, mapEnd) == 0 ? 0 : errno;
+#else
+        int err = posix_fallocate(m_fd, m_fileSize, mapEnd - m_fileSize);
+#endif
+        if (err) {
+            os::log("apitrace: warning: failed to extend trace (%s)\n", strerror(err));
+            return false;
+        }
+        m_fileSize = mapEnd;
+    }
+
+    void *map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, mapOffset);
+    if (map == MAP_FAILED) {
+        os::log("apitrace: warning: failed to map trace (%s)\n", strerror(errno));
+        return false;
+    }
+
+    m_map = static_cast<char *>(map);
+    m_mapOffset = mapOffset;
+    m_mapSize = mapSize;
+
+    return true;
+}
+
+void MappedSnappyOutStream::unmapWindow(void)
+{
+    if (m_map) {
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+        m_mapOffset = 0;
+        m_mapSize = 0;
+    }
+}
+
+bool MappedSnappyOutStream::writeAt(const void *buffer, size_t length, uint64_t offset)
+{
+    const char *ptr = static_cast<const char *>(buffer);
+    while (length) {
+        ssize_t written = pwrite(m_fd, ptr, length, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ptr += written;
+        length -= written;
+        offset += written;
+    }
+    return true;
+}
+
+void MappedSnappyOutStream::writeChunk(const char *data, size_t length)
+{
+    unsigned char buf[MAX_CHUNK_HEADER_SIZE];
+    size_t headerSize = encodeChunkHeader(buf, data, length);
+
+    size_t chunkSize = headerSize + length;
+
+    if (!m_unmapped && !mapWindow(chunkSize)) {
+        os::log("apitrace: warning: falling back to unmapped trace writes\n");
+        m_unmapped = true;
+    }
+
+    if (m_unmapped) {
+        if (!writeAt(buf, headerSize, m_offset) ||
+            !writeAt(data, length, m_offset + headerSize)) {
+            os::log("apitrace: error: failed to write trace (%s)\n", strerror(errno));
+            return;
+        }
+    } else {
+        char *dst = m_map + (m_offset - m_mapOffset);
+        memcpy(dst + 4, buf + 4, headerSize - 4);
+        memcpy(dst + headerSize, data, length);
+
+        // Only publish the length after the data, so that a crash never
+        // leaves a length followed by a partial chunk.
+        std::atomic_signal_fence(std::memory_order_release);
+        memcpy(dst, buf, 4);
+    }
+
+    m_offset += chunkSize;
+}
+
+#endif /* !_WIN32 */
+
+
+OutStream *
+trace::createMappedSnappyStream(const char *filename, bool checksums)
+{
+#ifndef _WIN32
+    MappedSnappyOutStream *outStream = new MappedSnappyOutStream(checksums);
+    if (!outStream->open(filename)) {
+        delete outStream;
+        return nullptr;
+    }
+    return outStream;
+#else
+    return nullptr;
+#endif
+}
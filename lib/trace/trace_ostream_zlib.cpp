@@ -34,6 +34,7 @@
 #include <zlib.h>
 
 #include "os.hpp"
+#include "trace_telemetry.hpp"
 
 #include <iostream>
 
@@ -68,6 +69,9 @@ ZLibOutStream::~ZLibOutStream()
 
 bool ZLibOutStream::write(const void *buffer, size_t length)
 {
+    if (m_telemetry) {
+        Telemetry::add(m_telemetry->bytesWritten, length);
+    }
     return gzwrite(m_gzFile, buffer, unsigned(length)) != -1;
 }
 
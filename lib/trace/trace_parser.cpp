@@ -29,8 +29,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <memory>
 
+#include "crc32c.hpp"
 #include "trace_file.hpp"
 #include "trace_dump.hpp"
 #include "trace_parser.hpp"
@@ -51,6 +53,32 @@ Parser::~Parser() {
 }
 
 
+/**
+ * Reads lazy blob contents from the parser's file, restoring the parsing
+ * position afterwards.  Detached when the parser is closed.
+ */
+class Parser::FileBlobSource : public BlobSource
+{
+public:
+    File *file;
+
+    FileBlobSource(File *_file) :
+        file(_file)
+    {}
+
+    bool readBlob(const File::Offset &offset, void *buf, size_t size) override {
+        if (!file) {
+            return false;
+        }
+        File::Offset savedOffset = file->currentOffset();
+        file->setCurrentOffset(offset);
+        size_t read = file->read(buf, size);
+        file->setCurrentOffset(savedOffset);
+        return read == size;
+    }
+};
+
+
 bool Parser::open(const char *filename) {
     assert(!file);
     file = File::createForRead(filename);
@@ -81,6 +109,24 @@ bool Parser::open(const char *filename) {
     return true;
 }
 
+bool Parser::openShared(const char *filename, const Parser &other) {
+    if (!open(filename)) {
+        return false;
+    }
+
+    functions = other.functions;
+    structs = other.structs;
+    enums = other.enums;
+    bitmasks = other.bitmasks;
+    frames = other.frames;
+    strings = other.strings;
+    glGetErrorSig = other.glGetErrorSig;
+    api = other.api;
+    sharedSignatures = true;
+
+    return true;
+}
+
 template <typename Iter>
 inline void
 deleteAll(Iter begin, Iter end)
@@ -100,6 +146,12 @@ deleteAll(Container &c)
 }
 
 void Parser::close(void) {
+    if (blobSource) {
+        // Lazy blobs may outlive the parser
+        blobSource->file = nullptr;
+        blobSource.reset();
+    }
+
     if (file) {
         file->close();
         delete file;
@@ -110,6 +162,18 @@ void Parser::close(void) {
 
     deleteAll(calls);
 
+    if (sharedSignatures) {
+        // Owned by the parser they were borrowed from
+        functions.clear();
+        structs.clear();
+        enums.clear();
+        bitmasks.clear();
+        frames.clear();
+        strings.clear();
+        glGetErrorSig = nullptr;
+        sharedSignatures = false;
+    }
+
     // Delete all signature data.  Signatures are mere structures which don't
     // own their own memory, so we need to destroy all data we created here.
 
@@ -159,6 +223,14 @@ void Parser::close(void) {
     }
     bitmasks.clear();
 
+    for (auto state : strings) {
+        delete state;
+    }
+    strings.clear();
+
+    stringPool.clear();
+    stringPoolSize = 0;
+
     next_call_no = 0;
 }
 
@@ -486,12 +558,12 @@ Call *Parser::parse_leave(Mode mode) {
          */
         const FunctionSig sig = {0, NULL, 0, NULL};
         call = new Call(&sig, 0, 0);
-        parse_call_details(call, SCAN);
+        parse_call_details(call, SCAN, true);
         delete call;
         return NULL;
     }
 
-    if (parse_call_details(call, mode)) {
+    if (parse_call_details(call, mode, true)) {
         return call;
     } else {
         delete call;
@@ -500,7 +572,8 @@ Call *Parser::parse_leave(Mode mode) {
 }
 
 
-bool Parser::parse_call_details(Call *call, Mode mode) {
+bool Parser::parse_call_details(Call *call, Mode mode, bool leave) {
+    elidedBlob = false;
     do {
         int c = read_byte();
         switch (c) {
@@ -508,6 +581,10 @@ bool Parser::parse_call_details(Call *call, Mode mode) {
             if (TRACE_VERBOSE) {
                 std::cerr << "\tCALL_END\n";
             }
+            // Output blobs are commonly elided, and never replayed
+            if (elidedBlob && !leave) {
+                call->flags |= CALL_FLAG_ELIDED;
+            }
             return true;
         case trace::CALL_ARG:
             if (TRACE_VERBOSE) {
@@ -538,6 +615,19 @@ bool Parser::parse_call_details(Call *call, Mode mode) {
                 }
             }
             break;
+        case trace::CALL_TIMESTAMP:
+            if (TRACE_VERBOSE) {
+                std::cerr << "\tCALL_TIMESTAMP\n";
+            }
+            {
+                unsigned long long timestamp = read_uint();
+                if (leave) {
+                    call->leaveTime = timestamp;
+                } else {
+                    call->enterTime = timestamp;
+                }
+            }
+            break;
         default:
             std::cerr << "error: ("<<call->name()<< ") unknown call detail "
                       << c << "\n";
@@ -706,6 +796,12 @@ Value *Parser::parse_value(void) {
     case trace::TYPE_WSTRING:
         value = parse_wstring();
         break;
+    case trace::TYPE_STRING_REF:
+        value = parse_string_ref();
+        break;
+    case trace::TYPE_ELIDED_BLOB:
+        value = parse_elided_blob();
+        break;
     default:
         std::cerr << "error: unknown type " << c << "\n";
         exit(1);
@@ -770,6 +866,12 @@ void Parser::scan_value(void) {
     case trace::TYPE_WSTRING:
         scan_wstring();
         break;
+    case trace::TYPE_STRING_REF:
+        scan_string_ref();
+        break;
+    case trace::TYPE_ELIDED_BLOB:
+        scan_elided_blob();
+        break;
     default:
         std::cerr << "error: unknown type " << c << "\n";
         exit(1);
@@ -823,8 +925,57 @@ void Parser::scan_double() {
 }
 
 
+/*
+ * Limit the memory held by the interning pool, as strings are never evicted
+ * from it while the parser is open.
+ */
+#define STRING_POOL_MAX_SIZE (16*1024*1024)
+
+size_t Parser::StringHash::operator () (const char *s) const {
+    return crc32c_8bytes(s, strlen(s));
+}
+
 Value *Parser::parse_string() {
-    return new String(read_string());
+    size_t length = read_uint();
+    if (length < internMinLength || length > internMaxLength) {
+        char *value = new char[length + 1];
+        if (length) {
+            file->read(value, length);
+        }
+        value[length] = 0;
+        if (TRACE_VERBOSE) {
+            std::cerr << "\tSTRING \"" << value << "\"\n";
+        }
+        return new String(value);
+    }
+
+    // Only allocate strings which aren't in the pool yet
+    if (stringScratch.size() < length + 1) {
+        stringScratch.resize(length + 1);
+    }
+    char *scratch = stringScratch.data();
+    file->read(scratch, length);
+    scratch[length] = 0;
+    if (TRACE_VERBOSE) {
+        std::cerr << "\tSTRING \"" << scratch << "\"\n";
+    }
+
+    auto it = stringPool.find(scratch);
+    if (it != stringPool.end()) {
+        return new String(it->second);
+    }
+
+    char *value = new char[length + 1];
+    memcpy(value, scratch, length + 1);
+
+    if (stringPoolSize + length + 1 > STRING_POOL_MAX_SIZE) {
+        return new String(value);
+    }
+
+    std::shared_ptr<const char> shared(value, std::default_delete<const char []>());
+    stringPool.emplace(value, shared);
+    stringPoolSize += length + 1;
+    return new String(shared);
 }
 
 
@@ -833,6 +984,35 @@ void Parser::scan_string() {
 }
 
 
+Parser::StringState *Parser::parse_string_ref_state() {
+    size_t id = read_uint();
+
+    StringState *state = lookup(strings, id);
+
+    if (!state) {
+        state = new StringState;
+        state->value.reset(read_string(), std::default_delete<const char []>());
+        state->fileOffset = file->currentOffset();
+        strings[id] = state;
+    } else if (file->currentOffset() < state->fileOffset) {
+        /* skip over the definition */
+        skip_string();
+    }
+
+    return state;
+}
+
+
+Value *Parser::parse_string_ref() {
+    return new String(parse_string_ref_state()->value);
+}
+
+
+void Parser::scan_string_ref() {
+    parse_string_ref_state();
+}
+
+
 Value *Parser::parse_enum() {
     EnumSig *sig;
     signed long long value;
@@ -893,6 +1073,14 @@ void Parser::scan_array(void) {
 
 Value *Parser::parse_blob(void) {
     size_t size = read_uint();
+    if (lazyBlobs && size && size >= lazyBlobMinSize && file->supportsOffsets()) {
+        if (!blobSource) {
+            blobSource = std::make_shared<FileBlobSource>(file);
+        }
+        Blob *blob = new Blob(size, blobSource, file->currentOffset());
+        file->skip(size);
+        return blob;
+    }
     Blob *blob = new Blob(size);
     if (size) {
         file->read(blob->buf, size);
@@ -909,6 +1097,57 @@ void Parser::scan_blob(void) {
 }
 
 
+Value *Parser::parse_elided_blob(void) {
+    size_t size = read_uint();
+    char *digest = read_string();
+    size_t recordedSize = read_uint();
+    size_t readSize = std::min(recordedSize, size);
+
+    // Only keep the recorded contents, as the original size can be huge
+    Blob *blob;
+    if (lazyBlobs && readSize && readSize >= lazyBlobMinSize && file->supportsOffsets()) {
+        if (!blobSource) {
+            blobSource = std::make_shared<FileBlobSource>(file);
+        }
+        blob = new Blob(size, blobSource, file->currentOffset());
+        blob->recordedSize = readSize;
+        file->skip(readSize);
+    } else if (readSize == size) {
+        blob = new Blob(size);
+        if (readSize) {
+            file->read(blob->buf, readSize);
+        }
+    } else {
+        char *prefix = new char[readSize];
+        if (readSize) {
+            file->read(prefix, readSize);
+        }
+        blob = new Blob(size, prefix, readSize);
+    }
+    if (recordedSize > readSize) {
+        file->skip(recordedSize - readSize);
+    }
+
+    if (readSize < size) {
+        elidedBlob = true;
+    }
+
+    blob->digest = digest;
+    delete [] digest;
+    return blob;
+}
+
+
+void Parser::scan_elided_blob(void) {
+    read_uint();
+    skip_string();
+    size_t recordedSize = read_uint();
+    if (recordedSize) {
+        file->skip(recordedSize);
+    }
+}
+
+
 Value *Parser::parse_struct() {
     StructSig *sig = parse_struct_sig();
     Struct *value = new Struct(sig);
@@ -26,8 +26,12 @@
 #pragma once
 
 
+#include <string.h>
+
 #include <iostream>
 #include <list>
+#include <memory>
+#include <unordered_map>
 
 #include "trace_file.hpp"
 #include "trace_format.hpp"
@@ -110,9 +114,47 @@ protected:
     BitmaskMap bitmasks;
     StackFrameMap frames;
 
+    // Whether the signatures above, and back-referenced strings below, are
+    // borrowed from another parser
+    bool sharedSignatures = false;
+
+    // Back-referenced strings, shared by all values referring to them
+    struct StringState {
+        std::shared_ptr<const char> value;
+        File::Offset fileOffset;
+    };
+    std::vector<StringState *> strings;
+
+    struct StringHash {
+        size_t operator () (const char *s) const;
+    };
+    struct StringEqual {
+        bool operator () (const char *a, const char *b) const {
+            return strcmp(a, b) == 0;
+        }
+    };
+
+    // Interning pool for inline strings, disabled by default
+    std::unordered_map<const char *, std::shared_ptr<const char>, StringHash, StringEqual> stringPool;
+    size_t stringPoolSize = 0;
+    size_t internMinLength = 1;
+    size_t internMaxLength = 0;
+
+    // Where candidates for interning are read into, so that strings already
+    // in the pool don't need to be allocated
+    std::vector<char> stringScratch;
+
 
     FunctionSig *glGetErrorSig = nullptr;
 
+    class FileBlobSource;
+    bool lazyBlobs = false;
+    size_t lazyBlobMinSize = 1;
+    std::shared_ptr<FileBlobSource> blobSource;
+
+    // Whether an elided blob was parsed in the current call details
+    bool elidedBlob = false;
+
     int next_event_type = -1;
     unsigned next_call_no = 0;
 
@@ -128,6 +170,15 @@ public:
 
     bool open(const char *filename) override;
 
+    /**
+     * Open the same file as another parser, borrowing its signature tables
+     * rather than discovering them again, so that parsing may start at any
+     * bookmark.  The other parser must have scanned the whole file, and must
+     * stay open for as long as this one.  Both may then be used concurrently
+     * from different threads.
+     */
+    bool openShared(const char *filename, const Parser &other);
+
     void close(void) override;
 
     Call *parse_call(void) override {
@@ -160,6 +211,29 @@ public:
         return parse_call(SCAN);
     }
 
+    /**
+     * Don't read the contents of blobs of at least minSize bytes while
+     * parsing, but only when first accessed, for tools that rarely look at
+     * them.  Streams that don't support offsets are still read eagerly.
+     *
+     * Reading a deferred blob costs seeking back to it, so tools that still
+     * need most blobs should only defer the large ones.
+     */
+    void setLazyBlobs(bool enable, size_t minSize = 1) {
+        lazyBlobs = enable;
+        lazyBlobMinSize = minSize;
+    }
+
+    /**
+     * Share a single copy of repeated strings whose length is within the
+     * given range, for tools that keep many calls in memory.  Use a zero
+     * maximum length to disable, which is the default.
+     */
+    void setStringInterning(size_t minLength, size_t maxLength) {
+        internMinLength = minLength;
+        internMaxLength = maxLength;
+    }
+
 protected:
     Call *parse_call(Mode mode);
 
@@ -182,7 +256,7 @@ protected:
 
     Call *parse_leave(Mode mode);
 
-    bool parse_call_details(Call *call, Mode mode);
+    bool parse_call_details(Call *call, Mode mode, bool leave = false);
 
     bool parse_call_backtrace(Call *call, Mode mode);
     StackFrame * parse_backtrace_frame(Mode mode);
@@ -217,6 +291,10 @@ protected:
     Value *parse_string();
     void scan_string();
 
+    StringState *parse_string_ref_state();
+    Value *parse_string_ref();
+    void scan_string_ref();
+
     Value *parse_enum();
     void scan_enum();
 
@@ -229,6 +307,9 @@ protected:
     Value *parse_blob(void);
     void scan_blob(void);
 
+    Value *parse_elided_blob(void);
+    void scan_elided_blob(void);
+
     Value *parse_struct();
     void scan_struct();
 
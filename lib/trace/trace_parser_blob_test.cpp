@@ -0,0 +1,287 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "os_process.hpp"
+#include "os_string.hpp"
+#include "trace_parser.hpp"
+#include "trace_synth.hpp"
+#include "trace_writer.hpp"
+
+
+using namespace trace;
+
+
+static const Blob *
+findBlob(const Call *call)
+{
+    for (auto & arg : call->args) {
+        if (arg.value && arg.value->toBlob()) {
+            return arg.value->toBlob();
+        }
+    }
+    return nullptr;
+}
+
+
+class LazyBlobTest : public ::testing::Test
+{
+protected:
+    os::String filename;
+
+    void SetUp() override {
+        filename = os::getTemporaryDirectoryPath();
+        filename.join(os::String::format("trace_parser_blob_test.%u.trace",
+                                         (unsigned)os::getCurrentProcessId()));
+
+        SynthOptions options;
+        options.mix = SYNTH_MIX_BLOBS;
+        options.numCalls = 200;
+        options.callsPerFrame = 50;
+        options.maxBlobSize = 2 * 1024 * 1024;
+        ASSERT_TRUE(SynthGenerator(options).writeFile(filename));
+    }
+
+    void TearDown() override {
+        os::removeFile(filename);
+    }
+};
+
+
+TEST_F(LazyBlobTest, Contents)
+{
+    Parser eager;
+    Parser lazy;
+    lazy.setLazyBlobs(true);
+    ASSERT_TRUE(eager.open(filename));
+    ASSERT_TRUE(lazy.open(filename));
+
+    // Keep calls alive, so that blobs are read in a different order, after
+    // the parser moved on.
+    std::vector<std::unique_ptr<Call>> eagerCalls;
+    std::vector<std::unique_ptr<Call>> lazyCalls;
+    Call *call;
+    while ((call = eager.parse_call())) {
+        eagerCalls.emplace_back(call);
+        call = lazy.parse_call();
+        ASSERT_NE(call, nullptr);
+        lazyCalls.emplace_back(call);
+    }
+    EXPECT_EQ(lazy.parse_call(), nullptr);
+
+    unsigned numBlobs = 0;
+    for (size_t i = eagerCalls.size(); i-- > 0; ) {
+        const Blob *eagerBlob = findBlob(eagerCalls[i].get());
+        const Blob *lazyBlob = findBlob(lazyCalls[i].get());
+        ASSERT_EQ(eagerBlob == nullptr, lazyBlob == nullptr);
+        if (eagerBlob) {
+            ASSERT_EQ(eagerBlob->size, lazyBlob->size);
+            EXPECT_EQ(memcmp(eagerBlob->data(), lazyBlob->data(), eagerBlob->size), 0);
+            ++numBlobs;
+        }
+    }
+    EXPECT_GT(numBlobs, 0U);
+}
+
+
+TEST_F(LazyBlobTest, MinSize)
+{
+    const size_t minSize = 64 * 1024;
+
+    Parser eager;
+    Parser lazy;
+    lazy.setLazyBlobs(true, minSize);
+    ASSERT_TRUE(eager.open(filename));
+    ASSERT_TRUE(lazy.open(filename));
+
+    // Compare as we go, so that deferred blobs are mostly read back from the
+    // current chunk.
+    unsigned numSmall = 0;
+    unsigned numLarge = 0;
+    Call *call;
+    while ((call = eager.parse_call())) {
+        std::unique_ptr<Call> eagerCall(call);
+        std::unique_ptr<Call> lazyCall(lazy.parse_call());
+        ASSERT_TRUE(lazyCall);
+        const Blob *eagerBlob = findBlob(eagerCall.get());
+        const Blob *lazyBlob = findBlob(lazyCall.get());
+        ASSERT_EQ(eagerBlob == nullptr, lazyBlob == nullptr);
+        if (eagerBlob) {
+            ASSERT_EQ(eagerBlob->size, lazyBlob->size);
+            if (lazyBlob->size < minSize) {
+                EXPECT_NE(lazyBlob->buf, nullptr);
+                ++numSmall;
+            } else {
+                EXPECT_EQ(lazyBlob->buf, nullptr);
+                ++numLarge;
+            }
+            EXPECT_EQ(memcmp(eagerBlob->data(), lazyBlob->data(), eagerBlob->size), 0);
+        }
+    }
+    EXPECT_EQ(lazy.parse_call(), nullptr);
+    EXPECT_GT(numSmall, 0U);
+    EXPECT_GT(numLarge, 0U);
+}
+
+
+TEST_F(LazyBlobTest, AfterClose)
+{
+    Parser parser;
+    parser.setLazyBlobs(true);
+    ASSERT_TRUE(parser.open(filename));
+
+    std::unique_ptr<Call> call;
+    const Blob *blob = nullptr;
+    while (!blob) {
+        call.reset(parser.parse_call());
+        ASSERT_TRUE(call);
+        blob = findBlob(call.get());
+    }
+    parser.close();
+
+    // Contents can't be read anymore, but must still be accessible
+    ASSERT_NE(blob->data(), nullptr);
+}
+
+
+TEST_F(LazyBlobTest, SharedSignatures)
+{
+    Parser parser;
+    ASSERT_TRUE(parser.open(filename));
+
+    // Bookmark the middle of the trace, then scan to the end so that all
+    // signatures are known.
+    ParseBookmark bookmark;
+    unsigned numCalls = 0;
+    Call *call;
+    while ((call = parser.scan_call())) {
+        delete call;
+        if (++numCalls == 100) {
+            parser.getBookmark(bookmark);
+        }
+    }
+    ASSERT_GT(numCalls, 100U);
+
+    Parser shared;
+    ASSERT_TRUE(shared.openShared(filename, parser));
+
+    parser.setBookmark(bookmark);
+    shared.setBookmark(bookmark);
+    while ((call = parser.parse_call())) {
+        std::unique_ptr<Call> ownedCall(call);
+        std::unique_ptr<Call> sharedCall(shared.parse_call());
+        ASSERT_TRUE(sharedCall);
+        EXPECT_EQ(sharedCall->no, call->no);
+        EXPECT_EQ(sharedCall->sig, call->sig);
+    }
+    EXPECT_EQ(shared.parse_call(), nullptr);
+
+    // Closing the borrowing parser must leave the signatures alone
+    shared.close();
+    parser.setBookmark(bookmark);
+    std::unique_ptr<Call> firstCall(parser.parse_call());
+    ASSERT_TRUE(firstCall);
+    EXPECT_NE(firstCall->sig->name, nullptr);
+}
+
+
+TEST(ElidedBlobTest, Contents)
+{
+    os::String filename = os::getTemporaryDirectoryPath();
+    filename.join(os::String::format("trace_parser_elided_test.%u.trace",
+                                     (unsigned)os::getCurrentProcessId()));
+
+    // An upload capped to a few bytes, with a huge original size, and an
+    // output blob of which only the digest was recorded.
+    static const char *argNames[] = {"data"};
+    static const FunctionSig sig = {0, "glBufferData", 1, argNames};
+    const size_t hugeSize = (size_t)1 << 40;
+    {
+        Writer writer;
+        ASSERT_TRUE(writer.open(filename, 6, Properties()));
+        unsigned no = writer.beginEnter(&sig, 0);
+        writer.beginArg(0);
+        writer.writeElidedBlob(hugeSize, "crc32c:00000000", "abcd", 4);
+        writer.endArg();
+        writer.endEnter();
+        writer.beginLeave(no);
+        writer.endLeave();
+        no = writer.beginEnter(&sig, 0);
+        writer.endEnter();
+        writer.beginLeave(no);
+        writer.beginArg(0);
+        writer.writeElidedBlob(16, "crc32c:00000000", nullptr, 0);
+        writer.endArg();
+        writer.endLeave();
+        writer.close();
+    }
+
+    for (bool lazy : {false, true}) {
+        Parser parser;
+        parser.setLazyBlobs(lazy);
+        ASSERT_TRUE(parser.open(filename));
+
+        std::unique_ptr<Call> call(parser.parse_call());
+        ASSERT_TRUE(call);
+        const Blob *blob = findBlob(call.get());
+        ASSERT_NE(blob, nullptr);
+        EXPECT_EQ(blob->size, hugeSize);
+        EXPECT_EQ(blob->recordedSize, 4U);
+        EXPECT_TRUE(blob->isElided());
+        EXPECT_EQ(memcmp(blob->recordedData(), "abcd", 4), 0);
+        EXPECT_TRUE(call->flags & CALL_FLAG_ELIDED);
+
+        // Output blobs don't affect replay
+        call.reset(parser.parse_call());
+        ASSERT_TRUE(call);
+        blob = findBlob(call.get());
+        ASSERT_NE(blob, nullptr);
+        EXPECT_EQ(blob->recordedSize, 0U);
+        EXPECT_FALSE(call->flags & CALL_FLAG_ELIDED);
+
+        // The unrecorded contents are materialized as zeros on demand
+        const char *data = blob->data();
+        for (size_t i = 0; i < blob->size; ++i) {
+            EXPECT_EQ(data[i], 0);
+        }
+    }
+
+    os::removeFile(filename);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -31,4 +31,10 @@
 #define SNAPPY_BYTE1 'a'
 #define SNAPPY_BYTE2 't'
 
+/*
+ * Second identifier byte of the checksummed container revision, where every
+ * chunk length is followed by the CRC-32C of the compressed chunk data.
+ */
+#define SNAPPY_BYTE2_CHECKSUM 'c'
+
 
@@ -0,0 +1,505 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "os_string.hpp"
+#include "trace_synth.hpp"
+#include "trace_format.hpp"
+
+
+namespace trace {
+
+
+/*
+ * A handful of signatures modelled after real OpenGL entry points, so that
+ * trace::Parser::lookupCallFlags assigns them realistic call flags.
+ */
+
+enum {
+    SIG_GLUNIFORM1I = 0,
+    SIG_GLUNIFORM4F,
+    SIG_GLENABLE,
+    SIG_GLUNIFORM4FV,
+    SIG_GLBUFFERDATA,
+    SIG_GLDRAWARRAYS,
+    SIG_GLGETUNIFORMLOCATION,
+    SIG_GLXSWAPBUFFERS,
+    SIG_COUNT
+};
+
+static const char *glUniform1i_args[] = {"location", "v0"};
+static const char *glUniform4f_args[] = {"location", "v0", "v1", "v2", "v3"};
+static const char *glEnable_args[] = {"cap"};
+static const char *glUniform4fv_args[] = {"location", "count", "value"};
+static const char *glBufferData_args[] = {"target", "size", "data", "usage"};
+static const char *glDrawArrays_args[] = {"mode", "first", "count"};
+static const char *glGetUniformLocation_args[] = {"program", "name"};
+static const char *glXSwapBuffers_args[] = {"dpy", "drawable"};
+
+static const FunctionSig
+staticSigs[SIG_COUNT] = {
+    {SIG_GLUNIFORM1I, "glUniform1i", 2, glUniform1i_args},
+    {SIG_GLUNIFORM4F, "glUniform4f", 5, glUniform4f_args},
+    {SIG_GLENABLE, "glEnable", 1, glEnable_args},
+    {SIG_GLUNIFORM4FV, "glUniform4fv", 3, glUniform4fv_args},
+    {SIG_GLBUFFERDATA, "glBufferData", 4, glBufferData_args},
+    {SIG_GLDRAWARRAYS, "glDrawArrays", 3, glDrawArrays_args},
+    {SIG_GLGETUNIFORMLOCATION, "glGetUniformLocation", 2, glGetUniformLocation_args},
+    {SIG_GLXSWAPBUFFERS, "glXSwapBuffers", 2, glXSwapBuffers_args},
+};
+
+static const EnumValue capValues[] = {
+    {"GL_CULL_FACE", 0x0B44},
+    {"GL_DEPTH_TEST", 0x0B71},
+    {"GL_BLEND", 0x0BE2},
+    {"GL_SCISSOR_TEST", 0x0C11},
+};
+static const EnumSig capSig = {0, 4, capValues};
+
+static const EnumValue targetValues[] = {
+    {"GL_ARRAY_BUFFER", 0x8892},
+    {"GL_ELEMENT_ARRAY_BUFFER", 0x8893},
+};
+static const EnumSig targetSig = {1, 2, targetValues};
+
+static const EnumValue usageValues[] = {
+    {"GL_STREAM_DRAW", 0x88E0},
+    {"GL_STATIC_DRAW", 0x88E4},
+    {"GL_DYNAMIC_DRAW", 0x88E8},
+};
+static const EnumSig usageSig = {2, 3, usageValues};
+
+static const EnumValue modeValues[] = {
+    {"GL_POINTS", 0x0000},
+    {"GL_LINES", 0x0001},
+    {"GL_TRIANGLES", 0x0004},
+};
+static const EnumSig modeSig = {3, 3, modeValues};
+
+static const char *
+uniformNames[] = {
+    "u_modelViewProjection",
+    "u_normalMatrix",
+    "u_lightPosition",
+    "u_diffuseColor",
+    "u_specularExponent",
+    "u_shadowMap",
+    "u_time",
+    "u_bones",
+};
+
+
+static inline void
+writeEnumValue(Writer &writer, SynthRandom &rng, const EnumSig *sig)
+{
+    writer.writeEnum(sig, sig->values[rng.below(sig->num_values)].value);
+}
+
+
+SynthGenerator::SynthGenerator(const SynthOptions &options) :
+    m_options(options)
+{
+    if (m_options.mix == SYNTH_MIX_SIGNATURES) {
+        unsigned numSignatures = m_options.numSignatures;
+        m_sigNames.reserve(numSignatures);
+        m_sigs.resize(numSignatures);
+        for (unsigned i = 0; i < numSignatures; ++i) {
+            m_sigNames.push_back(os::String::format("glSynthetic%04u", i).str());
+            FunctionSig &sig = m_sigs[i];
+            sig.id = SIG_COUNT + i;
+            sig.name = m_sigNames[i].c_str();
+            // Reuse glUniform4f argument names, with varying arity
+            sig.num_args = i % 6;
+            sig.arg_names = glUniform4f_args;
+        }
+    }
+
+    if (m_options.mix == SYNTH_MIX_BLOBS) {
+        // Pseudo-random, but mildly compressible, content
+        m_blob.resize(m_options.maxBlobSize);
+        SynthRandom rng(m_options.seed);
+        for (size_t i = 0; i < m_blob.size(); ++i) {
+            m_blob[i] = (i & 3) ? char(i >> 4) : char(rng.next());
+        }
+    }
+
+    if (m_options.mix == SYNTH_MIX_ARRAYS) {
+        m_floats.resize(m_options.arrayLength * 4);
+        for (size_t i = 0; i < m_floats.size(); ++i) {
+            m_floats[i] = float(i) * 0.25f;
+        }
+    }
+}
+
+
+SynthGenerator::~SynthGenerator()
+{
+}
+
+
+const char *
+SynthGenerator::mixName(SynthMix mix)
+{
+    switch (mix) {
+    case SYNTH_MIX_SCALAR:
+        return "scalar";
+    case SYNTH_MIX_ARRAYS:
+        return "arrays";
+    case SYNTH_MIX_BLOBS:
+        return "blobs";
+    case SYNTH_MIX_THREADS:
+        return "threads";
+    case SYNTH_MIX_SIGNATURES:
+        return "signatures";
+    default:
+        assert(0);
+        return "?";
+    }
+}
+
+
+bool
+SynthGenerator::parseMix(const char *name, SynthMix &mix)
+{
+    for (unsigned i = 0; i < SYNTH_MIX_COUNT; ++i) {
+        if (strcmp(name, mixName(SynthMix(i))) == 0) {
+            mix = SynthMix(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool
+SynthGenerator::writeFile(const char *filename)
+{
+    Writer writer;
+
+    Properties properties;
+    properties["process.name"] = "synthetic";
+
+    if (!writer.open(filename, TRACE_VERSION, properties)) {
+        return false;
+    }
+
+    writeCalls(writer);
+
+    writer.close();
+    return true;
+}
+
+
+void
+SynthGenerator::writeCalls(Writer &writer)
+{
+    SynthRandom rng(m_options.seed);
+
+    unsigned callsPerFrame = m_options.callsPerFrame;
+    if (callsPerFrame < 2) {
+        callsPerFrame = 2;
+    }
+
+    unsigned numCalls = 0;
+    while (numCalls < m_options.numCalls) {
+        unsigned frameCalls = std::min(callsPerFrame, m_options.numCalls - numCalls);
+
+        // Leave room for the frame terminator
+        unsigned count = frameCalls - 1;
+
+        switch (m_options.mix) {
+        case SYNTH_MIX_SCALAR:
+            for (unsigned i = 0; i < count; ++i) {
+                writeScalarCall(writer, rng, 0);
+            }
+            break;
+        case SYNTH_MIX_ARRAYS:
+            for (unsigned i = 0; i < count; ++i) {
+                writeArrayCall(writer, rng);
+            }
+            break;
+        case SYNTH_MIX_BLOBS:
+            for (unsigned i = 0; i < count; ++i) {
+                writeBlobCall(writer, rng);
+            }
+            break;
+        case SYNTH_MIX_THREADS:
+            writeThreadedCalls(writer, rng, count);
+            break;
+        case SYNTH_MIX_SIGNATURES:
+            for (unsigned i = 0; i < count; ++i) {
+                writeSignatureCall(writer, rng);
+            }
+            break;
+        default:
+            assert(0);
+            break;
+        }
+
+        writeSwapBuffers(writer, 0);
+
+        numCalls += frameCalls;
+    }
+}
+
+
+void
+SynthGenerator::writeScalarCall(Writer &writer, SynthRandom &rng, unsigned thread_id)
+{
+    unsigned sigNo;
+    switch (rng.below(8)) {
+    case 0:
+    case 1:
+    case 2:
+        sigNo = SIG_GLUNIFORM1I;
+        break;
+    case 3:
+    case 4:
+        sigNo = SIG_GLUNIFORM4F;
+        break;
+    case 5:
+        sigNo = SIG_GLENABLE;
+        break;
+    case 6:
+        sigNo = SIG_GLGETUNIFORMLOCATION;
+        break;
+    default:
+        sigNo = SIG_GLDRAWARRAYS;
+        break;
+    }
+
+    const FunctionSig *sig = &staticSigs[sigNo];
+    unsigned call = writer.beginEnter(sig, thread_id);
+    switch (sigNo) {
+    case SIG_GLUNIFORM1I:
+        writer.beginArg(0);
+        writer.writeSInt(rng.below(64));
+        writer.endArg();
+        writer.beginArg(1);
+        writer.writeSInt(rng.below(16));
+        writer.endArg();
+        break;
+    case SIG_GLUNIFORM4F:
+        writer.beginArg(0);
+        writer.writeSInt(rng.below(64));
+        writer.endArg();
+        for (unsigned i = 1; i < 5; ++i) {
+            writer.beginArg(i);
+            writer.writeFloat(float(rng.below(1024)) / 1024.0f);
+            writer.endArg();
+        }
+        break;
+    case SIG_GLENABLE:
+        writer.beginArg(0);
+        writeEnumValue(writer, rng, &capSig);
+        writer.endArg();
+        break;
+    case SIG_GLGETUNIFORMLOCATION:
+        writer.beginArg(0);
+        writer.writeUInt(1 + rng.below(32));
+        writer.endArg();
+        writer.beginArg(1);
+        writer.writeString(uniformNames[rng.below(sizeof uniformNames / sizeof uniformNames[0])]);
+        writer.endArg();
+        break;
+    case SIG_GLDRAWARRAYS:
+        writer.beginArg(0);
+        writeEnumValue(writer, rng, &modeSig);
+        writer.endArg();
+        writer.beginArg(1);
+        writer.writeSInt(0);
+        writer.endArg();
+        writer.beginArg(2);
+        writer.writeSInt(3 * (1 + rng.below(1000)));
+        writer.endArg();
+        break;
+    default:
+        assert(0);
+        break;
+    }
+    writer.endEnter();
+
+    writer.beginLeave(call);
+    if (sigNo == SIG_GLGETUNIFORMLOCATION) {
+        writer.beginReturn();
+        writer.writeSInt(rng.below(64));
+        writer.endReturn();
+    }
+    writer.endLeave();
+}
+
+
+void
+SynthGenerator::writeArrayCall(Writer &writer, SynthRandom &rng)
+{
+    if (rng.below(8) == 0) {
+        writeScalarCall(writer, rng, 0);
+        return;
+    }
+
+    unsigned length = 1 + rng.below(m_options.arrayLength);
+
+    const FunctionSig *sig = &staticSigs[SIG_GLUNIFORM4FV];
+    unsigned call = writer.beginEnter(sig, 0);
+    writer.beginArg(0);
+    writer.writeSInt(rng.below(64));
+    writer.endArg();
+    writer.beginArg(1);
+    writer.writeSInt(length);
+    writer.endArg();
+    writer.beginArg(2);
+    writer.beginArray(length * 4);
+    for (unsigned i = 0; i < length * 4; ++i) {
+        writer.beginElement();
+        writer.writeFloat(m_floats[i]);
+        writer.endElement();
+    }
+    writer.endArray();
+    writer.endArg();
+    writer.endEnter();
+    writer.beginLeave(call);
+    writer.endLeave();
+}
+
+
+void
+SynthGenerator::writeBlobCall(Writer &writer, SynthRandom &rng)
+{
+    if (rng.below(4) == 0) {
+        writeScalarCall(writer, rng, 0);
+        return;
+    }
+
+    size_t minSize = m_options.minBlobSize;
+    size_t maxSize = std::max(minSize, m_options.maxBlobSize);
+    size_t size = minSize + rng.below(uint32_t(maxSize - minSize + 1));
+    size_t offset = rng.below(uint32_t(m_blob.size() - size + 1));
+
+    const FunctionSig *sig = &staticSigs[SIG_GLBUFFERDATA];
+    unsigned call = writer.beginEnter(sig, 0);
+    writer.beginArg(0);
+    writeEnumValue(writer, rng, &targetSig);
+    writer.endArg();
+    writer.beginArg(1);
+    writer.writeSInt(size);
+    writer.endArg();
+    writer.beginArg(2);
+    writer.writeBlob(&m_blob[offset], size);
+    writer.endArg();
+    writer.beginArg(3);
+    writeEnumValue(writer, rng, &usageSig);
+    writer.endArg();
+    writer.endEnter();
+    writer.beginLeave(call);
+    writer.endLeave();
+}
+
+
+void
+SynthGenerator::writeSignatureCall(Writer &writer, SynthRandom &rng)
+{
+    const FunctionSig *sig = &m_sigs[rng.below(m_sigs.size())];
+    unsigned call = writer.beginEnter(sig, 0);
+    for (unsigned i = 0; i < sig->num_args; ++i) {
+        writer.beginArg(i);
+        writer.writeUInt(rng.below(1 << 20));
+        writer.endArg();
+    }
+    writer.endEnter();
+    writer.beginLeave(call);
+    writer.endLeave();
+}
+
+
+/*
+ * Emulate several threads entering calls concurrently, so that leave events
+ * don't immediately follow their enter events.
+ */
+void
+SynthGenerator::writeThreadedCalls(Writer &writer, SynthRandom &rng, unsigned count)
+{
+    unsigned numThreads = std::max(m_options.numThreads, 1U);
+
+    std::vector<unsigned> pending;
+    pending.reserve(numThreads);
+
+    while (count) {
+        unsigned batch = std::min(numThreads, count);
+
+        pending.clear();
+        for (unsigned thread_id = 0; thread_id < batch; ++thread_id) {
+            const FunctionSig *sig = &staticSigs[rng.below(2) ? SIG_GLUNIFORM1I : SIG_GLENABLE];
+            unsigned call = writer.beginEnter(sig, thread_id);
+            writer.beginArg(0);
+            if (sig->id == SIG_GLENABLE) {
+                writeEnumValue(writer, rng, &capSig);
+            } else {
+                writer.writeSInt(rng.below(64));
+                writer.endArg();
+                writer.beginArg(1);
+                writer.writeSInt(thread_id);
+            }
+            writer.endArg();
+            writer.endEnter();
+            pending.push_back(call);
+        }
+
+        // Leave in a shuffled order
+        while (!pending.empty()) {
+            size_t index = rng.below(pending.size());
+            writer.beginLeave(pending[index]);
+            writer.endLeave();
+            pending[index] = pending.back();
+            pending.pop_back();
+        }
+
+        count -= batch;
+    }
+}
+
+
+void
+SynthGenerator::writeSwapBuffers(Writer &writer, unsigned thread_id)
+{
+    const FunctionSig *sig = &staticSigs[SIG_GLXSWAPBUFFERS];
+    unsigned call = writer.beginEnter(sig, thread_id);
+    writer.beginArg(0);
+    writer.writePointer(0x1000);
+    writer.endArg();
+    writer.beginArg(1);
+    writer.writeUInt(0x2000001);
+    writer.endArg();
+    writer.endEnter();
+    writer.beginLeave(call);
+    writer.endLeave();
+}
+
+
+} /* namespace trace */
@@ -0,0 +1,156 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Deterministic synthetic trace generation, for benchmarking and testing the
+ * trace library without any graphics API.
+ */
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "trace_model.hpp"
+#include "trace_writer.hpp"
+
+
+namespace trace {
+
+
+enum SynthMix {
+    SYNTH_MIX_SCALAR = 0,   // glUniform*/glEnable-like calls with scalar args
+    SYNTH_MIX_ARRAYS,       // glUniform*v-like calls with uniform arrays
+    SYNTH_MIX_BLOBS,        // glBufferData/glTexImage-like large uploads
+    SYNTH_MIX_THREADS,      // scalar calls interleaved across several threads
+    SYNTH_MIX_SIGNATURES,   // thousands of distinct function signatures
+    SYNTH_MIX_COUNT
+};
+
+
+struct SynthOptions
+{
+    SynthMix mix = SYNTH_MIX_SCALAR;
+
+    // Total number of calls, including frame terminators
+    unsigned numCalls = 100000;
+
+    // A glXSwapBuffers call is emitted every so many calls
+    unsigned callsPerFrame = 1000;
+
+    // Number of elements in array arguments
+    unsigned arrayLength = 16;
+
+    // Blob size range, in bytes
+    size_t minBlobSize = 4 * 1024;
+    size_t maxBlobSize = 256 * 1024;
+
+    // Number of interleaved threads for SYNTH_MIX_THREADS
+    unsigned numThreads = 8;
+
+    // Number of distinct signatures for SYNTH_MIX_SIGNATURES
+    unsigned numSignatures = 4096;
+
+    uint32_t seed = 0x12345678;
+};
+
+
+/**
+ * Small and fast xorshift generator, so that generated traces are identical
+ * across platforms and C library implementations.
+ */
+class SynthRandom
+{
+    uint32_t state;
+
+public:
+    SynthRandom(uint32_t seed) :
+        state(seed ? seed : 1)
+    {}
+
+    inline uint32_t
+    next(void) {
+        uint32_t x = state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        state = x;
+        return x;
+    }
+
+    inline uint32_t
+    below(uint32_t n) {
+        return n ? next() % n : 0;
+    }
+};
+
+
+/**
+ * Writes synthetic calls through a trace::Writer.
+ */
+class SynthGenerator
+{
+public:
+    SynthGenerator(const SynthOptions &options);
+    ~SynthGenerator();
+
+    /**
+     * Write a complete trace into the given file.
+     */
+    bool writeFile(const char *filename);
+
+    /**
+     * Write the calls into an already opened writer.
+     */
+    void writeCalls(Writer &writer);
+
+    static const char *
+    mixName(SynthMix mix);
+
+    static bool
+    parseMix(const char *name, SynthMix &mix);
+
+private:
+    SynthOptions m_options;
+
+    std::vector<FunctionSig> m_sigs;
+    std::vector<std::string> m_sigNames;
+
+    std::vector<char> m_blob;
+    std::vector<float> m_floats;
+
+    void writeScalarCall(Writer &writer, SynthRandom &rng, unsigned thread_id);
+    void writeArrayCall(Writer &writer, SynthRandom &rng);
+    void writeBlobCall(Writer &writer, SynthRandom &rng);
+    void writeSignatureCall(Writer &writer, SynthRandom &rng);
+    void writeThreadedCalls(Writer &writer, SynthRandom &rng, unsigned count);
+    void writeSwapBuffers(Writer &writer, unsigned thread_id);
+};
+
+
+} /* namespace trace */
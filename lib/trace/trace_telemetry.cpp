@@ -0,0 +1,233 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "trace_telemetry.hpp"
+
+#include <new>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "os.hpp"
+#include "os_process.hpp"
+#include "os_string.hpp"
+#include "os_time.hpp"
+
+
+namespace trace {
+
+
+static void
+segmentName(char *buf, size_t size, unsigned long pid)
+{
+#ifdef _WIN32
+    snprintf(buf, size, "Local\\apitrace.%lu", pid);
+#else
+    snprintf(buf, size, "/apitrace.%lu", pid);
+#endif
+}
+
+
+TelemetrySegment::TelemetrySegment() :
+    m_data(nullptr),
+    m_owner(false),
+    m_pid(0)
+#ifdef _WIN32
+    , m_handle(nullptr)
+#endif
+{
+}
+
+
+TelemetrySegment::~TelemetrySegment()
+{
+    close();
+}
+
+
+bool
+TelemetrySegment::create(void)
+{
+    close();
+
+    m_pid = os::getCurrentProcessId();
+
+    char name[64];
+    segmentName(name, sizeof name, m_pid);
+
+    void *map;
+#ifdef _WIN32
+    HANDLE hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+                                         PAGE_READWRITE, 0, sizeof(Telemetry),
+                                         name);
+    if (!hMapping) {
+        return false;
+    }
+    map = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Telemetry));
+    if (!map) {
+        CloseHandle(hMapping);
+        return false;
+    }
+    m_handle = hMapping;
+#else
+    // A segment left over by a crashed process with the same ID is replaced.
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, sizeof(Telemetry)) != 0) {
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    map = mmap(nullptr, sizeof(Telemetry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+#endif
+
+    Telemetry *data = new (map) Telemetry();
+    data->version = Telemetry::VERSION;
+    data->pid = m_pid;
+    os::getTime(); // initializes os::timeFrequency on some platforms
+    data->timeFrequency = os::timeFrequency;
+    os::String processName = os::getProcessName();
+    strncpy(data->processName, processName.str(), sizeof data->processName - 1);
+
+    // Readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    data->magic = Telemetry::MAGIC;
+
+    m_data = data;
+    m_owner = true;
+    return true;
+}
+
+
+bool
+TelemetrySegment::open(unsigned long pid)
+{
+    close();
+
+    char name[64];
+    segmentName(name, sizeof name, pid);
+
+    void *map;
+#ifdef _WIN32
+    HANDLE hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (!hMapping) {
+        return false;
+    }
+    map = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, sizeof(Telemetry));
+    if (!map) {
+        CloseHandle(hMapping);
+        return false;
+    }
+    m_handle = hMapping;
+#else
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    map = mmap(nullptr, sizeof(Telemetry), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+#endif
+
+    m_data = static_cast<Telemetry *>(map);
+    m_owner = false;
+    m_pid = pid;
+
+    if (m_data->magic != Telemetry::MAGIC ||
+        m_data->version != Telemetry::VERSION) {
+        close();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return true;
+}
+
+
+void
+TelemetrySegment::close(void)
+{
+    if (!m_data) {
+        return;
+    }
+
+    // Forked children inherit the mapping, but must leave it alone.
+    bool remove = m_owner && m_pid == (unsigned long)os::getCurrentProcessId();
+    if (remove) {
+        m_data->closed.store(1, std::memory_order_relaxed);
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_handle);
+    m_handle = nullptr;
+#else
+    munmap(m_data, sizeof(Telemetry));
+    if (remove) {
+        char name[64];
+        segmentName(name, sizeof name, m_pid);
+        shm_unlink(name);
+    }
+#endif
+
+    m_data = nullptr;
+    m_owner = false;
+}
+
+
+bool
+TelemetrySegment::remove(unsigned long pid)
+{
+#ifdef _WIN32
+    (void)pid;
+    return false;
+#else
+    char name[64];
+    segmentName(name, sizeof name, pid);
+    return shm_unlink(name) == 0;
+#endif
+}
+
+
+} /* namespace trace */
@@ -0,0 +1,155 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Live tracer telemetry.
+ */
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include <atomic>
+
+
+namespace trace {
+
+
+/**
+ * Counters of a process being traced, kept in a small shared memory segment
+ * named after its process ID, so that `apitrace top` can watch whether the
+ * tracer keeps up while the capture is still running.
+ *
+ * Counters are only updated by the traced process, with the trace mutex
+ * held, so plain relaxed loads and stores suffice; readers merely take
+ * snapshots.  Times are in os::getTime() ticks of timeFrequency per second.
+ */
+struct Telemetry
+{
+    static const uint32_t MAGIC = 0x4d4c4554; // "TELM"
+    static const uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t pid;
+    uint64_t timeFrequency;
+    char processName[256];
+
+    // Set when the traced process closes the trace cleanly
+    std::atomic<uint32_t> closed;
+
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> discardedCalls;
+    std::atomic<uint64_t> frames;
+
+    // Uncompressed bytes written to the output stream
+    std::atomic<uint64_t> bytesWritten;
+    // Bytes which reached the file after compression
+    std::atomic<uint64_t> bytesCompressed;
+    // Bytes buffered by the output stream, still waiting to be compressed
+    std::atomic<uint64_t> bytesPending;
+    std::atomic<uint64_t> compressTime;
+
+    // Time spent waiting for the trace mutex, and how often it was contended
+    std::atomic<uint64_t> mutexWaitTime;
+    std::atomic<uint64_t> mutexWaits;
+
+    std::atomic<uint64_t> largestBlobSize;
+    std::atomic<uint64_t> largestBlobCall;
+
+    static inline void
+    add(std::atomic<uint64_t> &counter, uint64_t value = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+
+    static inline void
+    set(std::atomic<uint64_t> &counter, uint64_t value) {
+        counter.store(value, std::memory_order_relaxed);
+    }
+
+    static inline uint64_t
+    get(const std::atomic<uint64_t> &counter) {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    inline void
+    noteBlob(uint64_t size, unsigned call) {
+        if (size > get(largestBlobSize)) {
+            set(largestBlobSize, size);
+            set(largestBlobCall, call);
+        }
+    }
+};
+
+
+/**
+ * Shared memory segment holding a Telemetry structure.
+ */
+class TelemetrySegment
+{
+public:
+    TelemetrySegment();
+    ~TelemetrySegment();
+
+    /**
+     * Create (or replace) the segment of the current process, for writing.
+     */
+    bool create(void);
+
+    /**
+     * Attach to the segment of another process, read-only.
+     */
+    bool open(unsigned long pid);
+
+    /**
+     * Detach, removing the segment if it was created by this process.
+     */
+    void close(void);
+
+    /**
+     * Remove the segment left behind by a process which died without
+     * closing it.  Windows removes segments along with their last handle.
+     */
+    static bool remove(unsigned long pid);
+
+    Telemetry *
+    get(void) const {
+        return m_data;
+    }
+
+private:
+    Telemetry *m_data;
+    bool m_owner;
+    unsigned long m_pid;
+#ifdef _WIN32
+    void *m_handle;
+#endif
+};
+
+
+} /* namespace trace */
@@ -0,0 +1,104 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "os_process.hpp"
+
+#include "trace_telemetry.hpp"
+
+#include "gtest/gtest.h"
+
+
+using namespace trace;
+
+
+TEST(TelemetrySegment, RoundTrip)
+{
+    unsigned long pid = os::getCurrentProcessId();
+
+    TelemetrySegment writer;
+    ASSERT_TRUE(writer.create());
+    Telemetry *telemetry = writer.get();
+    ASSERT_NE(telemetry, nullptr);
+    Telemetry::add(telemetry->calls, 42);
+    Telemetry::add(telemetry->frames);
+
+    TelemetrySegment reader;
+    ASSERT_TRUE(reader.open(pid));
+    const Telemetry *view = reader.get();
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(view->pid, pid);
+    EXPECT_NE(view->timeFrequency, 0U);
+    EXPECT_EQ(Telemetry::get(view->calls), 42U);
+    EXPECT_EQ(Telemetry::get(view->frames), 1U);
+    EXPECT_EQ(view->closed.load(), 0U);
+
+    // Updates are seen live
+    Telemetry::add(telemetry->calls, 8);
+    EXPECT_EQ(Telemetry::get(view->calls), 50U);
+
+    // Readers don't remove the segment
+    reader.close();
+    EXPECT_EQ(reader.get(), nullptr);
+    ASSERT_TRUE(reader.open(pid));
+
+    // The owner does, flagging it as closed for readers still attached
+    writer.close();
+    EXPECT_EQ(writer.get(), nullptr);
+    EXPECT_EQ(reader.get()->closed.load(), 1U);
+    reader.close();
+
+    EXPECT_FALSE(reader.open(pid));
+}
+
+
+#ifndef _WIN32
+
+// Segments of dead processes can be removed by others
+TEST(TelemetrySegment, Remove)
+{
+    unsigned long pid = os::getCurrentProcessId();
+
+    TelemetrySegment writer;
+    ASSERT_TRUE(writer.create());
+
+    EXPECT_TRUE(TelemetrySegment::remove(pid));
+    EXPECT_FALSE(TelemetrySegment::remove(pid));
+
+    TelemetrySegment reader;
+    EXPECT_FALSE(reader.open(pid));
+
+    writer.close();
+}
+
+#endif
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
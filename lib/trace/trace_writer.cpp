@@ -32,6 +32,7 @@
 #include <wchar.h>
 #include <vector>
 
+#include "crc32c.hpp"
 #include "os.hpp"
 #include "trace_ostream.hpp"
 #include "trace_writer.hpp"
@@ -62,19 +63,32 @@ Writer::open(const char *filename,
              unsigned semanticVersion,
              const Properties &properties)
 {
-    close();
-
-    m_file = createSnappyStream(filename);
-    if (!m_file) {
+    OutStream *file = createSnappyStream(filename);
+    if (!file) {
         return false;
     }
 
+    return open(file, semanticVersion, properties);
+}
+
+bool
+Writer::open(OutStream *file,
+             unsigned semanticVersion,
+             const Properties &properties)
+{
+    close();
+
+    m_file = file;
+
     call_no = 0;
     functions.clear();
     structs.clear();
     enums.clear();
     bitmasks.clear();
     frames.clear();
+    strings.clear();
+    stringData.clear();
+    stringsSize = 0;
 
     _writeUInt(TRACE_VERSION);
 
@@ -178,7 +192,7 @@ void Writer::writeStackFrame(const RawStackFrame *frame) {
             _writeUInt(frame->offset);
         }
         _writeByte(trace::BACKTRACE_END);
-        frames[frame->id] = true;
+        frames[frame->id] = !m_discarding;
     }
 }
 
@@ -190,6 +204,12 @@ Writer::writeFlags(unsigned flags) {
     }
 }
 
+void
+Writer::writeTimestamp(unsigned long long timestamp) {
+    _writeByte(trace::CALL_TIMESTAMP);
+    _writeUInt(timestamp);
+}
+
 void
 Writer::writeProperty(const char *name, const char *value)
 {
@@ -216,7 +236,7 @@ unsigned Writer::beginEnter(const FunctionSig *sig, unsigned thread_id) {
         for (unsigned i = 0; i < sig->num_args; ++i) {
             _writeString(sig->arg_names[i]);
         }
-        functions[sig->id] = true;
+        functions[sig->id] = !m_discarding;
     }
 
     return call_no++;
@@ -258,7 +278,7 @@ void Writer::beginStruct(const StructSig *sig) {
         for (unsigned i = 0; i < sig->num_members; ++i) {
             _writeString(sig->member_names[i]);
         }
-        structs[sig->id] = true;
+        structs[sig->id] = !m_discarding;
     }
 }
 
@@ -295,13 +315,60 @@ void Writer::writeDouble(double value) {
     _writeDouble(value);
 }
 
+/*
+ * Strings at least this long (e.g. shader sources) are only written once, and
+ * referred to afterwards.
+ */
+#define STRING_REF_MIN_LENGTH 256
+
+/*
+ * Bound the memory used for remembering written strings.
+ */
+#define STRING_REF_MAX_TOTAL_SIZE (64*1024*1024)
+
+size_t Writer::StringKeyHash::operator () (const StringKey &key) const {
+    return crc32c_8bytes(key.str, key.len);
+}
+
+void Writer::_writeStringRef(const char *str, size_t len) {
+    StringKey key = {str, len};
+
+    auto it = strings.find(key);
+    if (it != strings.end()) {
+        _writeByte(trace::TYPE_STRING_REF);
+        _writeUInt(it->second);
+        return;
+    }
+
+    if (m_discarding ||
+        stringsSize + len > STRING_REF_MAX_TOTAL_SIZE) {
+        _writeByte(trace::TYPE_STRING);
+        _writeUInt(len);
+        _write(str, len);
+        return;
+    }
+
+    unsigned id = strings.size();
+    _writeByte(trace::TYPE_STRING_REF);
+    _writeUInt(id);
+    _writeUInt(len);
+    _write(str, len);
+
+    // Only copy the string when remembering it
+    char *copy = new char[len];
+    memcpy(copy, str, len);
+    stringData.emplace_back(copy);
+    key.str = copy;
+    strings.emplace(key, id);
+    stringsSize += len;
+}
+
 void Writer::writeString(const char *str) {
     if (!str) {
         Writer::writeNull();
         return;
     }
-    _writeByte(trace::TYPE_STRING);
-    _writeString(str);
+    writeString(str, strlen(str));
 }
 
 void Writer::writeString(const char *str, size_t len) {
@@ -309,6 +376,10 @@ void Writer::writeString(const char *str, size_t len) {
         Writer::writeNull();
         return;
     }
+    if (len >= STRING_REF_MIN_LENGTH) {
+        _writeStringRef(str, len);
+        return;
+    }
     _writeByte(trace::TYPE_STRING);
     _writeUInt(len);
     _write(str, len);
@@ -347,6 +418,18 @@ void Writer::writeBlob(const void *data, size_t size) {
     }
 }
 
+void Writer::writeElidedBlob(size_t size, const char *digest,
+                             const void *data, size_t recordedSize) {
+    assert(recordedSize <= size);
+    _writeByte(trace::TYPE_ELIDED_BLOB);
+    _writeUInt(size);
+    _writeString(digest ? digest : "");
+    _writeUInt(recordedSize);
+    if (recordedSize) {
+        _write(data, recordedSize);
+    }
+}
+
 void Writer::writeEnum(const EnumSig *sig, signed long long value) {
     _writeByte(trace::TYPE_ENUM);
     _writeUInt(sig->id);
@@ -356,7 +439,7 @@ void Writer::writeEnum(const EnumSig *sig, signed long long value) {
             _writeString(sig->values[i].name);
             writeSInt(sig->values[i].value);
         }
-        enums[sig->id] = true;
+        enums[sig->id] = !m_discarding;
     }
     writeSInt(value);
 }
@@ -373,7 +456,7 @@ void Writer::writeBitmask(const BitmaskSig *sig, unsigned long long value) {
             _writeString(sig->flags[i].name);
             _writeUInt(sig->flags[i].value);
         }
-        bitmasks[sig->id] = true;
+        bitmasks[sig->id] = !m_discarding;
     }
     _writeUInt(value);
 }
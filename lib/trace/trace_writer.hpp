@@ -31,7 +31,11 @@
 
 
 #include <stddef.h>
+#include <string.h>
 
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "trace_model.hpp"
@@ -50,13 +54,48 @@ namespace trace {
         std::vector<bool> bitmasks;
         std::vector<bool> frames;
 
+        /**
+         * Long strings written so far, and their back-reference ids.
+         *
+         * Keys refer to the copies in stringData, so that lookups don't need
+         * to copy the string.
+         */
+        struct StringKey {
+            const char *str;
+            size_t len;
+        };
+        struct StringKeyHash {
+            size_t operator () (const StringKey &key) const;
+        };
+        struct StringKeyEqual {
+            bool operator () (const StringKey &a, const StringKey &b) const {
+                return a.len == b.len && memcmp(a.str, b.str, a.len) == 0;
+            }
+        };
+        std::unordered_map<StringKey, unsigned, StringKeyHash, StringKeyEqual> strings;
+        std::vector<std::unique_ptr<char[]>> stringData;
+        size_t stringsSize = 0;
+
+        /**
+         * Whether output is currently being discarded, in which case
+         * signatures must not be marked as written.
+         */
+        bool m_discarding = false;
+
     public:
         Writer();
-        ~Writer();
+        virtual ~Writer();
 
         bool open(const char *filename,
                   unsigned semanticVersion,
                   const Properties &properties);
+
+        /**
+         * Start writing into the given stream, taking ownership of it.
+         */
+        bool open(OutStream *file,
+                  unsigned semanticVersion,
+                  const Properties &properties);
         void close(void);
 
         unsigned beginEnter(const FunctionSig *sig, unsigned thread_id);
@@ -65,10 +104,14 @@ namespace trace {
         void beginLeave(unsigned call);
         void endLeave(void);
 
-        void beginArg(unsigned index);
+        /*
+         * Virtual, so that LocalWriter's hooks also apply to code writing
+         * through a Writer reference, like the D3D shader dumpers.
+         */
+        virtual void beginArg(unsigned index);
         inline void endArg(void) {}
 
-        void beginReturn(void);
+        virtual void beginReturn(void);
         inline void endReturn(void) {}
 
         void beginBacktrace(unsigned num_frames);
@@ -77,6 +120,8 @@ namespace trace {
 
         void writeFlags(unsigned flags);
 
+        void writeTimestamp(unsigned long long timestamp);
+
         void beginArray(size_t length);
         inline void endArray(void) {}
 
@@ -98,7 +143,15 @@ namespace trace {
         void writeString(const char *str, size_t size);
         void writeWString(const wchar_t *str);
         void writeWString(const wchar_t *str, size_t size);
-        void writeBlob(const void *data, size_t size);
+        virtual void writeBlob(const void *data, size_t size);
+
+        /**
+         * Write a blob of the given size of which only the first
+         * recordedSize bytes are recorded, plus an optional digest of the
+         * whole contents.
+         */
+        void writeElidedBlob(size_t size, const char *digest,
+                             const void *data, size_t recordedSize);
         void writeEnum(const EnumSig *sig, signed long long value);
         void writeBitmask(const BitmaskSig *sig, unsigned long long value);
         void writeNull(void);
@@ -118,6 +171,7 @@ namespace trace {
         void inline _writeFloat(float value);
         void inline _writeDouble(double value);
         void inline _writeString(const char *str);
+        void _writeStringRef(const char *str, size_t len);
 
     };
 
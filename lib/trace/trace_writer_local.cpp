@@ -30,14 +30,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "os.hpp"
 #include "os_thread.hpp"
 #include "os_string.hpp"
+#include "os_time.hpp"
 #include "os_version.hpp"
 #include "trace_ostream.hpp"
 #include "trace_writer_local.hpp"
 #include "trace_format.hpp"
+#include "trace_parser.hpp"
 #include "os_backtrace.hpp"
+#include "crc32c.hpp"
 
 
 namespace trace {
@@ -62,8 +67,44 @@ static void exceptionCallback(void)
 }
 
 
+/**
+ * Output stream used while discarding calls.
+ */
+class NullOutStream : public OutStream {
+public:
+    bool write(const void *buffer, size_t length) override {
+        return true;
+    }
+
+    void flush(void) override {
+    }
+};
+
+static NullOutStream nullOutStream;
+
+
 LocalWriter::LocalWriter() :
-    acquired(0)
+    acquired(0),
+    frameWindow(false),
+    frameWindowStart(0),
+    frameWindowEnd(~0U),
+    frameNo(0),
+    frameWindowDone(false),
+    frameWindowFlushed(false),
+    discardedFile(nullptr),
+    timestamps(false),
+    timestampBase(0),
+    callLog(false),
+    callLogging(false),
+    callLogArg(0),
+    outputBlobPolicy(BLOB_POLICY_KEEP),
+    maxInputBlobSize(SIZE_MAX),
+    maxOutputBlobSize(SIZE_MAX),
+    maxBlobSize(SIZE_MAX),
+    leaving(false),
+    telemetryEnabled(false),
+    telemetry(nullptr),
+    telemetryCall(0)
 {
     os::String process = os::getProcessName();
     os::log("apitrace: loaded into %s\n", process.str());
@@ -71,6 +112,15 @@ LocalWriter::LocalWriter() :
     // Install the signal handlers as early as possible, to prevent
     // interfering with the application's signal handling.
     os::setExceptionCallback(exceptionCallback);
+
+    const char *timestampsEnv = getenv("TRACE_TIMESTAMPS");
+    timestamps = timestampsEnv && atoi(timestampsEnv) != 0;
+
+    const char *callLogEnv = getenv("TRACE_CALL_LOG");
+    callLog = callLogEnv && atoi(callLogEnv) != 0;
+
+    const char *telemetryEnv = getenv("TRACE_TELEMETRY");
+    telemetryEnabled = telemetryEnv && atoi(telemetryEnv) != 0;
 }
 
 LocalWriter::~LocalWriter()
@@ -78,6 +128,10 @@ LocalWriter::~LocalWriter()
     os::resetExceptionCallback();
     checkProcessId();
 
+    // The output stream outlives the segment, as it's only destroyed by
+    // Writer::~Writer.
+    closeTelemetry();
+
     os::String process = os::getProcessName();
     os::log("apitrace: unloaded from %s\n", process.str());
 }
@@ -142,13 +196,37 @@ LocalWriter::open(void) {
     Properties properties;
     os::String processName = os::getProcessName();
     properties["process.name"] = processName;
+    if (callLog) {
+        properties["trace.mode"] = "call-log";
+        os::log("apitrace: recording a call log without arguments\n");
+    }
 
-    if (!Writer::open(lpFileName, TRACE_VERSION, properties)) {
+    // Per-chunk checksums, as enabled by TRACE_CHECKSUMS=1
+    const char *checksumsEnv = getenv("TRACE_CHECKSUMS");
+    bool checksums = checksumsEnv && atoi(checksumsEnv) != 0;
+
+    // Prefer a memory-mapped file, so that completed chunks survive crashes
+    // even when the exception callback doesn't get to flush.
+    OutStream *file = createMappedSnappyStream(lpFileName, checksums);
+    if (!file) {
+        file = createSnappyStream(lpFileName, checksums);
+    }
+
+    if (!file ||
+        !Writer::open(file, TRACE_VERSION, properties)) {
         os::log("apitrace: error: failed to open %s\n", lpFileName);
         os::abort();
     }
 
     pid = os::getCurrentProcessId();
+    timestampBase = os::getTime();
+
+    parseFrameWindow();
+    parseBlobPolicy();
+
+    if (telemetryEnabled) {
+        openTelemetry();
+    }
 
 #if 0
     // For debugging the exception handler
@@ -156,6 +234,302 @@ LocalWriter::open(void) {
 #endif
 }
 
+void
+LocalWriter::openTelemetry(void)
+{
+    if (!telemetrySegment.create()) {
+        os::log("apitrace: warning: failed to create telemetry segment\n");
+        return;
+    }
+
+    telemetry = telemetrySegment.get();
+    m_file->setTelemetry(telemetry);
+
+    os::log("apitrace: telemetry available via `apitrace top %lu`\n",
+            (unsigned long)pid);
+}
+
+void
+LocalWriter::closeTelemetry(void)
+{
+    if (m_file) {
+        m_file->setTelemetry(nullptr);
+    }
+    if (discardedFile) {
+        discardedFile->setTelemetry(nullptr);
+    }
+    telemetry = nullptr;
+    telemetrySegment.close();
+}
+
+/**
+ * Parse the TRACE_FRAMES environment variable, which takes the form "A-B",
+ * "A-", or "A".
+ */
+void
+LocalWriter::parseFrameWindow(void)
+{
+    const char *frames = getenv("TRACE_FRAMES");
+    if (!frames || !frames[0]) {
+        return;
+    }
+
+    char *end;
+    unsigned long start = strtoul(frames, &end, 10);
+    unsigned long stop = start;
+    if (end != frames && *end == '-') {
+        if (end[1]) {
+            stop = strtoul(end + 1, &end, 10);
+        } else {
+            stop = ~0U;
+            ++end;
+        }
+    }
+    if (end == frames || *end || stop < start) {
+        os::log("apitrace: warning: ignoring invalid TRACE_FRAMES=%s\n", frames);
+        return;
+    }
+
+    frameWindow = true;
+    frameWindowStart = start;
+    frameWindowEnd = stop;
+    if (stop == ~0U) {
+        os::log("apitrace: recording draw calls from frame %lu onwards\n", start);
+    } else {
+        os::log("apitrace: recording draw calls in frames %lu-%lu\n", start, stop);
+    }
+}
+
+
+/**
+ * Parse the TRACE_OUTPUT_BLOBS (`keep`, `omit`, or `hash`) and
+ * TRACE_MAX_BLOB_SIZE (in bytes) environment variables.
+ */
+void
+LocalWriter::parseBlobPolicy(void)
+{
+    const char *outputBlobs = getenv("TRACE_OUTPUT_BLOBS");
+    if (outputBlobs && outputBlobs[0]) {
+        if (strcmp(outputBlobs, "keep") == 0) {
+            outputBlobPolicy = BLOB_POLICY_KEEP;
+        } else if (strcmp(outputBlobs, "omit") == 0) {
+            outputBlobPolicy = BLOB_POLICY_OMIT;
+        } else if (strcmp(outputBlobs, "hash") == 0) {
+            outputBlobPolicy = BLOB_POLICY_HASH;
+        } else {
+            os::log("apitrace: warning: ignoring invalid TRACE_OUTPUT_BLOBS=%s\n", outputBlobs);
+        }
+    }
+
+    const char *maxSize = getenv("TRACE_MAX_BLOB_SIZE");
+    if (maxSize && maxSize[0]) {
+        char *end;
+        unsigned long long size = strtoull(maxSize, &end, 10);
+        if (end == maxSize || *end) {
+            os::log("apitrace: warning: ignoring invalid TRACE_MAX_BLOB_SIZE=%s\n", maxSize);
+        } else {
+            maxInputBlobSize = size;
+            os::log("apitrace: truncating blobs larger than %llu bytes\n", size);
+        }
+    }
+
+    maxOutputBlobSize = outputBlobPolicy == BLOB_POLICY_KEEP ? maxInputBlobSize : 0;
+    maxBlobSize = leaving ? maxOutputBlobSize : maxInputBlobSize;
+}
+
+
+void
+LocalWriter::writeElidedBlob(const void *data, size_t size)
+{
+    size_t recordedSize;
+    bool hash;
+    if (leaving && outputBlobPolicy != BLOB_POLICY_KEEP) {
+        recordedSize = 0;
+        hash = outputBlobPolicy == BLOB_POLICY_HASH;
+    } else {
+        recordedSize = std::min(size, maxInputBlobSize);
+        hash = true;
+    }
+
+    char digest[32];
+    digest[0] = 0;
+    if (hash) {
+        uint32_t crc = crc32c_8bytes(data, size);
+        snprintf(digest, sizeof digest, "crc32c:%08x", crc);
+    }
+
+    Writer::writeElidedBlob(size, digest, data, recordedSize);
+}
+
+
+/*
+ * Read-backs, which are discarded outside the frame window even though they
+ * aren't flagged as free of side effects.
+ */
+static const char *
+readbackFunctionNames[] = {
+    "glGetBufferSubData",
+    "glGetBufferSubDataARB",
+    "glGetCompressedTexImage",
+    "glGetCompressedTexImageARB",
+    "glGetCompressedTextureImage",
+    "glGetCompressedTextureImageEXT",
+    "glGetCompressedTextureSubImage",
+    "glGetNamedBufferSubData",
+    "glGetNamedBufferSubDataEXT",
+    "glGetTexImage",
+    "glGetTextureImage",
+    "glGetTextureImageEXT",
+    "glGetTextureSubImage",
+    "glGetnCompressedTexImage",
+    "glGetnCompressedTexImageARB",
+    "glGetnTexImage",
+    "glGetnTexImageARB",
+    "glReadPixels",
+    "glReadnPixels",
+    "glReadnPixelsARB",
+    "glReadnPixelsEXT",
+};
+
+
+/*
+ * Calls without side effects whose results retrace still maps (locations and
+ * handles), so they must be kept outside the frame window.
+ */
+static const char *
+mappedFunctionNames[] = {
+    "glGetAttachedObjectsARB",
+    "glGetHandleARB",
+    "glGetProgramResourceLocation",
+    "glGetTransformFeedbackVaryingNV",
+    "wglGetCurrentContext",
+    "wglGetCurrentDC",
+};
+
+
+template< size_t N >
+static inline bool
+isNameIn(const char *name, const char * (&names)[N])
+{
+    for (size_t i = 0; i < N; ++i) {
+        if (strcmp(name, names[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+LocalWriter::WindowPolicy
+LocalWriter::getWindowPolicy(const FunctionSig *sig)
+{
+    if (sig->id >= windowPolicies.size()) {
+        windowPolicies.resize(sig->id + 1, WINDOW_POLICY_UNKNOWN);
+    }
+    unsigned char policy = windowPolicies[sig->id];
+    if (policy == WINDOW_POLICY_UNKNOWN) {
+        CallFlags flags = Parser::lookupCallFlags(sig->name);
+
+        if (flags & CALL_FLAG_END_FRAME) {
+            policy = WINDOW_POLICY_END_FRAME;
+        } else if (flags & CALL_FLAG_RENDER) {
+            // glBegin/glEnd pairs must stay balanced, and display lists may
+            // carry state.
+            if (strcmp(sig->name, "glEnd") == 0 ||
+                strncmp(sig->name, "glCallList", strlen("glCallList")) == 0) {
+                policy = WINDOW_POLICY_KEEP;
+            } else {
+                policy = WINDOW_POLICY_DISCARD;
+            }
+        } else if (isNameIn(sig->name, mappedFunctionNames)) {
+            policy = WINDOW_POLICY_KEEP;
+        } else if ((flags & CALL_FLAG_NO_SIDE_EFFECTS) ||
+                   isNameIn(sig->name, readbackFunctionNames)) {
+            policy = WINDOW_POLICY_DISCARD;
+        } else {
+            policy = WINDOW_POLICY_KEEP;
+        }
+        windowPolicies[sig->id] = policy;
+    }
+
+    return static_cast<WindowPolicy>(policy);
+}
+
+
+/*
+ * Decide whether a call should be recorded given the frame window, and keep
+ * track of the current frame.
+ */
+bool
+LocalWriter::isCallRecorded(const FunctionSig *sig, bool keep)
+{
+    if (frameWindowDone) {
+        return false;
+    }
+
+    WindowPolicy policy = getWindowPolicy(sig);
+
+    bool recorded = frameNo >= frameWindowStart ||
+                    policy != WINDOW_POLICY_DISCARD ||
+                    keep;
+
+    if (policy == WINDOW_POLICY_END_FRAME) {
+        if (frameNo == frameWindowEnd) {
+            os::log("apitrace: reached end of frame %u, stopping tracing\n", frameNo);
+            frameWindowDone = true;
+        }
+        ++frameNo;
+    }
+
+    return recorded;
+}
+
+
+inline void
+LocalWriter::beginDiscard(void) {
+    assert(!m_discarding);
+    discardedFile = m_file;
+    m_file = &nullOutStream;
+    m_discarding = true;
+}
+
+
+inline void
+LocalWriter::endDiscard(void) {
+    assert(m_discarding);
+    m_file = discardedFile;
+    discardedFile = nullptr;
+    m_discarding = false;
+}
+
+
+inline void
+LocalWriter::beginCallLog(void) {
+    beginDiscard();
+    callLogging = true;
+}
+
+
+inline void
+LocalWriter::endCallLog(void) {
+    callLogging = false;
+    endDiscard();
+
+    for (auto & size : callLogSizes) {
+        if (size.first == CALL_LOG_RETURN) {
+            Writer::beginReturn();
+            writeUInt(size.second);
+            endReturn();
+        } else {
+            Writer::beginArg(size.first);
+            writeUInt(size.second);
+            endArg();
+        }
+    }
+    callLogSizes.clear();
+}
+
+
 static uintptr_t next_thread_num = 1;
 
 static OS_THREAD_LOCAL uintptr_t thread_num;
@@ -167,6 +541,7 @@ void LocalWriter::checkProcessId(void) {
         // create a new file.  We can't call any method of the current
         // file, as it may cause it to flush and corrupt the parent's
         // trace, so we effectively leak the old file object.
+        closeTelemetry();
         close();
         // Don't want to open the same file again
         os::unsetEnvironment("TRACE_FILE");
@@ -174,8 +549,46 @@ void LocalWriter::checkProcessId(void) {
     }
 }
 
-unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake) {
+inline unsigned long long
+LocalWriter::getTimestamp(long long time) const {
+    long long delta = time - timestampBase;
+    if (delta <= 0) {
+        return 0;
+    }
+    if (os::timeFrequency == 1000000000LL) {
+        return delta;
+    }
+    return (unsigned long long)(delta * (1.0e9 / os::timeFrequency));
+}
+
+/*
+ * Acquire the mutex, accounting the time spent waiting for other threads
+ * when telemetry is enabled.
+ */
+inline void
+LocalWriter::lockMutex(void) {
+    if (!telemetry) {
+        mutex.lock();
+        return;
+    }
+
+    if (mutex.try_lock()) {
+        return;
+    }
+
+    long long startTime = os::getTime();
     mutex.lock();
+    // Telemetry may have been closed meanwhile.
+    if (telemetry) {
+        Telemetry::add(telemetry->mutexWaitTime, os::getTime() - startTime);
+        Telemetry::add(telemetry->mutexWaits);
+    }
+}
+
+unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake, bool keep) {
+    long long enterTime = timestamps ? os::getTime() : 0;
+
+    lockMutex();
     ++acquired;
 
     checkProcessId();
@@ -183,6 +596,21 @@ unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake) {
         open();
     }
 
+    if (frameWindow && !isCallRecorded(sig, keep)) {
+        if (telemetry) {
+            Telemetry::add(telemetry->discardedCalls);
+        }
+        beginDiscard();
+        return DISCARDED_CALL;
+    }
+
+    if (telemetry) {
+        Telemetry::add(telemetry->calls);
+        if (getWindowPolicy(sig) == WINDOW_POLICY_END_FRAME) {
+            Telemetry::add(telemetry->frames);
+        }
+    }
+
     uintptr_t this_thread_num = thread_num;
     if (!this_thread_num) {
         this_thread_num = next_thread_num++;
@@ -192,6 +620,7 @@ unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake) {
     assert(this_thread_num);
     unsigned thread_id = this_thread_num - 1;
     unsigned call_no = Writer::beginEnter(sig, thread_id);
+    telemetryCall = call_no;
     if (fake) {
         writeFlags(FLAG_FAKE);
     } else if (os::backtrace_is_needed(sig->name)) {
@@ -202,23 +631,60 @@ unsigned LocalWriter::beginEnter(const FunctionSig *sig, bool fake) {
         }
         endBacktrace();
     }
+    if (timestamps) {
+        writeTimestamp(getTimestamp(enterTime));
+    }
+    if (callLog) {
+        beginCallLog();
+    }
     return call_no;
 }
 
 void LocalWriter::endEnter(void) {
+    if (callLogging) {
+        endCallLog();
+    }
     Writer::endEnter();
+    if (m_discarding) {
+        endDiscard();
+    }
     --acquired;
     mutex.unlock();
 }
 
 void LocalWriter::beginLeave(unsigned call) {
-    mutex.lock();
+    long long leaveTime = timestamps ? os::getTime() : 0;
+
+    lockMutex();
     ++acquired;
+    if (call == DISCARDED_CALL) {
+        beginDiscard();
+    }
+    telemetryCall = call;
     Writer::beginLeave(call);
+    leaving = true;
+    maxBlobSize = maxOutputBlobSize;
+    if (timestamps) {
+        writeTimestamp(getTimestamp(leaveTime));
+    }
+    if (callLog && !m_discarding) {
+        beginCallLog();
+    }
 }
 
 void LocalWriter::endLeave(void) {
+    if (callLogging) {
+        endCallLog();
+    }
     Writer::endLeave();
+    leaving = false;
+    maxBlobSize = maxInputBlobSize;
+    if (m_discarding) {
+        endDiscard();
+    } else if (frameWindowDone && !frameWindowFlushed) {
+        m_file->flush();
+        frameWindowFlushed = true;
+    }
     --acquired;
     mutex.unlock();
 }
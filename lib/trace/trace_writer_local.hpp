@@ -32,8 +32,12 @@
 
 #include <stdint.h>
 
+#include <utility>
+#include <vector>
+
 #include "os_thread.hpp"
 #include "os_process.hpp"
+#include "trace_telemetry.hpp"
 #include "trace_writer.hpp"
 
 
@@ -53,7 +57,7 @@ namespace trace {
      * - flushes the output to ensure the last call is traced in event of
      *   abnormal termination
      */
-    class LocalWriter : public Writer {
+    class LocalWriter final : public Writer {
     protected:
         /**
          * This mutex guarantees that only one thread writes to the trace file
@@ -70,6 +74,8 @@ namespace trace {
         os::recursive_mutex mutex;
         int acquired;
 
+        inline void lockMutex(void);
+
         /**
          * ID of the processed that opened the trace file.
          */
@@ -77,7 +83,119 @@ namespace trace {
 
         void checkProcessId();
 
+        /**
+         * Frame window, as specified by TRACE_FRAMES=A-B.
+         *
+         * Outside the window, calls which merely render or read back
+         * (according to trace::Parser::lookupCallFlags) are discarded, while
+         * everything else is still recorded so that the window can be
+         * replayed.  Tracing stops entirely after frame B.
+         */
+        bool frameWindow;
+        unsigned frameWindowStart;
+        unsigned frameWindowEnd;
+        unsigned frameNo;
+        bool frameWindowDone;
+        bool frameWindowFlushed;
+
+        enum WindowPolicy {
+            WINDOW_POLICY_UNKNOWN = 0,
+            WINDOW_POLICY_KEEP,
+            WINDOW_POLICY_DISCARD,
+            WINDOW_POLICY_END_FRAME,
+        };
+
+        // Per function signature ID
+        std::vector<unsigned char> windowPolicies;
+
+        WindowPolicy getWindowPolicy(const FunctionSig *sig);
+
+        OutStream *discardedFile;
+
+        /**
+         * Per-call timestamps, as enabled by TRACE_TIMESTAMPS=1.
+         *
+         * Times are sampled outside the mutex, so that waiting for other
+         * threads isn't accounted to the call.
+         */
+        bool timestamps;
+        long long timestampBase;
+
+        inline unsigned long long getTimestamp(long long time) const;
+
+        /**
+         * Call log mode, as enabled by TRACE_CALL_LOG=1.
+         *
+         * Only the call events, flags and timestamps are recorded.  Arguments
+         * and return values are discarded, except for the total size of the
+         * blobs they contain, which is recorded in their place.  The
+         * resulting trace can be dumped but not replayed.
+         */
+        bool callLog;
+        bool callLogging;
+        unsigned callLogArg;
+        std::vector<std::pair<unsigned, unsigned long long>> callLogSizes;
+
+        // callLogArg value while writing the return value
+        static const unsigned CALL_LOG_RETURN = ~0U;
+
+        inline void beginCallLog(void);
+        inline void endCallLog(void);
+
+        /**
+         * Blob policy, as specified by TRACE_OUTPUT_BLOBS and
+         * TRACE_MAX_BLOB_SIZE.
+         *
+         * Output blobs (i.e., written when leaving a call) are never needed
+         * for replay, so they can be omitted or replaced by a digest.  Input
+         * blobs larger than the maximum size are truncated to that size, and
+         * recorded with a digest of the whole contents.
+         */
+        enum BlobPolicy {
+            BLOB_POLICY_KEEP = 0,
+            BLOB_POLICY_OMIT,
+            BLOB_POLICY_HASH,
+        };
+
+        BlobPolicy outputBlobPolicy;
+        size_t maxInputBlobSize;
+        size_t maxOutputBlobSize;
+
+        // Blobs larger than this are elided; switches between the two limits
+        // above when entering and leaving calls.
+        size_t maxBlobSize;
+        bool leaving;
+
+        void parseBlobPolicy(void);
+        void writeElidedBlob(const void *data, size_t size);
+
+        /**
+         * Live telemetry, as enabled by TRACE_TELEMETRY=1.
+         *
+         * Counters are published in a shared memory segment named after the
+         * process ID, for `apitrace top` to display.
+         */
+        bool telemetryEnabled;
+        TelemetrySegment telemetrySegment;
+        Telemetry *telemetry;
+        unsigned telemetryCall;
+
+        void openTelemetry(void);
+        void closeTelemetry(void);
+
+        void parseFrameWindow(void);
+        bool isCallRecorded(const FunctionSig *sig, bool keep);
+
+        inline void beginDiscard(void);
+        inline void endDiscard(void);
+
     public:
+        /**
+         * Call number returned by beginEnter for calls which are not
+         * recorded.
+         */
+        static const unsigned DISCARDED_CALL = ~0U;
+
         /**
          * Should never called directly -- use localWriter singleton below
          * instead.
@@ -89,8 +207,12 @@ namespace trace {
 
         /**
          * It will acquire the mutex.
+         *
+         * Calls are recorded before the frame window regardless of their
+         * window policy when keep is set, e.g., read-backs into pixel pack
+         * buffers.
          */
-        unsigned beginEnter(const FunctionSig *sig, bool fake = false);
+        unsigned beginEnter(const FunctionSig *sig, bool fake = false, bool keep = false);
 
         /**
          * It will release the mutex.
@@ -107,7 +229,72 @@ namespace trace {
          */
         void endLeave(void);
 
+        inline void beginArg(unsigned index) override {
+            callLogArg = index;
+            Writer::beginArg(index);
+        }
+
+        inline void beginReturn(void) override {
+            callLogArg = CALL_LOG_RETURN;
+            Writer::beginReturn();
+        }
+
+        inline void writeBlob(const void *data, size_t size) override {
+            if (telemetry && data) {
+                telemetry->noteBlob(size, telemetryCall);
+            }
+            if (callLogging && data) {
+                // Blobs within arrays or structs add up
+                if (!callLogSizes.empty() &&
+                    callLogSizes.back().first == callLogArg) {
+                    callLogSizes.back().second += size;
+                } else {
+                    callLogSizes.emplace_back(callLogArg, size);
+                }
+                return;
+            }
+            if (size > maxBlobSize && data) {
+                writeElidedBlob(data, size);
+                return;
+            }
+            Writer::writeBlob(data, size);
+        }
+
         void flush(void);
+
+        /**
+         * Whether the arguments and return value of the current call are
+         * being reduced to blob sizes, so that the wrappers can skip
+         * serializing those that have no blobs.
+         *
+         * Only meaningful between beginEnter/endEnter or beginLeave/endLeave.
+         */
+        inline bool isCallLogging(void) const {
+            return callLogging;
+        }
+
+        /**
+         * Whether render calls are currently being recorded.  Used to avoid
+         * serializing the user memory arrays of discarded draw calls, and of
+         * all draw calls in call log mode.
+         *
+         * This is only a hint, as it is checked without holding the mutex.
+         */
+        inline bool isRecordingRender(void) const {
+            return !callLog &&
+                   (!frameWindow ||
+                    (frameNo >= frameWindowStart && !frameWindowDone));
+        }
+
+        /**
+         * Whether read-backs are currently being recorded, i.e., we're not
+         * before the frame window.
+         *
+         * This is only a hint, as it is checked without holding the mutex.
+         */
+        inline bool isRecordingReadbacks(void) const {
+            return !frameWindow || frameNo >= frameWindowStart;
+        }
     };
 
     /**
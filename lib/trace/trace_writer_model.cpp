@@ -97,7 +97,12 @@ public:
     }
 
     void visit(Blob *node) override {
-        writer.writeBlob(node->buf, node->size);
+        if (node->isElided()) {
+            writer.writeElidedBlob(node->size, node->digest.c_str(),
+                                   node->recordedData(), node->recordedSize);
+            return;
+        }
+        writer.writeBlob(node->data(), node->size);
     }
 
     void visit(Pointer *node) override {
@@ -120,6 +125,9 @@ public:
             }
             writer.endBacktrace();
         }
+        if (call->enterTime != Call::NO_TIMESTAMP) {
+            writer.writeTimestamp(call->enterTime);
+        }
         for (unsigned i = 0; i < call->args.size(); ++i) {
             if (call->args[i].value) {
                 writer.beginArg(i);
@@ -129,6 +137,9 @@ public:
         }
         writer.endEnter();
         writer.beginLeave(call_no);
+        if (call->leaveTime != Call::NO_TIMESTAMP) {
+            writer.writeTimestamp(call->leaveTime);
+        }
         if (call->ret) {
             writer.beginReturn();
             _visit(call->ret);
@@ -36,6 +36,24 @@ class MetricWriter;
 
 namespace glretrace {
 
+/**
+ * Shader compile or program link status check, deferred so that the driver
+ * can compile several shaders in parallel.
+ */
+struct PendingShaderCheck
+{
+    // Enough of the glCompileShader/glLinkProgram call to rebuild it when
+    // reporting
+    unsigned callNo;
+    unsigned threadId;
+    const trace::FunctionSig *sig;
+    unsigned long long origObject;
+
+    GLuint object;
+    bool program;
+};
+
+
 class Context
 {
 public:
@@ -85,6 +103,9 @@ public:
     bool KHR_debug = false;
     GLsizei maxDebugMessageLength = 0;
 
+    // Status checks pending because of --parallel-compile
+    std::vector<PendingShaderCheck> pendingShaderChecks;
+
     inline glfeatures::Profile
     profile(void) const {
         return wsContext->profile;
@@ -116,7 +137,7 @@ MetricWriter& profiler();
 
 extern glfeatures::Profile defaultProfile;
 
-extern bool supportsARBShaderObjects;
+extern retrace::InstanceLocal<bool> supportsARBShaderObjects;
 
 extern OS_THREAD_LOCAL Context *
 currentContextPtr;
@@ -144,6 +165,13 @@ createDrawable(void);
 glws::Drawable *
 createPbuffer(int width, int height, const glws::pbuffer_info *info);
 
+/**
+ * Release a drawable at the end of a trace.  Window drawables are kept for
+ * reuse by the next trace, when replaying several traces in one process.
+ */
+void
+recycleDrawable(glws::Drawable *drawable);
+
 Context *
 createContext(Context *shareContext, glfeatures::Profile profile);
 
@@ -157,6 +185,12 @@ bool
 makeCurrent(trace::Call &call, glws::Drawable *drawable,
             glws::Drawable *readable, Context *context);
 
+/**
+ * Unbind and release the current context, if any, at the end of a trace.
+ */
+void
+clearCurrentContext(void);
+
 
 void
 checkGlError(trace::Call &call);
@@ -164,6 +198,30 @@ checkGlError(trace::Call &call);
 void
 insertCallMarker(trace::Call &call, Context *currentContext);
 
+void
+deferShaderCheck(trace::Call &call, Context *currentContext, GLuint object, bool program);
+
+/**
+ * Report the compile/link status of the shaders and programs whose checks
+ * were deferred.  This blocks until they are done compiling.
+ */
+void
+flushShaderChecks(Context *currentContext);
+
+static inline void
+flushPendingShaderChecks(Context *currentContext) {
+    if (currentContext && !currentContext->pendingShaderChecks.empty()) {
+        flushShaderChecks(currentContext);
+    }
+}
+
+/**
+ * Report the deferred check of the given shader or program, if any, before
+ * it's compiled or linked again.
+ */
+void
+flushShaderCheck(Context *currentContext, GLuint object, bool program);
+
 
 extern const retrace::Entry gl_callbacks[];
 extern const retrace::Entry cgl_callbacks[];
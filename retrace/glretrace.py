@@ -147,7 +147,7 @@ class GlRetracer(Retracer):
 
         # For backwards compatibility with old traces where non VBO drawing was supported
         if (is_array_pointer or is_draw_arrays or is_draw_elements) and not is_draw_indirect:
-            print '    if (retrace::parser->getVersion() < 1) {'
+            print '    if (retrace::getInstance().parser->getVersion() < 1) {'
 
             if is_array_pointer or is_draw_arrays:
                 print '        GLint _array_buffer = 0;'
@@ -319,6 +319,23 @@ class GlRetracer(Retracer):
             print r'        currentContext->insideList = false;'
             print r'    }'
 
+        # Shaders must be compiled by the time they are used or deleted, so
+        # report any deferred compile/link status checks now
+        if profileDraw or \
+           function.name.startswith('glBeginTransformFeedback') or \
+           function.name in ('glDeleteShader', 'glDeleteProgram', 'glDeleteObjectARB'):
+            print r'    glretrace::flushPendingShaderChecks(currentContext);'
+
+        # Don't let compiling or linking again overwrite a pending status
+        if function.name == 'glCompileShader':
+            print r'    if (retrace::parallelCompile) {'
+            print r'        glretrace::flushShaderCheck(currentContext, shader, false);'
+            print r'    }'
+        if function.name == 'glLinkProgram':
+            print r'    if (retrace::parallelCompile) {'
+            print r'        glretrace::flushShaderCheck(currentContext, program, true);'
+            print r'    }'
+
         if function.name == 'glBegin' or \
            is_draw_arrays or \
            is_draw_elements or \
@@ -426,34 +443,47 @@ class GlRetracer(Retracer):
                 print r'            retrace::warning(call) << "error in position " << error_position << ": " << error_string << "\n";'
                 print r'        }'
             if function.name == 'glCompileShader':
-                print r'        GLint compile_status = 0;'
-                print r'        glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);'
-                print r'        if (!compile_status) {'
-                print r'             retrace::warning(call) << "compilation failed\n";'
-                print r'        }'
-                print r'        GLint info_log_length = 0;'
-                print r'        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);'
-                print r'        if (info_log_length > 1) {'
-                print r'             GLchar *infoLog = new GLchar[info_log_length];'
-                print r'             glGetShaderInfoLog(shader, info_log_length, NULL, infoLog);'
-                print r'             retrace::warning(call) << infoLog << "\n";'
-                print r'             delete [] infoLog;'
+                # Defer the status check, so that the driver doesn't need to
+                # finish compiling right away
+                print r'        if (retrace::parallelCompile) {'
+                print r'            glretrace::deferShaderCheck(call, currentContext, shader, false);'
+                print r'        } else {'
+                print r'            GLint compile_status = 0;'
+                print r'            glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);'
+                print r'            if (!compile_status) {'
+                print r'                 retrace::warning(call) << "compilation failed\n";'
+                print r'            }'
+                print r'            GLint info_log_length = 0;'
+                print r'            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);'
+                print r'            if (info_log_length > 1) {'
+                print r'                 GLchar *infoLog = new GLchar[info_log_length];'
+                print r'                 glGetShaderInfoLog(shader, info_log_length, NULL, infoLog);'
+                print r'                 retrace::warning(call) << infoLog << "\n";'
+                print r'                 delete [] infoLog;'
+                print r'            }'
                 print r'        }'
             if function.name in ('glLinkProgram', 'glCreateShaderProgramv', 'glCreateShaderProgramEXT', 'glCreateShaderProgramvEXT', 'glProgramBinary', 'glProgramBinaryOES'):
                 if function.name.startswith('glCreateShaderProgram'):
                     print r'        GLuint program = _result;'
-                print r'        GLint link_status = 0;'
-                print r'        glGetProgramiv(program, GL_LINK_STATUS, &link_status);'
-                print r'        if (!link_status) {'
-                print r'             retrace::warning(call) << "link failed\n";'
-                print r'        }'
-                print r'        GLint info_log_length = 0;'
-                print r'        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);'
-                print r'        if (info_log_length > 1) {'
-                print r'             GLchar *infoLog = new GLchar[info_log_length];'
-                print r'             glGetProgramInfoLog(program, info_log_length, NULL, infoLog);'
-                print r'             retrace::warning(call) << infoLog << "\n";'
-                print r'             delete [] infoLog;'
+                if function.name == 'glLinkProgram':
+                    print r'        if (retrace::parallelCompile) {'
+                    print r'            glretrace::deferShaderCheck(call, currentContext, program, true);'
+                    print r'        } else {'
+                else:
+                    print r'        {'
+                print r'            GLint link_status = 0;'
+                print r'            glGetProgramiv(program, GL_LINK_STATUS, &link_status);'
+                print r'            if (!link_status) {'
+                print r'                 retrace::warning(call) << "link failed\n";'
+                print r'            }'
+                print r'            GLint info_log_length = 0;'
+                print r'            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);'
+                print r'            if (info_log_length > 1) {'
+                print r'                 GLchar *infoLog = new GLchar[info_log_length];'
+                print r'                 glGetProgramInfoLog(program, info_log_length, NULL, infoLog);'
+                print r'                 retrace::warning(call) << infoLog << "\n";'
+                print r'                 delete [] infoLog;'
+                print r'            }'
                 print r'        }'
             if function.name == 'glCompileShaderARB':
                 print r'        GLint compile_status = 0;'
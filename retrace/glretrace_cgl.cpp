@@ -89,12 +89,12 @@ typedef std::map<unsigned long long, glws::Drawable *> DrawableMap;
 typedef std::map<unsigned long long, Context *> ContextMap;
 
 // sid -> Drawable* map
-static DrawableMap drawable_map;
+static retrace::InstanceLocal<DrawableMap> drawable_map;
 
 // ctx -> Context* map
-static ContextMap context_map;
+static retrace::InstanceLocal<ContextMap> context_map;
 
-static Context *sharedContext = NULL;
+static retrace::InstanceLocal<Context *> sharedContext;
 
 
 struct PixelFormat
@@ -114,8 +114,8 @@ getDrawable(unsigned long drawable_id, glfeatures::Profile profile) {
     }
 
     DrawableMap::const_iterator it;
-    it = drawable_map.find(drawable_id);
-    if (it == drawable_map.end()) {
+    it = drawable_map->find(drawable_id);
+    if (it == drawable_map->end()) {
         return (drawable_map[drawable_id] = glretrace::createDrawable(profile));
     }
 
@@ -130,12 +130,12 @@ getContext(unsigned long long ctx) {
     }
 
     ContextMap::const_iterator it;
-    it = context_map.find(ctx);
-    if (it == context_map.end()) {
+    it = context_map->find(ctx);
+    if (it == context_map->end()) {
         Context *context;
-        context_map[ctx] = context = glretrace::createContext(sharedContext);
-        if (!sharedContext) {
-            sharedContext = context;
+        context_map[ctx] = context = glretrace::createContext(*sharedContext);
+        if (!*sharedContext) {
+            *sharedContext = context;
         }
         return context;
     }
@@ -144,6 +144,25 @@ getContext(unsigned long long ctx) {
 }
 
 
+static void
+resetState(void) {
+    glretrace::clearCurrentContext();
+
+    for (auto & it : *context_map) {
+        it.second->release();
+    }
+    context_map->clear();
+    *sharedContext = NULL;
+
+    for (auto & it : *drawable_map) {
+        glretrace::recycleDrawable(it.second);
+    }
+    drawable_map->clear();
+}
+
+static retrace::ResetHook resetHook(&resetState);
+
+
 static void retrace_CGLChoosePixelFormat(trace::Call &call) {
     if (call.ret->toUInt() != kCGLNoError) {
         return;
@@ -298,14 +317,14 @@ static void retrace_CGLDestroyContext(trace::Call &call) {
     unsigned long long ctx = call.arg(0).toUIntPtr();
 
     ContextMap::iterator it;
-    it = context_map.find(ctx);
-    if (it == context_map.end()) {
+    it = context_map->find(ctx);
+    if (it == context_map->end()) {
         return;
     }
 
     it->second->release();
 
-    context_map.erase(it);
+    context_map->erase(it);
 }
 
 
@@ -48,22 +48,27 @@ using namespace glretrace;
 typedef std::map<unsigned long long, glws::Drawable *> DrawableMap;
 typedef std::map<unsigned long long, Context *> ContextMap;
 typedef std::map<unsigned long long, glfeatures::Profile> ProfileMap;
-static DrawableMap drawable_map;
-static ContextMap context_map;
-static ProfileMap profile_map;
+static retrace::InstanceLocal<DrawableMap> drawable_map;
+static retrace::InstanceLocal<ContextMap> context_map;
+static retrace::InstanceLocal<ProfileMap> profile_map;
 
-/* FIXME: This should be tracked per thread. */
-static unsigned int current_api = EGL_OPENGL_ES_API;
-
-/*
- * FIXME: Ideally we would defer the context creation until the profile was
- * clear, as explained in https://github.com/apitrace/apitrace/issues/197 ,
- * instead of guessing.  For now, start with a guess of ES2 profile, which
- * should be the most common case for EGL.
- */
-static glfeatures::Profile last_profile(glfeatures::API_GLES, 2, 0);
+struct EglState
+{
+    /* FIXME: This should be tracked per thread. */
+    unsigned int current_api = EGL_OPENGL_ES_API;
+
+    /*
+     * FIXME: Ideally we would defer the context creation until the profile was
+     * clear, as explained in https://github.com/apitrace/apitrace/issues/197 ,
+     * instead of guessing.  For now, start with a guess of ES2 profile, which
+     * should be the most common case for EGL.
+     */
+    glfeatures::Profile last_profile = glfeatures::Profile(glfeatures::API_GLES, 2, 0);
+
+    glws::Drawable *null_drawable = NULL;
+};
 
-static glws::Drawable *null_drawable = NULL;
+static retrace::InstanceLocal<EglState> egl;
 
 
 static void
@@ -76,16 +81,16 @@ getDrawable(unsigned long long surface_ptr) {
     }
 
     DrawableMap::const_iterator it;
-    it = drawable_map.find(surface_ptr);
-    if (it == drawable_map.end()) {
+    it = drawable_map->find(surface_ptr);
+    if (it == drawable_map->end()) {
         // In Fennec we get the egl window surface from Java which isn't
         // traced, so just create a drawable if it doesn't exist in here
         createDrawable(0, surface_ptr);
-        it = drawable_map.find(surface_ptr);
-        assert(it != drawable_map.end());
+        it = drawable_map->find(surface_ptr);
+        assert(it != drawable_map->end());
     }
 
-    return (it != drawable_map.end()) ? it->second : NULL;
+    return (it != drawable_map->end()) ? it->second : NULL;
 }
 
 static Context *
@@ -95,23 +100,45 @@ getContext(unsigned long long context_ptr) {
     }
 
     ContextMap::const_iterator it;
-    it = context_map.find(context_ptr);
+    it = context_map->find(context_ptr);
 
-    return (it != context_map.end()) ? it->second : NULL;
+    return (it != context_map->end()) ? it->second : NULL;
 }
 
+static void
+resetState(void) {
+    glretrace::clearCurrentContext();
+
+    for (auto & it : *context_map) {
+        it.second->release();
+    }
+    context_map->clear();
+
+    for (auto & it : *drawable_map) {
+        glretrace::recycleDrawable(it.second);
+    }
+    drawable_map->clear();
+
+    glretrace::recycleDrawable(egl->null_drawable);
+
+    profile_map->clear();
+    *egl = EglState();
+}
+
+static retrace::ResetHook resetHook(&resetState);
+
 static void createDrawable(unsigned long long orig_config, unsigned long long orig_surface)
 {
-    ProfileMap::iterator it = profile_map.find(orig_config);
+    ProfileMap::iterator it = profile_map->find(orig_config);
     glfeatures::Profile profile;
 
     // If the requested config is associated with a profile, use that
     // profile. Otherwise, assume that the last used profile is what
     // the user wants.
-    if (it != profile_map.end()) {
+    if (it != profile_map->end()) {
         profile = it->second;
     } else {
-        profile = last_profile;
+        profile = egl->last_profile;
     }
 
     glws::Drawable *drawable = glretrace::createDrawable(profile);
@@ -170,15 +197,15 @@ static void retrace_eglDestroySurface(trace::Call &call) {
     unsigned long long orig_surface = call.arg(1).toUIntPtr();
 
     DrawableMap::iterator it;
-    it = drawable_map.find(orig_surface);
+    it = drawable_map->find(orig_surface);
 
-    if (it != drawable_map.end()) {
+    if (it != drawable_map->end()) {
         glretrace::Context *currentContext = glretrace::getCurrentContext();
         if (!currentContext || it->second != currentContext->drawable) {
             // TODO: reference count
             delete it->second;
         }
-        drawable_map.erase(it);
+        drawable_map->erase(it);
     }
 }
 
@@ -187,7 +214,7 @@ static void retrace_eglBindAPI(trace::Call &call) {
         return;
     }
 
-    current_api = call.arg(0).toUInt();
+    egl->current_api = call.arg(0).toUInt();
 }
 
 static void retrace_eglCreateContext(trace::Call &call) {
@@ -197,7 +224,7 @@ static void retrace_eglCreateContext(trace::Call &call) {
     trace::Array *attrib_array = call.arg(3).toArray();
     glfeatures::Profile profile;
 
-    switch (current_api) {
+    switch (egl->current_api) {
     case EGL_OPENGL_API:
         profile.api = glfeatures::API_GL;
         profile.major = parseAttrib(attrib_array, EGL_CONTEXT_MAJOR_VERSION, 1);
@@ -227,22 +254,22 @@ static void retrace_eglCreateContext(trace::Call &call) {
 
     context_map[orig_context] = context;
     profile_map[orig_config] = profile;
-    last_profile = profile;
+    egl->last_profile = profile;
 }
 
 static void retrace_eglDestroyContext(trace::Call &call) {
     unsigned long long orig_context = call.arg(1).toUIntPtr();
 
     ContextMap::iterator it;
-    it = context_map.find(orig_context);
+    it = context_map->find(orig_context);
 
-    if (it != context_map.end()) {
+    if (it != context_map->end()) {
         glretrace::Context *currentContext = glretrace::getCurrentContext();
         if (it->second != currentContext) {
             // TODO: reference count
             it->second->release();
         }
-        context_map.erase(it);
+        context_map->erase(it);
     }
 }
 
@@ -258,10 +285,10 @@ static void retrace_eglMakeCurrent(trace::Call &call) {
 
     // Try to support GL_OES_surfaceless_context by creating a dummy drawable.
     if (new_context && !new_drawable) {
-        if (!null_drawable) {
-            null_drawable = glretrace::createDrawable(last_profile);
+        if (!egl->null_drawable) {
+            egl->null_drawable = glretrace::createDrawable(egl->last_profile);
         }
-        new_drawable = null_drawable;
+        new_drawable = egl->null_drawable;
     }
 
     glretrace::makeCurrent(call, new_drawable, new_context);
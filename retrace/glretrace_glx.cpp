@@ -41,8 +41,8 @@ using namespace glretrace;
 
 typedef std::map<unsigned long, glws::Drawable *> DrawableMap;
 typedef std::map<unsigned long long, Context *> ContextMap;
-static DrawableMap drawable_map;
-static ContextMap context_map;
+static retrace::InstanceLocal<DrawableMap> drawable_map;
+static retrace::InstanceLocal<ContextMap> context_map;
 
 
 static glws::Drawable *
@@ -52,8 +52,8 @@ getDrawable(unsigned long drawable_id) {
     }
 
     DrawableMap::const_iterator it;
-    it = drawable_map.find(drawable_id);
-    if (it == drawable_map.end()) {
+    it = drawable_map->find(drawable_id);
+    if (it == drawable_map->end()) {
         return (drawable_map[drawable_id] = glretrace::createDrawable());
     }
 
@@ -67,14 +67,31 @@ getContext(unsigned long long context_ptr) {
     }
 
     ContextMap::const_iterator it;
-    it = context_map.find(context_ptr);
-    if (it == context_map.end()) {
+    it = context_map->find(context_ptr);
+    if (it == context_map->end()) {
         return (context_map[context_ptr] = glretrace::createContext());
     }
 
     return it->second;
 }
 
+static void
+resetState(void) {
+    glretrace::clearCurrentContext();
+
+    for (auto & it : *context_map) {
+        it.second->release();
+    }
+    context_map->clear();
+
+    for (auto & it : *drawable_map) {
+        glretrace::recycleDrawable(it.second);
+    }
+    drawable_map->clear();
+}
+
+static retrace::ResetHook resetHook(&resetState);
+
 static void retrace_glXCreateContext(trace::Call &call) {
     unsigned long long orig_context = call.ret->toUIntPtr();
     if (!orig_context) {
@@ -118,14 +135,14 @@ static void retrace_glXMakeCurrent(trace::Call &call) {
 
 static void retrace_glXDestroyContext(trace::Call &call) {
     ContextMap::iterator it;
-    it = context_map.find(call.arg(1).toUIntPtr());
-    if (it == context_map.end()) {
+    it = context_map->find(call.arg(1).toUIntPtr());
+    if (it == context_map->end()) {
         return;
     }
 
     it->second->release();
 
-    context_map.erase(it);
+    context_map->erase(it);
 }
 
 static void retrace_glXCopySubBufferMESA(trace::Call &call) {
@@ -185,13 +202,15 @@ static void retrace_glXCreatePbuffer(trace::Call &call) {
 }
 
 static void retrace_glXDestroyPbuffer(trace::Call &call) {
-    glws::Drawable *drawable = getDrawable(call.arg(1).toUInt());
-
-    if (!drawable) {
+    DrawableMap::iterator it;
+    it = drawable_map->find(call.arg(1).toUInt());
+    if (it == drawable_map->end()) {
         return;
     }
 
-    delete drawable;
+    delete it->second;
+
+    drawable_map->erase(it);
 }
 
 static void retrace_glXMakeContextCurrent(trace::Call &call) {
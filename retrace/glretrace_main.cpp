@@ -52,7 +52,7 @@ namespace glretrace {
 
 glfeatures::Profile defaultProfile(glfeatures::API_GL, 1, 0);
 
-bool supportsARBShaderObjects = false;
+retrace::InstanceLocal<bool> supportsARBShaderObjects;
 
 enum {
     GPU_START = 0,
@@ -76,11 +76,33 @@ struct CallQuery
     int64_t rssEnd;
 };
 
-static bool supportsElapsed = true;
-static bool supportsTimestamp = true;
-static bool supportsOcclusion = true;
+/*
+ * Profiling queries, and the timer and occlusion query support of the last
+ * context made current, for each instance.
+ */
+struct QueryState
+{
+    bool supportsElapsed = true;
+    bool supportsTimestamp = true;
+    bool supportsOcclusion = true;
+
+    std::list<CallQuery> callQueries;
+};
+
+static retrace::InstanceLocal<QueryState> queryState;
+
 
-static std::list<CallQuery> callQueries;
+/*
+ * Forget about the queries and features of the previous trace's contexts,
+ * which are gone by now.
+ */
+static void
+resetQueries(void) {
+    *queryState = QueryState();
+    *supportsARBShaderObjects = false;
+}
+
+static retrace::ResetHook resetQueriesHook(&resetQueries);
 
 static void APIENTRY
 debugOutputCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam);
@@ -90,7 +112,7 @@ debugOutputCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsi
 static const unsigned
 maxWarningCount = 100;
 
-static std::map< uint64_t, unsigned > errorCounts;
+static retrace::InstanceLocal< std::map< uint64_t, unsigned > > errorCounts;
 
 void
 checkGlError(trace::Call &call) {
@@ -184,7 +206,7 @@ insertCallMarker(trace::Call &call, Context *currentContext)
 
 static inline int64_t
 getCurrentTime(void) {
-    if (retrace::profilingGpuTimes && supportsTimestamp) {
+    if (retrace::profilingGpuTimes && queryState->supportsTimestamp) {
         /* Get the current GL time without stalling */
         GLint64 timestamp = 0;
         glGetInteger64v(GL_TIMESTAMP, &timestamp);
@@ -196,7 +218,7 @@ getCurrentTime(void) {
 
 static inline int64_t
 getTimeFrequency(void) {
-    if (retrace::profilingGpuTimes && supportsTimestamp) {
+    if (retrace::profilingGpuTimes && queryState->supportsTimestamp) {
         return 1000000000;
     } else {
         return os::timeFrequency;
@@ -220,7 +242,7 @@ completeCallQuery(CallQuery& query) {
 
     if (query.isDraw) {
         if (retrace::profilingGpuTimes) {
-            if (supportsTimestamp) {
+            if (queryState->supportsTimestamp) {
                 /* Use ARB queries in case EXT not present */
                 glGetQueryObjecti64v(query.ids[GPU_START], GL_QUERY_RESULT, &gpuStart);
                 glGetQueryObjecti64v(query.ids[GPU_DURATION], GL_QUERY_RESULT, &gpuDuration);
@@ -230,9 +252,9 @@ completeCallQuery(CallQuery& query) {
         }
 
         if (retrace::profilingPixelsDrawn) {
-            if (supportsTimestamp) {
+            if (queryState->supportsTimestamp) {
                 glGetQueryObjecti64v(query.ids[OCCLUSION], GL_QUERY_RESULT, &pixels);
-            } else if (supportsElapsed) {
+            } else if (queryState->supportsElapsed) {
                 glGetQueryObjecti64vEXT(query.ids[OCCLUSION], GL_QUERY_RESULT, &pixels);
             } else {
                 uint32_t pixels32;
@@ -264,11 +286,11 @@ completeCallQuery(CallQuery& query) {
 
 void
 flushQueries() {
-    for (auto & callQuerie : callQueries) {
+    for (auto & callQuerie : queryState->callQueries) {
         completeCallQuery(callQuerie);
     }
 
-    callQueries.clear();
+    queryState->callQueries.clear();
 }
 
 void
@@ -313,7 +335,7 @@ beginProfile(trace::Call &call, bool isDraw) {
     /* GPU profiling only for draw calls */
     if (isDraw) {
         if (retrace::profilingGpuTimes) {
-            if (supportsTimestamp) {
+            if (queryState->supportsTimestamp) {
                 glQueryCounter(query.ids[GPU_START], GL_TIMESTAMP);
             }
 
@@ -325,16 +347,16 @@ beginProfile(trace::Call &call, bool isDraw) {
         }
     }
 
-    callQueries.push_back(query);
+    queryState->callQueries.push_back(query);
 
     /* CPU profiling for all calls */
     if (retrace::profilingCpuTimes) {
-        CallQuery& query = callQueries.back();
+        CallQuery& query = queryState->callQueries.back();
         query.cpuStart = getCurrentTime();
     }
 
     if (retrace::profilingMemoryUsage) {
-        CallQuery& query = callQueries.back();
+        CallQuery& query = queryState->callQueries.back();
         query.vsizeStart = os::getVsize();
         query.rssStart = os::getRss();
     }
@@ -354,7 +376,7 @@ endProfile(trace::Call &call, bool isDraw) {
 
     /* CPU profiling for all calls */
     if (retrace::profilingCpuTimes) {
-        CallQuery& query = callQueries.back();
+        CallQuery& query = queryState->callQueries.back();
         query.cpuEnd = getCurrentTime();
     }
 
@@ -370,7 +392,7 @@ endProfile(trace::Call &call, bool isDraw) {
     }
 
     if (retrace::profilingMemoryUsage) {
-        CallQuery& query = callQueries.back();
+        CallQuery& query = queryState->callQueries.back();
         query.vsizeEnd = os::getVsize();
         query.rssEnd = os::getRss();
     }
@@ -438,11 +460,17 @@ initContext() {
 
     /* Ensure we have adequate extension support */
     glfeatures::Profile currentProfile = currentContext->actualProfile();
-    supportsTimestamp   = currentProfile.versionGreaterOrEqual(glfeatures::API_GL, 3, 3) ||
-                          currentContext->hasExtension("GL_ARB_timer_query");
-    supportsElapsed     = currentContext->hasExtension("GL_EXT_timer_query") || supportsTimestamp;
-    supportsOcclusion   = currentProfile.versionGreaterOrEqual(glfeatures::API_GL, 1, 5);
-    supportsARBShaderObjects = currentContext->hasExtension("GL_ARB_shader_objects");
+    queryState->supportsTimestamp   = currentProfile.versionGreaterOrEqual(glfeatures::API_GL, 3, 3) ||
+                                      currentContext->hasExtension("GL_ARB_timer_query");
+    queryState->supportsElapsed     = currentContext->hasExtension("GL_EXT_timer_query") || queryState->supportsTimestamp;
+    queryState->supportsOcclusion   = currentProfile.versionGreaterOrEqual(glfeatures::API_GL, 1, 5);
+    *supportsARBShaderObjects = currentContext->hasExtension("GL_ARB_shader_objects");
+
+    if (retrace::parallelCompile &&
+        currentContext->hasExtension("GL_ARB_parallel_shader_compile")) {
+        // Use as many compiler threads as the implementation sees fit
+        glMaxShaderCompilerThreadsARB(0xffffffff);
+    }
 
     currentContext->KHR_debug = currentContext->hasExtension("GL_KHR_debug");
     if (currentContext->KHR_debug) {
@@ -453,12 +481,12 @@ initContext() {
 #ifdef __APPLE__
     // GL_TIMESTAMP doesn't work on Apple.  GL_TIME_ELAPSED still does however.
     // http://lists.apple.com/archives/mac-opengl/2014/Nov/threads.html#00001
-    supportsTimestamp   = false;
+    queryState->supportsTimestamp   = false;
 #endif
 
     /* Check for timer query support */
     if (retrace::profilingGpuTimes) {
-        if (!supportsTimestamp && !supportsElapsed) {
+        if (!queryState->supportsTimestamp && !queryState->supportsElapsed) {
             std::cout << "error: cannot profile, GL_ARB_timer_query or GL_EXT_timer_query extensions are not supported." << std::endl;
             exit(-1);
         }
@@ -473,7 +501,7 @@ initContext() {
     }
 
     /* Check for occlusion query support */
-    if (retrace::profilingPixelsDrawn && !supportsOcclusion) {
+    if (retrace::profilingPixelsDrawn && !queryState->supportsOcclusion) {
         std::cout << "error: cannot profile, GL_ARB_occlusion_query extension is not supported (" << currentProfile << ")" << std::endl;
         exit(-1);
     }
@@ -521,6 +549,86 @@ initContext() {
     }
 }
 
+void
+deferShaderCheck(trace::Call &call, Context *currentContext, GLuint object, bool program) {
+    assert(call.sig->num_args == 1);
+    PendingShaderCheck check;
+    check.callNo = call.no;
+    check.threadId = call.thread_id;
+    check.sig = call.sig;
+    check.origObject = call.arg(0).toUInt();
+    check.object = object;
+    check.program = program;
+    currentContext->pendingShaderChecks.push_back(check);
+}
+
+
+static void
+reportShaderCheck(const PendingShaderCheck &check) {
+    GLint status = 0;
+    GLint info_log_length = 0;
+    if (check.program) {
+        glGetProgramiv(check.object, GL_LINK_STATUS, &status);
+        glGetProgramiv(check.object, GL_INFO_LOG_LENGTH, &info_log_length);
+    } else {
+        glGetShaderiv(check.object, GL_COMPILE_STATUS, &status);
+        glGetShaderiv(check.object, GL_INFO_LOG_LENGTH, &info_log_length);
+    }
+
+    if (status && info_log_length <= 1) {
+        return;
+    }
+
+    trace::Call call(check.sig, 0, check.threadId);
+    call.no = check.callNo;
+    call.args[0].value = new trace::UInt(check.origObject);
+
+    if (!status) {
+        retrace::warning(call) << (check.program ? "link" : "compilation") << " failed\n";
+    }
+
+    if (info_log_length > 1) {
+        GLchar *infoLog = new GLchar[info_log_length];
+        if (check.program) {
+            glGetProgramInfoLog(check.object, info_log_length, NULL, infoLog);
+        } else {
+            glGetShaderInfoLog(check.object, info_log_length, NULL, infoLog);
+        }
+        retrace::warning(call) << infoLog << "\n";
+        delete [] infoLog;
+    }
+}
+
+
+void
+flushShaderChecks(Context *currentContext) {
+    std::vector<PendingShaderCheck> checks;
+    checks.swap(currentContext->pendingShaderChecks);
+
+    for (auto & check : checks) {
+        reportShaderCheck(check);
+    }
+}
+
+
+void
+flushShaderCheck(Context *currentContext, GLuint object, bool program) {
+    if (!currentContext) {
+        return;
+    }
+
+    auto &checks = currentContext->pendingShaderChecks;
+    for (auto it = checks.begin(); it != checks.end(); ++it) {
+        if (it->object == object && it->program == program) {
+            PendingShaderCheck check = *it;
+            checks.erase(it);
+            reportShaderCheck(check);
+            return;
+        }
+    }
+}
+
+
 void
 frame_complete(trace::Call &call) {
     if (retrace::profilingWithBackends) {
@@ -547,6 +655,10 @@ frame_complete(trace::Call &call) {
                         profilingBoundariesIndex[QUERY_BOUNDARY_FRAME]++);
             }
         }
+        // write out whatever the backends have finished so far
+        if (isLastPass() && curMetricBackend) {
+            profiler().flush();
+        }
     }
     else if (retrace::profiling) {
         /* Complete any remaining queries */
@@ -563,6 +675,8 @@ frame_complete(trace::Call &call) {
         return;
     }
 
+    flushPendingShaderChecks(currentContext);
+
     glws::Drawable *currentDrawable = currentContext->drawable;
     assert(currentDrawable);
     if (retrace::debug &&
@@ -648,7 +762,15 @@ afterContextSwitch()
 }
 
 
-static std::map< uint64_t, unsigned > messageCounts;
+static retrace::InstanceLocal< std::map< uint64_t, unsigned > > messageCounts;
+
+static void
+resetWarningCounts(void) {
+    errorCounts->clear();
+    messageCounts->clear();
+}
+
+static retrace::ResetHook resetWarningCountsHook(&resetWarningCounts);
 
 
 static void APIENTRY
@@ -765,7 +887,7 @@ debugOutputCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
         break;
     }
 
-    std::cerr << *color << retrace::callNo << ": message:" << severityStr << sourceStr << typeStr;
+    std::cerr << *color << retrace::getInstance().callNo << ": message:" << severityStr << sourceStr << typeStr;
 
     if (id) {
         std::cerr << " " << id;
@@ -885,6 +1007,7 @@ retrace::finishRendering(void) {
 
     glretrace::Context *currentContext = glretrace::getCurrentContext();
     if (currentContext) {
+        glretrace::flushPendingShaderChecks(currentContext);
         glFinish();
     }
 
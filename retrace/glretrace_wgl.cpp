@@ -24,6 +24,8 @@
  **************************************************************************/
 
 
+#include <set>
+
 #include "glretrace_wgl.hpp"
 
 #include "glproc.hpp"
@@ -36,9 +38,9 @@ using namespace glretrace;
 
 typedef std::map<unsigned long long, glws::Drawable *> DrawableMap;
 typedef std::map<unsigned long long, Context *> ContextMap;
-static DrawableMap drawable_map;
-static DrawableMap pbuffer_map;
-static ContextMap context_map;
+static retrace::InstanceLocal<DrawableMap> drawable_map;
+static retrace::InstanceLocal<DrawableMap> pbuffer_map;
+static retrace::InstanceLocal<ContextMap> context_map;
 
 
 static glws::Drawable *
@@ -48,8 +50,8 @@ getDrawable(unsigned long long hdc) {
     }
 
     DrawableMap::const_iterator it;
-    it = drawable_map.find(hdc);
-    if (it == drawable_map.end()) {
+    it = drawable_map->find(hdc);
+    if (it == drawable_map->end()) {
         return (drawable_map[hdc] = glretrace::createDrawable());
     }
 
@@ -63,8 +65,8 @@ getContext(unsigned long long context_ptr) {
     }
 
     ContextMap::const_iterator it;
-    it = context_map.find(context_ptr);
-    if (it == context_map.end()) {
+    it = context_map->find(context_ptr);
+    if (it == context_map->end()) {
         assert(false);
         return NULL;
     }
@@ -72,6 +74,32 @@ getContext(unsigned long long context_ptr) {
     return it->second;
 }
 
+static void
+resetState(void) {
+    glretrace::clearCurrentContext();
+
+    for (auto & it : *context_map) {
+        it.second->release();
+    }
+    context_map->clear();
+
+    // Pbuffer DCs alias the respective pbuffers
+    std::set<glws::Drawable *> drawables;
+    for (auto & it : *drawable_map) {
+        drawables.insert(it.second);
+    }
+    for (auto & it : *pbuffer_map) {
+        drawables.insert(it.second);
+    }
+    for (auto drawable : drawables) {
+        glretrace::recycleDrawable(drawable);
+    }
+    drawable_map->clear();
+    pbuffer_map->clear();
+}
+
+static retrace::ResetHook resetHook(&resetState);
+
 static void retrace_wglCreateContext(trace::Call &call) {
     unsigned long long orig_context = call.ret->toUIntPtr();
     if (!orig_context) {
@@ -86,14 +114,14 @@ static void retrace_wglDeleteContext(trace::Call &call) {
     unsigned long long hglrc = call.arg(0).toUIntPtr();
 
     ContextMap::iterator it;
-    it = context_map.find(hglrc);
-    if (it == context_map.end()) {
+    it = context_map->find(hglrc);
+    if (it == context_map->end()) {
         return;
     }
 
     it->second->release();
     
-    context_map.erase(it);
+    context_map->erase(it);
 }
 
 static void retrace_wglMakeCurrent(trace::Call &call) {
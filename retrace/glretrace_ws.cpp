@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <map>
+#include <vector>
 
 #include "os_thread.hpp"
 #include "retrace.hpp"
@@ -44,12 +45,20 @@
 namespace glretrace {
 
 
+/*
+ * Visuals and pooled drawables are shared by all replay instances.
+ */
+static os::mutex
+visualsMutex;
+
+
 static std::map<glfeatures::Profile, glws::Visual *>
 visuals;
 
 
 inline glws::Visual *
 getVisual(glfeatures::Profile profile) {
+    os::unique_lock<os::mutex> lock(visualsMutex);
     std::map<glfeatures::Profile, glws::Visual *>::iterator it = visuals.find(profile);
     if (it == visuals.end()) {
         glws::Visual *visual = NULL;
@@ -75,10 +84,51 @@ getVisual(glfeatures::Profile profile) {
 }
 
 
+/*
+ * Window drawables released by previous traces.
+ */
+static std::vector<glws::Drawable *>
+drawablePool;
+
+
+void
+recycleDrawable(glws::Drawable *drawable) {
+    if (!drawable) {
+        return;
+    }
+    if (drawable->pbuffer) {
+        delete drawable;
+        return;
+    }
+    os::unique_lock<os::mutex> lock(visualsMutex);
+    if (std::find(drawablePool.begin(), drawablePool.end(), drawable) == drawablePool.end()) {
+        drawablePool.push_back(drawable);
+    }
+}
+
+
 static glws::Drawable *
 createDrawableHelper(glfeatures::Profile profile, int width = 32, int height = 32,
                      const glws::pbuffer_info *pbInfo = NULL) {
     glws::Visual *visual = getVisual(profile);
+
+    if (!pbInfo) {
+        glws::Drawable *draw = NULL;
+        visualsMutex.lock();
+        for (auto it = drawablePool.begin(); it != drawablePool.end(); ++it) {
+            if ((*it)->visual == visual) {
+                draw = *it;
+                drawablePool.erase(it);
+                break;
+            }
+        }
+        visualsMutex.unlock();
+        if (draw) {
+            draw->resize(width, height);
+            return draw;
+        }
+    }
+
     glws::Drawable *draw = glws::createDrawable(visual, width, height, pbInfo);
     if (!draw) {
         std::cerr << "error: failed to create OpenGL drawable\n";
@@ -170,6 +220,7 @@ makeCurrent(trace::Call &call, glws::Drawable *drawable,
     }
 
     if (currentContext) {
+        flushPendingShaderChecks(currentContext);
         glFlush();
         currentContext->needsFlush = false;
         if (!retrace::doubleBuffer) {
@@ -214,6 +265,20 @@ makeCurrent(trace::Call &call, glws::Drawable *drawable,
 }
 
 
+void
+clearCurrentContext(void)
+{
+    Context *currentContext = currentContextPtr;
+    if (!currentContext) {
+        return;
+    }
+
+    glws::makeCurrent(NULL, NULL, NULL);
+    currentContextPtr = NULL;
+    currentContext->release();
+}
+
+
 /**
  * Grow the current drawable.
  *
@@ -660,15 +660,20 @@ class StateDumper:
         print '            }'
 
     def dump_atoms(self, getter, *args):
+        # Errors are drained once for the whole group.  Each query leaves no
+        # pending error behind (a failing one is flushed right away), so the
+        # individual atoms don't need to flush before querying.
+        print '        flushErrors();'
         for _, _, name in getter.iter():
-            self.dump_atom(getter, *(args + (name,)))
+            self.dump_atom(getter, *(args + (name,)), flush=False)
 
-    def dump_atom(self, getter, *args):
+    def dump_atom(self, getter, *args, **kwargs):
         name = args[getter.pnameIdx]
 
         print '        // %s' % name
         print '        {'
-        print '            flushErrors();'
+        if kwargs.get('flush', True):
+            print '            flushErrors();'
         type, value = getter(*args)
         print '            if (glGetError() != GL_NO_ERROR) {'
         #print '                std::cerr << "warning: %s(%s) failed\\n";' % (inflection, name)
@@ -382,85 +382,255 @@ dumpAttribArray(StateWriter &writer,
 
 
 /**
- * Dump an uniform that belows to an uniform block.
+ * Metadata of an active uniform.
  */
-static void
-dumpUniformBlock(StateWriter &writer,
-                 GLint program,
-                 GLint size,
-                 GLenum type,
-                 const GLchar *name,
-                 GLuint index,
-                 GLuint block_index)
+struct UniformInfo
 {
-
+    std::string name;
+    GLint size = 0;
+    GLenum type = GL_NONE;
+    GLint location = -1;
+    GLint blockIndex = -1;
     GLint offset = 0;
-    GLint array_stride = 0;
-    GLint matrix_stride = 0;
-    GLint is_row_major = GL_FALSE;
-    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
-    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &array_stride);
-    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &matrix_stride);
-    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_IS_ROW_MAJOR, &is_row_major);
-
-    GLint slot = -1;
-    glGetActiveUniformBlockiv(program, block_index, GL_UNIFORM_BLOCK_BINDING, &slot);
-    if (slot == -1) {
+    GLint arrayStride = 0;
+    GLint matrixStride = 0;
+    GLint isRowMajor = GL_FALSE;
+};
+
+
+/**
+ * Get the metadata of all active uniforms of a program.
+ *
+ * With program interface queries every uniform is described by a single
+ * call.  Otherwise the uniform block layouts are fetched for all uniforms
+ * at once, and only if there are uniforms outside the default block.
+ */
+static void
+getProgramUniforms(Context &context, GLint program, std::vector<UniformInfo> &uniforms)
+{
+    GLint active_uniforms = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &active_uniforms);
+    if (active_uniforms <= 0) {
         return;
     }
 
-    AttribDesc desc(type, size, array_stride, matrix_stride, is_row_major);
-    if (!desc) {
+    uniforms.resize(active_uniforms);
+
+    if (context.ARB_program_interface_query) {
+        static const GLenum props[] = {
+            GL_NAME_LENGTH,
+            GL_TYPE,
+            GL_ARRAY_SIZE,
+            GL_LOCATION,
+            GL_BLOCK_INDEX,
+            GL_OFFSET,
+            GL_ARRAY_STRIDE,
+            GL_MATRIX_STRIDE,
+            GL_IS_ROW_MAJOR,
+        };
+        static const GLsizei numProps = sizeof props / sizeof props[0];
+
+        std::vector<GLchar> name;
+        for (GLuint index = 0; (GLint)index < active_uniforms; ++index) {
+            GLint values[numProps];
+            memset(values, 0, sizeof values);
+            glGetProgramResourceiv(program, GL_UNIFORM, index, numProps, props, numProps, NULL, values);
+
+            UniformInfo &uniform = uniforms[index];
+            uniform.type = values[1];
+            uniform.size = values[2];
+            uniform.location = values[3];
+            uniform.blockIndex = values[4];
+            uniform.offset = values[5];
+            uniform.arrayStride = values[6];
+            uniform.matrixStride = values[7];
+            uniform.isRowMajor = values[8];
+
+            name.resize(std::max(values[0], 1));
+            name[0] = 0;
+            glGetProgramResourceName(program, GL_UNIFORM, index, name.size(), NULL, name.data());
+            uniform.name = name.data();
+        }
         return;
     }
 
-    if (0) {
-        GLint active_uniform_block_max_name_length = 0;
-        glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &active_uniform_block_max_name_length);
-
-        GLchar* block_name = new GLchar[active_uniform_block_max_name_length];
+    GLint active_uniform_max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &active_uniform_max_length);
+    std::vector<GLchar> name(std::max(active_uniform_max_length, 1));
 
-        GLint block_data_size = 0;
-        glGetActiveUniformBlockiv(program, block_index, GL_UNIFORM_BLOCK_DATA_SIZE, &block_data_size);
+    bool blockUniforms = false;
+    for (GLuint index = 0; (GLint)index < active_uniforms; ++index) {
+        UniformInfo &uniform = uniforms[index];
 
         GLsizei length = 0;
-        glGetActiveUniformBlockName(program, block_index, active_uniform_block_max_name_length, &length, block_name);
+        name[0] = 0;
+        glGetActiveUniform(program, index, name.size(), &length, &uniform.size, &uniform.type, name.data());
+        uniform.name = name.data();
+
+        if (isBuiltinName(name.data())) {
+            continue;
+        }
+
+        uniform.location = glGetUniformLocation(program, name.data());
+        if (uniform.location == -1) {
+            blockUniforms = true;
+        }
+    }
 
-        std::cerr
-            << "uniform `" << name << "`, size " << size << ", type " << enumToString(desc.type) << "\n"
-            << "  block " << block_index << ", name `" << block_name << "`, size " << block_data_size << "; binding " << slot << "; \n"
-            << "  offset " << offset << ", array stride " << array_stride << ", matrix stride " << matrix_stride << ", row_major " << is_row_major << "\n"
-        ;
+    if (blockUniforms) {
+        std::vector<GLuint> indices(active_uniforms);
+        for (GLint index = 0; index < active_uniforms; ++index) {
+            indices[index] = index;
+        }
 
-        delete [] block_name;
+        std::vector<GLint> values(active_uniforms);
+
+        struct {
+            GLenum pname;
+            GLint UniformInfo::*member;
+        } const blockProps[] = {
+            { GL_UNIFORM_BLOCK_INDEX, &UniformInfo::blockIndex },
+            { GL_UNIFORM_OFFSET, &UniformInfo::offset },
+            { GL_UNIFORM_ARRAY_STRIDE, &UniformInfo::arrayStride },
+            { GL_UNIFORM_MATRIX_STRIDE, &UniformInfo::matrixStride },
+            { GL_UNIFORM_IS_ROW_MAJOR, &UniformInfo::isRowMajor },
+        };
+        for (auto &prop : blockProps) {
+            std::fill(values.begin(), values.end(), prop.pname == GL_UNIFORM_BLOCK_INDEX ? -1 : 0);
+            glGetActiveUniformsiv(program, active_uniforms, indices.data(), prop.pname, values.data());
+            for (GLint index = 0; index < active_uniforms; ++index) {
+                uniforms[index].*prop.member = values[index];
+            }
+        }
     }
+}
+
+
+/**
+ * Uniform buffers of a program, mapped once for all its uniforms.
+ */
+class UniformBlocks
+{
+    struct Block
+    {
+        bool resolved = false;
+        GLint slot = -1;
+        GLint ubo = 0;
+        GLint start = 0;
+    };
+
+    GLint program;
+    std::map<GLint, Block> blocks;
+    std::map<GLint, BufferMapping> mappings;
+
+public:
+    UniformBlocks(GLint _program) :
+        program(_program)
+    {}
 
-    GLint ubo = 0;
-    glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, slot, &ubo);
-    GLint start = 0;
-    glGetIntegeri_v(GL_UNIFORM_BUFFER_START, slot, &start);
+    /**
+     * Get the data of a block, or NULL if its binding isn't usable.
+     */
+    const GLbyte *
+    map(GLint block_index)
+    {
+        Block &block = blocks[block_index];
+        if (!block.resolved) {
+            block.resolved = true;
+            glGetActiveUniformBlockiv(program, block_index, GL_UNIFORM_BLOCK_BINDING, &block.slot);
+            if (block.slot != -1) {
+                glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, block.slot, &block.ubo);
+                glGetIntegeri_v(GL_UNIFORM_BUFFER_START, block.slot, &block.start);
+                if (!block.ubo) {
+                    std::cerr << "Uniform buffer object not bound.\n";
+                }
+            }
+        }
 
-    /* If ubo is zero, don't try to map to a 0 bound buffer. */
-    if (ubo) {
-        BufferMapping mapping;
-        const GLbyte *raw_data = (const GLbyte *)mapping.map(GL_UNIFORM_BUFFER, ubo);
-        if (raw_data) {
-            std::string qualifiedName = resolveUniformName(name, size);
+        /* If ubo is zero, don't try to map to a 0 bound buffer. */
+        if (block.slot == -1 || !block.ubo) {
+            return NULL;
+        }
 
-            dumpAttribArray(writer, qualifiedName, desc, raw_data + start + offset);
+        const GLbyte *raw_data = (const GLbyte *)mappings[block.ubo].map(GL_UNIFORM_BUFFER, block.ubo);
+        if (!raw_data) {
+            return NULL;
         }
+
+        return raw_data + block.start;
     }
-    else {
-        std::cerr << "Uniform buffer object not bound.\n";
+};
+
+
+/**
+ * Dump an uniform that belows to an uniform block.
+ */
+static void
+dumpUniformBlock(StateWriter &writer,
+                 UniformBlocks &blocks,
+                 const UniformInfo &uniform)
+{
+    AttribDesc desc(uniform.type, uniform.size, uniform.arrayStride, uniform.matrixStride, uniform.isRowMajor);
+    if (!desc) {
+        return;
+    }
+
+    const GLbyte *block_data = blocks.map(uniform.blockIndex);
+    if (block_data) {
+        std::string qualifiedName = resolveUniformName(uniform.name.c_str(), uniform.size);
+
+        dumpAttribArray(writer, qualifiedName, desc, block_data + uniform.offset);
     }
 }
 
 
+/**
+ * Get the locations of all elements of an uniform array.
+ *
+ * Array elements are normally assigned consecutive locations (and must be,
+ * for explicit locations), so when the last element is where it's expected
+ * to be, that's taken for granted instead of looking up every element.
+ */
+static void
+getUniformLocations(Context &context,
+                    GLint program,
+                    const std::string &qualifiedName,
+                    const UniformInfo &uniform,
+                    std::vector<GLint> &locations)
+{
+    locations.resize(uniform.size);
+    if (uniform.size == 1) {
+        locations[0] = uniform.location;
+        return;
+    }
+
+    std::stringstream ss;
+    ss << qualifiedName << '[' << uniform.size - 1 << ']';
+    GLint last = glGetUniformLocation(program, ss.str().c_str());
+
+    if (context.ARB_program_interface_query &&
+        last == uniform.location + uniform.size - 1) {
+        for (GLint i = 0; i < uniform.size; ++i) {
+            locations[i] = uniform.location + i;
+        }
+        return;
+    }
+
+    for (GLint i = 0; i < uniform.size - 1; ++i) {
+        std::stringstream ss;
+        ss << qualifiedName << '[' << i << ']';
+        locations[i] = glGetUniformLocation(program, ss.str().c_str());
+    }
+    locations[uniform.size - 1] = last;
+}
+
+
 static void
 dumpUniform(StateWriter &writer,
+            Context &context,
             GLint program,
             const AttribDesc & desc,
-            const GLchar *name)
+            const UniformInfo &uniform)
 {
     if (desc.elemType == GL_NONE) {
         return;
@@ -478,7 +648,10 @@ dumpUniform(StateWriter &writer,
 
     GLint i;
 
-    std::string qualifiedName = resolveUniformName(name, desc.size);
+    std::string qualifiedName = resolveUniformName(uniform.name.c_str(), desc.size);
+
+    std::vector<GLint> locations;
+    getUniformLocations(context, program, qualifiedName, uniform, locations);
 
     writer.beginMember(qualifiedName);
     if (desc.size > 1) {
@@ -486,14 +659,7 @@ dumpUniform(StateWriter &writer,
     }
 
     for (i = 0; i < desc.size; ++i) {
-        std::stringstream ss;
-        ss << qualifiedName;
-        if (desc.size > 1) {
-            ss << '[' << i << ']';
-        }
-        std::string elemName = ss.str();
-
-        GLint location = glGetUniformLocation(program, elemName.c_str());
+        GLint location = locations[i];
         assert(location != -1);
         if (location == -1) {
             continue;
@@ -538,42 +704,26 @@ dumpUniform(StateWriter &writer,
 
 
 static inline void
-dumpProgramUniforms(StateWriter &writer, GLint program)
+dumpProgramUniforms(StateWriter &writer, Context &context, GLint program)
 {
-    GLint active_uniforms = 0;
-    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &active_uniforms);
-    if (!active_uniforms) {
-        return;
-    }
+    std::vector<UniformInfo> uniforms;
+    getProgramUniforms(context, program, uniforms);
 
-    GLint active_uniform_max_length = 0;
-    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &active_uniform_max_length);
-    GLchar *name = new GLchar[active_uniform_max_length];
-    if (!name) {
-        return;
-    }
+    UniformBlocks blocks(program);
 
-    for (GLuint index = 0; (GLint)index < active_uniforms; ++index) {
-        GLsizei length = 0;
-        GLint size = 0;
-        GLenum type = GL_NONE;
-        glGetActiveUniform(program, index, active_uniform_max_length, &length, &size, &type, name);
-
-        if (isBuiltinName(name)) {
+    for (const UniformInfo &uniform : uniforms) {
+        if (isBuiltinName(uniform.name.c_str())) {
             continue;
         }
 
-        GLint location = glGetUniformLocation(program, name);
-        if (location != -1) {
-            AttribDesc desc(type, size);
-            dumpUniform(writer, program, desc, name);
+        if (uniform.location != -1) {
+            AttribDesc desc(uniform.type, uniform.size);
+            dumpUniform(writer, context, program, desc, uniform);
             continue;
         }
 
-        GLint block_index = -1;
-        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block_index);
-        if (block_index != -1) {
-            dumpUniformBlock(writer, program, size, type, name, index, block_index);
+        if (uniform.blockIndex != -1) {
+            dumpUniformBlock(writer, blocks, uniform);
             continue;
         }
 
@@ -582,8 +732,6 @@ dumpProgramUniforms(StateWriter &writer, GLint program)
          * on an inactive uniform block.  So just ingnore that.
          */
     }
-
-    delete [] name;
 }
 
 
@@ -844,7 +992,7 @@ dumpArbProgramUniforms(StateWriter &writer, Context &context, GLenum target, con
 }
 
 static void
-dumpProgramUniformsStage(StateWriter &writer, GLint program, const char *stage)
+dumpProgramUniformsStage(StateWriter &writer, Context &context, GLint program, const char *stage)
 {
     if (program <= 0) {
         return;
@@ -852,7 +1000,7 @@ dumpProgramUniformsStage(StateWriter &writer, GLint program, const char *stage)
 
     writer.beginMember(stage);
     writer.beginObject();
-    dumpProgramUniforms(writer, program);
+    dumpProgramUniforms(writer, context, program);
     writer.endObject();
     writer.endMember();
 }
@@ -1182,14 +1330,14 @@ dumpShadersUniforms(StateWriter &writer, Context &context)
     writer.beginMember("uniforms");
     writer.beginObject();
     if (pipeline) {
-        dumpProgramUniformsStage(writer, vertex_program, "GL_VERTEX_SHADER");
-        dumpProgramUniformsStage(writer, fragment_program, "GL_FRAGMENT_SHADER");
-        dumpProgramUniformsStage(writer, geometry_program, "GL_GEOMETRY_SHADER");
-        dumpProgramUniformsStage(writer, tess_control_program, "GL_TESS_CONTROL_SHADER");
-        dumpProgramUniformsStage(writer, tess_evaluation_program, "GL_TESS_EVALUATION_SHADER");
-        dumpProgramUniformsStage(writer, compute_program, "GL_COMPUTE_SHADER");
+        dumpProgramUniformsStage(writer, context, vertex_program, "GL_VERTEX_SHADER");
+        dumpProgramUniformsStage(writer, context, fragment_program, "GL_FRAGMENT_SHADER");
+        dumpProgramUniformsStage(writer, context, geometry_program, "GL_GEOMETRY_SHADER");
+        dumpProgramUniformsStage(writer, context, tess_control_program, "GL_TESS_CONTROL_SHADER");
+        dumpProgramUniformsStage(writer, context, tess_evaluation_program, "GL_TESS_EVALUATION_SHADER");
+        dumpProgramUniformsStage(writer, context, compute_program, "GL_COMPUTE_SHADER");
     } else if (program) {
-        dumpProgramUniforms(writer, program);
+        dumpProgramUniforms(writer, context, program);
     } else {
         dumpArbProgramUniforms(writer, context, GL_FRAGMENT_PROGRAM_ARB, "fp.");
         dumpArbProgramUniforms(writer, context, GL_VERTEX_PROGRAM_ARB, "vp.");
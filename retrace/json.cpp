@@ -29,24 +29,37 @@
 
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include <sstream>
+#include <cmath> // for std::isinf, std::isnan; as C99 macros are unavailable in C++11
+#include <limits>
 
 #include "json.hpp"
 
 
+void
+JSONWriter::flushBuffer(void) {
+    if (used) {
+        os.write(buffer, used);
+        used = 0;
+    }
+}
+
 void
 JSONWriter::newline(void) {
-    os << "\n";
-    for (int i = 0; i < level; ++i)
-        os << "  ";
+    char *dst = reserve(1 + 2*level);
+    *dst++ = '\n';
+    memset(dst, ' ', 2*level);
+    used += 1 + 2*level;
 }
 
 void
 JSONWriter::separator(void) {
     if (value) {
-        os << ",";
+        put(',');
         switch (space) {
         case '\0':
             break;
@@ -54,7 +67,7 @@ JSONWriter::separator(void) {
             newline();
             break;
         default:
-            os << space;
+            put(space);
             break;
         }
     } else {
@@ -64,133 +77,564 @@ JSONWriter::separator(void) {
     }
 }
 
-static void
-escapeAsciiString(std::ostream &os, const char *str) {
-    os << "\"";
+
+/*
+ * How each byte of a string is written.
+ */
+enum EscapeClass {
+    ESCAPE_NONE = 0,
+    ESCAPE_BACKSLASH,   // '"' and '\\'
+    ESCAPE_CONTROL,     // other control characters, as \u00XX
+    ESCAPE_UTF8,        // start or continuation of a UTF-8 sequence
+    ESCAPE_END,         // terminating NUL
+};
+
+#define _ ESCAPE_NONE
+#define B ESCAPE_BACKSLASH
+#define C ESCAPE_CONTROL
+#define U ESCAPE_UTF8
+#define E ESCAPE_END
+
+static const unsigned char
+escapeTable[256] = {
+    E, C, C, C, C, C, C, C, C, _, _, C, C, _, C, C,
+    C, C, C, C, C, C, C, C, C, C, C, C, C, C, C, C,
+    _, _, B, _, _, _, _, _, _, _, _, _, _, _, _, _,
+    _, _, _, _, _, _, _, _, _, _, _, _, _, _, _, _,
+    _, _, _, _, _, _, _, _, _, _, _, _, _, _, _, _,
+    _, _, _, _, _, _, _, _, _, _, _, _, B, _, _, _,
+    _, _, _, _, _, _, _, _, _, _, _, _, _, _, _, _,
+    _, _, _, _, _, _, _, _, _, _, _, _, _, _, _, C,
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U,
+};
+
+#undef _
+#undef B
+#undef C
+#undef U
+#undef E
+
+static const char hexDigits[] = "0123456789abcdef";
+
+void
+JSONWriter::escapeAsciiString(const char *str) {
+    put('"');
 
     const unsigned char *src = (const unsigned char *)str;
-    unsigned char c;
-    while ((c = *src++)) {
-        if ((c == '\"') ||
-            (c == '\\')) {
-            // escape character
-            os << '\\' << (unsigned char)c;
-        } else if ((c >= 0x20 && c <= 0x7e) ||
-                    c == '\t' ||
-                    c == '\r' ||
-                    c == '\n') {
-            // pass-through character
-            os << (unsigned char)c;
+    const unsigned char *run = src;
+    for (;;) {
+        unsigned char c = *src;
+        if (escapeTable[c] == ESCAPE_NONE) {
+            ++src;
+            continue;
+        }
+
+        write((const char *)run, src - run);
+        if (c == 0) {
+            break;
+        }
+        if (escapeTable[c] == ESCAPE_BACKSLASH) {
+            char *dst = reserve(2);
+            dst[0] = '\\';
+            dst[1] = c;
+            used += 2;
         } else {
             assert(0);
-            os << "?";
+            put('?');
         }
+        run = ++src;
     }
 
-    os << "\"";
+    put('"');
 }
 
-static void
-escapeUnicodeString(std::ostream &os, const char *str) {
-    os << "\"";
+static inline void
+formatUnicodeEscape(char *dst, unsigned c) {
+    dst[0] = '\\';
+    dst[1] = 'u';
+    dst[2] = hexDigits[(c >> 12) & 0xf];
+    dst[3] = hexDigits[(c >> 8) & 0xf];
+    dst[4] = hexDigits[(c >> 4) & 0xf];
+    dst[5] = hexDigits[c & 0xf];
+}
 
-    const char *locale = setlocale(LC_CTYPE, "");
-    const char *src = str;
-    mbstate_t state;
+/*
+ * Decode one UTF-8 sequence, returning its length, or zero if invalid.
+ */
+static inline size_t
+decodeUTF8(const unsigned char *src, unsigned &c) {
+    unsigned char c0 = src[0];
+    size_t length;
+    unsigned min;
+    if (c0 >= 0xc2 && c0 <= 0xdf) {
+        c = c0 & 0x1f;
+        length = 2;
+        min = 0x80;
+    } else if (c0 >= 0xe0 && c0 <= 0xef) {
+        c = c0 & 0x0f;
+        length = 3;
+        min = 0x800;
+    } else if (c0 >= 0xf0 && c0 <= 0xf4) {
+        c = c0 & 0x07;
+        length = 4;
+        min = 0x10000;
+    } else {
+        return 0;
+    }
 
-    memset(&state, 0, sizeof state);
+    for (size_t i = 1; i < length; ++i) {
+        // Also stops at the terminating NUL
+        if ((src[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+        c = (c << 6) | (src[i] & 0x3f);
+    }
 
-    do {
-        // Convert characters one at a time in order to recover from
-        // conversion errors
-        wchar_t c;
-        size_t written = mbsrtowcs(&c, &src, 1, &state);
-        if (written == 0) {
-            // completed
-            break;
-        } if (written == (size_t)-1) {
-            // conversion error -- skip
-            os << "?";
-            do {
-                ++src;
-            } while (*src & 0x80);
-        } else if ((c == '\"') ||
-                   (c == '\\')) {
-            // escape character
-            os << '\\' << (unsigned char)c;
-        } else if ((c >= 0x20 && c <= 0x7e) ||
-                    c == '\t' ||
-                    c == '\r' ||
-                    c == '\n') {
-            // pass-through character
-            os << (unsigned char)c;
-        } else {
-            // unicode
-            os << "\\u" << std::hex << std::setfill('0') << std::setw(4) << (unsigned)c << std::setfill(' ') << std::dec;
+    if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) {
+        return 0;
+    }
+
+    return length;
+}
+
+/*
+ * Strings are assumed to be UTF-8, irrespective of the current locale.
+ * Non-ASCII characters are written as \u escapes, and invalid sequences as
+ * `?`.
+ */
+void
+JSONWriter::escapeUnicodeString(const char *str) {
+    put('"');
+
+    const unsigned char *src = (const unsigned char *)str;
+    const unsigned char *run = src;
+    for (;;) {
+        unsigned char c = *src;
+        if (escapeTable[c] == ESCAPE_NONE) {
+            ++src;
+            continue;
         }
-    } while (src);
 
-    setlocale(LC_CTYPE, locale);
+        write((const char *)run, src - run);
+
+        switch (escapeTable[c]) {
+        case ESCAPE_BACKSLASH:
+            {
+                char *dst = reserve(2);
+                dst[0] = '\\';
+                dst[1] = c;
+                used += 2;
+                ++src;
+            }
+            break;
+        case ESCAPE_CONTROL:
+            formatUnicodeEscape(reserve(6), c);
+            used += 6;
+            ++src;
+            break;
+        case ESCAPE_UTF8:
+            {
+                unsigned u;
+                size_t length = decodeUTF8(src, u);
+                if (length == 0) {
+                    // conversion error -- skip
+                    put('?');
+                    do {
+                        ++src;
+                    } while (*src & 0x80);
+                } else if (u < 0x10000) {
+                    formatUnicodeEscape(reserve(6), u);
+                    used += 6;
+                    src += length;
+                } else {
+                    // surrogate pair
+                    u -= 0x10000;
+                    char *dst = reserve(12);
+                    formatUnicodeEscape(dst, 0xd800 + (u >> 10));
+                    formatUnicodeEscape(dst + 6, 0xdc00 + (u & 0x3ff));
+                    used += 12;
+                    src += length;
+                }
+            }
+            break;
+        default:
+            assert(c == 0);
+            put('"');
+            return;
+        }
 
-    os << "\"";
+        run = src;
+    }
 }
 
-static void
-encodeBase64String(std::ostream &os, const unsigned char *bytes, size_t size) {
-    const char *table64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    unsigned char c0, c1, c2, c3;
-    char buf[4];
-    unsigned written;
 
-    os << "\"";
+/*
+ * Base64 is encoded 12 bits at a time, by looking up pairs of output
+ * characters.
+ */
+struct Base64Table
+{
+    char pairs[4096][2];
 
-    written = 0;
-    while (size >= 3) {
-        c0 = bytes[0] >> 2;
-        c1 = ((bytes[0] & 0x03) << 4) | ((bytes[1] & 0xf0) >> 4);
-        c2 = ((bytes[1] & 0x0f) << 2) | ((bytes[2] & 0xc0) >> 6);
-        c3 = bytes[2] & 0x3f;
+    Base64Table() {
+        const char *table64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (unsigned i = 0; i < 4096; ++i) {
+            pairs[i][0] = table64[i >> 6];
+            pairs[i][1] = table64[i & 0x3f];
+        }
+    }
+};
+
+static const Base64Table base64Table;
+
+void
+JSONWriter::encodeBase64String(const unsigned char *bytes, size_t size) {
+    const char *table64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-        buf[0] = table64[c0];
-        buf[1] = table64[c1];
-        buf[2] = table64[c2];
-        buf[3] = table64[c3];
+    // 76 characters per line
+    const size_t groupsPerLine = 76/4;
 
-        os.write(buf, 4);
+    put('"');
 
-        bytes += 3;
-        size -= 3;
-        ++written;
+    while (size >= 3) {
+        size_t groups = size/3;
+        if (groups > groupsPerLine) {
+            groups = groupsPerLine;
+        }
+
+        char *dst = reserve(groups*4 + 1);
+        for (size_t i = 0; i < groups; ++i) {
+            unsigned v = ((unsigned)bytes[0] << 16) |
+                         ((unsigned)bytes[1] << 8) |
+                          (unsigned)bytes[2];
+            memcpy(dst, base64Table.pairs[v >> 12], 2);
+            memcpy(dst + 2, base64Table.pairs[v & 0xfff], 2);
+            dst += 4;
+            bytes += 3;
+        }
+        size -= groups*3;
+        used += groups*4;
 
-        if (written >= 76/4 && size) {
-            os << "\n";
-            written = 0;
+        if (groups == groupsPerLine && size) {
+            *dst = '\n';
+            ++used;
         }
     }
 
     if (size > 0) {
-        c0 = bytes[0] >> 2;
-        c1 = ((bytes[0] & 0x03) << 4);
+        char *dst = reserve(4);
+        unsigned char c0 = bytes[0] >> 2;
+        unsigned char c1 = ((bytes[0] & 0x03) << 4);
 
-        buf[3] = '=';
+        dst[3] = '=';
         if (size > 1) {
             c1 |= ((bytes[1] & 0xf0) >> 4);
-            c2 = ((bytes[1] & 0x0f) << 2);
-            buf[2] = table64[c2];
+            unsigned char c2 = ((bytes[1] & 0x0f) << 2);
+            dst[2] = table64[c2];
         } else {
-            buf[2] = '=';
+            dst[2] = '=';
         }
-        buf[1] = table64[c1];
-        buf[0] = table64[c0];
+        dst[1] = table64[c1];
+        dst[0] = table64[c0];
+        used += 4;
+    }
+
+    put('"');
+}
+
+
+void
+JSONWriter::writeUnsigned(unsigned long long n) {
+    separator();
+
+    char buf[20];
+    char *p = buf + sizeof buf;
+    do {
+        *--p = '0' + (n % 10);
+        n /= 10;
+    } while (n);
+    write(p, buf + sizeof buf - p);
+
+    value = true;
+    space = ' ';
+}
 
-        os.write(buf, 4);
+void
+JSONWriter::writeSigned(long long n) {
+    if (n >= 0) {
+        writeUnsigned(n);
+        return;
     }
 
-    os << "\"";
+    separator();
+
+    unsigned long long u = 0ULL - (unsigned long long)n;
+    char buf[21];
+    char *p = buf + sizeof buf;
+    do {
+        *--p = '0' + (u % 10);
+        u /= 10;
+    } while (u);
+    *--p = '-';
+    write(p, buf + sizeof buf - p);
+
+    value = true;
+    space = ' ';
 }
 
+
+static inline bool
+parsesBack(const char *buf, float n) {
+    return strtof(buf, NULL) == n;
+}
+
+static inline bool
+parsesBack(const char *buf, double n) {
+    return strtod(buf, NULL) == n;
+}
+
+/*
+ * Format with the shortest %g precision that still reads back as the same
+ * value.  Precisions up to digits10 are always exact for normal numbers
+ * which were written with that many digits, so that's where the search
+ * starts.
+ */
+template<class T>
+static size_t
+formatFloat(char *buf, size_t size, T n) {
+    typedef std::numeric_limits<T> limits;
+
+    int length = 0;
+    int precision = std::fpclassify(n) == FP_SUBNORMAL ? 1 : limits::digits10;
+    for (; precision <= limits::max_digits10; ++precision) {
+        length = snprintf(buf, size, "%.*g", precision, (double)n);
+        if (parsesBack(buf, n)) {
+            break;
+        }
+    }
+    assert(length > 0 && (size_t)length < size);
+    return length;
+}
+
+/*
+ * Powers of ten which are exactly representable as doubles.
+ */
+static const double exactPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const int maxExactPowerOf10 = sizeof exactPowersOf10 / sizeof exactPowersOf10[0] - 1;
+
+/*
+ * Round a positive value to the given number of significant digits,
+ * returning them as an integer.  The exponent is adjusted if the rounding
+ * carries into a new digit.  Returns false if the scaling isn't exact.
+ */
+static inline bool
+roundDigits(double d, int precision, int &exp10, unsigned long long &digits) {
+    for (;;) {
+        int k = precision - 1 - exp10;
+        if (k > maxExactPowerOf10 || -k > maxExactPowerOf10) {
+            return false;
+        }
+        double scaled = k >= 0 ? d * exactPowersOf10[k] : d / exactPowersOf10[-k];
+        double whole = std::floor(scaled);
+        digits = (unsigned long long)whole;
+        // Round half to even, like printf
+        double fraction = scaled - whole;
+        if (fraction > 0.5 || (fraction == 0.5 && (digits & 1))) {
+            ++digits;
+        }
+        if (digits >= (unsigned long long)exactPowersOf10[precision]) {
+            ++exp10;
+        } else if (digits < (unsigned long long)exactPowersOf10[precision - 1]) {
+            --exp10;
+        } else {
+            return true;
+        }
+    }
+}
+
+/*
+ * Write the digits like printf's %.*g would, i.e., with trailing zeros
+ * removed, and an exponent when it is below -4 or not below the precision.
+ */
+static size_t
+formatDigits(char *buf, bool negative, unsigned long long digits, int precision, int exp10) {
+    char tmp[20];
+    int numDigits = precision;
+    while (numDigits > 1 && digits % 10 == 0) {
+        digits /= 10;
+        --numDigits;
+    }
+    for (int i = numDigits; i-- > 0; ) {
+        tmp[i] = '0' + digits % 10;
+        digits /= 10;
+    }
+
+    char *p = buf;
+    if (negative) {
+        *p++ = '-';
+    }
+
+    if (exp10 < -4 || exp10 >= precision) {
+        *p++ = tmp[0];
+        if (numDigits > 1) {
+            *p++ = '.';
+            memcpy(p, tmp + 1, numDigits - 1);
+            p += numDigits - 1;
+        }
+        *p++ = 'e';
+        unsigned e;
+        if (exp10 < 0) {
+            *p++ = '-';
+            e = -exp10;
+        } else {
+            *p++ = '+';
+            e = exp10;
+        }
+        if (e >= 100) {
+            *p++ = '0' + e / 100;
+        }
+        *p++ = '0' + (e / 10) % 10;
+        *p++ = '0' + e % 10;
+    } else if (exp10 >= 0) {
+        int intDigits = exp10 + 1;
+        for (int i = 0; i < intDigits; ++i) {
+            *p++ = i < numDigits ? tmp[i] : '0';
+        }
+        if (numDigits > intDigits) {
+            *p++ = '.';
+            memcpy(p, tmp + intDigits, numDigits - intDigits);
+            p += numDigits - intDigits;
+        }
+    } else {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = -1; i > exp10; --i) {
+            *p++ = '0';
+        }
+        memcpy(p, tmp, numDigits);
+        p += numDigits;
+    }
+
+    *p = 0;
+    return p - buf;
+}
+
+/*
+ * Fast path for floats.  Floats convert to doubles exactly, and have few
+ * enough digits that candidates can be scaled and checked in double
+ * precision.  Any float which can be written with up to digits10 digits
+ * rounds to those digits at precision digits10, so that's where the search
+ * starts.  Returns zero when the slow path must be taken instead.
+ */
+static size_t
+formatShortestFloat(char *buf, float n) {
+    double d = std::fabs((double)n);
+    if (std::fpclassify(n) != FP_NORMAL) {
+        return 0;
+    }
+
+    typedef std::numeric_limits<float> limits;
+
+    int exp10 = (int)std::floor(std::log10(d));
+    for (int precision = limits::digits10; precision <= limits::max_digits10; ++precision) {
+        unsigned long long digits;
+        if (!roundDigits(d, precision, exp10, digits)) {
+            return 0;
+        }
+
+        int k = precision - 1 - exp10;
+        double candidate = k >= 0 ? digits / exactPowersOf10[k] : digits * exactPowersOf10[-k];
+        if ((float)candidate == (float)d) {
+            size_t length = formatDigits(buf, n < 0, digits, precision, exp10);
+
+            // The candidate was rounded twice (to double, then to float),
+            // which can only give a different result than strtof when the
+            // double lies exactly halfway between two floats.
+            uint64_t bits;
+            memcpy(&bits, &candidate, sizeof bits);
+            if ((bits & 0x1fffffff) == 0x10000000 && !parsesBack(buf, n)) {
+                return 0;
+            }
+
+            return length;
+        }
+    }
+
+    return 0;
+}
+
+template<class T>
+static inline bool
+isSmallInteger(T n) {
+    // Integers which %g would write without an exponent
+    static const T limit = (T)(sizeof(T) == sizeof(float) ? 1e7 : 1e16);
+    return std::fabs(n) < limit &&
+           n == (T)(long long)n &&
+           !(n == 0 && std::signbit(n));
+}
+
+void
+JSONWriter::writeFloat(float n) {
+    if (isSmallInteger(n)) {
+        writeSigned((long long)n);
+        return;
+    }
+
+    separator();
+    if (std::isnan(n)) {
+        // NaN is non-standard but widely supported
+        write("NaN");
+    } else if (std::isinf(n)) {
+        // Infinite is non-standard but widely supported
+        write(n < 0 ? "-Infinity" : "Infinity");
+    } else {
+        char buf[32];
+        size_t length = formatShortestFloat(buf, n);
+        if (!length) {
+            length = formatFloat(buf, sizeof buf, n);
+        }
+        write(buf, length);
+    }
+    value = true;
+    space = ' ';
+}
+
+void
+JSONWriter::writeFloat(double n) {
+    if (isSmallInteger(n)) {
+        writeSigned((long long)n);
+        return;
+    }
+
+    separator();
+    if (std::isnan(n)) {
+        write("NaN");
+    } else if (std::isinf(n)) {
+        write(n < 0 ? "-Infinity" : "Infinity");
+    } else {
+        char buf[32];
+        write(buf, formatFloat(buf, sizeof buf, n));
+    }
+    value = true;
+    space = ' ';
+}
+
+
 JSONWriter::JSONWriter(std::ostream &_os) :
     os(_os),
+    buffer(new char[bufferSize]),
+    used(0),
     level(0),
     value(false),
     space(0)
@@ -201,12 +645,14 @@ JSONWriter::JSONWriter(std::ostream &_os) :
 JSONWriter::~JSONWriter() {
     endObject();
     newline();
+    flushBuffer();
+    delete [] buffer;
 }
 
 void
 JSONWriter::beginObject() {
     separator();
-    os << "{";
+    put('{');
     ++level;
     value = false;
 }
@@ -216,7 +662,7 @@ JSONWriter::endObject() {
     --level;
     if (value)
         newline();
-    os << "}";
+    put('}');
     value = true;
     space = '\n';
 }
@@ -226,8 +672,8 @@ JSONWriter::beginMember(const char * name) {
     space = 0;
     separator();
     newline();
-    escapeAsciiString(os, name);
-    os << ": ";
+    escapeAsciiString(name);
+    write(": ", 2);
     value = false;
 }
 
@@ -241,7 +687,7 @@ JSONWriter::endMember(void) {
 void
 JSONWriter::beginArray() {
     separator();
-    os << "[";
+    put('[');
     ++level;
     value = false;
     space = 0;
@@ -253,7 +699,7 @@ JSONWriter::endArray(void) {
     if (space == '\n') {
         newline();
     }
-    os << "]";
+    put(']');
     value = true;
     space = '\n';
 }
@@ -266,7 +712,7 @@ JSONWriter::writeString(const char *s) {
     }
 
     separator();
-    escapeUnicodeString(os, s);
+    escapeUnicodeString(s);
     value = true;
     space = ' ';
 }
@@ -274,7 +720,7 @@ JSONWriter::writeString(const char *s) {
 void
 JSONWriter::writeBase64(const void *bytes, size_t size) {
     separator();
-    encodeBase64String(os, (const unsigned char *)bytes, size);
+    encodeBase64String((const unsigned char *)bytes, size);
     value = true;
     space = ' ';
 }
@@ -282,7 +728,7 @@ JSONWriter::writeBase64(const void *bytes, size_t size) {
 void
 JSONWriter::writeNull(void) {
     separator();
-    os << "null";
+    write("null", 4);
     value = true;
     space = ' ';
 }
@@ -290,7 +736,11 @@ JSONWriter::writeNull(void) {
 void
 JSONWriter::writeBool(bool b) {
     separator();
-    os << (b ? "true" : "false");
+    if (b) {
+        write("true", 4);
+    } else {
+        write("false", 5);
+    }
     value = true;
     space = ' ';
 }
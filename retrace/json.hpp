@@ -25,6 +25,9 @@
 
 /*
  * JSON writing functions.
+ *
+ * Output is formatted into an internal buffer, which is only handed to the
+ * underlying stream when full, or when the writer is destroyed.
  */
 
 
@@ -32,14 +35,11 @@
 
 
 #include <stddef.h>
-#include <wchar.h>
-
-#include <cmath> // for std::isinf, std::isnan; as C99 macros are unavailable in C++11
+#include <string.h>
 
-#include <iomanip>
-#include <limits>
 #include <ostream>
 #include <string>
+#include <type_traits>
 
 
 class JSONWriter
@@ -47,16 +47,70 @@ class JSONWriter
 private:
     std::ostream &os;
 
+    char *buffer;
+    size_t used;
+
+    static const size_t bufferSize = 64 * 1024;
+
     int level;
     bool value;
     char space;
 
+    void
+    flushBuffer(void);
+
+    // Ensure there is room for n more bytes, and return where they go.
+    inline char *
+    reserve(size_t n) {
+        if (used + n > bufferSize) {
+            flushBuffer();
+        }
+        return buffer + used;
+    }
+
+    inline void
+    put(char c) {
+        *reserve(1) = c;
+        ++used;
+    }
+
+    inline void
+    write(const char *s, size_t n) {
+        if (n > bufferSize) {
+            flushBuffer();
+            os.write(s, n);
+        } else {
+            memcpy(reserve(n), s, n);
+            used += n;
+        }
+    }
+
+    inline void
+    write(const char *s) {
+        write(s, strlen(s));
+    }
+
     void
     newline(void);
 
     void
     separator(void);
 
+    void
+    escapeAsciiString(const char *str);
+
+    void
+    escapeUnicodeString(const char *str);
+
+    void
+    encodeBase64String(const unsigned char *bytes, size_t size);
+
+    void
+    writeSigned(long long n);
+
+    void
+    writeUnsigned(unsigned long long n);
+
 public:
     JSONWriter(std::ostream &_os);
 
@@ -103,51 +157,27 @@ public:
     writeBool(bool b);
 
     /**
-     * Special case for char to prevent it to be written as a literal
-     * character.
+     * Chars are written as numbers, like any other integer, rather than as
+     * literal characters.
      */
-    inline void
-    writeInt(signed char n) {
-        separator();
-        os << std::dec << static_cast<int>(n);
-        value = true;
-        space = ' ';
-    }
-
-    inline void
-    writeInt(unsigned char n) {
-        separator();
-        os << std::dec << static_cast<unsigned>(n);
-        value = true;
-        space = ' ';
-    }
-
     template<class T>
     inline void
     writeInt(T n) {
-        separator();
-        os << std::dec << n;
-        value = true;
-        space = ' ';
-    }
-
-    template<class T>
-    void
-    writeFloat(T n) {
-        separator();
-        if (std::isnan(n)) {
-            // NaN is non-standard but widely supported
-            os << "NaN";
-        } else if (std::isinf(n)) {
-            // Infinite is non-standard but widely supported
-            if (n < 0) {
-                os << '-';
-            }
-            os << "Infinity";
+        static_assert(std::is_integral<T>::value, "integer type expected");
+        if (std::is_signed<T>::value) {
+            writeSigned(static_cast<long long>(n));
         } else {
-            os << std::dec << std::setprecision(std::numeric_limits<T>::digits10 + 1) << n;
+            writeUnsigned(static_cast<unsigned long long>(n));
         }
-        value = true;
-        space = ' ';
     }
+
+    /**
+     * Floats are written with the fewest digits which still read back as
+     * the same value.
+     */
+    void
+    writeFloat(float n);
+
+    void
+    writeFloat(double n);
 };
@@ -0,0 +1,267 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include "json.hpp"
+
+#include "gtest/gtest.h"
+
+
+/*
+ * Write a single member with the given writer method, and return the text of
+ * its value.
+ */
+template<class F>
+static std::string
+writeValue(F f)
+{
+    std::ostringstream ss;
+    {
+        JSONWriter json(ss);
+        json.beginMember("v");
+        f(json);
+        json.endMember();
+    }
+    std::string s = ss.str();
+    const char *prefix = "{\n  \"v\": ";
+    const char *suffix = "\n}\n";
+    EXPECT_EQ(s.compare(0, strlen(prefix), prefix), 0) << s;
+    EXPECT_GE(s.size(), strlen(prefix) + strlen(suffix)) << s;
+    if (s.size() < strlen(prefix) + strlen(suffix)) {
+        return s;
+    }
+    return s.substr(strlen(prefix), s.size() - strlen(prefix) - strlen(suffix));
+}
+
+template<class T>
+static std::string
+writeInt(T n)
+{
+    return writeValue([=](JSONWriter &json) { json.writeInt(n); });
+}
+
+template<class T>
+static std::string
+writeFloat(T n)
+{
+    return writeValue([=](JSONWriter &json) { json.writeFloat(n); });
+}
+
+static std::string
+writeString(const char *s)
+{
+    return writeValue([=](JSONWriter &json) { json.writeString(s); });
+}
+
+static std::string
+writeBase64(const void *bytes, size_t size)
+{
+    return writeValue([=](JSONWriter &json) { json.writeBase64(bytes, size); });
+}
+
+
+/*
+ * Count the digits from the first non-zero digit to the last one.
+ */
+static int
+significantDigits(const std::string &s)
+{
+    int digits = 0;
+    int zeros = 0;
+    for (const char *p = s.c_str(); *p && *p != 'e'; ++p) {
+        if (*p >= '1' && *p <= '9') {
+            digits += zeros + 1;
+            zeros = 0;
+        } else if (*p == '0' && digits) {
+            ++zeros;
+        }
+    }
+    return digits;
+}
+
+
+TEST(JSONWriter, Integers)
+{
+    EXPECT_EQ(writeInt(0), "0");
+    EXPECT_EQ(writeInt(7), "7");
+    EXPECT_EQ(writeInt(-1), "-1");
+    EXPECT_EQ(writeInt(1234567890U), "1234567890");
+    EXPECT_EQ(writeInt(std::numeric_limits<int64_t>::min()), "-9223372036854775808");
+    EXPECT_EQ(writeInt(std::numeric_limits<int64_t>::max()), "9223372036854775807");
+    EXPECT_EQ(writeInt(std::numeric_limits<uint64_t>::max()), "18446744073709551615");
+
+    // Chars are numbers too
+    EXPECT_EQ(writeInt('A'), "65");
+    EXPECT_EQ(writeInt((signed char)-2), "-2");
+    EXPECT_EQ(writeInt((unsigned char)255), "255");
+}
+
+
+TEST(JSONWriter, Floats)
+{
+    EXPECT_EQ(writeFloat(0.0f), "0");
+    EXPECT_EQ(writeFloat(-0.0f), "-0");
+    EXPECT_EQ(writeFloat(3.0f), "3");
+    EXPECT_EQ(writeFloat(-16777216.0f), "-16777216");
+    EXPECT_EQ(writeFloat(0.5f), "0.5");
+    EXPECT_EQ(writeFloat(0.1f), "0.1");
+    EXPECT_EQ(writeFloat(-2.5e-5f), "-2.5e-05");
+    EXPECT_EQ(writeFloat(1e20f), "1e+20");
+    EXPECT_EQ(writeFloat(1.0f/3.0f), "0.33333334");
+    EXPECT_EQ(writeFloat(std::numeric_limits<float>::max()), "3.4028235e+38");
+    EXPECT_EQ(writeFloat(std::numeric_limits<float>::denorm_min()), "1e-45");
+    EXPECT_EQ(writeFloat(std::numeric_limits<float>::quiet_NaN()), "NaN");
+    EXPECT_EQ(writeFloat(std::numeric_limits<float>::infinity()), "Infinity");
+    EXPECT_EQ(writeFloat(-std::numeric_limits<float>::infinity()), "-Infinity");
+}
+
+
+// Every float reads back as the same value, with no more digits than needed
+TEST(JSONWriter, FloatsRoundTrip)
+{
+    uint32_t bits = 0x12345678;
+    for (unsigned i = 0; i < 100000; ++i) {
+        bits = bits * 1664525 + 1013904223;
+        float n;
+        memcpy(&n, &bits, sizeof n);
+        if (std::isnan(n) || std::isinf(n)) {
+            continue;
+        }
+
+        std::string s = writeFloat(n);
+        float m = strtof(s.c_str(), NULL);
+        ASSERT_EQ(memcmp(&m, &n, sizeof n), 0) << s;
+
+        // One digit less must not round-trip
+        int precision = significantDigits(s);
+        if (precision > 1) {
+            char buf[512];
+            snprintf(buf, sizeof buf, "%.*g", precision - 1, (double)n);
+            EXPECT_NE(strtof(buf, NULL), n) << s;
+        }
+    }
+}
+
+
+TEST(JSONWriter, Doubles)
+{
+    EXPECT_EQ(writeFloat(0.0), "0");
+    EXPECT_EQ(writeFloat(-0.0), "-0");
+    EXPECT_EQ(writeFloat(42.0), "42");
+    EXPECT_EQ(writeFloat(0.1), "0.1");
+    EXPECT_EQ(writeFloat(1e16), "1e+16");
+    EXPECT_EQ(writeFloat(1e300), "1e+300");
+    EXPECT_EQ(writeFloat(1.0/3.0), "0.3333333333333333");
+    EXPECT_EQ(writeFloat(std::numeric_limits<double>::denorm_min()), "5e-324");
+    EXPECT_EQ(writeFloat(std::numeric_limits<double>::quiet_NaN()), "NaN");
+    EXPECT_EQ(writeFloat(-std::numeric_limits<double>::infinity()), "-Infinity");
+
+    uint64_t bits = 0x123456789abcdefULL;
+    for (unsigned i = 0; i < 10000; ++i) {
+        bits = bits * 6364136223846793005ULL + 1442695040888963407ULL;
+        double n;
+        memcpy(&n, &bits, sizeof n);
+        if (std::isnan(n) || std::isinf(n)) {
+            continue;
+        }
+        std::string s = writeFloat(n);
+        double m = strtod(s.c_str(), NULL);
+        ASSERT_EQ(memcmp(&m, &n, sizeof n), 0) << s;
+    }
+}
+
+
+TEST(JSONWriter, Strings)
+{
+    EXPECT_EQ(writeString(""), "\"\"");
+    EXPECT_EQ(writeString("plain text"), "\"plain text\"");
+    EXPECT_EQ(writeString("a\"b\\c"), "\"a\\\"b\\\\c\"");
+    EXPECT_EQ(writeString("\x01\x1f\x7f"), "\"\\u0001\\u001f\\u007f\"");
+
+    // Non-ASCII characters are escaped, irrespective of the locale
+    EXPECT_EQ(writeString("caf\xc3\xa9"), "\"caf\\u00e9\"");
+    EXPECT_EQ(writeString("\xe2\x82\xac"), "\"\\u20ac\"");
+
+    // Characters outside the BMP as surrogate pairs
+    EXPECT_EQ(writeString("\xf0\x9f\x98\x80!"), "\"\\ud83d\\ude00!\"");
+    EXPECT_EQ(writeString("\xf4\x8f\xbf\xbf"), "\"\\udbff\\udfff\"");
+}
+
+
+TEST(JSONWriter, InvalidUTF8)
+{
+    // Stray continuation and invalid lead bytes
+    EXPECT_EQ(writeString("a\x80z"), "\"a?z\"");
+    EXPECT_EQ(writeString("a\xffz"), "\"a?z\"");
+
+    // Overlong encodings, surrogates and code points beyond U+10FFFF
+    EXPECT_EQ(writeString("\xc0\xaf"), "\"?\"");
+    EXPECT_EQ(writeString("\xe0\x80\xaf"), "\"?\"");
+    EXPECT_EQ(writeString("\xed\xa0\x80"), "\"?\"");
+    EXPECT_EQ(writeString("\xf4\x90\x80\x80"), "\"?\"");
+
+    // Truncated sequences, without reading past the end
+    EXPECT_EQ(writeString("a\xe2\x82"), "\"a?\"");
+    EXPECT_EQ(writeString("\xf0\x9f\x98 ok"), "\"? ok\"");
+}
+
+
+TEST(JSONWriter, Base64)
+{
+    EXPECT_EQ(writeBase64("", 0), "\"\"");
+    EXPECT_EQ(writeBase64("f", 1), "\"Zg==\"");
+    EXPECT_EQ(writeBase64("fo", 2), "\"Zm8=\"");
+    EXPECT_EQ(writeBase64("foo", 3), "\"Zm9v\"");
+    EXPECT_EQ(writeBase64("foob", 4), "\"Zm9vYg==\"");
+    EXPECT_EQ(writeBase64("fooba", 5), "\"Zm9vYmE=\"");
+    EXPECT_EQ(writeBase64("foobar", 6), "\"Zm9vYmFy\"");
+
+    static const unsigned char bytes[] = {0x00, 0x10, 0x83, 0xff, 0xfe};
+    EXPECT_EQ(writeBase64(bytes, sizeof bytes), "\"ABCD//4=\"");
+
+    // Lines are broken every 76 characters, but not after the last one
+    std::string data(57 * 2, '\xaa');
+    std::string line(76, 'q');
+    EXPECT_EQ(writeBase64(data.data(), data.size()), "\"" + line + "\n" + line + "\"");
+
+    data.push_back('\xaa');
+    EXPECT_EQ(writeBase64(data.data(), data.size()), "\"" + line + "\n" + line + "\nqg==\"");
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -282,4 +282,22 @@ public:
      */
     virtual unsigned getNumPasses() = 0;
 
+    /**
+     * Returns the number of leading query ids of a given type of boundary
+     * whose data is already complete, i.e. ids below the returned value can
+     * be passed to enumDataQueryId(...) before profiling finishes.
+     * Backends which only know their data at the end of the last pass
+     * return 0.
+     */
+    virtual unsigned getNumAvailableQueries(QueryBoundary boundary) {
+        return 0;
+    }
+
+    /**
+     * Tells the backend that data of all query ids below a given id was
+     * written out and will not be enumerated again, so it can be freed.
+     * Query ids of later queries are not affected.
+     */
+    virtual void releaseQueries(QueryBoundary boundary, unsigned id) {}
+
 };
@@ -23,6 +23,8 @@
  *
  **************************************************************************/
 
+#include <algorithm>
+
 #include "metric_backend_opengl.hpp"
 #include "os_time.hpp"
 #include "os_memory.hpp"
@@ -35,7 +37,24 @@ MetricBackend_opengl::Storage::addData(QueryBoundary boundary, int64_t data) {
 int64_t* MetricBackend_opengl::Storage::getData(QueryBoundary boundary,
                                                  unsigned eventId)
 {
-    return &(data[boundary][eventId]);
+    if (eventId < base[boundary] ||
+        eventId - base[boundary] >= data[boundary].size()) {
+        return nullptr;
+    }
+    return &(data[boundary][eventId - base[boundary]]);
+}
+
+unsigned MetricBackend_opengl::Storage::size(QueryBoundary boundary) const {
+    return base[boundary] + data[boundary].size();
+}
+
+void MetricBackend_opengl::Storage::release(QueryBoundary boundary,
+                                            unsigned eventId)
+{
+    while (base[boundary] < eventId && !data[boundary].empty()) {
+        data[boundary].pop_front();
+        base[boundary]++;
+    }
 }
 
 Metric_opengl::Metric_opengl(unsigned gId, unsigned id, const std::string &name,
@@ -474,6 +493,25 @@ unsigned MetricBackend_opengl::getNumPasses() {
     return twoPasses ? 2 : 1;
 }
 
+unsigned MetricBackend_opengl::getNumAvailableQueries(QueryBoundary boundary) {
+    // GPU metrics lag behind CPU ones until their queries are processed
+    unsigned available = ~0U;
+    for (int i = 0; i < METRIC_LIST_END; i++) {
+        if (metrics[i].enabled[boundary]) {
+            available = std::min(available, data[i][boundary]->size(boundary));
+        }
+    }
+    return available;
+}
+
+void MetricBackend_opengl::releaseQueries(QueryBoundary boundary, unsigned id) {
+    for (int i = 0; i < METRIC_LIST_END; i++) {
+        if (metrics[i].enabled[boundary]) {
+            data[i][boundary]->release(boundary, id);
+        }
+    }
+}
+
 MetricBackend_opengl&
 MetricBackend_opengl::getInstance(glretrace::Context* context, MmapAllocator<char> &alloc) {
     static MetricBackend_opengl backend(context, alloc);
@@ -75,6 +75,8 @@ private:
     {
     private:
         std::deque<int64_t, MmapAllocator<int64_t>> data[QUERY_BOUNDARY_LIST_END];
+        // query id of the first element still held in data
+        unsigned base[QUERY_BOUNDARY_LIST_END] = {};
 
     public:
 #ifdef _WIN32
@@ -91,6 +93,8 @@ private:
 #endif
         void addData(QueryBoundary boundary, int64_t data);
         int64_t* getData(QueryBoundary boundary, unsigned eventId);
+        unsigned size(QueryBoundary boundary) const;
+        void release(QueryBoundary boundary, unsigned eventId);
     };
 
     // indexes into metrics vector
@@ -184,6 +188,10 @@ public:
 
     unsigned getNumPasses() override;
 
+    unsigned getNumAvailableQueries(QueryBoundary boundary) override;
+
+    void releaseQueries(QueryBoundary boundary, unsigned id) override;
+
     static MetricBackend_opengl& getInstance(glretrace::Context* context,
                                              MmapAllocator<char> &alloc);
 
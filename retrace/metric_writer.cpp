@@ -23,47 +23,51 @@
  *
  **************************************************************************/
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
 #include "metric_writer.hpp"
 
 void ProfilerQuery::writeMetricHeaderCallback(Metric* metric, int event, void* data, int error,
                                       void* userData) {
-    std::cout << "\t" << metric->name();
+    std::ostream &os = *reinterpret_cast<std::ostream*>(userData);
+    os << "\t" << metric->name();
 }
 
 void ProfilerQuery::writeMetricEntryCallback(Metric* metric, int event, void* data, int error,
                                      void* userData) {
+    std::ostream &os = *reinterpret_cast<std::ostream*>(userData);
     if (error) {
-        std::cout << "\t" << "#ERR" << error;
+        os << "\t" << "#ERR" << error;
         return;
     }
     if (!data) {
-        std::cout << "\t" << "-";
+        os << "\t" << "-";
         return;
     }
     switch(metric->numType()) {
-        case CNT_NUM_UINT: std::cout << "\t" << *(reinterpret_cast<unsigned*>(data)); break;
-        case CNT_NUM_FLOAT: std::cout << "\t" << *(reinterpret_cast<float*>(data)); break;
-        case CNT_NUM_DOUBLE: std::cout << "\t" << *(reinterpret_cast<double*>(data)); break;
-        case CNT_NUM_BOOL: std::cout << "\t" << *(reinterpret_cast<bool*>(data)); break;
-        case CNT_NUM_UINT64: std::cout << "\t" << *(reinterpret_cast<uint64_t*>(data)); break;
-        case CNT_NUM_INT64: std::cout << "\t" << *(reinterpret_cast<int64_t*>(data)); break;
+        case CNT_NUM_UINT: os << "\t" << *(reinterpret_cast<unsigned*>(data)); break;
+        case CNT_NUM_FLOAT: os << "\t" << *(reinterpret_cast<float*>(data)); break;
+        case CNT_NUM_DOUBLE: os << "\t" << *(reinterpret_cast<double*>(data)); break;
+        case CNT_NUM_BOOL: os << "\t" << *(reinterpret_cast<bool*>(data)); break;
+        case CNT_NUM_UINT64: os << "\t" << *(reinterpret_cast<uint64_t*>(data)); break;
+        case CNT_NUM_INT64: os << "\t" << *(reinterpret_cast<int64_t*>(data)); break;
     }
 }
 
-void ProfilerQuery::writeMetricHeader(QueryBoundary qb) const {
+void ProfilerQuery::writeMetricHeader(QueryBoundary qb, std::ostream &os) const {
     for (auto &a : *metricBackends) {
-        a->enumDataQueryId(eventId, &writeMetricHeaderCallback, qb);
+        a->enumDataQueryId(eventId, &writeMetricHeaderCallback, qb, &os);
     }
-    std::cout << std::endl;
+    os << "\n";
 }
 
-void ProfilerQuery::writeMetricEntry(QueryBoundary qb) const {
+void ProfilerQuery::writeMetricEntry(QueryBoundary qb, std::ostream &os) const {
     for (auto &a : *metricBackends) {
-        a->enumDataQueryId(eventId, &writeMetricEntryCallback, qb);
+        a->enumDataQueryId(eventId, &writeMetricEntryCallback, qb, &os);
     }
-    std::cout << std::endl;
+    os << "\n";
 }
 
 template<typename T>
@@ -98,60 +102,77 @@ ProfilerCall::ProfilerCall(unsigned eventId, const data* queryData)
 }
 
 
-void ProfilerCall::writeHeader() const {
-    std::cout << "#\tcall no\tprogram\tname";
-    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_CALL);
+
+void ProfilerCall::writeHeader(std::ostream &os) const {
+    os << "#\tcall no\tprogram\tname";
+    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_CALL, os);
 }
 
-void ProfilerCall::writeEntry() const {
+void ProfilerCall::writeEntry(std::ostream &os) const {
     if (isFrameEnd) {
-        std::cout << "frame_end" << std::endl;
+        os << "frame_end" << "\n";
     } else {
-        std::cout << "call"
+        os << "call"
             << "\t" << no
             << "\t" << program
             << "\t" << nameTable.getString(nameTableEntry);
-        ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_CALL);
+        ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_CALL, os);
     }
 }
 
 
-void ProfilerDrawcall::writeHeader() const {
-    std::cout << "#\tcall no\tprogram\tname";
-    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_DRAWCALL);
+void ProfilerDrawcall::writeHeader(std::ostream &os) const {
+    os << "#\tcall no\tprogram\tname";
+    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_DRAWCALL, os);
 }
 
-void ProfilerDrawcall::writeEntry() const {
+void ProfilerDrawcall::writeEntry(std::ostream &os) const {
     if (isFrameEnd) {
-        std::cout << "frame_end" << std::endl;
+        os << "frame_end" << "\n";
     } else {
-        std::cout << "call"
+        os << "call"
             << "\t" << no
             << "\t" << program
             << "\t" << nameTable.getString(nameTableEntry);
-        ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_DRAWCALL);
+        ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_DRAWCALL, os);
     }
 }
 
 
-void ProfilerFrame::writeHeader() const {
-    std::cout << "#";
-    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_FRAME);
+void ProfilerFrame::writeHeader(std::ostream &os) const {
+    os << "#";
+    ProfilerQuery::writeMetricHeader(QUERY_BOUNDARY_FRAME, os);
 }
 
-void ProfilerFrame::writeEntry() const {
-    std::cout << "frame";
-    ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_FRAME);
+void ProfilerFrame::writeEntry(std::ostream &os) const {
+    os << "frame";
+    ProfilerQuery::writeMetricEntry(QUERY_BOUNDARY_FRAME, os);
 }
 
 
 MetricWriter::MetricWriter(std::vector<MetricBackend*> &metricBackends,
                            const MmapAllocator<char> &alloc)
-    : frameQueue(MmapAllocator<ProfilerCall>(alloc)),
+    : metricBackends(metricBackends),
+      frameQueue(MmapAllocator<ProfilerFrame>(alloc)),
       callQueue(MmapAllocator<ProfilerCall>(alloc)),
-      drawcallQueue(MmapAllocator<ProfilerCall>(alloc))
+      drawcallQueue(MmapAllocator<ProfilerDrawcall>(alloc)),
+      streamChosen(false),
+      streamBoundary(QUERY_BOUNDARY_FRAME)
 {
     ProfilerQuery::metricBackends = &metricBackends;
+    for (int i = 0; i < QUERY_BOUNDARY_LIST_END; i++) {
+        headerWritten[i] = false;
+        spool[i] = nullptr;
+    }
+}
+
+MetricWriter::~MetricWriter()
+{
+    for (auto &f : spool) {
+        if (f) {
+            fclose(f);
+        }
+    }
 }
 
 void MetricWriter::addQuery(QueryBoundary boundary, unsigned eventId,
@@ -174,48 +195,132 @@ void MetricWriter::addQuery(QueryBoundary boundary, unsigned eventId,
     }
 }
 
-void MetricWriter::writeQuery(QueryBoundary boundary) {
+void MetricWriter::chooseStream(void) {
+    // boundaries are written out in this order at the end
+    if (!frameQueue.empty()) {
+        streamBoundary = QUERY_BOUNDARY_FRAME;
+    } else if (!callQueue.empty()) {
+        streamBoundary = QUERY_BOUNDARY_CALL;
+    } else if (!drawcallQueue.empty()) {
+        streamBoundary = QUERY_BOUNDARY_DRAWCALL;
+    } else {
+        return;
+    }
+    streamChosen = true;
+}
+
+bool MetricWriter::isEmpty(QueryBoundary boundary) const {
     switch (boundary) {
         case QUERY_BOUNDARY_FRAME:
-            frameQueue.front().writeEntry();
-            frameQueue.pop_front();
-            break;
+            return frameQueue.empty();
         case QUERY_BOUNDARY_CALL:
-            callQueue.front().writeEntry();
-            callQueue.pop_front();
-            break;
+            return callQueue.empty();
         case QUERY_BOUNDARY_DRAWCALL:
-            drawcallQueue.front().writeEntry();
-            drawcallQueue.pop_front();
-            break;
+            return drawcallQueue.empty();
         default:
-            break;
+            return true;
     }
 }
 
-void MetricWriter::writeAll(QueryBoundary boundary) {
+template<typename Queue>
+void MetricWriter::writeQueue(Queue &queue, QueryBoundary boundary,
+                              unsigned available, std::ostream &os)
+{
+    unsigned released = 0;
+    while (!queue.empty()) {
+        auto &query = queue.front();
+        if (!query.frameEnd()) {
+            if (query.getEventId() >= available) {
+                break;
+            }
+            released = query.getEventId() + 1;
+        }
+        if (!headerWritten[boundary]) {
+            query.writeHeader(os);
+            headerWritten[boundary] = true;
+        }
+        query.writeEntry(os);
+        queue.pop_front();
+    }
+    if (released) {
+        for (auto &b : metricBackends) {
+            b->releaseQueries(boundary, released);
+        }
+    }
+}
+
+void MetricWriter::writeQueries(QueryBoundary boundary, unsigned available,
+                                std::ostream &os)
+{
     switch (boundary) {
         case QUERY_BOUNDARY_FRAME:
-            frameQueue.front().writeHeader();
-            while (!frameQueue.empty()) {
-                writeQuery(boundary);
-            }
+            writeQueue(frameQueue, boundary, available, os);
             break;
         case QUERY_BOUNDARY_CALL:
-            callQueue.front().writeHeader();
-            while (!callQueue.empty()) {
-                writeQuery(boundary);
-            }
+            writeQueue(callQueue, boundary, available, os);
             break;
         case QUERY_BOUNDARY_DRAWCALL:
-            drawcallQueue.front().writeHeader();
-            while (!drawcallQueue.empty()) {
-                writeQuery(boundary);
-            }
+            writeQueue(drawcallQueue, boundary, available, os);
             break;
         default:
             break;
     }
+}
+
+void MetricWriter::flush(void) {
+    if (!streamChosen) {
+        chooseStream();
+    }
+    for (int i = 0; i < QUERY_BOUNDARY_LIST_END; i++) {
+        QueryBoundary boundary = static_cast<QueryBoundary>(i);
+        if (isEmpty(boundary)) {
+            continue;
+        }
+        if (boundary != streamBoundary && !spool[i]) {
+            spool[i] = tmpfile();
+            if (!spool[i]) {
+                // keep the queries in memory until writeAll()
+                continue;
+            }
+        }
+
+        unsigned available = ~0U;
+        for (auto &b : metricBackends) {
+            available = std::min(available, b->getNumAvailableQueries(boundary));
+        }
+
+        std::ostringstream os;
+        writeQueries(boundary, available, os);
+        const std::string &str = os.str();
+        if (str.empty()) {
+            continue;
+        }
+        if (boundary == streamBoundary) {
+            std::cout << str;
+            std::cout.flush();
+        } else {
+            fwrite(str.data(), 1, str.size(), spool[i]);
+        }
+    }
+}
+
+void MetricWriter::writeAll(QueryBoundary boundary) {
+    if (!streamChosen) {
+        streamBoundary = boundary;
+        streamChosen = true;
+    }
+    FILE *f = spool[boundary];
+    if (f) {
+        rewind(f);
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof buf, f)) > 0) {
+            std::cout.write(buf, n);
+        }
+        fclose(f);
+        spool[boundary] = nullptr;
+    }
+    writeQueries(boundary, ~0U, std::cout);
     std::cout << std::endl;
 }
 
@@ -25,9 +25,13 @@
 
 #pragma once
 
-#include <queue>
+#include <stdio.h>
+
+#include <deque>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "metric_backend.hpp"
 #include "mmap_allocator.hpp"
@@ -46,8 +50,10 @@ public:
 
     ProfilerQuery(QueryBoundary qb, unsigned eventId)
         : eventId(eventId) {};
-    void writeMetricHeader(QueryBoundary qb) const;
-    void writeMetricEntry(QueryBoundary qb) const;
+    unsigned getEventId() const { return eventId; }
+    bool frameEnd() const { return false; }
+    void writeMetricHeader(QueryBoundary qb, std::ostream &os) const;
+    void writeMetricEntry(QueryBoundary qb, std::ostream &os) const;
 };
 
 class ProfilerCall : public ProfilerQuery
@@ -82,8 +88,9 @@ protected:
 
 public:
     ProfilerCall(unsigned eventId, const data* queryData = nullptr);
-    void writeHeader() const;
-    void writeEntry() const;
+    bool frameEnd() const { return isFrameEnd; }
+    void writeHeader(std::ostream &os) const;
+    void writeEntry(std::ostream &os) const;
 };
 
 class ProfilerDrawcall : public ProfilerCall
@@ -91,8 +98,8 @@ class ProfilerDrawcall : public ProfilerCall
 public:
     ProfilerDrawcall(unsigned eventId, const data* queryData)
         : ProfilerCall( eventId, queryData) {};
-    void writeHeader() const;
-    void writeEntry() const;
+    void writeHeader(std::ostream &os) const;
+    void writeEntry(std::ostream &os) const;
 };
 
 class ProfilerFrame : public ProfilerQuery
@@ -100,25 +107,52 @@ class ProfilerFrame : public ProfilerQuery
 public:
     ProfilerFrame(unsigned eventId)
         : ProfilerQuery(QUERY_BOUNDARY_FRAME, eventId) {};
-    void writeHeader() const;
-    void writeEntry() const;
+    void writeHeader(std::ostream &os) const;
+    void writeEntry(std::ostream &os) const;
 };
 
+/*
+ * Queries are written out as soon as every backend has their data, so only
+ * the in-flight part of the trace is kept in memory.  Only one boundary type
+ * can be streamed to stdout; the others are spooled to temporary files and
+ * appended by writeAll(), preserving the output layout.
+ */
 class MetricWriter
 {
 private:
+    std::vector<MetricBackend*> &metricBackends;
+
+    // Backends which can't release their data before the end keep every
+    // query queued, so keep the queues out of the heap too
     std::deque<ProfilerFrame, MmapAllocator<ProfilerFrame>> frameQueue;
     std::deque<ProfilerCall, MmapAllocator<ProfilerCall>> callQueue;
     std::deque<ProfilerDrawcall, MmapAllocator<ProfilerDrawcall>> drawcallQueue;
 
+    bool streamChosen;
+    QueryBoundary streamBoundary;
+    bool headerWritten[QUERY_BOUNDARY_LIST_END];
+    FILE *spool[QUERY_BOUNDARY_LIST_END];
+
+    void chooseStream(void);
+
+    bool isEmpty(QueryBoundary boundary) const;
+
+    template<typename Queue>
+    void writeQueue(Queue &queue, QueryBoundary boundary, unsigned available,
+                    std::ostream &os);
+
+    void writeQueries(QueryBoundary boundary, unsigned available,
+                      std::ostream &os);
+
 public:
     MetricWriter(std::vector<MetricBackend*> &metricBackends,
                  const MmapAllocator<char> &alloc);
+    ~MetricWriter();
 
     void addQuery(QueryBoundary boundary, unsigned eventId,
                   const void* queryData = nullptr);
 
-    void writeQuery(QueryBoundary boundary);
+    void flush(void);
 
     void writeAll(QueryBoundary boundary);
 };
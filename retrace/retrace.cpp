@@ -41,6 +41,50 @@ namespace retrace {
 trace::DumpFlags dumpFlags = trace::DUMP_FLAG_THREAD_IDS;
 
 
+unsigned Instance::numSlots = 0;
+
+Instance defaultInstance;
+
+bool multipleInstances = false;
+
+OS_THREAD_LOCAL Instance *
+currentInstance = nullptr;
+
+
+Instance::~Instance() {
+    for (unsigned index = 0; index < slots.size(); ++index) {
+        if (slots[index]) {
+            destructors[index](slots[index]);
+        }
+    }
+}
+
+
+void *
+Instance::createSlot(unsigned index, void *(*create)(void), void (*destroy)(void *)) {
+    if (index >= slots.size()) {
+        slots.resize(numSlots);
+        destructors.resize(numSlots);
+    }
+    assert(!slots[index]);
+    void *ptr = create();
+    slots[index] = ptr;
+    destructors[index] = destroy;
+    return ptr;
+}
+
+
+ResetHook *ResetHook::first = nullptr;
+
+
+void
+ResetHook::resetAll(void) {
+    for (ResetHook *hook = first; hook; hook = hook->next) {
+        hook->callback();
+    }
+}
+
+
 static bool call_dumped = false;
 
 
@@ -154,6 +198,10 @@ void Retracer::retrace(trace::Call &call) {
         }
     }
 
+    if (call.flags & trace::CALL_FLAG_ELIDED) {
+        warning(call) << "blob contents were only partially recorded, replaying zeros for the rest\n";
+    }
+
     callback(call);
 }
 
@@ -33,11 +33,14 @@
 #include <list>
 #include <map>
 #include <ostream>
+#include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
+#include "os_thread.hpp"
 #include "trace_model.hpp"
 #include "trace_parser.hpp"
 #include "trace_profiler.hpp"
@@ -56,7 +59,124 @@ class StateWriter;
 namespace retrace {
 
 
-extern trace::AbstractParser *parser;
+/**
+ * Replay instance.
+ *
+ * Holds the state of one trace being replayed.  There is usually just the
+ * default instance, but `--instances=N` replays several traces concurrently,
+ * so everything that depends on the trace being replayed (parser, handle
+ * maps, contexts, drawables, etc.) must be reached through the instance the
+ * current thread is bound to.
+ */
+class Instance
+{
+    static unsigned numSlots;
+
+    std::vector<void *> slots;
+    std::vector<void (*)(void *)> destructors;
+
+    void *
+    createSlot(unsigned index, void *(*create)(void), void (*destroy)(void *));
+
+public:
+    unsigned id;
+
+    trace::AbstractParser *parser = nullptr;
+    unsigned frameNo = 0;
+    unsigned callNo = 0;
+
+    Instance(unsigned _id = 0) :
+        id(_id)
+    {}
+
+    ~Instance();
+
+    static unsigned
+    allocSlot(void) {
+        return numSlots++;
+    }
+
+    inline void *
+    getSlot(unsigned index, void *(*create)(void), void (*destroy)(void *)) {
+        if (index < slots.size() && slots[index]) {
+            return slots[index];
+        }
+        return createSlot(index, create, destroy);
+    }
+};
+
+
+extern Instance defaultInstance;
+
+/**
+ * Whether threads may be bound to instances other than the default one.  Set
+ * before any such thread starts, so that the thread-local lookup below is
+ * avoided on ordinary replays.
+ */
+extern bool multipleInstances;
+
+/**
+ * Instance the current thread is replaying, or NULL for the default one.
+ */
+extern OS_THREAD_LOCAL Instance *
+currentInstance;
+
+static inline Instance &
+getInstance(void) {
+    if (!multipleInstances) {
+        return defaultInstance;
+    }
+    Instance *instance = currentInstance;
+    return instance ? *instance : defaultInstance;
+}
+
+
+/**
+ * Global variable with a separate value for each instance.
+ *
+ * Values are default constructed the first time each instance accesses them.
+ */
+template <class T>
+class InstanceLocal
+{
+    unsigned index;
+
+    static void *
+    create(void) {
+        return new T();
+    }
+
+    static void
+    destroy(void *ptr) {
+        delete static_cast<T *>(ptr);
+    }
+
+public:
+    InstanceLocal() :
+        index(Instance::allocSlot())
+    {}
+
+    inline T &
+    get(void) {
+        return *static_cast<T *>(getInstance().getSlot(index, create, destroy));
+    }
+
+    inline T & operator * (void) {
+        return get();
+    }
+
+    inline T * operator -> (void) {
+        return &get();
+    }
+
+    // Convenience for maps
+    template <class K>
+    inline auto operator [] (const K &key) -> decltype(std::declval<T &>()[key]) {
+        return get()[key];
+    }
+};
+
+
 extern trace::Profiler profiler;
 
 
@@ -145,6 +265,12 @@ extern bool ignoreRetvals;
 
 extern bool contextCheck;
 
+/**
+ * Let the driver compile shaders in parallel, by deferring compile/link
+ * status checks until the results are actually needed.
+ */
+extern bool parallelCompile;
+
 /**
  * Add profiling data to the dump when retracing.
  */
@@ -185,9 +311,6 @@ extern const char *driverModule;
 extern bool doubleBuffer;
 extern unsigned samples;
 
-extern unsigned frameNo;
-extern unsigned callNo;
-
 extern trace::DumpFlags dumpFlags;
 
 std::ostream &warning(trace::Call &call);
@@ -241,6 +364,32 @@ public:
 };
 
 
+/**
+ * Hook for resetting global replay state (handle maps, contexts, etc.)
+ * between traces, when several traces are replayed in the same process.
+ *
+ * Meant to be instantiated as static objects next to the state they reset.
+ */
+class ResetHook
+{
+    static ResetHook *first;
+
+    ResetHook *next;
+    void (*callback)(void);
+
+public:
+    ResetHook(void (*_callback)(void)) :
+        next(first),
+        callback(_callback)
+    {
+        first = this;
+    }
+
+    static void
+    resetAll(void);
+};
+
+
 class Dumper
 {
 public:
@@ -186,7 +186,7 @@ class ValueDeserializer(stdapi.Visitor, stdapi.ExpanderMixin):
         new_lvalue = lookupHandle(handle, lvalue)
         shaderObject = new_lvalue.startswith('_program_map') or new_lvalue.startswith('_shader_map')
         if shaderObject:
-            print 'if (glretrace::supportsARBShaderObjects) {'
+            print 'if (*glretrace::supportsARBShaderObjects) {'
             print '    if (retrace::verbosity >= 2) {'
             print '        std::cout << "%s " << size_t(%s) << " <- " << size_t(_handleARB_map[%s]) << "\\n";' % (handle.name, lvalue, lvalue)
             print '    }'
@@ -318,7 +318,7 @@ class SwizzledValueRegistrator(stdapi.Visitor, stdapi.ExpanderMixin):
             rvalue = "_origResult"
             entry = lookupHandle(handle, rvalue, True)
             if (entry.startswith('_program_map') or entry.startswith('_shader_map')):
-                print 'if (glretrace::supportsARBShaderObjects) {'
+                print 'if (*glretrace::supportsARBShaderObjects) {'
                 print '    _handleARB_map[%s] = %s;' % (rvalue, lvalue)
                 print '} else {'
                 print '    %s = %s;' % (entry, lvalue)
@@ -623,13 +623,22 @@ class Retracer:
         for handle in handles:
             if handle.name not in handle_names:
                 if handle.key is None:
-                    print 'static retrace::map<%s> _%s_map;' % (handle.type, handle.name)
+                    print 'static retrace::InstanceLocal< retrace::map<%s> > _%s_map;' % (handle.type, handle.name)
                 else:
                     key_name, key_type = handle.key
-                    print 'static std::map<%s, retrace::map<%s> > _%s_map;' % (key_type, handle.type, handle.name)
+                    print 'static retrace::InstanceLocal< std::map<%s, retrace::map<%s> > > _%s_map;' % (key_type, handle.type, handle.name)
                 handle_names.add(handle.name)
         print
 
+        print 'static void'
+        print '_resetHandleMaps(void) {'
+        for handle_name in sorted(handle_names):
+            print '    _%s_map->clear();' % handle_name
+        print '}'
+        print
+        print 'static retrace::ResetHook _resetHandleMapsHook(&_resetHandleMaps);'
+        print
+
         functions = filter(self.filterFunction, api.getAllFunctions())
         for function in functions:
             if function.sideeffects and not function.internal:
@@ -26,14 +26,23 @@
  **************************************************************************/
 
 
+#include <stdio.h>
 #include <string.h>
 #include <limits.h> // for CHAR_MAX
 #include <memory> // for unique_ptr
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <string>
+#include <vector>
 #include <regex>
+#include <fstream>
+#include <sstream>
 #include <getopt.h>
 #ifndef _WIN32
 #include <unistd.h> // for isatty()
+#include <sys/types.h>
+#include <sys/wait.h>
 #endif
 #ifdef _WIN32
 #include <malloc.h> // _get_heap_handle
@@ -47,6 +56,7 @@
 #include "os_time.hpp"
 #include "os_thread.hpp"
 #include "image.hpp"
+#include "image_pack.hpp"
 #include "threaded_snapshot.hpp"
 #include "trace_callset.hpp"
 #include "trace_dump.hpp"
@@ -58,6 +68,21 @@
 
 
 static bool waitOnFinish = false;
+static bool pacing = false;
+static bool reportHotspots = false;
+static int loopCount = 0;
+
+static const char *batchFileName = nullptr;
+static bool batchFork = false;
+
+// Number of concurrent replay instances, or zero for a normal replay
+static unsigned numInstances = 0;
+
+// Set when the replay should stop early (e.g., after the last snapshot)
+static bool replayStopped = false;
+
+static void
+adjustProcessName(const std::string &name);
 
 static const char *snapshotPrefix = "";
 static enum {
@@ -69,6 +94,10 @@ static enum {
 static trace::CallSet snapshotFrequency;
 static unsigned snapshotInterval = 0;
 
+// Single container receiving all snapshots, instead of one file each
+static const char *snapshotPackName = nullptr;
+static image::PackWriter snapshotPack;
+
 static unsigned dumpStateCallNo = ~0;
 
 retrace::Retracer retracer;
@@ -77,7 +106,6 @@ retrace::Retracer retracer;
 namespace retrace {
 
 
-trace::AbstractParser *parser;
 trace::Profiler profiler;
 
 
@@ -116,10 +144,7 @@ bool useCallNos = true;
 bool singleThread = false;
 bool ignoreRetvals = false;
 bool contextCheck = true;
-
-unsigned frameNo = 0;
-unsigned callNo = 0;
-
+bool parallelCompile = false;
 
 static void
 takeSnapshot(unsigned call_no);
@@ -127,7 +152,7 @@ takeSnapshot(unsigned call_no);
 
 void
 frameComplete(trace::Call &call) {
-    ++frameNo;
+    ++getInstance().frameNo;
 
     if (!(call.flags & trace::CALL_FLAG_END_FRAME) &&
         snapshotFrequency.contains(call)) {
@@ -169,6 +194,7 @@ Dumper *dumper = &defaultDumper;
 
 typedef StateWriter *(*StateWriterFactory)(std::ostream &);
 static StateWriterFactory stateWriterFactory = createJSONStateWriter;
+static bool dumpHashes = false;
 
 
 static Snapshotter *snapshotter;
@@ -194,7 +220,10 @@ takeSnapshot(unsigned call_no, int mrt, unsigned snapshot_no) {
     if ((snapshotInterval == 0 ||
         (snapshot_no % snapshotInterval) == 0)) {
 
-        if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
+        if (snapshotPack.isOpen()) {
+            // The pack keeps both numbers, so there's no need to pick one
+            snapshotter->writePack(&snapshotPack, call_no, snapshot_no, mrt, src.release());
+        } else if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
             char comment[21];
             snprintf(comment, sizeof comment, "%u",
                      useCallNos ? call_no : snapshot_no);
@@ -238,9 +267,10 @@ takeSnapshot(unsigned call_no, int mrt, unsigned snapshot_no) {
     return;
 }
 
+static unsigned snapshot_no = 0;
+
 static void
 takeSnapshot(unsigned call_no) {
-    static unsigned snapshot_no = 0;
     int cnt = dumper->getSnapshotCount();
 
     if (retrace::snapshotMRT) {
@@ -254,6 +284,124 @@ takeSnapshot(unsigned call_no) {
     snapshot_no++;
 }
 
+/*
+ * Capture-time pacing and hotspots, based on the call timestamps recorded
+ * when tracing with TRACE_TIMESTAMPS.
+ */
+
+static long long paceStartTime = 0;
+static unsigned long long paceFirstEnterTime = trace::Call::NO_TIMESTAMP;
+
+/**
+ * Delay the call until the same time has elapsed since the first call as
+ * it did when the trace was captured.
+ */
+static void
+paceCall(const trace::Call *call) {
+    if (call->enterTime == trace::Call::NO_TIMESTAMP) {
+        return;
+    }
+
+    long long now = os::getTime();
+    if (paceFirstEnterTime == trace::Call::NO_TIMESTAMP ||
+        call->enterTime < paceFirstEnterTime) {
+        // First call, or looping back over the last frame
+        paceFirstEnterTime = call->enterTime;
+        paceStartTime = now;
+        return;
+    }
+
+    long long target = paceStartTime +
+        (long long)((call->enterTime - paceFirstEnterTime) * (os::timeFrequency * 1.0e-9));
+    if (target > now) {
+        os::sleep((target - now) * 1000000LL / os::timeFrequency);
+    }
+}
+
+struct Hotspot {
+    unsigned long long numCalls = 0;
+    unsigned long long numTimedCalls = 0;
+    unsigned long long captureTime = 0; // nanoseconds
+    long long replayTime = 0; // os::timeFrequency units
+};
+
+static std::map<std::string, Hotspot> hotspots;
+
+static void
+addHotspot(const trace::Call *call, long long replayTime) {
+    Hotspot &hotspot = hotspots[call->name()];
+    ++hotspot.numCalls;
+    hotspot.replayTime += replayTime;
+    if (call->hasTimestamps() && call->leaveTime >= call->enterTime) {
+        ++hotspot.numTimedCalls;
+        hotspot.captureTime += call->leaveTime - call->enterTime;
+    }
+}
+
+static void
+dumpHotspots(void) {
+    typedef std::pair<std::string, Hotspot> Entry;
+    std::vector<Entry> entries(hotspots.begin(), hotspots.end());
+
+    bool timed = false;
+    for (auto &entry : entries) {
+        timed = timed || entry.second.numTimedCalls;
+    }
+    if (!timed) {
+        std::cerr << "warning: trace has no call timestamps (capture with TRACE_TIMESTAMPS=1)\n";
+    }
+
+    hotspots.clear();
+
+    std::sort(entries.begin(), entries.end(),
+              [timed](const Entry &a, const Entry &b) {
+                  if (timed) {
+                      return a.second.captureTime > b.second.captureTime;
+                  }
+                  return a.second.replayTime > b.second.replayTime;
+              });
+
+    const size_t maxEntries = 30;
+    fprintf(stdout, "# %-40s %10s %14s %14s %8s\n",
+            "function", "calls", "capture (ms)", "replay (ms)", "ratio");
+    for (size_t i = 0; i < entries.size() && i < maxEntries; ++i) {
+        const Hotspot &hotspot = entries[i].second;
+        double captureMs = hotspot.captureTime * 1.0e-6;
+        double replayMs = hotspot.replayTime * (1.0e3 / os::timeFrequency);
+        fprintf(stdout, "  %-40s %10llu %14.3f %14.3f",
+                entries[i].first.c_str(), hotspot.numCalls, captureMs, replayMs);
+        if (hotspot.numTimedCalls && captureMs > 0) {
+            fprintf(stdout, " %8.2f\n", replayMs / captureMs);
+        } else {
+            fprintf(stdout, " %8s\n", "-");
+        }
+    }
+    fflush(stdout);
+}
+
+
+/**
+ * Stop replaying the current trace.  Exits, unless replaying a batch of
+ * traces.
+ */
+static void
+stopReplay(void) {
+    if (!batchFileName) {
+        exit(0);
+    }
+    replayStopped = true;
+}
+
+
+static inline trace::Call *
+parseCall(void) {
+    if (replayStopped) {
+        return NULL;
+    }
+    return getInstance().parser->parse_call();
+}
+
+
 /**
  * Retrace one call.
  *
@@ -262,7 +410,7 @@ takeSnapshot(unsigned call_no) {
  */
 static void
 retraceCall(trace::Call *call) {
-    callNo = call->no;
+    getInstance().callNo = call->no;
 
     bool swapRenderTarget = call->flags &
         trace::CALL_FLAG_SWAP_RENDERTARGET;
@@ -282,23 +430,36 @@ retraceCall(trace::Call *call) {
         }
     }
 
-    retracer.retrace(*call);
+    if (pacing) {
+        paceCall(call);
+    }
+
+    if (reportHotspots) {
+        long long replayStartTime = os::getTime();
+        retracer.retrace(*call);
+        addHotspot(call, os::getTime() - replayStartTime);
+    } else {
+        retracer.retrace(*call);
+    }
 
     if (doSnapshot) {
         if (!swapRenderTarget) {
             takeSnapshot(call->no);
         }
         if (call->no >= snapshotFrequency.getLast()) {
-            exit(0);
+            stopReplay();
         }
     }
 
     if (call->no >= dumpStateCallNo &&
         dumper->canDump()) {
         StateWriter *writer = stateWriterFactory(std::cout);
+        if (dumpHashes) {
+            writer = createHashingStateWriter(writer);
+        }
         dumper->dumpState(*writer);
         delete writer;
-        exit(0);
+        stopReplay();
     }
 }
 
@@ -358,6 +519,8 @@ private:
 
     RelayRace *race;
 
+    Instance *instance;
+
     unsigned leg;
 
     os::mutex mutex;
@@ -377,6 +540,7 @@ private:
 public:
     RelayRunner(RelayRace *race, unsigned _leg) :
         race(race),
+        instance(currentInstance),
         leg(_leg),
         finished(false),
         baton(0)
@@ -437,7 +601,7 @@ public:
 
             retraceCall(call);
             delete call;
-            call = parser->parse_call();
+            call = parseCall();
 
         } while (call && call->thread_id == leg);
 
@@ -491,6 +655,7 @@ public:
 
 void
 RelayRunner::runnerThread(RelayRunner *_this) {
+    currentInstance = _this->instance;
     _this->runRace();
 }
 
@@ -539,7 +704,7 @@ RelayRace::getRunner(unsigned leg) {
 void
 RelayRace::run(void) {
     trace::Call *call;
-    call = parser->parse_call();
+    call = parseCall();
     if (!call) {
         /* Nothing to do */
         return;
@@ -599,16 +764,16 @@ RelayRace::stopRunners(void) {
 
 static void
 mainLoop() {
-    addCallbacks(retracer);
+    Instance &instance = getInstance();
 
     long long startTime = 0;
-    frameNo = 0;
+    instance.frameNo = 0;
 
     startTime = os::getTime();
 
     if (singleThread) {
         trace::Call *call;
-        while ((call = parser->parse_call())) {
+        while ((call = parseCall())) {
             retraceCall(call);
             delete call;
         }
@@ -622,10 +787,20 @@ mainLoop() {
     float timeInterval = (endTime - startTime) * (1.0 / os::timeFrequency);
 
     if ((retrace::verbosity >= -1) || (retrace::profiling)) {
-        std::cout <<
-            "Rendered " << frameNo << " frames"
+        std::ostringstream line;
+        if (numInstances) {
+            line << "instance " << instance.id << ": ";
+        }
+        line <<
+            "Rendered " << instance.frameNo << " frames"
             " in " <<  timeInterval << " secs,"
-            " average of " << (frameNo/timeInterval) << " fps\n";
+            " average of " << (instance.frameNo/timeInterval) << " fps\n";
+        std::cout << line.str();
+        std::cout.flush();
+    }
+
+    if (reportHotspots) {
+        dumpHotspots();
     }
 
     if (waitOnFinish) {
@@ -636,9 +811,351 @@ mainLoop() {
 }
 
 
+/**
+ * Replay one trace file.
+ */
+static bool
+replayTrace(const char *filename) {
+    trace::AbstractParser *&parser = getInstance().parser;
+
+    parser = new trace::Parser;
+    if (loopCount) {
+        parser = lastFrameLoopParser(parser, loopCount);
+    }
+
+    if (!parser->open(filename)) {
+        delete parser;
+        parser = NULL;
+        return false;
+    }
+
+    auto &properties = parser->getProperties();
+    auto modeIt = properties.find("trace.mode");
+    if (modeIt != properties.end() && modeIt->second == "call-log") {
+        std::cerr << "error: " << filename << " is a call log without arguments, and can't be replayed\n";
+        delete parser;
+        parser = NULL;
+        return false;
+    }
+
+    auto processNameIt = properties.find("process.name");
+    if (processNameIt != properties.end()) {
+        adjustProcessName(processNameIt->second);
+    }
+
+    mainLoop();
+
+    parser->close();
+
+    delete parser;
+    parser = NULL;
+
+    return true;
+}
+
+
 } /* namespace retrace */
 
 
+static bool snapshotThreaded = false;
+
+
+static void
+setUpReplay(void) {
+    if (snapshotThreaded) {
+        retrace::snapshotter = new ThreadedSnapshotter(os::thread::hardware_concurrency());
+    } else {
+        retrace::snapshotter = new Snapshotter();
+    }
+
+    retrace::setUp();
+    retrace::addCallbacks(retracer);
+    if (retrace::profiling && !retrace::profilingWithBackends) {
+        retrace::profiler.setup(retrace::profilingCpuTimes,
+                                retrace::profilingGpuTimes,
+                                retrace::profilingPixelsDrawn,
+                                retrace::profilingMemoryUsage);
+    }
+}
+
+
+/*
+ * Batch replay, i.e., replaying many traces in the same process, so that the
+ * window system setup and visuals are shared across them.
+ */
+
+enum BatchStatus {
+    BATCH_PENDING = 0,
+    BATCH_OK,
+    BATCH_FAILED,
+    BATCH_CRASHED,
+};
+
+
+static bool
+readBatchList(const char *filename, std::vector<std::string> &traces) {
+    std::ifstream stream(filename);
+    if (!stream) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(stream, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        size_t end = line.find_last_not_of(" \t\r");
+        traces.push_back(line.substr(start, end + 1 - start));
+    }
+
+    return true;
+}
+
+
+/**
+ * Replay one trace of the batch, writing its snapshots with a per-trace
+ * prefix, and reset all global state afterwards.
+ */
+static BatchStatus
+replayBatchTrace(const std::string &filename, const std::string &baseSnapshotPrefix) {
+    std::string prefix = baseSnapshotPrefix;
+    if (retrace::dumpingSnapshots && prefix != "-") {
+        os::String stem(filename.c_str());
+        stem.trimDirectory();
+        stem.trimExtension();
+        prefix += stem.str();
+        prefix += "-";
+    }
+    snapshotPrefix = prefix.c_str();
+
+    retrace::getInstance().callNo = 0;
+    retrace::snapshot_no = 0;
+    replayStopped = false;
+    retrace::paceFirstEnterTime = trace::Call::NO_TIMESTAMP;
+
+    if (retrace::verbosity >= -1) {
+        std::cout << "batch: replaying " << filename << "\n";
+        std::cout.flush();
+    }
+
+    bool ok = true;
+    for (retrace::curPass = 0; ok && retrace::curPass < retrace::numPasses;
+         retrace::curPass++)
+    {
+        ok = retrace::replayTrace(filename.c_str());
+    }
+    retrace::curPass = 0;
+
+    retrace::ResetHook::resetAll();
+    trace::Blob::releaseBound();
+
+    snapshotPrefix = "";
+
+    return ok ? BATCH_OK : BATCH_FAILED;
+}
+
+
+#ifndef _WIN32
+
+/**
+ * Replay the batch in forked worker processes, so that crashes are isolated
+ * to the trace that caused them.  The worker replays traces until it's done
+ * or crashes, in which case a new worker resumes after the offending trace.
+ */
+static void
+runForkedBatch(const std::vector<std::string> &traces,
+               const std::string &baseSnapshotPrefix,
+               std::vector<BatchStatus> &results)
+{
+    struct Message {
+        uint32_t index;
+        int32_t status;
+    };
+
+    size_t next = 0;
+    while (next < traces.size()) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            std::cerr << "error: failed to create pipe\n";
+            exit(1);
+        }
+
+        std::cout.flush();
+        fflush(stdout);
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "error: failed to fork\n";
+            exit(1);
+        }
+
+        if (pid == 0) {
+            // worker
+            close(fds[0]);
+            setUpReplay();
+            for (size_t i = next; i < traces.size(); ++i) {
+                Message message = {uint32_t(i), BATCH_PENDING};
+                ssize_t ret = write(fds[1], &message, sizeof message);
+                message.status = replayBatchTrace(traces[i], baseSnapshotPrefix);
+                std::cout.flush();
+                ret = write(fds[1], &message, sizeof message);
+                (void)ret;
+            }
+            delete retrace::snapshotter;
+            std::cout.flush();
+            fflush(stdout);
+            // XXX: X often hangs on XCloseDisplay, so skip any cleanup
+            _exit(0);
+        }
+
+        // parent
+        close(fds[1]);
+        size_t current = traces.size();
+        Message message;
+        while (read(fds[0], &message, sizeof message) == sizeof message) {
+            if (message.index >= traces.size()) {
+                break;
+            }
+            current = message.index;
+            results[current] = BatchStatus(message.status);
+            if (message.status != BATCH_PENDING) {
+                current = traces.size();
+                next = message.index + 1;
+            }
+        }
+        close(fds[0]);
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+
+        if (current < traces.size()) {
+            std::cerr << "error: " << traces[current] << ": worker ";
+            if (WIFSIGNALED(status)) {
+                std::cerr << "killed by signal " << WTERMSIG(status) << "\n";
+            } else {
+                std::cerr << "exited with status " << WEXITSTATUS(status) << "\n";
+            }
+            results[current] = BATCH_CRASHED;
+            next = current + 1;
+        } else if (next < traces.size()) {
+            // Worker died between traces
+            results[next] = BATCH_CRASHED;
+            ++next;
+        }
+    }
+}
+
+#endif /* !_WIN32 */
+
+
+/*
+ * Concurrent replay of several instances, to measure how the driver scales
+ * with independent workloads.  Each instance has its own thread, parser,
+ * contexts and handle maps (see retrace::Instance).
+ */
+
+static void
+instanceThread(retrace::Instance *instance, const char *filename, bool *ok) {
+    retrace::currentInstance = instance;
+    *ok = retrace::replayTrace(filename);
+}
+
+
+static int
+runInstances(int argc, char **argv) {
+    unsigned numTraces = argc - optind;
+
+    std::vector<retrace::Instance *> instances(numInstances);
+    std::vector<os::thread> threads(numInstances);
+    std::unique_ptr<bool[]> results(new bool[numInstances]);
+
+    retrace::multipleInstances = true;
+
+    long long startTime = os::getTime();
+
+    for (unsigned i = 0; i < numInstances; ++i) {
+        instances[i] = new retrace::Instance(i);
+        results[i] = false;
+        const char *filename = argv[optind + i % numTraces];
+        threads[i] = os::thread(instanceThread, instances[i], filename, &results[i]);
+    }
+
+    unsigned long long totalFrames = 0;
+    unsigned numFailed = 0;
+    for (unsigned i = 0; i < numInstances; ++i) {
+        threads[i].join();
+        if (results[i]) {
+            totalFrames += instances[i]->frameNo;
+        } else {
+            ++numFailed;
+        }
+        delete instances[i];
+    }
+
+    long long endTime = os::getTime();
+    float timeInterval = (endTime - startTime) * (1.0 / os::timeFrequency);
+
+    std::cout <<
+        "Rendered " << totalFrames << " frames"
+        " on " << numInstances << " instances"
+        " in " << timeInterval << " secs,"
+        " aggregate of " << (totalFrames/timeInterval) << " fps\n";
+
+    return numFailed ? 1 : 0;
+}
+
+
+static int
+runBatch(void) {
+    std::vector<std::string> traces;
+    if (!readBatchList(batchFileName, traces)) {
+        return 1;
+    }
+
+    std::string baseSnapshotPrefix(snapshotPrefix);
+    std::vector<BatchStatus> results(traces.size(), BATCH_PENDING);
+
+#ifndef _WIN32
+    if (batchFork) {
+        runForkedBatch(traces, baseSnapshotPrefix, results);
+    } else
+#endif
+    {
+        setUpReplay();
+        for (size_t i = 0; i < traces.size(); ++i) {
+            results[i] = replayBatchTrace(traces[i], baseSnapshotPrefix);
+        }
+        delete retrace::snapshotter;
+        retrace::snapshotter = nullptr;
+    }
+
+    // Summary, on stderr so that it doesn't interfere with snapshots on stdout
+    unsigned numFailed = 0;
+    for (size_t i = 0; i < traces.size(); ++i) {
+        const char *status;
+        switch (results[i]) {
+        case BATCH_OK:
+            status = "ok";
+            break;
+        case BATCH_CRASHED:
+            status = "crashed";
+            ++numFailed;
+            break;
+        default:
+            status = "failed";
+            ++numFailed;
+            break;
+        }
+        std::cerr << "batch: " << traces[i] << ": " << status << "\n";
+    }
+    std::cerr << "batch: " << (traces.size() - numFailed) << " of " << traces.size() << " traces replayed successfully\n";
+
+    return numFailed ? 1 : 0;
+}
+
+
 static void
 usage(const char *argv0) {
     std::cout <<
@@ -672,15 +1189,23 @@ usage(const char *argv0) {
         "      --snapshot-format=FMT       use (PNM, RGB, or MD5; default is PNM) when writing to stdout output\n"
         "  -S, --snapshot=CALLSET  calls to snapshot (default is every frame)\n"
         "      --snapshot-interval=N    specify a frame interval when generating snaphots (default is 0)\n"
+        "      --snapshot-pack=FILE    append PNG snapshots to a single indexed pack file\n"
         "  -t, --snapshot-threaded encode screenshots on multiple threads\n"
         "  -v, --verbose           increase output verbosity\n"
         "  -D, --dump-state=CALL   dump state at specific call no\n"
         "      --dump-format=FORMAT dump state format (`json` or `ubjson`)\n"
+        "      --dump-hashes       add a hash of the contents to every object in the state dump\n"
         "  -w, --wait              waitOnFinish on final frame\n"
         "      --loop[=N]          loop N times (N<0 continuously) replaying final frame.\n"
         "      --singlethread      use a single thread to replay command stream\n"
         "      --ignore-retvals    ignore return values in wglMakeCurrent, etc\n"
+        "      --pace              honor the call pacing recorded with TRACE_TIMESTAMPS\n"
+        "      --hotspots          report capture-time vs replay-time cpu cost per function\n"
+        "      --batch=LISTFILE    replay the traces listed in LISTFILE (one per line) in the same process\n"
+        "      --batch-fork        replay batches in forked worker processes, to survive crashes\n"
+        "      --instances=N       replay N instances of the given trace(s) concurrently, each on its own thread\n"
         "      --no-context-check  don't check that the actual GL context version matches the requested version\n"
+        "      --parallel-compile  let the driver compile shaders in parallel, deferring compile/link status checks\n"
     ;
 }
 
@@ -707,11 +1232,19 @@ enum {
     SINGLETHREAD_OPT,
     IGNORE_RETVALS_OPT,
     NO_CONTEXT_CHECK,
+    PARALLEL_COMPILE_OPT,
     SNAPSHOT_ALPHA_OPT,
     SNAPSHOT_FORMAT_OPT,
     SNAPSHOT_INTERVAL_OPT,
+    SNAPSHOT_PACK_OPT,
     DUMP_FORMAT_OPT,
-    MARKERS_OPT
+    DUMP_HASHES_OPT,
+    MARKERS_OPT,
+    PACE_OPT,
+    HOTSPOTS_OPT,
+    BATCH_OPT,
+    BATCH_FORK_OPT,
+    INSTANCES_OPT
 };
 
 const static char *
@@ -729,6 +1262,7 @@ longOptions[] = {
     {"driver", required_argument, 0, DRIVER_OPT},
     {"dump-state", required_argument, 0, 'D'},
     {"dump-format", required_argument, 0, DUMP_FORMAT_OPT},
+    {"dump-hashes", no_argument, 0, DUMP_HASHES_OPT},
     {"fullscreen", no_argument, 0, FULLSCREEN_OPT},
     {"headless", no_argument, 0, HEADLESS_OPT},
     {"help", no_argument, 0, 'h'},
@@ -748,6 +1282,7 @@ longOptions[] = {
     {"snapshot-alpha", no_argument, 0, SNAPSHOT_ALPHA_OPT},
     {"snapshot-format", required_argument, 0, SNAPSHOT_FORMAT_OPT},
     {"snapshot-interval", required_argument, 0, SNAPSHOT_INTERVAL_OPT},
+    {"snapshot-pack", required_argument, 0, SNAPSHOT_PACK_OPT},
     {"snapshot-prefix", required_argument, 0, 's'},
     {"snapshot-threaded", no_argument, 0, 't'},
     {"verbose", no_argument, 0, 'v'},
@@ -756,13 +1291,19 @@ longOptions[] = {
     {"singlethread", no_argument, 0, SINGLETHREAD_OPT},
     {"ignore-retvals", no_argument, 0, IGNORE_RETVALS_OPT},
     {"no-context-check", no_argument, 0, NO_CONTEXT_CHECK},
+    {"parallel-compile", no_argument, 0, PARALLEL_COMPILE_OPT},
+    {"pace", no_argument, 0, PACE_OPT},
+    {"hotspots", no_argument, 0, HOTSPOTS_OPT},
+    {"batch", required_argument, 0, BATCH_OPT},
+    {"batch-fork", no_argument, 0, BATCH_FORK_OPT},
+    {"instances", required_argument, 0, INSTANCES_OPT},
     {0, 0, 0, 0}
 };
 
 
 static void exceptionCallback(void)
 {
-    std::cerr << retrace::callNo << ": error: caught an unhandled exception\n";
+    std::cerr << retrace::getInstance().callNo << ": error: caught an unhandled exception\n";
 }
 
 
@@ -899,9 +1440,7 @@ extern "C"
 int main(int argc, char **argv)
 {
     using namespace retrace;
-    int loopCount = 0;
     int i;
-    bool snapshotThreaded = false;
 
     os::setDebugOutput(os::OUTPUT_STDERR);
 
@@ -952,6 +1491,9 @@ int main(int argc, char **argv)
                 return EXIT_FAILURE;
             }
             break;
+        case DUMP_HASHES_OPT:
+            dumpHashes = true;
+            break;
         case CORE_OPT:
             retrace::setFeatureLevel("3_2_core");
             break;
@@ -999,6 +1541,9 @@ int main(int argc, char **argv)
         case NO_CONTEXT_CHECK:
             retrace::contextCheck = false;
             break;
+        case PARALLEL_COMPILE_OPT:
+            retrace::parallelCompile = true;
+            break;
         case 's':
             dumpingSnapshots = true;
             snapshotPrefix = optarg;
@@ -1045,6 +1590,13 @@ int main(int argc, char **argv)
         case SNAPSHOT_INTERVAL_OPT:
             snapshotInterval = atoi(optarg);
             break;
+        case SNAPSHOT_PACK_OPT:
+            dumpingSnapshots = true;
+            snapshotPackName = optarg;
+            if (snapshotFrequency.empty()) {
+                snapshotFrequency = trace::CallSet(trace::FREQUENCY_FRAME);
+            }
+            break;
         case 't':
             snapshotThreaded = true;
             break;
@@ -1057,6 +1609,25 @@ int main(int argc, char **argv)
         case LOOP_OPT:
             loopCount = trace::intOption(optarg, -1);
             break;
+        case PACE_OPT:
+            pacing = true;
+            break;
+        case HOTSPOTS_OPT:
+            reportHotspots = true;
+            break;
+        case BATCH_OPT:
+            batchFileName = optarg;
+            break;
+        case BATCH_FORK_OPT:
+            batchFork = true;
+            break;
+        case INSTANCES_OPT:
+            numInstances = trace::intOption(optarg, 0);
+            if (numInstances < 1) {
+                std::cerr << "error: invalid number of instances " << optarg << "\n";
+                return 1;
+            }
+            break;
         case PGPU_OPT:
             retrace::debug = 0;
             retrace::profiling = true;
@@ -1127,6 +1698,31 @@ int main(int argc, char **argv)
         }
     }
 
+    if (snapshotPackName) {
+        if (snapshotPrefix[0]) {
+            std::cerr << "error: --snapshot-pack can't be combined with --snapshot-prefix\n";
+            return 1;
+        }
+        if (batchFileName) {
+            std::cerr << "error: --snapshot-pack can't be combined with --batch\n";
+            return 1;
+        }
+    }
+
+    if (numInstances) {
+        // These rely on state which is shared by all instances
+        if (retrace::dumpingSnapshots || !snapshotFrequency.empty() ||
+            dumpStateCallNo != ~0U || retrace::profiling ||
+            pacing || reportHotspots || waitOnFinish || batchFileName) {
+            std::cerr << "error: --instances can't be combined with snapshots, state dumps, profiling, pacing, hotspots, waiting, or batches\n";
+            return 1;
+        }
+        if (optind >= argc) {
+            std::cerr << "error: --instances requires at least one trace\n";
+            return 1;
+        }
+    }
+
 #ifndef _WIN32
     if (!isatty(STDOUT_FILENO)) {
         dumpFlags |= trace::DUMP_FLAG_NO_COLOR;
@@ -1143,54 +1739,58 @@ int main(int argc, char **argv)
     }
 #endif
 
-    if (snapshotThreaded) {
-        snapshotter = new ThreadedSnapshotter(os::thread::hardware_concurrency());
-    } else {
-        snapshotter = new Snapshotter();
+    os::setExceptionCallback(exceptionCallback);
+
+    if (batchFileName) {
+        int ret = runBatch();
+        os::resetExceptionCallback();
+#ifdef _WIN32
+        if (mmRes == MMSYSERR_NOERROR) {
+            timeEndPeriod(tc.wPeriodMin);
+        }
+#endif
+        return ret;
     }
 
-    retrace::setUp();
-    if (retrace::profiling && !retrace::profilingWithBackends) {
-        retrace::profiler.setup(retrace::profilingCpuTimes,
-                                retrace::profilingGpuTimes,
-                                retrace::profilingPixelsDrawn,
-                                retrace::profilingMemoryUsage);
+    if (snapshotPackName && !snapshotPack.open(snapshotPackName)) {
+        std::cerr << "error: failed to create snapshot pack `" << snapshotPackName << "`\n";
+        return 1;
     }
 
-    os::setExceptionCallback(exceptionCallback);
+    setUpReplay();
+
+    if (numInstances) {
+        int ret = runInstances(argc, argv);
+        os::resetExceptionCallback();
+        delete snapshotter;
+#ifdef _WIN32
+        if (mmRes == MMSYSERR_NOERROR) {
+            timeEndPeriod(tc.wPeriodMin);
+        }
+#endif
+        return ret;
+    }
 
     for (retrace::curPass = 0; retrace::curPass < retrace::numPasses;
          retrace::curPass++)
     {
         for (i = optind; i < argc; ++i) {
-            parser = new trace::Parser;
-            if (loopCount) {
-                parser = lastFrameLoopParser(parser, loopCount);
-            }
-
-            if (!parser->open(argv[i])) {
+            if (!retrace::replayTrace(argv[i])) {
                 return 1;
             }
-
-            auto &properties = parser->getProperties();
-            auto processNameIt = properties.find("process.name");
-            if (processNameIt != properties.end()) {
-                adjustProcessName(processNameIt->second);
-            }
-
-            retrace::mainLoop();
-
-            parser->close();
-
-            delete parser;
-            parser = NULL;
         }
     }
 
     os::resetExceptionCallback();
 
+    // Wait for any pending snapshot before writing the pack index
     delete snapshotter;
 
+    if (!snapshotPack.close()) {
+        std::cerr << "error: failed to write snapshot pack `" << snapshotPackName << "`\n";
+        return 1;
+    }
+
     // XXX: X often hangs on XCloseDisplay
     //retrace::cleanUp();
 
@@ -45,7 +45,17 @@ struct Region
 };
 
 typedef std::map<unsigned long long, Region> RegionMap;
-static RegionMap regionMap;
+static InstanceLocal<RegionMap> regionMap;
+
+static InstanceLocal< std::map<unsigned long long, void *> > _obj_map;
+
+static void
+resetRegions(void) {
+    regionMap->clear();
+    _obj_map->clear();
+}
+
+static ResetHook resetRegionsHook(&resetRegions);
 
 
 static inline bool
@@ -66,9 +76,9 @@ intersects(RegionMap::iterator &it, unsigned long long start, unsigned long long
 // Iterator to the first region that contains the address, or the first after
 static RegionMap::iterator
 lowerBound(unsigned long long address) {
-    RegionMap::iterator it = regionMap.lower_bound(address);
+    RegionMap::iterator it = regionMap->lower_bound(address);
 
-    while (it != regionMap.begin()) {
+    while (it != regionMap->begin()) {
         RegionMap::iterator pred = it;
         --pred;
         if (contains(pred, address)) {
@@ -79,7 +89,7 @@ lowerBound(unsigned long long address) {
     }
 
 #ifndef NDEBUG
-    if (it != regionMap.end()) {
+    if (it != regionMap->end()) {
         assert(contains(it, address) || it->first > address);
     }
 #endif
@@ -90,10 +100,10 @@ lowerBound(unsigned long long address) {
 // Iterator to the first region that starts after the address
 static RegionMap::iterator
 upperBound(unsigned long long address) {
-    RegionMap::iterator it = regionMap.upper_bound(address);
+    RegionMap::iterator it = regionMap->upper_bound(address);
 
 #ifndef NDEBUG
-    if (it != regionMap.end()) {
+    if (it != regionMap->end()) {
         assert(it->first >= address);
     }
 #endif
@@ -133,7 +143,7 @@ addRegion(trace::Call &call, unsigned long long address, void *buffer, unsigned
         RegionMap::iterator stop = upperBound(address + size - 1);
         if (0) {
             // Forget all regions that intersect this new one.
-            regionMap.erase(start, stop);
+            regionMap->erase(start, stop);
         } else {
             for (RegionMap::iterator it = start; it != stop; ++it) {
                 warning(call) << std::hex <<
@@ -155,12 +165,12 @@ addRegion(trace::Call &call, unsigned long long address, void *buffer, unsigned
 
 static RegionMap::iterator
 lookupRegion(unsigned long long address) {
-    RegionMap::iterator it = regionMap.lower_bound(address);
+    RegionMap::iterator it = regionMap->lower_bound(address);
 
-    if (it == regionMap.end() ||
+    if (it == regionMap->end() ||
         it->first > address) {
-        if (it == regionMap.begin()) {
-            return regionMap.end();
+        if (it == regionMap->begin()) {
+            return regionMap->end();
         } else {
             --it;
         }
@@ -173,7 +183,7 @@ lookupRegion(unsigned long long address) {
 void
 setRegionPitch(unsigned long long address, unsigned dimensions, int tracePitch, int realPitch) {
     RegionMap::iterator it = lookupRegion(address);
-    if (it != regionMap.end()) {
+    if (it != regionMap->end()) {
         Region &region = it->second;
         region.dimensions = dimensions;
         region.tracePitch = tracePitch;
@@ -186,8 +196,8 @@ setRegionPitch(unsigned long long address, unsigned dimensions, int tracePitch,
 void
 delRegion(unsigned long long address) {
     RegionMap::iterator it = lookupRegion(address);
-    if (it != regionMap.end()) {
-        regionMap.erase(it);
+    if (it != regionMap->end()) {
+        regionMap->erase(it);
     } else {
         assert(0);
     }
@@ -196,9 +206,9 @@ delRegion(unsigned long long address) {
 
 void
 delRegionByPointer(void *ptr) {
-    for (RegionMap::iterator it = regionMap.begin(); it != regionMap.end(); ++it) {
+    for (RegionMap::iterator it = regionMap->begin(); it != regionMap->end(); ++it) {
         if (it->second.buffer == ptr) {
-            regionMap.erase(it);
+            regionMap->erase(it);
             return;
         }
     }
@@ -208,7 +218,7 @@ delRegionByPointer(void *ptr) {
 static void
 lookupAddress(unsigned long long address, Range &range) {
     RegionMap::const_iterator it = lookupRegion(address);
-    if (it != regionMap.end()) {
+    if (it != regionMap->end()) {
         const Region & region = it->second;
         unsigned long long offset = address - it->first;
         assert(offset < region.size);
@@ -300,8 +310,6 @@ toPointer(trace::Value &value, bool bind)
 
 
 
-static std::map<unsigned long long, void *> _obj_map;
-
 void
 addObj(trace::Call &call, trace::Value &value, void *obj) {
     unsigned long long address = value.toUIntPtr();
@@ -327,7 +335,7 @@ addObj(trace::Call &call, trace::Value &value, void *obj) {
 void
 delObj(trace::Value &value) {
     unsigned long long address = value.toUIntPtr();
-    _obj_map.erase(address);
+    _obj_map->erase(address);
     if (retrace::verbosity >= 2) {
         std::cout << std::hex << "obj 0x" << address << std::dec << " del\n";
     }
@@ -162,7 +162,7 @@ public:
         {}
     };
 
-    void
+    virtual void
     writeImage(image::Image *image, const ImageDesc & desc);
 
     inline void
@@ -180,3 +180,11 @@ createJSONStateWriter(std::ostream &os);
 
 StateWriter *
 createUBJSONStateWriter(std::ostream &os);
+
+
+/*
+ * Wrap a state writer so that every object gets a `__hash__` member with the
+ * hash of its contents.  Takes ownership of the wrapped writer.
+ */
+StateWriter *
+createHashingStateWriter(StateWriter *writer);
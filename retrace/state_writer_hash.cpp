@@ -0,0 +1,273 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/*
+ * State writer that computes a Merkle hash of the state tree.
+ *
+ * Every object is appended a `__hash__` member, which is the MD5 of its
+ * members' names and values, where nested objects and arrays contribute
+ * with their own hash.  Images are hashed over their raw pixels rather than
+ * over their encoding.
+ *
+ * This allows two state dumps to be compared from the root, descending only
+ * into the objects whose hashes differ.
+ */
+
+
+#include "state_writer.hpp"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "image.hpp"
+#include "md5.h"
+
+
+namespace {
+
+
+enum {
+    DIGEST_SIZE = 16
+};
+
+
+class HashingStateWriter : public StateWriter
+{
+private:
+    StateWriter *writer;
+
+    std::vector<MD5Context> stack;
+
+    // Digest to hash instead of the contents of the next blob
+    bool overrideBlob = false;
+    unsigned char blobDigest[DIGEST_SIZE];
+
+    void
+    update(const void *data, size_t size) {
+        if (!stack.empty()) {
+            MD5Update(&stack.back(), (unsigned char *)data, size);
+        }
+    }
+
+    void
+    update(char tag) {
+        update(&tag, 1);
+    }
+
+    template<typename T>
+    void
+    update(char tag, T value) {
+        update(tag);
+        update(&value, sizeof value);
+    }
+
+    void
+    push(void) {
+        stack.emplace_back();
+        MD5Init(&stack.back());
+    }
+
+    void
+    pop(char tag, unsigned char digest[DIGEST_SIZE]) {
+        assert(!stack.empty());
+        MD5Final(digest, &stack.back());
+        stack.pop_back();
+        update(tag);
+        update(digest, DIGEST_SIZE);
+    }
+
+    void
+    writeHash(const unsigned char digest[DIGEST_SIZE]) {
+        static const char hex[] = "0123456789abcdef";
+        char str[2*DIGEST_SIZE + 1];
+        for (unsigned i = 0; i < DIGEST_SIZE; ++i) {
+            str[2*i    ] = hex[digest[i] >> 4];
+            str[2*i + 1] = hex[digest[i] & 0xf];
+        }
+        str[2*DIGEST_SIZE] = 0;
+
+        writer->beginMember("__hash__");
+        writer->writeString(str);
+        writer->endMember();
+    }
+
+public:
+    HashingStateWriter(StateWriter *_writer) :
+        writer(_writer)
+    {
+        // The wrapped writer implicitly opens the root object
+        push();
+    }
+
+    ~HashingStateWriter() {
+        unsigned char digest[DIGEST_SIZE];
+        pop('{', digest);
+        assert(stack.empty());
+        writeHash(digest);
+
+        delete writer;
+    }
+
+    void
+    beginObject(void) override {
+        writer->beginObject();
+        push();
+    }
+
+    void
+    endObject(void) override {
+        unsigned char digest[DIGEST_SIZE];
+        pop('{', digest);
+        writeHash(digest);
+        writer->endObject();
+    }
+
+    void
+    beginMember(const char * name) override {
+        update(':');
+        update(name, strlen(name) + 1);
+        writer->beginMember(name);
+    }
+
+    void
+    endMember(void) override {
+        writer->endMember();
+    }
+
+    void
+    beginArray(void) override {
+        writer->beginArray();
+        push();
+    }
+
+    void
+    endArray(void) override {
+        unsigned char digest[DIGEST_SIZE];
+        pop('[', digest);
+        writer->endArray();
+    }
+
+    void
+    writeString(const char *s) override {
+        if (!s) {
+            // Written as null, and must not hash like an empty string
+            update('n');
+            writer->writeString(s);
+            return;
+        }
+        update('s');
+        update(s, strlen(s) + 1);
+        writer->writeString(s);
+    }
+
+    void
+    writeBlob(const void *bytes, size_t size) override {
+        if (overrideBlob) {
+            overrideBlob = false;
+            update('p');
+            update(blobDigest, DIGEST_SIZE);
+        } else {
+            update('b', (uint64_t)size);
+            update(bytes, size);
+        }
+        writer->writeBlob(bytes, size);
+    }
+
+    void
+    writeNull(void) override {
+        update('n');
+        writer->writeNull();
+    }
+
+    void
+    writeBool(bool b) override {
+        update(b ? 't' : 'f');
+        writer->writeBool(b);
+    }
+
+    void
+    writeSInt(signed long long i) override {
+        update('i', (int64_t)i);
+        writer->writeSInt(i);
+    }
+
+    void
+    writeUInt(unsigned long long u) override {
+        update('u', (uint64_t)u);
+        writer->writeUInt(u);
+    }
+
+    void
+    writeFloat(float f) override {
+        update('d', (double)f);
+        writer->writeFloat(f);
+    }
+
+    void
+    writeFloat(double f) override {
+        update('d', f);
+        writer->writeFloat(f);
+    }
+
+    void
+    writeImage(image::Image *image, const ImageDesc & desc) override {
+        if (image) {
+            MD5Context md5;
+            MD5Init(&md5);
+            uint32_t header[4] = {
+                image->width,
+                image->height,
+                image->channels,
+                (uint32_t)image->channelType
+            };
+            MD5Update(&md5, (unsigned char *)header, sizeof header);
+            unsigned len = image->width*image->bytesPerPixel;
+            for (const unsigned char *row = image->start(); row != image->end(); row += image->stride()) {
+                MD5Update(&md5, (unsigned char *)row, len);
+            }
+            MD5Final(blobDigest, &md5);
+            overrideBlob = true;
+        }
+
+        StateWriter::writeImage(image, desc);
+
+        assert(!overrideBlob);
+    }
+};
+
+
+}
+
+
+StateWriter *
+createHashingStateWriter(StateWriter *writer)
+{
+    return new HashingStateWriter(writer);
+}
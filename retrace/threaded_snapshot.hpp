@@ -28,6 +28,7 @@
 #include <iostream>
 
 #include "image.hpp"
+#include "image_pack.hpp"
 #include "os_string.hpp"
 #include "thread_pool.hpp"
 #include "retrace.hpp"
@@ -49,6 +50,20 @@ actuallyWritePNG(const os::String& filename, image::Image *image)
 }
 
 
+static void
+actuallyWritePack(image::PackWriter *pack, unsigned callNo,
+                  unsigned snapshotNo, int mrt, image::Image *image)
+{
+    if (!pack->addPNG(callNo, snapshotNo, mrt, *image, !retrace::snapshotAlpha)) {
+        std::cerr << callNo << ": warning: failed to write snapshot to pack\n";
+    } else if (retrace::verbosity >= 1) {
+        std::cout << "Packed snapshot " << snapshotNo << " of call " << callNo << "\n";
+    }
+
+    delete image;
+}
+
+
 /**
  * Write one snapshot at a time, blocking until it is finished.
  */
@@ -62,6 +77,12 @@ public:
     writePNG(const os::String& filename, image::Image *image) {
         actuallyWritePNG(filename, image);
     }
+
+    virtual void
+    writePack(image::PackWriter *pack, unsigned callNo,
+              unsigned snapshotNo, int mrt, image::Image *image) {
+        actuallyWritePack(pack, callNo, snapshotNo, mrt, image);
+    }
 };
 
 
@@ -81,4 +102,10 @@ public:
     writePNG(const os::String& filename, image::Image *image) override {
         pool.enqueue(actuallyWritePNG, filename, image);
     }
+
+    virtual void
+    writePack(image::PackWriter *pack, unsigned callNo,
+              unsigned snapshotNo, int mrt, image::Image *image) override {
+        pool.enqueue(actuallyWritePack, pack, callNo, snapshotNo, mrt, image);
+    }
 };
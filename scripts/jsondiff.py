@@ -33,18 +33,162 @@ import difflib
 import sys
 
 
-def strip_object_hook(obj):
-    if '__class__' in obj:
-        return None
-    for name in obj.keys():
-        if name.startswith('__') and name.endswith('__'):
-            del obj[name]
-    return obj
+# Member added to every object by `glretrace --dump-hashes`, holding a hash of
+# the object's contents.
+HASH = '__hash__'
+
+
+# Characters that delimit values in JSON text, or start a comment.
+_delimiter_re = re.compile(r'["{}\[\],:/]')
+
+# The hash is always the last member of an object.
+_hash_re = re.compile(r'"__hash__"\s*:\s*"([0-9a-f]+)"\s*\}\Z')
+
+_whitespace = ' \t\r\n'
+
+
+def _strip(data, start, end):
+    while start < end and data[start] in _whitespace:
+        start += 1
+    while end > start and data[end - 1] in _whitespace:
+        end -= 1
+    return start, end
+
+
+def _skip_string(data, pos):
+    '''Return the end of the string starting at pos.'''
+    end = pos
+    while True:
+        end = data.index('"', end + 1)
+        backslashes = end - 1
+        while data[backslashes] == '\\':
+            backslashes -= 1
+        if (end - 1 - backslashes) % 2 == 0:
+            return end + 1
+
+
+def _scan(data, start, end):
+    '''Split the object or array in data[start:end] into a list of
+    (name, start, end) tuples, one for each member or element, without parsing
+    their values.'''
+
+    items = []
+    name = None
+    depth = 0
+    pos = start + 1
+    comment = None
+    search = _delimiter_re.search
+    mo = search(data, pos, end)
+    while mo:
+        i = mo.start()
+        c = data[i]
+        if c == '"':
+            # Strings are skipped with find() as they may be very long
+            mo = search(data, _skip_string(data, i), end)
+            continue
+        if c == '/':
+            eol = data.find('\n', i, end)
+            if eol < 0:
+                eol = end
+            if not depth:
+                if data[pos:i].strip():
+                    # Comment after a value
+                    if comment is None:
+                        comment = i
+                else:
+                    pos = eol
+            mo = search(data, eol, end)
+            continue
+        if c in '{[':
+            depth += 1
+        elif depth:
+            if c in '}]':
+                depth -= 1
+        elif c == ':':
+            name = json.loads(data[pos:i], strict=False)
+            pos = i + 1
+        else:
+            # Comma, or the closing bracket
+            vstart, vend = _strip(data, pos, i if comment is None else comment)
+            if vstart < vend:
+                items.append((name, vstart, vend))
+            pos = i + 1
+            comment = None
+        mo = search(data, i + 1, end)
+    return items
+
+
+def _loads(data, start, end):
+    text = data[start:end]
+    if '//' in text:
+        text = _strip_comments(text)
+    return json.loads(text, strict=False)
+
+
+def _value(data, start, end, strip_images):
+    c = data[start]
+    if c == '{':
+        return LazyObject(data, start, end, strip_images)
+    if c == '[':
+        if data.find('{', start, end) < 0:
+            return _loads(data, start, end)
+        return [_value(data, vstart, vend, strip_images) for name, vstart, vend in _scan(data, start, end)]
+    return _loads(data, start, end)
+
+
+class LazyObject:
+    '''JSON object, whose members are only parsed when first needed, so that
+    objects with matching hashes can be skipped without parsing them.'''
+
+    def __init__(self, data, start, end, strip_images):
+        self.data = data
+        self.start = start
+        self.end = end
+        self.strip_images = strip_images
+        self.loaded = False
+        self.obj = None
+
+        mo = _hash_re.search(data, max(start, end - 128), end)
+        if mo:
+            self.hash = mo.group(1)
+        else:
+            self.hash = None
+
+    def load(self):
+        if not self.loaded:
+            self.loaded = True
+            if self.data.find('{', self.start + 1, self.end) < 0:
+                # No nested objects, so parse it in one go
+                obj = _loads(self.data, self.start, self.end)
+            else:
+                obj = {}
+                for name, start, end in _scan(self.data, self.start, self.end):
+                    obj[name] = _value(self.data, start, end, self.strip_images)
+            if self.strip_images:
+                if '__class__' in obj:
+                    return None
+                for name in obj.keys():
+                    if name.startswith('__') and name.endswith('__') and name != HASH:
+                        del obj[name]
+            self.obj = obj
+        return self.obj
+
+
+def resolve(node):
+    '''Parse the node if it is a lazy object.'''
+    if isinstance(node, LazyObject):
+        return node.load()
+    return node
+
+
+def members(obj):
+    return [name for name in obj.keys() if name != HASH]
 
 
 class Visitor:
 
     def visit(self, node, *args, **kwargs):
+        node = resolve(node)
         if isinstance(node, dict):
             return self.visitObject(node, *args, **kwargs)
         elif isinstance(node, list):
@@ -80,14 +224,14 @@ class Dumper(Visitor):
     def visitObject(self, node):
         self.enter_object()
 
-        members = node.keys()
-        members.sort()
-        for i in range(len(members)):
-            name = members[i]
+        names = members(node)
+        names.sort()
+        for i in range(len(names)):
+            name = names[i]
             value = node[name]
             self.enter_member(name)
             self.visit(value)
-            self.leave_member(i == len(members) - 1)
+            self.leave_member(i == len(names) - 1)
         self.leave_object()
 
     def enter_object(self):
@@ -143,13 +287,22 @@ class Comparer(Visitor):
         self.ignore_added = ignore_added
         self.tolerance = tolerance
 
+    def visit(self, a, b):
+        # Equal hashes imply equal contents, so there is no need to parse,
+        # let alone descend into, the objects.  Different hashes don't imply
+        # differences though, as floats are compared with some tolerance.
+        if isinstance(a, LazyObject) and isinstance(b, LazyObject) and \
+           a.hash is not None and a.hash == b.hash:
+            return True
+        return Visitor.visit(self, a, resolve(b))
+
     def visitObject(self, a, b):
         if not isinstance(b, dict):
             return False
-        if len(a) != len(b) and not self.ignore_added:
+        ak = members(a)
+        bk = members(b)
+        if len(ak) != len(bk) and not self.ignore_added:
             return False
-        ak = a.keys()
-        bk = b.keys()
         ak.sort()
         bk.sort()
         if ak != bk and not self.ignore_added:
@@ -199,16 +352,16 @@ class Differ(Visitor):
     def visit(self, a, b):
         if self.comparer.visit(a, b):
             return
-        Visitor.visit(self, a, b)
+        Visitor.visit(self, a, resolve(b))
 
     def visitObject(self, a, b):
         if not isinstance(b, dict):
             self.replace(a, b)
         else:
             self.dumper.enter_object()
-            names = set(a.keys())
+            names = set(members(a))
             if not self.comparer.ignore_added:
-                names.update(b.keys())
+                names.update(members(b))
             names = list(names)
             names.sort()
 
@@ -319,17 +472,19 @@ assert _strip_comments('''// a comment
 "'''
 
 
-def load(stream, strip_images = True, strip_comments = True):
-    if strip_images:
-        object_hook = strip_object_hook
-    else:
-        object_hook = None
-    if strip_comments:
-        data = stream.read()
-        data = _strip_comments(data)
-        return json.loads(data, strict=False, object_hook = object_hook)
-    else:
-        return json.load(stream, strict=False, object_hook = object_hook)
+def load(stream, strip_images = True):
+    '''Load a JSON document, which may have comments.  Objects are returned
+    as LazyObject instances, which the visitors above parse as they are
+    reached, or which can be parsed with resolve().'''
+
+    # Wrapped in an array, so that the document can be scanned like any
+    # other value, comments included
+    data = '[' + stream.read() + '\n]'
+    items = _scan(data, 0, len(data))
+    if len(items) != 1:
+        raise ValueError('expected a single JSON value')
+    name, start, end = items[0]
+    return _value(data, start, end, strip_images)
 
 
 def main():
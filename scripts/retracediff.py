@@ -107,7 +107,7 @@ class Retracer:
         p = self._retrace([
             '-D', str(call_no),
         ])
-        state = jsondiff.load(p.stdout)
+        state = jsondiff.resolve(jsondiff.load(p.stdout))
         p.wait()
         return state.get('parameters', {})
 
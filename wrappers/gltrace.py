@@ -173,6 +173,20 @@ class GlTracer(Tracer):
         print r'static void _trace_user_arrays(gltrace::Context *_ctx, GLuint count);'
         print
 
+        # Whether read-backs must be recorded before the frame window
+        print 'static inline bool _need_pack_buffer_readback(void)'
+        print '{'
+        print '    if (trace::localWriter.isRecordingReadbacks()) {'
+        print '        return false;'
+        print '    }'
+        print
+        print '    // Read-backs into a pixel pack buffer change its contents'
+        print '    gltrace::Context *_ctx = gltrace::getContext();'
+        print '    return _ctx->features.pixel_buffer_object &&'
+        print '           _glGetInteger(GL_PIXEL_PACK_BUFFER_BINDING) != 0;'
+        print '}'
+        print
+
         # Declare helper functions to emit fake function calls into the trace
         for function in api.getAllFunctions():
             if function.name in self.fake_function_names:
@@ -425,7 +439,9 @@ class GlTracer(Tracer):
         if mo:
             functionRadical = mo.group('radical')
             print '    gltrace::Context *_ctx = gltrace::getContext();'
-            print '    if (_need_user_arrays(_ctx)) {'
+            # No need to serialize user arrays of draw calls that will be
+            # discarded due to TRACE_FRAMES
+            print '    if (_need_user_arrays(_ctx) && trace::localWriter.isRecordingRender()) {'
             if 'Indirect' in function.name:
                 print r'        os::log("apitrace: warning: %s: indirect user arrays not supported\n");' % (function.name,)
             else:
@@ -856,6 +872,23 @@ class GlTracer(Tracer):
         r'(Compressed)?(Multi)?Tex(ture)?(Sub)?Image[1-4]D',
     ]) + r')[0-9A-Z]*$')
 
+    # Regular expression for the names of the functions that pack into a
+    # pixel buffer object.  See the ARB_pixel_buffer_object specification.
+    pack_function_regex = re.compile(r'^gl(' + r'|'.join([
+        r'Getn?Histogram',
+        r'Getn?PolygonStipple',
+        r'Getn?PixelMap[a-z]+v',
+        r'Getn?Minmax',
+        r'Getn?(Convolution|Separable)Filter',
+        r'Getn?(Compressed)?(Multi)?Tex(ture)?(Sub)?Image',
+        r'Readn?Pixels',
+    ]) + r')[0-9A-Z]*$')
+
+    def beginEnterExtraArgs(self, function):
+        if self.pack_function_regex.match(function.name):
+            return ', false, _need_pack_buffer_readback()'
+        return Tracer.beginEnterExtraArgs(self, function)
+
     def serializeArgValue(self, function, arg):
         # Recognize offsets instead of blobs when a PBO is bound
         if self.unpack_function_regex.match(function.name) \
@@ -0,0 +1,277 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Stress benchmark for the tracer's context lookup, with several threads
+ * repeatedly making contexts current, as done by applications that rebind
+ * contexts per job on worker thread pools.
+ *
+ * No GL is involved: only the handle to context state mapping is measured,
+ * comparing the per-thread cached lookup against a plain locked map.
+ */
+
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "os_thread.hpp"
+#include "os_time.hpp"
+#include "gltrace_context_map.hpp"
+
+
+using namespace gltrace;
+
+
+struct Context
+{
+    unsigned retain_count = 0;
+};
+
+
+/**
+ * How lookups were done before the per-thread cache.
+ */
+class LockedContextMap
+{
+    std::map<uintptr_t, std::shared_ptr<Context>> map;
+    os::recursive_mutex mutex;
+
+public:
+    void
+    create(uintptr_t context_id) {
+        mutex.lock();
+        map[context_id] = std::make_shared<Context>();
+        mutex.unlock();
+    }
+
+    std::shared_ptr<Context>
+    lookup(uintptr_t context_id) {
+        std::shared_ptr<Context> ctx;
+        mutex.lock();
+        ctx = map[context_id];
+        mutex.unlock();
+        return ctx;
+    }
+};
+
+
+struct Options
+{
+    unsigned numThreads = 8;
+    unsigned numContexts = 4;
+    unsigned long long iterations = 1000000;
+};
+
+
+static inline uintptr_t
+contextId(const Options &options, unsigned thread, unsigned long long i)
+{
+    // Each thread cycles over all contexts, starting at a different one
+    return 1 + (thread + i) % options.numContexts;
+}
+
+
+static void
+runLocked(const Options &options, LockedContextMap &map, unsigned thread)
+{
+    std::shared_ptr<Context> current;
+    for (unsigned long long i = 0; i < options.iterations; ++i) {
+        current = map.lookup(contextId(options, thread, i));
+        assert(current);
+    }
+}
+
+
+static void
+runCached(const Options &options, ContextMap<Context> &map, unsigned thread,
+          bool mustExist = true)
+{
+    ContextCache<Context> cache;
+    Context *current = nullptr;
+    for (unsigned long long i = 0; i < options.iterations; ++i) {
+        current = cache.lookup(map, contextId(options, thread, i));
+        assert(current || !mustExist);
+    }
+    (void)current;
+    (void)mustExist;
+}
+
+
+template< class Function >
+static double
+runThreads(const Options &options, Function function)
+{
+    std::vector<os::thread> threads;
+    long long startTime = os::getTime();
+    for (unsigned thread = 0; thread < options.numThreads; ++thread) {
+        threads.emplace_back(function, thread);
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    long long endTime = os::getTime();
+    return double(endTime - startTime) / os::timeFrequency;
+}
+
+
+static void
+report(const char *name, const Options &options, double seconds)
+{
+    double lookups = double(options.iterations) * options.numThreads;
+    std::cout
+        << std::left << std::setw(12) << name
+        << std::right
+        << std::setw(8) << options.numThreads
+        << std::setw(10) << options.numContexts
+        << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e3
+        << std::setw(12) << std::setprecision(1) << seconds * 1e9 / lookups
+        << "\n";
+}
+
+
+static const char *synopsis = "Stress context lookup from many threads.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: gltrace_context_bench [OPTIONS]\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help             show this help message and exit\n"
+        "    --threads=N            number of threads [default: 8]\n"
+        "    --contexts=N           number of contexts each thread cycles over [default: 4]\n"
+        "    --iterations=N         MakeCurrent calls per thread [default: 1000000]\n"
+        "\n"
+    ;
+}
+
+enum {
+    THREADS_OPT = CHAR_MAX + 1,
+    CONTEXTS_OPT,
+    ITERATIONS_OPT,
+};
+
+const static char *
+shortOptions = "h";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"threads", required_argument, 0, THREADS_OPT},
+    {"contexts", required_argument, 0, CONTEXTS_OPT},
+    {"iterations", required_argument, 0, ITERATIONS_OPT},
+    {0, 0, 0, 0}
+};
+
+
+int
+main(int argc, char **argv)
+{
+    Options options;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case THREADS_OPT:
+            options.numThreads = strtoul(optarg, NULL, 0);
+            break;
+        case CONTEXTS_OPT:
+            options.numContexts = strtoul(optarg, NULL, 0);
+            break;
+        case ITERATIONS_OPT:
+            options.iterations = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (!options.numThreads || !options.numContexts) {
+        std::cerr << "error: at least one thread and one context are required\n";
+        return 1;
+    }
+
+    LockedContextMap lockedMap;
+    ContextMap<Context> cachedMap;
+    for (unsigned i = 1; i <= options.numContexts; ++i) {
+        lockedMap.create(i);
+        cachedMap.create(i);
+    }
+
+    std::cout
+        << std::left << std::setw(12) << "lookup"
+        << std::right
+        << std::setw(8) << "threads"
+        << std::setw(10) << "contexts"
+        << std::setw(12) << "ms"
+        << std::setw(12) << "ns/call"
+        << "\n";
+
+    double seconds;
+
+    seconds = runThreads(options, [&] (unsigned thread) {
+        runLocked(options, lockedMap, thread);
+    });
+    report("locked", options, seconds);
+
+    seconds = runThreads(options, [&] (unsigned thread) {
+        runCached(options, cachedMap, thread);
+    });
+    report("cached", options, seconds);
+
+    // Destroy and recreate contexts while other threads keep binding them,
+    // to exercise cache invalidation
+    os::thread churn([&] () {
+        for (unsigned long long i = 0; i < options.iterations / 1000; ++i) {
+            uintptr_t context_id = 1 + i % options.numContexts;
+            cachedMap.retain(context_id);
+            cachedMap.release(context_id);
+            cachedMap.release(context_id);
+            cachedMap.create(context_id);
+        }
+    });
+    seconds = runThreads(options, [&] (unsigned thread) {
+        // Contexts might be momentarily missing while being recreated
+        runCached(options, cachedMap, thread, false);
+    });
+    churn.join();
+    report("churn", options, seconds);
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Context handle to tracer context state mapping.
+ *
+ * Creating and destroying contexts is rare, but applications may make
+ * contexts current at a high rate from many threads, so lookups go through
+ * a small per-thread cache that neither takes the map lock nor touches the
+ * shared_ptr reference counts on a hit.  Cached entries are invalidated by
+ * a generation counter, which is bumped whenever a context is destroyed.
+ */
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include "os_thread.hpp"
+
+
+namespace gltrace {
+
+
+template< class Context >
+class ContextMap
+{
+public:
+    typedef std::shared_ptr<Context> pointer;
+
+private:
+    std::map<uintptr_t, pointer> map;
+    os::recursive_mutex mutex;
+    std::atomic<unsigned> generation;
+
+public:
+    ContextMap() :
+        generation(0)
+    {}
+
+    /**
+     * Returns false if the context was already defined.
+     */
+    bool
+    create(uintptr_t context_id) {
+        bool created = false;
+        mutex.lock();
+        if (map.find(context_id) == map.end()) {
+            pointer ctx(new Context);
+            ctx->retain_count++;
+            map[context_id] = ctx;
+            created = true;
+        }
+        mutex.unlock();
+        return created;
+    }
+
+    void
+    retain(uintptr_t context_id) {
+        mutex.lock();
+        auto it = map.find(context_id);
+        if (it != map.end()) {
+            it->second->retain_count++;
+        }
+        mutex.unlock();
+    }
+
+    /**
+     * Returns true if the context was destroyed, false if only its refcount
+     * got decreased.
+     */
+    bool
+    release(uintptr_t context_id) {
+        bool destroyed = false;
+        mutex.lock();
+        auto it = map.find(context_id);
+        if (it != map.end() &&
+            !--it->second->retain_count) {
+            map.erase(it);
+            // The handle may be reused for a new context, so invalidate caches
+            generation.fetch_add(1, std::memory_order_release);
+            destroyed = true;
+        }
+        mutex.unlock();
+        return destroyed;
+    }
+
+    pointer
+    lookup(uintptr_t context_id) {
+        pointer ctx;
+        mutex.lock();
+        auto it = map.find(context_id);
+        if (it != map.end()) {
+            ctx = it->second;
+        }
+        mutex.unlock();
+        return ctx;
+    }
+
+    inline unsigned
+    getGeneration(void) const {
+        return generation.load(std::memory_order_acquire);
+    }
+};
+
+
+/**
+ * Per-thread cache of ContextMap lookups.
+ *
+ * The context returned by the last lookup is never evicted, and is kept
+ * alive until the next lookup even if destroyed meanwhile, as it might still
+ * be current.
+ */
+template< class Context, unsigned Size = 4 >
+class ContextCache
+{
+public:
+    typedef typename ContextMap<Context>::pointer pointer;
+
+private:
+    struct Entry {
+        uintptr_t id = 0;
+        pointer ctx;
+    };
+
+    Entry entries[Size];
+    pointer pinned;
+    unsigned generation = ~0U;
+    unsigned current = 0;
+    unsigned victim = 0;
+
+public:
+    Context *
+    lookup(ContextMap<Context> &map, uintptr_t context_id) {
+        unsigned current_generation = map.getGeneration();
+        if (generation != current_generation) {
+            pinned = std::move(entries[current].ctx);
+            for (auto & entry : entries) {
+                entry.ctx.reset();
+            }
+            generation = current_generation;
+        }
+
+        for (unsigned i = 0; i < Size; ++i) {
+            if (entries[i].id == context_id && entries[i].ctx) {
+                current = i;
+                return entries[i].ctx.get();
+            }
+        }
+
+        pointer ctx = map.lookup(context_id);
+        if (!ctx) {
+            return nullptr;
+        }
+
+        // Round-robin replacement, sparing the current context
+        if (victim == current) {
+            victim = (victim + 1) % Size;
+        }
+        current = victim;
+        victim = (victim + 1) % Size;
+
+        entries[current].id = context_id;
+        entries[current].ctx = std::move(ctx);
+        return entries[current].ctx.get();
+    }
+};
+
+
+} /* namespace gltrace */
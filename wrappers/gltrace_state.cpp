@@ -27,30 +27,31 @@
 
 #include <assert.h>
 
-#include <map>
 #include <memory>
 
 #include <os_thread.hpp>
 #include <glproc.hpp>
 #include <gltrace.hpp>
+#include <gltrace_context_map.hpp>
 
 namespace gltrace {
 
 typedef std::shared_ptr<Context> context_ptr_t;
-static std::map<uintptr_t, context_ptr_t> context_map;
-static os::recursive_mutex context_map_mutex;
+static ContextMap<Context> context_map;
 
 class ThreadState {
 public:
-    context_ptr_t current_context;
+    Context *current_context;
     context_ptr_t dummy_context;     /*
                                       * For cases when there is no current
                                       * context, but the app still calls some
                                       * GL function that expects one.
                                       */
+    ContextCache<Context> context_cache;
+
     ThreadState() : dummy_context(new Context)
     {
-        current_context = dummy_context;
+        current_context = dummy_context.get();
     }
 };
 
@@ -66,77 +67,40 @@ static ThreadState *get_ts(void)
     return ts;
 }
 
-static void _retainContext(context_ptr_t ctx)
-{
-    ctx->retain_count++;
-}
-
 void retainContext(uintptr_t context_id)
 {
-    context_map_mutex.lock();
-    if (context_map.find(context_id) != context_map.end())
-        _retainContext(context_map[context_id]);
-    context_map_mutex.unlock();
-}
-
-static bool _releaseContext(context_ptr_t ctx)
-{
-    return !(--ctx->retain_count);
+    context_map.retain(context_id);
 }
 
 /*
  * return true if the context was destroyed, false if only its refcount
  * got decreased. Note that even if the context was destroyed it may
  * still live, if it's the currently selected context (by setContext).
+ *
+ * This can potentially called (from glX) with an invalid context_id,
+ * so don't assert on it being valid.
  */
 bool releaseContext(uintptr_t context_id)
 {
-    bool res = false;
-
-    context_map_mutex.lock();
-    /*
-     * This can potentially called (from glX) with an invalid context_id,
-     * so don't assert on it being valid.
-     */
-    if (context_map.find(context_id) != context_map.end()) {
-        res = _releaseContext(context_map[context_id]);
-        if (res)
-            context_map.erase(context_id);
-    }
-    context_map_mutex.unlock();
-
-    return res;
+    return context_map.release(context_id);
 }
 
 void createContext(uintptr_t context_id)
 {
     // wglCreateContextAttribsARB causes internal calls to wglCreateContext to be
     // traced, causing context to be defined twice.
-    if (context_map.find(context_id) != context_map.end()) {
-        return;
-    }
-
-    context_ptr_t ctx(new Context);
-
-    context_map_mutex.lock();
-
-    _retainContext(ctx);
-    context_map[context_id] = ctx;
-
-    context_map_mutex.unlock();
+    context_map.create(context_id);
 }
 
 void setContext(uintptr_t context_id)
 {
     ThreadState *ts = get_ts();
-    context_ptr_t ctx;
-
-    context_map_mutex.lock();
-
-    assert(context_map.find(context_id) != context_map.end());
-    ctx = context_map[context_id];
 
-    context_map_mutex.unlock();
+    Context *ctx = ts->context_cache.lookup(context_map, context_id);
+    assert(ctx);
+    if (!ctx) {
+        return;
+    }
 
     ts->current_context = ctx;
 
@@ -181,12 +145,12 @@ void clearContext(void)
 {
     ThreadState *ts = get_ts();
 
-    ts->current_context = ts->dummy_context;
+    ts->current_context = ts->dummy_context.get();
 }
 
 Context *getContext(void)
 {
-    return get_ts()->current_context.get();
+    return get_ts()->current_context;
 }
 
 }
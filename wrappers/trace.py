@@ -364,6 +364,24 @@ class WrapDecider(stdapi.Traverser):
         self.needsWrapping = True
 
 
+class BlobDetector(stdapi.Traverser):
+    '''Type visitor which will decide whether this type may contain blobs,
+    whose sizes are still needed in call log mode.
+    '''
+
+    def __init__(self):
+        self.hasBlob = False
+
+    def visitBlob(self, blob):
+        self.hasBlob = True
+
+    def visitObjPointer(self, pointer):
+        pass
+
+    def visitInterface(self, interface):
+        pass
+
+
 class ValueWrapper(stdapi.Traverser, stdapi.ExpanderMixin):
     '''Type visitor which will generate the code to wrap an instance.
     
@@ -574,7 +592,7 @@ class Tracer:
 
     def traceFunctionImplBody(self, function):
         if not function.internal:
-            print '    unsigned _call = trace::localWriter.beginEnter(&_%s_sig);' % (function.name,)
+            print '    unsigned _call = trace::localWriter.beginEnter(&_%s_sig%s);' % (function.name, self.beginEnterExtraArgs(function))
             for arg in function.args:
                 if not arg.output:
                     self.serializeArg(function, arg)
@@ -594,6 +612,10 @@ class Tracer:
                 self.wrapRet(function, "_result")
             print '    trace::localWriter.endLeave();'
 
+    def beginEnterExtraArgs(self, function):
+        # Additional LocalWriter::beginEnter arguments
+        return ''
+
     def invokeFunction(self, function):
         self.doInvokeFunction(function)
 
@@ -614,9 +636,15 @@ class Tracer:
         return 'true'
 
     def serializeArg(self, function, arg):
+        # Values without blobs are of no use in call log mode
+        hasBlob = self.hasBlob(arg.type)
+        if not hasBlob:
+            print '    if (!trace::localWriter.isCallLogging()) {'
         print '    trace::localWriter.beginArg(%u);' % (arg.index,)
         self.serializeArgValue(function, arg)
         print '    trace::localWriter.endArg();'
+        if not hasBlob:
+            print '    }'
 
     def serializeArgValue(self, function, arg):
         self.serializeValue(arg.type, arg.name)
@@ -642,9 +670,14 @@ class Tracer:
         self.unwrapValue(arg.type, arg.name)
 
     def serializeRet(self, function, instance):
+        hasBlob = self.hasBlob(function.type)
+        if not hasBlob:
+            print '    if (!trace::localWriter.isCallLogging()) {'
         print '    trace::localWriter.beginReturn();'
         self.serializeValue(function.type, instance)
         print '    trace::localWriter.endReturn();'
+        if not hasBlob:
+            print '    }'
 
     def serializeValue(self, type, instance):
         serializer = self.serializerFactory()
@@ -653,6 +686,11 @@ class Tracer:
     def wrapRet(self, function, instance):
         self.wrapValue(function.type, instance)
 
+    def hasBlob(self, type):
+        visitor = BlobDetector()
+        visitor.visit(type)
+        return visitor.hasBlob
+
     def needsWrapping(self, type):
         visitor = WrapDecider()
         visitor.visit(type)